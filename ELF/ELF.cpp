@@ -0,0 +1,748 @@
+#include "ELF.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Allocation caps, counts come straight from the file
+static const uint64_t max_segments = 65536;
+static const uint64_t max_sections = 65536;
+static const uint64_t max_symbols = 1 << 22;
+static const uint64_t max_dynamic = 65536;
+static const size_t max_string = 4096;
+
+ELF::ELF(ByteSource& source, Arena* parse_arena) : owned_arena(parse_arena == nullptr ? std::make_unique<Arena>() : nullptr), arena(parse_arena == nullptr ? owned_arena.get() : parse_arena), source_(source)
+{
+}
+
+template<typename T>
+T ELF::fix(T value) const
+{
+    if(!big_endian)
+        return value;
+
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    std::memcpy(&value, bytes, sizeof(T));
+
+    return value;
+}
+
+// Table entries can sit at any offset, they're copied out rather than read in place
+template<typename T>
+bool ELF::read_entry(uint64_t offset, T& out)
+{
+    ByteSpan span = source_.view(offset, sizeof(T));
+    if(span.empty())
+        return false;
+
+    std::memcpy(&out, span.data(), sizeof(T));
+
+    return true;
+}
+
+void ELF::report(ELFIssue issue, const char* field, uint64_t offset, uint64_t value, bool fatal)
+{
+    // A garbage section table can have an issue per entry, the first ones say enough
+    const size_t max_diagnostics = 256;
+
+    if(diagnostics.size() < max_diagnostics || fatal)
+        diagnostics.push_back({ issue, fatal, field, offset, value });
+}
+
+const char* ELF::describe_issue(ELFIssue issue)
+{
+    switch (issue)
+    {
+        case ELFIssue::TruncatedHeader: return "File is too small for an ELF header";
+        case ELFIssue::BadMagic: return "Executeable isn't in ELF format";
+        case ELFIssue::UnknownClass: return "ELF class is neither 32 nor 64 bit";
+        case ELFIssue::UnknownByteOrder: return "ELF byte order is neither little nor big endian";
+        case ELFIssue::BadEntrySize: return "Table entries are smaller than their structure";
+        case ELFIssue::ProgramHeadersTruncated: return "Program headers run past the end of the file";
+        case ELFIssue::SectionHeadersTruncated: return "Section headers run past the end of the file";
+        case ELFIssue::BadStringTable: return "String table index doesn't name a section in the file";
+        case ELFIssue::SectionDataOutOfBounds: return "Section data runs past the end of the file";
+        case ELFIssue::TableLimit: return "Table cut short at its size limit";
+    }
+
+    return "Unknown issue";
+}
+
+const char* ELF::get_machine_name(uint16_t machine)
+{
+    switch (machine)
+    {
+        case 0: return "None";
+        case 2: return "SPARC";
+        case 3: return "x86";
+        case 8: return "MIPS";
+        case 20: return "PowerPC";
+        case 21: return "PowerPC 64-bit";
+        case 22: return "IBM S/390";
+        case 40: return "ARM";
+        case 42: return "SuperH";
+        case 43: return "SPARC V9";
+        case 50: return "Intel Itanium processor family";
+        case 62: return "x64";
+        case 183: return "ARM64";
+        case 243: return "RISC-V";
+        case 247: return "eBPF";
+        case 258: return "LoongArch";
+        default: return "Unknown Architecture";
+    }
+}
+
+const char* ELF::get_type_name(uint16_t type)
+{
+    switch (type)
+    {
+        case 0: return "None";
+        case 1: return "Relocatable";
+        case 2: return "Executable";
+        case 3: return "Shared object";
+        case 4: return "Core";
+        default: return "Unknown";
+    }
+}
+
+const char* ELF::get_segment_type_name(uint32_t type)
+{
+    switch (type)
+    {
+        case 0: return "NULL";
+        case PT_LOAD: return "LOAD";
+        case PT_DYNAMIC: return "DYNAMIC";
+        case PT_INTERP: return "INTERP";
+        case 4: return "NOTE";
+        case 5: return "SHLIB";
+        case 6: return "PHDR";
+        case 7: return "TLS";
+        case 0x6474E550: return "GNU_EH_FRAME";
+        case 0x6474E551: return "GNU_STACK";
+        case 0x6474E552: return "GNU_RELRO";
+        case 0x6474E553: return "GNU_PROPERTY";
+        default: return "Unknown";
+    }
+}
+
+const char* ELF::get_section_type_name(uint32_t type)
+{
+    switch (type)
+    {
+        case 0: return "NULL";
+        case 1: return "PROGBITS";
+        case SHT_SYMTAB: return "SYMTAB";
+        case SHT_STRTAB: return "STRTAB";
+        case 4: return "RELA";
+        case 5: return "HASH";
+        case SHT_DYNAMIC: return "DYNAMIC";
+        case 7: return "NOTE";
+        case SHT_NOBITS: return "NOBITS";
+        case 9: return "REL";
+        case 10: return "SHLIB";
+        case SHT_DYNSYM: return "DYNSYM";
+        case 14: return "INIT_ARRAY";
+        case 15: return "FINI_ARRAY";
+        case 16: return "PREINIT_ARRAY";
+        case 17: return "GROUP";
+        case 18: return "SYMTAB_SHNDX";
+        case 0x6FFFFFF6: return "GNU_HASH";
+        case 0x6FFFFFFD: return "VERDEF";
+        case 0x6FFFFFFE: return "VERNEED";
+        case 0x6FFFFFFF: return "VERSYM";
+        default: return "Unknown";
+    }
+}
+
+const char* ELF::get_dynamic_tag_name(int64_t tag)
+{
+    switch (tag)
+    {
+        case DT_NULL: return "NULL";
+        case DT_NEEDED: return "NEEDED";
+        case 2: return "PLTRELSZ";
+        case 3: return "PLTGOT";
+        case 4: return "HASH";
+        case DT_STRTAB: return "STRTAB";
+        case 6: return "SYMTAB";
+        case 7: return "RELA";
+        case 8: return "RELASZ";
+        case 9: return "RELAENT";
+        case DT_STRSZ: return "STRSZ";
+        case 11: return "SYMENT";
+        case 12: return "INIT";
+        case 13: return "FINI";
+        case DT_SONAME: return "SONAME";
+        case DT_RPATH: return "RPATH";
+        case 16: return "SYMBOLIC";
+        case 17: return "REL";
+        case 18: return "RELSZ";
+        case 19: return "RELENT";
+        case 20: return "PLTREL";
+        case 21: return "DEBUG";
+        case 22: return "TEXTREL";
+        case 23: return "JMPREL";
+        case 24: return "BIND_NOW";
+        case 25: return "INIT_ARRAY";
+        case 26: return "FINI_ARRAY";
+        case 27: return "INIT_ARRAYSZ";
+        case 28: return "FINI_ARRAYSZ";
+        case DT_RUNPATH: return "RUNPATH";
+        case 30: return "FLAGS";
+        case 32: return "PREINIT_ARRAY";
+        case 33: return "PREINIT_ARRAYSZ";
+        case 0x6FFFFEF5: return "GNU_HASH";
+        case 0x6FFFFFF0: return "VERSYM";
+        case 0x6FFFFFF9: return "RELACOUNT";
+        case 0x6FFFFFFA: return "RELCOUNT";
+        case 0x6FFFFFFB: return "FLAGS_1";
+        case 0x6FFFFFFE: return "VERNEED";
+        case 0x6FFFFFFF: return "VERNEEDNUM";
+        default: return "Unknown";
+    }
+}
+
+const char* ELF::get_symbol_binding_name(uint8_t info)
+{
+    switch (info >> 4)
+    {
+        case 0: return "LOCAL";
+        case 1: return "GLOBAL";
+        case 2: return "WEAK";
+        case 10: return "UNIQUE";
+        default: return "Unknown";
+    }
+}
+
+const char* ELF::get_symbol_type_name(uint8_t info)
+{
+    switch (info & 0xF)
+    {
+        case 0: return "NOTYPE";
+        case 1: return "OBJECT";
+        case 2: return "FUNC";
+        case 3: return "SECTION";
+        case 4: return "FILE";
+        case 5: return "COMMON";
+        case 6: return "TLS";
+        case 10: return "IFUNC";
+        default: return "Unknown";
+    }
+}
+
+Span<ELFDiagnostic> ELF::get_diagnostics()
+{
+    get_header();
+
+    return Span<ELFDiagnostic>(diagnostics.data(), diagnostics.size());
+}
+
+const char* ELF::get_error()
+{
+    if(get_header() != nullptr)
+        return nullptr;
+
+    return diagnostics.empty() ? "Invalid ELF header" : describe_issue(diagnostics.front().issue);
+}
+
+template<typename Flavour>
+bool ELF::load_header()
+{
+    using Ehdr = typename Flavour::Ehdr;
+
+    Ehdr raw;
+    if(!read_entry(0, raw))
+    {
+        report(ELFIssue::TruncatedHeader, "Elf_Ehdr", 0, source_.size(), true);
+        return false;
+    }
+
+    std::memcpy(header.e_ident, raw.e_ident, EI_NIDENT);
+    header.e_type = fix(raw.e_type);
+    header.e_machine = fix(raw.e_machine);
+    header.e_version = fix(raw.e_version);
+    header.e_entry = fix(raw.e_entry);
+    header.e_phoff = fix(raw.e_phoff);
+    header.e_shoff = fix(raw.e_shoff);
+    header.e_flags = fix(raw.e_flags);
+    header.e_ehsize = fix(raw.e_ehsize);
+    header.e_phentsize = fix(raw.e_phentsize);
+    header.e_phnum = fix(raw.e_phnum);
+    header.e_shentsize = fix(raw.e_shentsize);
+    header.e_shnum = fix(raw.e_shnum);
+    header.e_shstrndx = fix(raw.e_shstrndx);
+
+    segment_count = header.e_phnum;
+    section_count = header.e_shnum;
+    section_names = header.e_shstrndx;
+
+    if(header.e_phnum > 0 && header.e_phentsize < sizeof(typename Flavour::Phdr))
+    {
+        report(ELFIssue::BadEntrySize, "e_phentsize", offsetof(Ehdr, e_phentsize), header.e_phentsize);
+        segment_count = 0;
+    }
+
+    if(header.e_shoff != 0 && header.e_shentsize < sizeof(typename Flavour::Shdr))
+    {
+        report(ELFIssue::BadEntrySize, "e_shentsize", offsetof(Ehdr, e_shentsize), header.e_shentsize);
+        section_count = 0;
+
+        return true;
+    }
+
+    // Counts that don't fit in the header live in the first section header
+    if(header.e_shoff != 0 && (header.e_shnum == 0 || header.e_shstrndx == SHN_XINDEX || header.e_phnum == PN_XNUM))
+    {
+        typename Flavour::Shdr first;
+        if(read_entry(header.e_shoff, first))
+        {
+            if(header.e_shnum == 0)
+                section_count = fix(first.sh_size);
+
+            if(header.e_shstrndx == SHN_XINDEX)
+                section_names = fix(first.sh_link);
+
+            if(header.e_phnum == PN_XNUM)
+                segment_count = fix(first.sh_info);
+        }
+    }
+
+    return true;
+}
+
+const Elf64_Ehdr* ELF::get_header()
+{
+    if(!header_checked)
+    {
+        header_checked = true;
+
+        const uint8_t* ident = source_.view(0, EI_NIDENT).data();
+        if(ident == nullptr)
+            report(ELFIssue::TruncatedHeader, "e_ident", 0, source_.size(), true);
+        else if(ident[0] != 0x7F || ident[1] != 'E' || ident[2] != 'L' || ident[3] != 'F')
+            report(ELFIssue::BadMagic, "e_ident", 0, ident[0], true);
+        else if(ident[EI_DATA] != ELFDATA2LSB && ident[EI_DATA] != ELFDATA2MSB)
+            report(ELFIssue::UnknownByteOrder, "e_ident[EI_DATA]", EI_DATA, ident[EI_DATA], true);
+        else
+        {
+            big_endian = ident[EI_DATA] == ELFDATA2MSB;
+
+            if(ident[EI_CLASS] == ELFCLASS32)
+                header_valid = load_header<ELF32>();
+            else if(ident[EI_CLASS] == ELFCLASS64)
+                header_valid = load_header<ELF64>();
+            else
+                report(ELFIssue::UnknownClass, "e_ident[EI_CLASS]", EI_CLASS, ident[EI_CLASS], true);
+        }
+    }
+
+    return header_valid ? &header : nullptr;
+}
+
+bool ELF::is_64bit()
+{
+    return get_header() != nullptr && header.e_ident[EI_CLASS] == ELFCLASS64;
+}
+
+bool ELF::is_big_endian()
+{
+    get_header();
+
+    return big_endian;
+}
+
+template<typename Flavour>
+void ELF::parse_segments()
+{
+    using Phdr = typename Flavour::Phdr;
+
+    uint64_t count = segment_count;
+    if(count > max_segments)
+    {
+        report(ELFIssue::TableLimit, "e_phnum", ELF_NO_OFFSET, count);
+        count = max_segments;
+    }
+
+    segments.reserve(std::min<uint64_t>(count, source_.size() / sizeof(Phdr)));
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t offset = header.e_phoff + i * header.e_phentsize;
+        Phdr raw;
+
+        if(offset < header.e_phoff || !read_entry(offset, raw))
+        {
+            report(ELFIssue::ProgramHeadersTruncated, "e_phoff", ELF_NO_OFFSET, i);
+            break;
+        }
+
+        segments.push_back({ fix(raw.p_type), fix(raw.p_flags), fix(raw.p_offset), fix(raw.p_vaddr), fix(raw.p_paddr), fix(raw.p_filesz),
+            fix(raw.p_memsz), fix(raw.p_align) });
+    }
+}
+
+Span<ELFSegment> ELF::get_segments()
+{
+    if(!segments_parsed && get_header() != nullptr)
+    {
+        segments_parsed = true;
+
+        if(is_64bit())
+            parse_segments<ELF64>();
+        else
+            parse_segments<ELF32>();
+    }
+
+    return Span<ELFSegment>(segments.data(), segments.size());
+}
+
+template<typename Flavour>
+void ELF::parse_sections()
+{
+    using Shdr = typename Flavour::Shdr;
+
+    uint64_t count = header.e_shoff != 0 ? section_count : 0;
+    if(count > max_sections)
+    {
+        report(ELFIssue::TableLimit, "e_shnum", ELF_NO_OFFSET, count);
+        count = max_sections;
+    }
+
+    sections.reserve(std::min<uint64_t>(count, source_.size() / sizeof(Shdr)));
+
+    // Names are resolved once the string table's own header has been read
+    std::vector<uint32_t> name_offsets;
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t offset = header.e_shoff + i * header.e_shentsize;
+        Shdr raw;
+
+        if(offset < header.e_shoff || !read_entry(offset, raw))
+        {
+            report(ELFIssue::SectionHeadersTruncated, "e_shoff", ELF_NO_OFFSET, i);
+            break;
+        }
+
+        ELFSection section = { {}, fix(raw.sh_type), fix(raw.sh_flags), fix(raw.sh_addr), fix(raw.sh_offset), fix(raw.sh_size), fix(raw.sh_link),
+            fix(raw.sh_info), fix(raw.sh_addralign), fix(raw.sh_entsize) };
+
+        if(section.type != SHT_NOBITS && (section.offset > source_.size() || section.size > source_.size() - section.offset))
+            report(ELFIssue::SectionDataOutOfBounds, "sh_offset", offset + offsetof(Shdr, sh_offset), section.offset);
+
+        sections.push_back(section);
+        name_offsets.push_back(fix(raw.sh_name));
+    }
+
+    if(!sections.empty() && section_names >= sections.size())
+    {
+        report(ELFIssue::BadStringTable, "e_shstrndx", offsetof(typename Flavour::Ehdr, e_shstrndx), section_names);
+        return;
+    }
+
+    for (size_t i = 0; i < sections.size(); ++i)
+        sections[i].name = get_string(section_names, name_offsets[i]);
+}
+
+Span<ELFSection> ELF::get_sections()
+{
+    if(!sections_parsed && get_header() != nullptr)
+    {
+        sections_parsed = true;
+
+        if(is_64bit())
+            parse_sections<ELF64>();
+        else
+            parse_sections<ELF32>();
+    }
+
+    return Span<ELFSection>(sections.data(), sections.size());
+}
+
+std::string_view ELF::get_string(uint32_t table, uint64_t offset)
+{
+    Span<ELFSection> all = get_sections();
+    if(table >= all.size() || all[table].type == SHT_NOBITS || offset >= all[table].size)
+        return {};
+
+    const ELFSection& section = all[table];
+    if(section.offset > source_.size() || offset > source_.size() - section.offset)
+        return {};
+
+    return read_string(section.offset + offset, std::min(section.size - offset, source_.size() - section.offset - offset));
+}
+
+std::string_view ELF::read_string(uint64_t offset, uint64_t limit)
+{
+    ByteSpan data = source_.view(offset, std::min<uint64_t>(limit, max_string));
+    if(data.empty())
+        return {};
+
+    const char* text = reinterpret_cast<const char*>(data.data());
+    const void* end = std::memchr(text, '\0', data.size());
+
+    return std::string_view(text, end != nullptr ? static_cast<const char*>(end) - text : data.size());
+}
+
+template<typename Flavour>
+void ELF::parse_symbols(uint32_t type, ArenaVector<ELFSymbol>& out)
+{
+    using Sym = typename Flavour::Sym;
+
+    for (const ELFSection& section : get_sections())
+    {
+        if(section.type != type)
+            continue;
+
+        uint64_t entry_size = section.entsize != 0 ? section.entsize : sizeof(Sym);
+        if(entry_size < sizeof(Sym))
+        {
+            report(ELFIssue::BadEntrySize, "sh_entsize", ELF_NO_OFFSET, section.entsize);
+            continue;
+        }
+
+        uint64_t size = section.size;
+        if(section.offset > source_.size())
+            size = 0;
+        else if(size > source_.size() - section.offset)
+            size = source_.size() - section.offset;
+
+        uint64_t count = size / entry_size;
+        if(out.size() + count > max_symbols)
+        {
+            report(ELFIssue::TableLimit, type == SHT_DYNSYM ? "DYNSYM" : "SYMTAB", section.offset, count);
+            count = max_symbols - out.size();
+        }
+
+        out.reserve(out.size() + count);
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            Sym raw;
+            if(!read_entry(section.offset + i * entry_size, raw))
+                break;
+
+            out.push_back({ get_string(section.link, fix(raw.st_name)), fix(raw.st_value), fix(raw.st_size), raw.st_info, raw.st_other, fix(raw.st_shndx) });
+        }
+    }
+}
+
+Span<ELFSymbol> ELF::get_symbols()
+{
+    if(!symbols_parsed && get_header() != nullptr)
+    {
+        symbols_parsed = true;
+
+        if(is_64bit())
+            parse_symbols<ELF64>(SHT_SYMTAB, symbols);
+        else
+            parse_symbols<ELF32>(SHT_SYMTAB, symbols);
+    }
+
+    return Span<ELFSymbol>(symbols.data(), symbols.size());
+}
+
+Span<ELFSymbol> ELF::get_dynamic_symbols()
+{
+    if(!dynamic_symbols_parsed && get_header() != nullptr)
+    {
+        dynamic_symbols_parsed = true;
+
+        if(is_64bit())
+            parse_symbols<ELF64>(SHT_DYNSYM, dynamic_symbols);
+        else
+            parse_symbols<ELF32>(SHT_DYNSYM, dynamic_symbols);
+    }
+
+    return Span<ELFSymbol>(dynamic_symbols.data(), dynamic_symbols.size());
+}
+
+uint64_t ELF::address_to_offset(uint64_t address)
+{
+    for (const ELFSegment& segment : get_segments())
+    {
+        if(segment.type == PT_LOAD && address >= segment.vaddr && address - segment.vaddr < segment.filesz)
+            return segment.offset + (address - segment.vaddr);
+    }
+
+    return ELF_NO_OFFSET;
+}
+
+uint64_t ELF::offset_to_address(uint64_t offset)
+{
+    for (const ELFSegment& segment : get_segments())
+    {
+        if(segment.type == PT_LOAD && offset >= segment.offset && offset - segment.offset < segment.filesz)
+            return segment.vaddr + (offset - segment.offset);
+    }
+
+    return ELF_NO_ADDRESS;
+}
+
+int32_t ELF::get_section_by_offset(uint64_t offset)
+{
+    Span<ELFSection> all = get_sections();
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        // SHT_NULL and SHT_NOBITS sections take no space in the file
+        if(all[i].type != 0 && all[i].type != SHT_NOBITS && offset >= all[i].offset && offset - all[i].offset < all[i].size)
+            return static_cast<int32_t>(i);
+    }
+
+    return -1;
+}
+
+template<typename Flavour>
+void ELF::parse_dynamic()
+{
+    using Dyn = typename Flavour::Dyn;
+
+    // The section is what tools read when there is one, stripped section tables leave the segment
+    uint64_t offset = ELF_NO_OFFSET;
+    uint64_t size = 0;
+    uint32_t strings = UINT32_MAX;
+
+    for (const ELFSection& section : get_sections())
+    {
+        if(section.type == SHT_DYNAMIC)
+        {
+            offset = section.offset;
+            size = section.size;
+            strings = section.link;
+            break;
+        }
+    }
+
+    if(offset == ELF_NO_OFFSET)
+    {
+        for (const ELFSegment& segment : get_segments())
+        {
+            if(segment.type == PT_DYNAMIC)
+            {
+                offset = segment.offset;
+                size = segment.filesz;
+                break;
+            }
+        }
+    }
+
+    if(offset == ELF_NO_OFFSET)
+        return;
+
+    uint64_t count = std::min<uint64_t>(size / sizeof(Dyn), max_dynamic);
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        Dyn raw;
+        if(!read_entry(offset + i * sizeof(Dyn), raw))
+            break;
+
+        int64_t tag = fix(raw.d_tag);
+        if(tag == DT_NULL)
+            break;
+
+        dynamic.push_back({ tag, fix(raw.d_val), {} });
+    }
+
+    // Without the section link the string table comes from DT_STRTAB, a virtual address
+    uint64_t strings_offset = ELF_NO_OFFSET;
+    uint64_t strings_size = 0;
+
+    for (const ELFDynamic& entry : dynamic)
+    {
+        if(entry.tag == DT_STRTAB)
+            strings_offset = address_to_offset(entry.value);
+        else if(entry.tag == DT_STRSZ)
+            strings_size = entry.value;
+    }
+
+    for (ELFDynamic& entry : dynamic)
+    {
+        if(entry.tag != DT_NEEDED && entry.tag != DT_SONAME && entry.tag != DT_RPATH && entry.tag != DT_RUNPATH)
+            continue;
+
+        if(strings != UINT32_MAX)
+            entry.text = get_string(strings, entry.value);
+        else if(strings_offset != ELF_NO_OFFSET && entry.value < strings_size && strings_offset <= source_.size() && entry.value < source_.size() - strings_offset)
+            entry.text = read_string(strings_offset + entry.value, std::min(strings_size - entry.value, source_.size() - strings_offset - entry.value));
+    }
+
+    if(count == max_dynamic && size / sizeof(Dyn) > max_dynamic)
+        report(ELFIssue::TableLimit, "DYNAMIC", offset, size / sizeof(Dyn));
+}
+
+Span<ELFDynamic> ELF::get_dynamic()
+{
+    if(!dynamic_parsed && get_header() != nullptr)
+    {
+        dynamic_parsed = true;
+
+        if(is_64bit())
+            parse_dynamic<ELF64>();
+        else
+            parse_dynamic<ELF32>();
+    }
+
+    return Span<ELFDynamic>(dynamic.data(), dynamic.size());
+}
+
+std::string_view ELF::get_interpreter()
+{
+    for (const ELFSegment& segment : get_segments())
+    {
+        if(segment.type == PT_INTERP)
+            return read_string(segment.offset, segment.filesz);
+    }
+
+    return {};
+}
+
+uint64_t ELF::memory_usage()
+{
+    // Every table is in the arena
+    return arena->memory_usage();
+}
+
+std::vector<BackgroundAnalysis::Stage> ELF::analysis_stages(BackgroundAnalysis& background)
+{
+    std::vector<BackgroundAnalysis::Stage> stages(static_cast<size_t>(ELFStage::Count));
+
+    stages[static_cast<size_t>(ELFStage::Headers)] = { "Headers", [this]() -> const char*
+    {
+        return get_error();
+    }};
+
+    stages[static_cast<size_t>(ELFStage::Tables)] = { "Tables", [this]() -> const char*
+    {
+        get_segments();
+        get_sections();
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(ELFStage::Symbols)] = { "Symbols", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(ELFStage::Symbols);
+        std::atomic<uint64_t>& done = background.done_counter(stage);
+
+        background.set_total(stage, 2);
+
+        get_symbols();
+        ++done;
+        get_dynamic_symbols();
+        ++done;
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(ELFStage::Dynamic)] = { "Dynamic", [this]() -> const char*
+    {
+        get_dynamic();
+
+        return nullptr;
+    }};
+
+    return stages;
+}
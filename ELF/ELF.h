@@ -0,0 +1,401 @@
+/*
+* Define the structure for ELF
+* Based on the System V ABI (elf.h), both classes and byte orders
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <inttypes.h>
+#include "../core/byte_source.h"
+#include "../core/background_analysis.h"
+#include "../core/binary_format.h"
+#include "../core/arena.h"
+
+#define EI_NIDENT 16
+#define EI_CLASS 4
+#define EI_DATA 5
+
+#define ELFCLASS32 1
+#define ELFCLASS64 2
+#define ELFDATA2LSB 1
+#define ELFDATA2MSB 2
+
+#define SHN_UNDEF 0
+#define SHN_LORESERVE 0xFF00
+#define SHN_ABS 0xFFF1
+#define SHN_COMMON 0xFFF2
+#define SHN_XINDEX 0xFFFF
+#define PN_XNUM 0xFFFF
+
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_DYNAMIC 6
+#define SHT_NOBITS 8
+#define SHT_DYNSYM 11
+
+#define PT_LOAD 1
+#define PT_DYNAMIC 2
+#define PT_INTERP 3
+
+#define DT_NULL 0
+#define DT_NEEDED 1
+#define DT_STRTAB 5
+#define DT_STRSZ 10
+#define DT_SONAME 14
+#define DT_RPATH 15
+#define DT_RUNPATH 29
+
+typedef struct
+{
+    uint8_t e_ident[EI_NIDENT]; /*00: 7F 'E' 'L' 'F', class, byte order, version, ABI */
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} Elf32_Ehdr;
+
+typedef struct
+{
+    uint8_t e_ident[EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} Elf64_Ehdr;
+
+// Program headers, p_flags moved next to p_type in ELF64 for alignment
+typedef struct
+{
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} Elf32_Phdr;
+
+typedef struct
+{
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} Elf64_Phdr;
+
+typedef struct
+{
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+} Elf32_Shdr;
+
+typedef struct
+{
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+} Elf64_Shdr;
+
+typedef struct
+{
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    uint8_t st_info; // Binding in the top 4 bits, type in the low 4
+    uint8_t st_other;
+    uint16_t st_shndx;
+} Elf32_Sym;
+
+typedef struct
+{
+    uint32_t st_name;
+    uint8_t st_info;
+    uint8_t st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+} Elf64_Sym;
+
+typedef struct
+{
+    int32_t d_tag;
+    uint32_t d_val;
+} Elf32_Dyn;
+
+typedef struct
+{
+    int64_t d_tag;
+    uint64_t d_val;
+} Elf64_Dyn;
+
+// Class flavours, code that depends on the layout is templated on these
+struct ELF32
+{
+    using Ehdr = Elf32_Ehdr;
+    using Phdr = Elf32_Phdr;
+    using Shdr = Elf32_Shdr;
+    using Sym = Elf32_Sym;
+    using Dyn = Elf32_Dyn;
+
+    static constexpr uint8_t elf_class = ELFCLASS32;
+};
+
+struct ELF64
+{
+    using Ehdr = Elf64_Ehdr;
+    using Phdr = Elf64_Phdr;
+    using Shdr = Elf64_Shdr;
+    using Sym = Elf64_Sym;
+    using Dyn = Elf64_Dyn;
+
+    static constexpr uint8_t elf_class = ELFCLASS64;
+};
+
+// The tables below are copies in the ELF64 layout and host byte order, ELF32 fields are widened. Names are views into the
+// file.
+
+struct ELFSegment
+{
+    uint32_t type;
+    uint32_t flags; // PF_X 1, PF_W 2, PF_R 4
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t paddr;
+    uint64_t filesz;
+    uint64_t memsz;
+    uint64_t align;
+};
+
+struct ELFSection
+{
+    std::string_view name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t addralign;
+    uint64_t entsize;
+};
+
+struct ELFSymbol
+{
+    std::string_view name;
+    uint64_t value;
+    uint64_t size;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+};
+
+struct ELFDynamic
+{
+    int64_t tag;
+    uint64_t value;
+    std::string_view text; // DT_NEEDED, DT_SONAME, DT_RPATH and DT_RUNPATH strings
+};
+
+#define ELF_NO_OFFSET UINT64_MAX
+#define ELF_NO_ADDRESS UINT64_MAX
+
+// Problems found in malformed files. Only header issues are fatal, tables keep the entries that are in bounds.
+enum class ELFIssue : uint8_t
+{
+    TruncatedHeader,        // File is smaller than the ELF header
+    BadMagic,               // Doesn't start with 7F 'E' 'L' 'F'
+    UnknownClass,           // Neither ELFCLASS32 nor ELFCLASS64
+    UnknownByteOrder,       // Neither little nor big endian
+    BadEntrySize,           // e_phentsize or e_shentsize is smaller than the structure
+    ProgramHeadersTruncated,
+    SectionHeadersTruncated,
+    BadStringTable,         // e_shstrndx or a link doesn't name a string table in the file
+    SectionDataOutOfBounds, // Section contents run past the end of the file
+    TableLimit              // A table was cut at its allocation cap
+};
+
+struct ELFDiagnostic
+{
+    ELFIssue issue;
+    bool fatal;
+    const char* field;
+    uint64_t offset; // ELF_NO_OFFSET if the issue isn't tied to one
+    uint64_t value;
+};
+
+// Stages of ELF::analysis_stages, in order
+enum class ELFStage : size_t
+{
+    Headers,
+    Tables,  // Program and section headers
+    Symbols, // .symtab and .dynsym
+    Dynamic,
+    Count
+};
+
+// What the window shows for one file, only ELF_ui.cpp uses it
+struct ELFViewState : ViewState
+{
+    bool showHEADER = false;
+    bool showSEGMENTS = false;
+    bool showSECTIONS = false;
+    bool showSYMBOLS = false;
+    bool showDYNAMIC_SYMBOLS = false;
+    bool showDYNAMIC = false;
+    bool showDIAGNOSTICS = false;
+
+    // Rows of the symbol lists matching the filter, only rebuilt when it changes
+    std::string symbolFilter = "";
+    std::vector<uint32_t> symbolRows;
+    std::vector<uint32_t> dynamicSymbolRows;
+    std::string symbolRowsFilter = "";
+    bool symbolRowsValid = false;
+
+    void detach() override
+    {
+        symbolRowsValid = false;
+    }
+};
+
+class ELF : public BinaryFormat
+{
+public:
+    // Tables go to arena when one is given, see PE
+    ELF(ByteSource& source, Arena* arena = nullptr);
+
+    BinaryKind kind() const override { return BinaryKind::ELF; }
+
+    static const char* describe_issue(ELFIssue);
+    const char* get_machine_name(uint16_t machine);
+    const char* get_type_name(uint16_t type);
+    const char* get_segment_type_name(uint32_t type);
+    const char* get_section_type_name(uint32_t type);
+    const char* get_dynamic_tag_name(int64_t tag);
+    static const char* get_symbol_binding_name(uint8_t info); // From the top 4 bits of st_info
+    static const char* get_symbol_type_name(uint8_t info);    // From the low 4 bits
+
+    // Header issues first, then whatever the tables parsed so far ran into
+    Span<ELFDiagnostic> get_diagnostics();
+    // Description of the fatal issue, nullptr if the header is valid
+    const char* get_error();
+
+    // Widened copy of the ELF header, nullptr if it isn't valid
+    const Elf64_Ehdr* get_header();
+    bool is_64bit();
+    bool is_big_endian();
+
+    // Tables, each parsed the first time it's asked for
+    Span<ELFSegment> get_segments();
+    Span<ELFSection> get_sections();
+    Span<ELFSymbol> get_symbols();         // .symtab, empty when stripped
+    Span<ELFSymbol> get_dynamic_symbols(); // .dynsym
+    Span<ELFDynamic> get_dynamic();        // Up to DT_NULL
+    std::string_view get_interpreter();                  // PT_INTERP
+
+    // File offset backing a virtual address through the PT_LOAD segments, ELF_NO_OFFSET if it isn't in the file
+    uint64_t address_to_offset(uint64_t address);
+    // Virtual address a file offset is loaded at, ELF_NO_ADDRESS if no PT_LOAD segment maps it
+    uint64_t offset_to_address(uint64_t offset);
+    // Section whose contents hold a file offset, -1 if none does
+    int32_t get_section_by_offset(uint64_t offset);
+
+    uint64_t memory_usage() override;
+    void set_thread_pool(ThreadPool*) override {} // Nothing here is big enough to split
+
+    // Stages for BackgroundAnalysis, indices follow ELFStage
+    std::vector<BackgroundAnalysis::Stage> analysis_stages(BackgroundAnalysis& analysis) override;
+    void set_analysis(const BackgroundAnalysis* background) override { analysis = background; }
+
+    // An ELFViewState, has to be set before rendering and outlives the ELF
+    void set_view_state(ViewState* state) override { view = static_cast<ELFViewState*>(state); }
+
+    // Defined in ELF_ui.cpp, only part of the GUI build
+    void render_sidebar();
+    void render_main();
+
+private:
+    template<typename T> T fix(T value) const; // File byte order to host
+    template<typename T> bool read_entry(uint64_t offset, T& out);
+    template<typename Flavour> bool load_header();
+    template<typename Flavour> void parse_segments();
+    template<typename Flavour> void parse_sections();
+    template<typename Flavour> void parse_symbols(uint32_t type, ArenaVector<ELFSymbol>& out);
+    template<typename Flavour> void parse_dynamic();
+
+    std::string_view get_string(uint32_t table, uint64_t offset); // From the string table section at index table
+    std::string_view read_string(uint64_t offset, uint64_t limit); // NUL terminated, cut at limit
+    void report(ELFIssue issue, const char* field, uint64_t offset, uint64_t value, bool fatal = false);
+
+    std::unique_ptr<Arena> owned_arena;
+    Arena* arena;
+
+    ArenaVector<ELFDiagnostic> diagnostics{ *arena };
+    Elf64_Ehdr header = {};
+    bool header_valid = false;
+    bool header_checked = false;
+    bool big_endian = false;
+
+    // From the header, or from section 0 when they don't fit in it (extended numbering)
+    uint64_t segment_count = 0;
+    uint64_t section_count = 0;
+    uint32_t section_names = 0;
+
+    ArenaVector<ELFSegment> segments{ *arena };
+    bool segments_parsed = false;
+    ArenaVector<ELFSection> sections{ *arena };
+    bool sections_parsed = false;
+    ArenaVector<ELFSymbol> symbols{ *arena };
+    bool symbols_parsed = false;
+    ArenaVector<ELFSymbol> dynamic_symbols{ *arena };
+    bool dynamic_symbols_parsed = false;
+    ArenaVector<ELFDynamic> dynamic{ *arena };
+    bool dynamic_parsed = false;
+
+    const BackgroundAnalysis* analysis = nullptr;
+    ELFViewState* view = nullptr;
+
+    ByteSource& source_;
+};
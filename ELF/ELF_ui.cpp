@@ -0,0 +1,300 @@
+#include "ELF.h"
+#include "../widgets/widgets.h"
+#include "../core/profiler.h"
+#include <algorithm>
+#include <cctype>
+
+/*
+* UI Elements
+*/
+
+#define NEW_TABLE_ENTRY(field, value, type) ImGui::TableNextRow(); \
+                    ImGui::TableSetColumnIndex(0); \
+                    ImGui::Text("%s", field); \
+                    ImGui::TableSetColumnIndex(1); \
+                    ImGui::Text("%" type, value);
+
+static bool name_matches(std::string_view name, const std::string& filter)
+{
+    auto lower_equal = [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); };
+
+    return std::search(name.begin(), name.end(), filter.begin(), filter.end(), lower_equal) != name.end();
+}
+
+static void filter_symbols(Span<ELFSymbol> symbols, const std::string& filter, std::vector<uint32_t>& rows)
+{
+    rows.clear();
+
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        if(filter.empty() || name_matches(symbols[i].name, filter))
+            rows.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+static void symbol_table(const char* id, Span<ELFSymbol> symbols, const std::vector<uint32_t>& rows)
+{
+    ImGui::Text("%zu / %zu", rows.size(), symbols.size());
+
+    clipped_table(id, { "Value", "Size", "Type", "Bind", "Ndx", "Name" }, rows.size(), [&](size_t i)
+    {
+        const ELFSymbol& symbol = symbols[rows[i]];
+
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("%016" PRIX64, symbol.value);
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%" PRIu64, symbol.size);
+        ImGui::TableSetColumnIndex(2);
+        ImGui::Text("%s", ELF::get_symbol_type_name(symbol.info));
+        ImGui::TableSetColumnIndex(3);
+        ImGui::Text("%s", ELF::get_symbol_binding_name(symbol.info));
+        ImGui::TableSetColumnIndex(4);
+        if(symbol.shndx == SHN_UNDEF)
+            ImGui::Text("UND");
+        else if(symbol.shndx == SHN_ABS)
+            ImGui::Text("ABS");
+        else
+            ImGui::Text("%" PRIu16, symbol.shndx);
+        ImGui::TableSetColumnIndex(5);
+        ImGui::TextUnformatted(symbol.name.data(), symbol.name.data() + symbol.name.size());
+    });
+}
+
+void ELF::render_sidebar()
+{
+    if(analysis != nullptr && !analysis->finished())
+    {
+        for (size_t i = 0; i < analysis->stage_count(); ++i)
+            ImGui::ProgressBar(analysis->progress(i), ImVec2(-1, 0), analysis->stage_name(i));
+
+        ImGui::Separator();
+    }
+
+    if (ImGui::Button("HEADER", ImVec2(-1, 0)))
+        view->showHEADER = !view->showHEADER;
+
+    if (ImGui::Button("SEGMENTS", ImVec2(-1, 0)))
+        view->showSEGMENTS = !view->showSEGMENTS;
+
+    if (ImGui::Button("SECTIONS", ImVec2(-1, 0)))
+        view->showSECTIONS = !view->showSECTIONS;
+
+    if (ImGui::Button("SYMBOLS", ImVec2(-1, 0)))
+        view->showSYMBOLS = !view->showSYMBOLS;
+
+    if (ImGui::Button("DYNAMIC SYMBOLS", ImVec2(-1, 0)))
+        view->showDYNAMIC_SYMBOLS = !view->showDYNAMIC_SYMBOLS;
+
+    if (ImGui::Button("DYNAMIC", ImVec2(-1, 0)))
+        view->showDYNAMIC = !view->showDYNAMIC;
+
+    if (ImGui::Button("DIAGNOSTICS", ImVec2(-1, 0)))
+        view->showDIAGNOSTICS = !view->showDIAGNOSTICS;
+}
+
+void ELF::render_main()
+{
+    PROFILE_SCOPE("ELF::render_main");
+
+    // Nothing else makes sense without a valid header
+    if(!stage_ready(analysis, ELFStage::Headers, "File"))
+        return;
+
+    if(view->showHEADER && stage_ready(analysis, ELFStage::Headers, "HEADER"))
+    {
+        if (ImGui::TreeNode("HEADER"))
+        {
+            const Elf64_Ehdr* ehdr = get_header();
+            std::string_view interpreter = get_interpreter();
+
+            if (ImGui::BeginTable("HEADER", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable))
+            {
+                ImGui::TableSetupColumn("Field");
+                ImGui::TableSetupColumn("Value");
+                ImGui::TableHeadersRow();
+
+                NEW_TABLE_ENTRY("Class", is_64bit() ? "ELF64" : "ELF32", "s");
+                NEW_TABLE_ENTRY("Data", is_big_endian() ? "Big endian" : "Little endian", "s");
+                NEW_TABLE_ENTRY("Type", get_type_name(ehdr->e_type), "s");
+                NEW_TABLE_ENTRY("Machine", get_machine_name(ehdr->e_machine), "s");
+                NEW_TABLE_ENTRY("Entry", ehdr->e_entry, PRIX64);
+                NEW_TABLE_ENTRY("Flags", ehdr->e_flags, PRIX32);
+                NEW_TABLE_ENTRY("Program headers", ehdr->e_phoff, PRIX64);
+                NEW_TABLE_ENTRY("Section headers", ehdr->e_shoff, PRIX64);
+                NEW_TABLE_ENTRY("Segment count", segment_count, PRIu64);
+                NEW_TABLE_ENTRY("Section count", section_count, PRIu64);
+                NEW_TABLE_ENTRY("Section names", section_names, PRIu32);
+
+                if(!interpreter.empty())
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("Interpreter");
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(interpreter.data(), interpreter.data() + interpreter.size());
+                }
+
+                ImGui::EndTable();
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showSEGMENTS && stage_ready(analysis, ELFStage::Tables, "SEGMENTS"))
+    {
+        if (ImGui::TreeNode("SEGMENTS"))
+        {
+            Span<ELFSegment> entries = get_segments();
+
+            clipped_table("segments", { "Type", "Flags", "Offset", "VirtAddr", "FileSiz", "MemSiz", "Align" }, entries.size(), [&](size_t i)
+            {
+                const ELFSegment& segment = entries[i];
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", get_segment_type_name(segment.type));
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%c%c%c", segment.flags & 4 ? 'R' : '-', segment.flags & 2 ? 'W' : '-', segment.flags & 1 ? 'X' : '-');
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%08" PRIX64, segment.offset);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%016" PRIX64, segment.vaddr);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%" PRIX64, segment.filesz);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%" PRIX64, segment.memsz);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%" PRIX64, segment.align);
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showSECTIONS && stage_ready(analysis, ELFStage::Tables, "SECTIONS"))
+    {
+        if (ImGui::TreeNode("SECTIONS"))
+        {
+            Span<ELFSection> entries = get_sections();
+
+            clipped_table("sections", { "Name", "Type", "Address", "Offset", "Size", "Flags", "Link", "Info" }, entries.size(), [&](size_t i)
+            {
+                const ELFSection& section = entries[i];
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(section.name.data(), section.name.data() + section.name.size());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", get_section_type_name(section.type));
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%016" PRIX64, section.addr);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%08" PRIX64, section.offset);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%" PRIX64, section.size);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%" PRIX64, section.flags);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%" PRIu32, section.link);
+                ImGui::TableSetColumnIndex(7);
+                ImGui::Text("%" PRIu32, section.info);
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if((view->showSYMBOLS || view->showDYNAMIC_SYMBOLS) && stage_ready(analysis, ELFStage::Symbols, "SYMBOLS"))
+    {
+        // Both lists share the filter, only refiltered when it changes
+        if(!view->symbolRowsValid || view->symbolRowsFilter != view->symbolFilter)
+        {
+            filter_symbols(get_symbols(), view->symbolFilter, view->symbolRows);
+            filter_symbols(get_dynamic_symbols(), view->symbolFilter, view->dynamicSymbolRows);
+            view->symbolRowsFilter = view->symbolFilter;
+            view->symbolRowsValid = true;
+        }
+
+        if (view->showSYMBOLS && ImGui::TreeNode("SYMBOLS"))
+        {
+            ImGui::InputTextWithHintR("Filter", view->symbolFilter);
+
+            if(get_symbols().empty())
+                ImGui::TextDisabled("No .symtab, the file is stripped");
+            else
+                symbol_table("symbols", get_symbols(), view->symbolRows);
+
+            ImGui::TreePop();
+        }
+
+        if (view->showDYNAMIC_SYMBOLS && ImGui::TreeNode("DYNAMIC SYMBOLS"))
+        {
+            ImGui::InputTextWithHintR("Filter##dynamic", view->symbolFilter);
+
+            symbol_table("dynamic_symbols", get_dynamic_symbols(), view->dynamicSymbolRows);
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showDYNAMIC && stage_ready(analysis, ELFStage::Dynamic, "DYNAMIC"))
+    {
+        if (ImGui::TreeNode("DYNAMIC"))
+        {
+            Span<ELFDynamic> entries = get_dynamic();
+
+            if(entries.empty())
+                ImGui::TextDisabled("Statically linked");
+            else
+            {
+                clipped_table("dynamic", { "Tag", "Value" }, entries.size(), [&](size_t i)
+                {
+                    const ELFDynamic& entry = entries[i];
+
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s", get_dynamic_tag_name(entry.tag));
+                    ImGui::TableSetColumnIndex(1);
+                    if(!entry.text.empty())
+                        ImGui::TextUnformatted(entry.text.data(), entry.text.data() + entry.text.size());
+                    else
+                        ImGui::Text("%" PRIX64, entry.value);
+                });
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    // Every stage can add to the list, it's only read once they're all done
+    if(view->showDIAGNOSTICS && (analysis == nullptr || analysis->finished()))
+    {
+        if (ImGui::TreeNode("DIAGNOSTICS"))
+        {
+            Span<ELFDiagnostic> entries = get_diagnostics();
+
+            if(entries.empty())
+                ImGui::TextDisabled("No issues found");
+            else
+            {
+                clipped_table("diagnostics", { "Issue", "Field", "Offset", "Value" }, entries.size(), [&](size_t i)
+                {
+                    const ELFDiagnostic& entry = entries[i];
+
+                    ImGui::TableSetColumnIndex(0);
+                    if(entry.fatal)
+                        ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", describe_issue(entry.issue));
+                    else
+                        ImGui::Text("%s", describe_issue(entry.issue));
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%s", entry.field);
+                    ImGui::TableSetColumnIndex(2);
+                    if(entry.offset != ELF_NO_OFFSET)
+                        ImGui::Text("%016" PRIX64, entry.offset);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%" PRIX64, entry.value);
+                });
+            }
+
+            ImGui::TreePop();
+        }
+    }
+}
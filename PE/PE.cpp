@@ -1,5 +1,19 @@
 #include "PE.h"
-#include "../widgets/widgets.h"
+#include "../core/profiler.h"
+#include "../core/thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+
+// Passes over the whole file read this much at a time from sources that aren't mapped
+static const uint64_t stream_chunk_size = 16 << 20;
+
+PE::PE(ByteSource& source, Arena* parse_arena) : owned_arena(parse_arena == nullptr ? std::make_unique<Arena>() : nullptr), arena(parse_arena == nullptr ? owned_arena.get() : parse_arena), pool(&ThreadPool::shared()), source_(source), page_cache(source)
+{
+}
 
 const char* PE::get_arc_name(MachineArc machine)
 {
@@ -40,233 +54,1273 @@ const char* PE::get_arc_name(MachineArc machine)
     return "Unknown Architecture";
 }
 
-IMAGE_DOS_HEADER* PE::get_dos()
+std::string_view PE::get_section_name(const IMAGE_SECTION_HEADER& section)
+{
+    // Names are padded with NULs but an 8 character name has no terminator
+    const char* name = reinterpret_cast<const char*>(section.Name);
+
+    size_t length = 0;
+    while(length < sizeof(section.Name) && name[length] != '\0')
+        ++length;
+
+    return std::string_view(name, length);
+}
+
+void PE::report(PEIssue issue, const char* field, uint64_t offset, uint64_t value, bool fatal)
 {
-    if(dos == nullptr)
+    // A garbage section table can have an issue per entry, the first ones say enough
+    const size_t max_diagnostics = 256;
+
+    if(diagnostics.size() < max_diagnostics || fatal)
+        diagnostics.push_back({ issue, fatal, field, offset, value });
+}
+
+const char* PE::describe_issue(PEIssue issue)
+{
+    switch (issue)
     {
-        dos = new IMAGE_DOS_HEADER;
+        case PEIssue::TruncatedDosHeader: return "File is too small for a DOS header";
+        case PEIssue::BadDosSignature: return "Executeable isn't in DOS format";
+        case PEIssue::NtHeadersOutOfBounds: return "NT headers are past the end of the file";
+        case PEIssue::BadNtSignature: return "Executeable isn't in PE format";
+        case PEIssue::UnknownOptionalMagic: return "Optional header is neither PE32 nor PE32+";
+        case PEIssue::OptionalHeaderTooSmall: return "Optional header is too small for its data directories";
+        case PEIssue::OptionalHeaderTruncated: return "File ends inside the optional header";
+        case PEIssue::TooManyDirectories: return "More than 16 data directories, the rest are ignored";
+        case PEIssue::SectionTableTruncated: return "Section table runs past the end of the file";
+        case PEIssue::TooManySections: return "More sections than the loader accepts";
+        case PEIssue::SectionDataOutOfBounds: return "Section data runs past the end of the file";
+        case PEIssue::DirectoryOutOfBounds: return "Data directory isn't backed by the file";
+        case PEIssue::TableLimit: return "Table cut short at its size limit";
+    }
 
-        file_.read(reinterpret_cast<char*>(dos), sizeof(IMAGE_DOS_HEADER)); // The first X bytes of a PE executeable is the DOS header
-    
-        if(dos->e_magic != 0x5A4D) // 54 = 'M', 4D = 'Z' | DOS executeables have this signature to verify, Windows supports DOS for legacy compatability reasons.
-            return nullptr;
+    return "Unknown issue";
+}
 
-        return dos;
+const IMAGE_DOS_HEADER* PE::get_dos()
+{
+    if(!dos_checked)
+    {
+        dos_checked = true;
+
+        // The first X bytes of a PE executeable is the DOS header. Copied, an embedded PE can start at any offset.
+        if(!source_.read_as(0, dos_header))
+            report(PEIssue::TruncatedDosHeader, "IMAGE_DOS_HEADER", 0, source_.size(), true);
+        else if(dos_header.e_magic != 0x5A4D) // 54 = 'M', 4D = 'Z' | DOS executeables have this signature to verify, Windows supports DOS for legacy compatability reasons.
+            report(PEIssue::BadDosSignature, "e_magic", offsetof(IMAGE_DOS_HEADER, e_magic), dos_header.e_magic, true);
+        else
+            dos = &dos_header;
     }
 
     return dos;
 }
 
-IMAGE_NT_HEADERS* PE::get_nt()
+template<typename Flavour>
+bool PE::load_nt_headers(uint64_t offset)
+{
+    using NtHeaders = typename Flavour::NtHeaders;
+
+    // The optional header may be shorter than the struct (fewer directories), whatever is missing stays zero
+    const uint64_t size_field = offset + offsetof(NtHeaders, FileHeader) + offsetof(IMAGE_FILE_HEADER, SizeOfOptionalHeader);
+    IMAGE_FILE_HEADER file_header;
+    if(!source_.read_as(offset + offsetof(NtHeaders, FileHeader), file_header))
+    {
+        report(PEIssue::OptionalHeaderTruncated, "IMAGE_FILE_HEADER", offset + offsetof(NtHeaders, FileHeader), source_.size(), true);
+
+        return false;
+    }
+
+    if(file_header.SizeOfOptionalHeader < offsetof(decltype(NtHeaders::OptionalHeader), DataDirectory))
+    {
+        report(PEIssue::OptionalHeaderTooSmall, "SizeOfOptionalHeader", size_field, file_header.SizeOfOptionalHeader, true);
+
+        return false;
+    }
+
+    NtHeaders headers = {};
+    uint64_t length = std::min<uint64_t>(sizeof(NtHeaders), offsetof(NtHeaders, OptionalHeader) + file_header.SizeOfOptionalHeader);
+
+    if(source_.read(offset, &headers, length) != length)
+    {
+        report(PEIssue::OptionalHeaderTruncated, "SizeOfOptionalHeader", size_field, file_header.SizeOfOptionalHeader, true);
+
+        return false;
+    }
+
+    if(headers.OptionalHeader.NumberOfRvaAndSizes > 16)
+        report(PEIssue::TooManyDirectories, "NumberOfRvaAndSizes", offset + offsetof(NtHeaders, OptionalHeader) + offsetof(decltype(NtHeaders::OptionalHeader), NumberOfRvaAndSizes), headers.OptionalHeader.NumberOfRvaAndSizes);
+
+    const auto& optional = headers.OptionalHeader;
+    IMAGE_OPTIONAL_HEADER64& out = nt_headers.OptionalHeader;
+
+    nt_headers.Signature = headers.Signature;
+    nt_headers.FileHeader = headers.FileHeader;
+
+    out.Magic = optional.Magic;
+    out.MajorLinkerVersion = optional.MajorLinkerVersion;
+    out.MinorLinkerVersion = optional.MinorLinkerVersion;
+    out.SizeOfCode = optional.SizeOfCode;
+    out.SizeOfInitializedData = optional.SizeOfInitializedData;
+    out.SizeOfUninitializedData = optional.SizeOfUninitializedData;
+    out.AddressOfEntryPoint = optional.AddressOfEntryPoint;
+    out.BaseOfCode = optional.BaseOfCode;
+    out.ImageBase = optional.ImageBase;
+    out.SectionAlignment = optional.SectionAlignment;
+    out.FileAlignment = optional.FileAlignment;
+    out.MajorOperatingSystemVersion = optional.MajorOperatingSystemVersion;
+    out.MinorOperatingSystemVersion = optional.MinorOperatingSystemVersion;
+    out.MajorImageVersion = optional.MajorImageVersion;
+    out.MinorImageVersion = optional.MinorImageVersion;
+    out.MajorSubsystemVersion = optional.MajorSubsystemVersion;
+    out.MinorSubsystemVersion = optional.MinorSubsystemVersion;
+    out.Win32VersionValue = optional.Win32VersionValue;
+    out.SizeOfImage = optional.SizeOfImage;
+    out.SizeOfHeaders = optional.SizeOfHeaders;
+    out.CheckSum = optional.CheckSum;
+    out.Subsystem = optional.Subsystem;
+    out.DllCharacteristics = optional.DllCharacteristics;
+    out.SizeOfStackReserve = optional.SizeOfStackReserve;
+    out.SizeOfStackCommit = optional.SizeOfStackCommit;
+    out.SizeOfHeapReserve = optional.SizeOfHeapReserve;
+    out.SizeOfHeapCommit = optional.SizeOfHeapCommit;
+    out.LoaderFlags = optional.LoaderFlags;
+    out.NumberOfRvaAndSizes = optional.NumberOfRvaAndSizes;
+
+    for (uint32_t i = 0; i < 16; ++i)
+        out.DataDirectory[i] = i < optional.NumberOfRvaAndSizes ? optional.DataDirectory[i] : IMAGE_DATA_DIRECTORY{};
+
+    if constexpr (std::is_same<Flavour, PE32>::value)
+        nt_headers.BaseOfData = optional.BaseOfData;
+
+    return true;
+}
+
+const PENtHeaders* PE::get_nt()
 {
-    if(nt == nullptr)
+    if(!nt_checked)
     {
-        nt = new IMAGE_NT_HEADERS;
+        nt_checked = true;
+
+        if(get_dos() == nullptr)
+            return nullptr;
+
+        uint32_t signature;
+        if(!source_.read_as(dos->e_lfanew, signature))
+        {
+            report(PEIssue::NtHeadersOutOfBounds, "e_lfanew", offsetof(IMAGE_DOS_HEADER, e_lfanew), dos->e_lfanew, true);
+
+            return nullptr;
+        }
+
+        if(signature != 0x4550) // 45 = 'E', 50 = 'P' | PE executeables have this signature to verify.
+        {
+            report(PEIssue::BadNtSignature, "Signature", dos->e_lfanew, signature, true);
+
+            return nullptr;
+        }
+
+        // The only place that looks at Magic, everything after works on the widened copy or is templated on the flavour
+        uint64_t magic_offset = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader);
+        uint16_t magic;
+        if(!source_.read_as(magic_offset, magic))
+        {
+            report(PEIssue::OptionalHeaderTruncated, "Magic", magic_offset, source_.size(), true);
 
-        file_.seekg(dos->e_lfanew, std::ios::beg);
-        file_.read(reinterpret_cast<char*>(nt), sizeof(IMAGE_NT_HEADERS)); // Read the NT headers
+            return nullptr;
+        }
 
-        if(nt->Signature != 0x4550) // 45 = 'E', 50 = 'P' | PE executeables have this signature to verify.
+        bool loaded = false;
+        if(magic == PE32::magic)
+            loaded = load_nt_headers<PE32>(dos->e_lfanew);
+        else if(magic == PE64::magic)
+            loaded = load_nt_headers<PE64>(dos->e_lfanew);
+        else
+            report(PEIssue::UnknownOptionalMagic, "Magic", magic_offset, magic, true);
+
+        if(!loaded)
             return nullptr;
+
+        nt = &nt_headers;
     }
 
     return nt;
 }
 
-std::vector<IMAGE_SECTION_HEADER> PE::get_sections()
+Span<IMAGE_SECTION_HEADER> PE::get_sections()
 {
-    if(sections.empty())
+    if(!sections_loaded && get_nt() != nullptr)
     {
-        sections.reserve(nt->FileHeader.NumberOfSections);
-        sections.resize(nt->FileHeader.NumberOfSections);
+        sections_loaded = true;
+
+        uint64_t offset = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + nt->FileHeader.SizeOfOptionalHeader;
+        uint64_t count = nt->FileHeader.NumberOfSections;
+        uint64_t count_field = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, FileHeader) + offsetof(IMAGE_FILE_HEADER, NumberOfSections);
+
+        if(count > PE_MAX_LOADER_SECTIONS)
+            report(PEIssue::TooManySections, "NumberOfSections", count_field, count);
+
+        // Keep the headers that are in the file rather than dropping the whole table
+        uint64_t available = offset < source_.size() ? (source_.size() - offset) / sizeof(IMAGE_SECTION_HEADER) : 0;
+        if(count > available)
+        {
+            report(PEIssue::SectionTableTruncated, "NumberOfSections", count_field, count);
+            count = available;
+        }
 
-        file_.seekg(dos->e_lfanew + offsetof(IMAGE_NT_HEADERS, OptionalHeader) + nt->FileHeader.SizeOfOptionalHeader, std::ios::beg);
-        file_.read(reinterpret_cast<char*>(sections.data()), sizeof(IMAGE_SECTION_HEADER) * sections.size());
+        sections = source_.view_array(offset, count, section_copy);
+
+        check_layout(offset);
     }
 
     return sections;
 }
 
-std::vector<std::string> PE::get_rdata_strings()
+void PE::check_layout(uint64_t section_table)
+{
+    for (size_t i = 0; i < sections.size(); ++i)
+    {
+        const IMAGE_SECTION_HEADER& section = sections[i];
+
+        if(section.SizeOfRawData != 0 && (section.PointerToRawData > source_.size() || section.SizeOfRawData > source_.size() - section.PointerToRawData))
+            report(PEIssue::SectionDataOutOfBounds, "SizeOfRawData", section_table + i * sizeof(IMAGE_SECTION_HEADER) + offsetof(IMAGE_SECTION_HEADER, SizeOfRawData), section.SizeOfRawData);
+    }
+
+    static const char* const names[16] =
+    {
+        "Export", "Import", "Resource", "Exception", "Security", "BaseReloc", "Debug", "Architecture",
+        "GlobalPtr", "TLS", "LoadConfig", "BoundImport", "IAT", "DelayImport", "COMDescriptor", "Reserved"
+    };
+
+    uint64_t directories = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + (is_64bit() ? offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory) : offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory));
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        IMAGE_DATA_DIRECTORY directory = nt->OptionalHeader.DataDirectory[i];
+        if(directory.VirtualAddress == 0 || i == IMAGE_DIRECTORY_ENTRY_ARCHITECTURE || i == IMAGE_DIRECTORY_ENTRY_GLOBALPTR || i == 15)
+            continue;
+
+        // The security directory is the one that holds a file offset, bound imports live in the headers
+        bool backed;
+        if(i == IMAGE_DIRECTORY_ENTRY_SECURITY)
+            backed = directory.VirtualAddress < source_.size() && directory.Size <= source_.size() - directory.VirtualAddress;
+        else
+            backed = !view_rva(directory.VirtualAddress, 1).empty();
+
+        if(!backed)
+            report(PEIssue::DirectoryOutOfBounds, names[i], directories + i * sizeof(IMAGE_DATA_DIRECTORY), directory.VirtualAddress);
+    }
+}
+
+Span<PEDiagnostic> PE::get_diagnostics()
+{
+    get_sections();
+
+    std::stable_partition(diagnostics.begin(), diagnostics.end(), [](const PEDiagnostic& diagnostic) { return diagnostic.fatal; });
+
+    return Span<PEDiagnostic>(diagnostics.data(), diagnostics.size());
+}
+
+const char* PE::get_error()
+{
+    if(get_nt() != nullptr)
+        return nullptr;
+
+    for (const PEDiagnostic& diagnostic : diagnostics)
+    {
+        if(diagnostic.fatal)
+            return describe_issue(diagnostic.issue);
+    }
+
+    return "Executeable isn't in PE format";
+}
+
+int32_t PE::get_section_by_offset(uint64_t offset)
 {
-    if(!rdata_strings.empty())
-        return rdata_strings;
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
 
-    for (IMAGE_SECTION_HEADER& section : sections) 
+    if(sections_by_offset.size() != all.size())
     {
-        char* section_name = reinterpret_cast<char*>(section.Name);
-        if(strcmp(section_name, ".rdata") == 0)
+        sections_by_offset.resize(all.size());
+        for (uint32_t i = 0; i < all.size(); ++i)
+            sections_by_offset[i] = i;
+
+        std::stable_sort(sections_by_offset.begin(), sections_by_offset.end(), [&all](uint32_t a, uint32_t b)
         {
-            std::vector<uint8_t> sectionData(section.SizeOfRawData);
-            file_.seekg(section.PointerToRawData, std::ios::beg);
-            file_.read(reinterpret_cast<char*>(sectionData.data()), section.SizeOfRawData);
-            
-            std::string string = "";
-            for (int i = 0; i < section.SizeOfRawData; ++i)
-            {
-                char c = sectionData.data()[i];
+            return all[a].PointerToRawData < all[b].PointerToRawData;
+        });
+    }
 
-                if(c == '\0')
-                {
-                    if(string.size() >= 4)
-                        rdata_strings.emplace_back(std::move(string));
+    // Last section starting at or before the offset
+    auto it = std::upper_bound(sections_by_offset.begin(), sections_by_offset.end(), offset, [&all](uint64_t value, uint32_t index)
+    {
+        return value < all[index].PointerToRawData;
+    });
 
-                    string.clear();
-                }
-                else
-                    string += c;
-            }
-            
-            if(string.size() >= 4)
-            {
-                rdata_strings.emplace_back(std::move(string));
+    if(it == sections_by_offset.begin())
+        return -1;
 
-                string.clear();
-            }        
+    const IMAGE_SECTION_HEADER& section = all[*(it - 1)];
+    if(offset - section.PointerToRawData >= section.SizeOfRawData)
+        return -1;
+
+    return static_cast<int32_t>(*(it - 1));
+}
+
+uint32_t PE::offset_to_rva(uint64_t offset)
+{
+    int32_t index = get_section_by_offset(offset);
+    if(index >= 0)
+    {
+        const IMAGE_SECTION_HEADER& section = sections[index];
+
+        return static_cast<uint32_t>(section.VirtualAddress + (offset - section.PointerToRawData));
+    }
+
+    // Headers are mapped as is at the start of the image
+    if(get_nt() != nullptr && offset < nt->OptionalHeader.SizeOfHeaders)
+        return static_cast<uint32_t>(offset);
+
+    return PE_NO_RVA;
+}
+
+int32_t PE::get_section_by_rva(uint32_t rva)
+{
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+
+    if(sections_by_rva.size() != all.size())
+    {
+        sections_by_rva.resize(all.size());
+        for (uint32_t i = 0; i < all.size(); ++i)
+            sections_by_rva[i] = i;
+
+        std::stable_sort(sections_by_rva.begin(), sections_by_rva.end(), [&all](uint32_t a, uint32_t b)
+        {
+            return all[a].VirtualAddress < all[b].VirtualAddress;
+        });
+    }
+
+    auto it = std::upper_bound(sections_by_rva.begin(), sections_by_rva.end(), rva, [&all](uint32_t value, uint32_t index)
+    {
+        return value < all[index].VirtualAddress;
+    });
+
+    if(it == sections_by_rva.begin())
+        return -1;
+
+    // The loader maps max(VirtualSize, SizeOfRawData), anything past the raw data is zero filled
+    const IMAGE_SECTION_HEADER& section = all[*(it - 1)];
+    if(rva - section.VirtualAddress >= std::max(section.Misc.VirtualSize, section.SizeOfRawData))
+        return -1;
+
+    return static_cast<int32_t>(*(it - 1));
+}
+
+uint64_t PE::rva_to_offset(uint32_t rva)
+{
+    int32_t index = get_section_by_rva(rva);
+    if(index >= 0)
+    {
+        const IMAGE_SECTION_HEADER& section = sections[index];
+
+        if(rva - section.VirtualAddress < section.SizeOfRawData)
+            return uint64_t(section.PointerToRawData) + (rva - section.VirtualAddress);
+
+        return PE_NO_OFFSET;
+    }
+
+    if(get_nt() != nullptr && rva < nt->OptionalHeader.SizeOfHeaders && rva < source_.size())
+        return rva;
+
+    return PE_NO_OFFSET;
+}
+
+ByteSpan PE::view_rva(uint32_t rva, uint64_t length)
+{
+    uint64_t offset = rva_to_offset(rva);
+    if(offset == PE_NO_OFFSET)
+        return {};
+
+    // How much of the file is mapped contiguously from this RVA
+    uint64_t available = nt->OptionalHeader.SizeOfHeaders - uint64_t(rva);
+
+    int32_t index = get_section_by_rva(rva);
+    if(index >= 0)
+        available = sections[index].SizeOfRawData - (rva - sections[index].VirtualAddress);
+
+    if(length > available)
+        return {};
+
+    return source_.view(offset, length);
+}
+
+std::string_view PE::get_rva_string(uint32_t rva, size_t max_length)
+{
+    uint64_t offset = rva_to_offset(rva);
+    if(offset == PE_NO_OFFSET)
+        return {};
+
+    int32_t index = get_section_by_rva(rva);
+    uint64_t available = index >= 0 ? sections[index].SizeOfRawData - (rva - sections[index].VirtualAddress) : nt->OptionalHeader.SizeOfHeaders - uint64_t(rva);
+
+    ByteSpan data = source_.view(offset, std::min<uint64_t>({ available, max_length, source_.size() - offset }));
+
+    const char* text = reinterpret_cast<const char*>(data.data());
+    size_t length = 0;
+    while(length < data.size() && text[length] != '\0')
+        ++length;
+
+    return std::string_view(text, length);
+}
+
+bool PE::is_64bit()
+{
+    return get_nt() != nullptr && nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+}
+
+uint64_t PE::get_image_base()
+{
+    return get_nt() != nullptr ? nt->OptionalHeader.ImageBase : 0;
+}
+
+bool PE::is_x86()
+{
+    return get_nt() != nullptr && (nt->FileHeader.Machine == MachineArc::I386 || nt->FileHeader.Machine == MachineArc::AMD64);
+}
+
+Disassembly* PE::get_disassembly(int32_t index)
+{
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    if(!is_x86() || index < 0 || uint32_t(index) >= all.size())
+        return nullptr;
+
+    const IMAGE_SECTION_HEADER& section = all[index];
+    if(!(section.Characteristics & (IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_CNT_CODE)))
+        return nullptr;
+
+    if(disassemblies.size() != all.size())
+        disassemblies.resize(all.size());
+
+    if(disassemblies[index] == nullptr)
+    {
+        // Raw data past VirtualSize is alignment padding, it never gets mapped
+        uint64_t size = section.SizeOfRawData;
+        if(section.Misc.VirtualSize != 0)
+            size = std::min<uint64_t>(size, section.Misc.VirtualSize);
+
+        uint64_t offset = std::min<uint64_t>(section.PointerToRawData, source_.size());
+        size = std::min(size, source_.size() - offset);
+
+        disassemblies[index] = std::make_unique<Disassembly>(page_cache, offset, size, get_image_base() + section.VirtualAddress, nt->FileHeader.Machine == MachineArc::AMD64);
+    }
+
+    return disassemblies[index].get();
+}
+
+IMAGE_DATA_DIRECTORY PE::get_data_directory(uint32_t index)
+{
+    if(get_nt() == nullptr || index >= 16)
+        return {};
+
+    return nt->OptionalHeader.DataDirectory[index];
+}
+
+std::string_view PE::describe_offset(uint64_t offset, uint64_t& start, uint64_t& end)
+{
+    start = 0;
+    end = source_.size();
+
+    if(get_nt() == nullptr || offset >= source_.size())
+        return "";
+
+    uint64_t nt_start = dos->e_lfanew;
+    uint64_t nt_end = nt_start + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + nt->FileHeader.SizeOfOptionalHeader;
+    uint64_t table_end = nt_end + uint64_t(get_sections().size()) * sizeof(IMAGE_SECTION_HEADER);
+
+    // Regions in file order, the first one containing the offset wins
+    const struct { uint64_t start; uint64_t end; const char* name; } headers[] =
+    {
+        { 0, sizeof(IMAGE_DOS_HEADER), "IMAGE_DOS_HEADER" },
+        { sizeof(IMAGE_DOS_HEADER), nt_start, "DOS stub" },
+        { nt_start, nt_end, "IMAGE_NT_HEADERS" },
+        { nt_end, table_end, "IMAGE_SECTION_HEADER" },
+        { table_end, nt->OptionalHeader.SizeOfHeaders, "Headers" },
+    };
+
+    for (const auto& header : headers)
+    {
+        if(offset >= header.start && offset < header.end)
+        {
+            start = header.start;
+            end = header.end;
+
+            return header.name;
         }
     }
 
-    return rdata_strings;
+    int32_t index = get_section_by_offset(offset);
+    if(index >= 0)
+    {
+        start = sections[index].PointerToRawData;
+        end = start + sections[index].SizeOfRawData;
+
+        return get_section_name(sections[index]);
+    }
+
+    // Not inside any section, the gap is bounded by the nearest section data on either side
+    start = std::min<uint64_t>(nt->OptionalHeader.SizeOfHeaders, offset);
+
+    for (const IMAGE_SECTION_HEADER& section : sections)
+    {
+        uint64_t section_start = section.PointerToRawData;
+        uint64_t section_end = section_start + section.SizeOfRawData;
+
+        if(section_end <= offset)
+            start = std::max(start, section_end);
+        else if(section_start > offset)
+            end = std::min(end, section_start);
+    }
+
+    // Nothing after it means it's past the last section's data
+    return end == source_.size() ? "Overlay" : "Padding";
 }
 
-/*
-* UI Elements
-*/
+uint64_t PE::memory_usage()
+{
+    uint64_t total = page_cache.memory_usage() + rdata_index.memory_usage() + strings_index.memory_usage();
+
+    total += entropy.sections.capacity() * sizeof(ByteHistogram) + entropy.profile.capacity() * sizeof(float);
+    total += hashes.sections.capacity() * sizeof(PESectionHashes);
+    total += payloads.capacity() * sizeof(CarvedPayload);
 
-static bool showIMAGE_DOS_HEADER = false;
-static bool showIMAGE_FILE_HEADER = false;
-static bool showIMAGE_SECTION_HEADER = false;
-static bool showSTRINGS = false;
-static std::string rdataSearchQuery = "";
+    // Strings, section lookups, diagnostics and directory tables
+    total += arena->memory_usage();
 
-#define NEW_TABLE_ENTRY(field, value, type) ImGui::TableNextRow(); \
-                    ImGui::TableSetColumnIndex(0); \
-                    ImGui::Text("%s", field); \
-                    ImGui::TableSetColumnIndex(1); \
-                    ImGui::Text("%" type, value);
+    resource_cache.for_each([&total](const PEResourceKey&, const std::shared_ptr<const PEResourceContent>& content) { total += content->memory_usage(); });
 
-void PE::render_sidebar()
+    for (const std::unique_ptr<Disassembly>& disassembly : disassemblies)
+    {
+        if(disassembly != nullptr)
+            total += sizeof(Disassembly) + disassembly->memory_usage();
+    }
+
+    return total;
+}
+
+void PE::set_thread_pool(ThreadPool* thread_pool)
 {
+    pool = thread_pool;
+}
 
-    if (ImGui::Button("STRINGS", ImVec2(-1, 0)))
-        showSTRINGS = !showSTRINGS;
+void PE::set_string_options(const StringScanOptions& options)
+{
+    // Only the cancel flag or progress counter changed, what was found is still valid
+    bool same = options.min_length == string_options.min_length && options.ascii == string_options.ascii && options.utf16 == string_options.utf16;
 
-    if (ImGui::Button("IMAGE_DOS_HEADER", ImVec2(-1, 0)))
-        showIMAGE_DOS_HEADER = !showIMAGE_DOS_HEADER;
+    string_options = options;
+    if(same)
+        return;
 
-    if (ImGui::Button("IMAGE_FILE_HEADER", ImVec2(-1, 0)))
-        showIMAGE_FILE_HEADER = !showIMAGE_FILE_HEADER;
+    rdata_strings.clear();
+    rdata_strings_view = {};
+    rdata_scanned = false;
+    strings.clear();
+    strings_view = {};
+    strings_scanned = false;
+    rdata_index.clear();
+    rdata_indexed = false;
+    strings_index.clear();
+    strings_indexed = false;
+}
+
+void PE::tag_strings(const std::vector<StringSpan>& spans, ArenaVector<PEString>& out)
+{
+    out.reserve(out.size() + spans.size());
 
-    if (ImGui::Button("IMAGE_SECTION_HEADER", ImVec2(-1, 0)))
-        showIMAGE_SECTION_HEADER = !showIMAGE_SECTION_HEADER;
+    for (const StringSpan& span : spans)
+    {
+        int32_t index = get_section_by_offset(span.offset);
+
+        uint32_t rva = PE_NO_RVA;
+        if(index >= 0)
+            rva = static_cast<uint32_t>(sections[index].VirtualAddress + (span.offset - sections[index].PointerToRawData));
+        else if(span.offset < nt->OptionalHeader.SizeOfHeaders)
+            rva = static_cast<uint32_t>(span.offset);
+
+        out.push_back({ span, index, rva });
+    }
 }
 
-void PE::render_main()
+Span<PEString> PE::get_rdata_strings()
 {
-    if(showSTRINGS)
+    if(rdata_scanned)
+        return rdata_strings_view;
+
+    std::vector<StringSpan> spans;
+
+    for (const IMAGE_SECTION_HEADER& section : get_sections()) 
     {
-        if (ImGui::TreeNode("STRINGS"))
+        if(get_section_name(section) == ".rdata")
         {
-            ImGui::InputTextWithHintR("Search", rdataSearchQuery);
+            // Sections that run past the end of the file aren't scanned
+            if(section.PointerToRawData <= source_.size() && section.SizeOfRawData <= source_.size() - section.PointerToRawData)
+                scan_strings(source_, section.PointerToRawData, section.SizeOfRawData, string_options, spans);
+        }
+    }
 
-            for (std::string& string : get_rdata_strings()) 
-            {
-                if(string.find(rdataSearchQuery) != std::string::npos)
-                    ImGui::Text("%s", string.c_str());
-            }
-           
-            ImGui::TreePop();
+    // A cancelled scan is partial, it's done again on the next call
+    if(string_options.cancel != nullptr && string_options.cancel->load(std::memory_order_relaxed))
+        return {};
+
+    if(get_nt() != nullptr)
+        tag_strings(spans, rdata_strings);
+
+    rdata_strings_view = Span<PEString>(rdata_strings.data(), rdata_strings.size());
+    rdata_scanned = true;
+
+    return rdata_strings_view;
+}
+
+Span<PEString> PE::get_strings()
+{
+    if(strings_scanned)
+        return strings_view;
+
+    // One pass over the whole file rather than per section so the overlay and anything between sections is covered too
+    if(source_.size() == 0 || get_nt() == nullptr)
+    {
+        strings_scanned = true;
+
+        return strings_view;
+    }
+
+    std::vector<StringSpan> spans;
+
+    // Without a mapping the file is streamed, a view of all of it would stay pinned in memory
+    if(!source_.is_mapped())
+        scan_strings(source_, 0, source_.size(), string_options, spans);
+    else if(pool != nullptr)
+        scan_strings_parallel(source_.view(0, source_.size()).data(), source_.size(), 0, string_options, *pool, spans);
+    else
+        scan_strings(source_.view(0, source_.size()).data(), source_.size(), 0, string_options, spans);
+
+    if(string_options.cancel != nullptr && string_options.cancel->load(std::memory_order_relaxed))
+        return {};
+
+    tag_strings(spans, strings);
+
+    strings_view = Span<PEString>(strings.data(), strings.size());
+    strings_scanned = true;
+
+    return strings_view;
+}
+
+std::string_view PE::get_string_text(const StringSpan& span, std::string& scratch)
+{
+    // Indexing reads every string, pinned views of them would add up to a copy of the file
+    if(!source_.is_mapped())
+    {
+        std::vector<uint8_t> buffer;
+        ByteSpan data = source_.chunk(span.offset, span.length, buffer);
+        if(data.empty())
+            return {};
+
+        scratch.clear();
+        append_string_text(data.data(), span, scratch);
+
+        return scratch;
+    }
+
+    ByteSpan data = source_.view(span.offset, span.length);
+    if(data.empty())
+        return {};
+
+    // ASCII is used straight from the mapping, only UTF-16 needs narrowing
+    if(span.encoding == StringEncoding::ASCII)
+        return std::string_view(reinterpret_cast<const char*>(data.data()), data.size());
+
+    scratch.clear();
+    append_string_text(data.data(), span, scratch);
+
+    return scratch;
+}
+
+StringIndex& PE::get_string_index(bool whole_file)
+{
+    StringIndex& index = whole_file ? strings_index : rdata_index;
+    bool& indexed = whole_file ? strings_indexed : rdata_indexed;
+
+    if(indexed)
+        return index;
+
+    Span<PEString> entries = whole_file ? get_strings() : get_rdata_strings();
+
+    // Nothing to index after a cancelled scan, the next call scans and indexes again
+    if(!(whole_file ? strings_scanned : rdata_scanned))
+        return index;
+
+    indexed = true;
+
+    PROFILE_SCOPE("PE::get_string_index");
+
+    std::string scratch;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        // Search only finds the strings before the cut, the list itself still has all of them
+        if(!index.add(get_string_text(entries[i].span, scratch)))
+        {
+            report(PEIssue::TableLimit, whole_file ? "StringIndex" : "RdataStringIndex", PE_NO_OFFSET, i);
+            break;
         }
-    }   
+    }
+
+    index.finalize();
+
+    return index;
+}
 
-    if(showIMAGE_DOS_HEADER)
+std::vector<PESignatureMatch> PE::scan_signatures(const SignatureSet& signatures, int32_t section, const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    PROFILE_SCOPE("PE::scan_signatures");
+    std::vector<PESignatureMatch> out;
+
+    uint64_t offset = 0;
+    uint64_t size = source_.size();
+
+    if(section >= 0)
+    {
+        if(static_cast<uint32_t>(section) >= get_sections().size())
+            return out;
+
+        offset = std::min<uint64_t>(sections[section].PointerToRawData, source_.size());
+        size = std::min<uint64_t>(sections[section].SizeOfRawData, source_.size() - offset);
+    }
+
+    ByteSpan data = source_.view(offset, size);
+    if(data.empty())
+        return out;
+
+    SignatureScanOptions options;
+    options.cancel = cancel;
+    options.progress = progress;
+
+    std::vector<SignatureMatch> matches;
+
+    if(pool != nullptr)
+        signatures.scan_parallel(data.data(), data.size(), offset, options, *pool, matches);
+    else
+        signatures.scan(data.data(), data.size(), offset, options, matches);
+
+    out.reserve(matches.size());
+
+    for (const SignatureMatch& match : matches)
+    {
+        // Sections can share raw data, hits in a section scan belong to that section
+        int32_t index = section >= 0 ? section : get_section_by_offset(match.offset);
+
+        uint32_t rva = index >= 0 ? static_cast<uint32_t>(sections[index].VirtualAddress + (match.offset - sections[index].PointerToRawData)) : offset_to_rva(match.offset);
+
+        out.push_back({ match, index, rva });
+    }
+
+    return out;
+}
+
+uint64_t PE::entropy_work()
+{
+    // File histogram, profile windows (each advances by step, together at most the file) and every section again
+    uint64_t work = source_.size() * 2;
+
+    for (const IMAGE_SECTION_HEADER& section : get_sections())
     {
-        if (ImGui::TreeNode("IMAGE_DOS_HEADER"))
+        uint64_t offset = std::min<uint64_t>(section.PointerToRawData, source_.size());
+        work += std::min<uint64_t>(section.SizeOfRawData, source_.size() - offset);
+    }
+
+    return work;
+}
+
+const PEEntropy& PE::get_entropy(const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    if(entropy_computed)
+        return entropy;
+
+    PROFILE_SCOPE("PE::get_entropy");
+
+    // A cancelled run left nothing behind, start over
+    entropy = {};
+
+    uint64_t size = source_.size();
+    if(size == 0)
+    {
+        entropy_computed = true;
+
+        return entropy;
+    }
+
+    // Power of two steps keep the points on round offsets, windows overlap by half so nothing sits on a boundary alone
+    entropy.step = 256;
+    while(entropy.step * 1024 < size)
+        entropy.step *= 2;
+
+    entropy.window = entropy.step * 2;
+
+    // Mapped files are counted in one go. Others are read a chunk at a time, a view of the whole file would stay pinned;
+    // chunks are a multiple of the step and carry the rest of their last window.
+    const uint64_t chunk_size = source_.is_mapped() ? size : std::max<uint64_t>(stream_chunk_size, entropy.step);
+    std::vector<uint8_t> buffer;
+
+    auto count = [&](const uint8_t* bytes, size_t size, ByteHistogram& histogram)
+    {
+        if(pool != nullptr)
+            count_bytes_parallel(bytes, size, *pool, histogram, cancel, progress);
+        else
         {
-            if (ImGui::BeginTable("IMAGE_DOS_HEADER", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable)) 
-            {
-                ImGui::TableSetupColumn("Field");
-                ImGui::TableSetupColumn("Value");
-                ImGui::TableHeadersRow();
-
-                NEW_TABLE_ENTRY("e_magic", dos->e_magic, PRIx16);
-                NEW_TABLE_ENTRY("e_magic", dos->e_magic, PRIx16);
-                NEW_TABLE_ENTRY("e_cblp", dos->e_cblp, PRIx16);
-                NEW_TABLE_ENTRY("e_cp", dos->e_cp, PRIX16);
-                NEW_TABLE_ENTRY("e_crlc", dos->e_crlc, PRIX16);
-                NEW_TABLE_ENTRY("e_cparhdr", dos->e_cparhdr, PRIX16);
-                NEW_TABLE_ENTRY("e_minalloc", dos->e_minalloc, PRIX16);
-                NEW_TABLE_ENTRY("e_maxalloc", dos->e_maxalloc, PRIX16);
-                NEW_TABLE_ENTRY("e_ss", dos->e_ss, PRIX16);
-                NEW_TABLE_ENTRY("e_sp", dos->e_sp, PRIX16);
-                NEW_TABLE_ENTRY("e_csum", dos->e_csum, PRIX16);
-                NEW_TABLE_ENTRY("e_ip", dos->e_ip, PRIX16);
-                NEW_TABLE_ENTRY("e_cs", dos->e_cs, PRIX16);
-                NEW_TABLE_ENTRY("e_lfarlc", dos->e_lfarlc, PRIX16);
-                NEW_TABLE_ENTRY("e_ovno", dos->e_ovno, PRIX16);
-                NEW_TABLE_ENTRY("e_oemid", dos->e_oemid, PRIX16);
-                NEW_TABLE_ENTRY("e_oeminfo", dos->e_oeminfo, PRIX16);
-                NEW_TABLE_ENTRY("e_lfanew", dos->e_lfanew, PRIX16);
-
-                ImGui::EndTable();
-            }
+            count_bytes(bytes, size, histogram);
+
+            if(progress != nullptr)
+                *progress += size;
+        }
+    };
+
+    std::vector<float> windows;
 
-            ImGui::TreePop();
+    for (uint64_t position = 0; position < size; position += chunk_size)
+    {
+        if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+            break;
+
+        ByteSpan data = source_.chunk(position, std::min(chunk_size + entropy.window - entropy.step, size - position), buffer);
+        if(data.empty())
+            break;
+
+        count(data.data(), std::min(chunk_size, size - position), entropy.file);
+
+        // Past the first chunk a tail shorter than a window has none, the whole file doesn't either
+        if(position != 0 && data.size() < entropy.window)
+            continue;
+
+        if(pool != nullptr)
+            sliding_entropy_parallel(data.data(), data.size(), entropy.window, entropy.step, *pool, windows, cancel, progress);
+        else
+        {
+            sliding_entropy(data.data(), data.size(), entropy.window, entropy.step, windows);
+
+            if(progress != nullptr)
+                *progress += windows.size() * entropy.step;
         }
+
+        entropy.profile.insert(entropy.profile.end(), windows.begin(), windows.end());
+    }
+
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    entropy.sections.resize(all.size());
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        // The whole raw data like other tools report it, padding included
+        uint64_t start = std::min<uint64_t>(all[i].PointerToRawData, size);
+        uint64_t end = start + std::min<uint64_t>(all[i].SizeOfRawData, size - start);
+
+        for (uint64_t position = start; position < end; position += chunk_size)
+        {
+            if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+                break;
+
+            ByteSpan data = source_.chunk(position, std::min(chunk_size, end - position), buffer);
+            if(data.empty())
+                break;
+
+            count(data.data(), data.size(), entropy.sections[i]);
+        }
+    }
+
+    // Counts stop anywhere when cancelled, what's there isn't the file's entropy and the next call computes it again
+    if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+    {
+        entropy = {};
+
+        return entropy;
+    }
+
+    entropy_computed = true;
+
+    return entropy;
+}
+
+const PEHashes& PE::get_hashes(const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    if(hashes_computed)
+        return hashes;
+
+    PROFILE_SCOPE("PE::get_hashes");
+
+    uint64_t size = source_.size();
+    if(size == 0 || get_nt() == nullptr)
+    {
+        hashes_computed = true;
+
+        return hashes;
+    }
+
+    struct Range
+    {
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // Authenticode hashes everything but the fields signing changes: CheckSum, the security directory entry and the
+    // certificate table it points at (a file offset, not an RVA). Skipping ranges of the file gives the same digest as
+    // walking the headers and sections in file order whenever the sections are laid out contiguously.
+    std::vector<Range> skipped;
+
+    uint64_t optional_header = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader);
+    uint64_t checksum = optional_header + offsetof(IMAGE_OPTIONAL_HEADER64, CheckSum); // Same offset in PE32
+    skipped.push_back({ checksum, checksum + sizeof(uint32_t) });
+
+    if(nt->OptionalHeader.NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_SECURITY)
+    {
+        uint64_t directories = optional_header + (is_64bit() ? offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory) : offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory));
+        uint64_t entry = directories + IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY);
+        skipped.push_back({ entry, entry + sizeof(IMAGE_DATA_DIRECTORY) });
+    }
+
+    IMAGE_DATA_DIRECTORY security = get_data_directory(IMAGE_DIRECTORY_ENTRY_SECURITY);
+    if(security.Size != 0 && security.VirtualAddress < size)
+        skipped.push_back({ security.VirtualAddress, std::min<uint64_t>(uint64_t(security.VirtualAddress) + security.Size, size) });
+
+    std::sort(skipped.begin(), skipped.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    std::vector<Range> section_ranges(all.size());
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        uint64_t offset = std::min<uint64_t>(all[i].PointerToRawData, size);
+        section_ranges[i] = { offset, offset + std::min<uint64_t>(all[i].SizeOfRawData, size - offset) };
     }
 
-    if(showIMAGE_FILE_HEADER)
+    Md5 md5;
+    Sha1 sha1;
+    Sha256 sha256;
+    Sha256 authenticode;
+    std::vector<Md5> section_md5(all.size());
+    std::vector<Sha256> section_sha256(all.size());
+
+    // Feeds the parts of [start, end) that fall inside ranges (or outside them when inverted) to update
+    auto clip = [&](const std::vector<Range>& ranges, uint64_t start, uint64_t end, bool inverted, const std::function<void(size_t, uint64_t, uint64_t)>& update)
+    {
+        uint64_t position = start;
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            uint64_t first = std::max(start, ranges[i].start);
+            uint64_t last = std::min(end, ranges[i].end);
+            if(first >= last)
+                continue;
+
+            if(inverted && first > position)
+                update(i, position, first);
+            else if(!inverted)
+                update(i, first, last);
+
+            position = std::max(position, last);
+        }
+
+        if(inverted && position < end)
+            update(ranges.size(), position, end);
+    };
+
+    // The chunk being hashed, a view of the mapping or a copy for sources that aren't mapped so the file isn't pinned
+    std::vector<uint8_t> buffer;
+    ByteSpan chunk;
+    uint64_t chunk_start = 0;
+    auto at = [&](uint64_t offset) { return chunk.data() + (offset - chunk_start); };
+
+    // Each digest is its own stream, all of them read a chunk while it's still in cache
+    const std::function<void(uint64_t, uint64_t)> streams[] =
+    {
+        [&](uint64_t start, uint64_t end) { md5.update(at(start), end - start); },
+        [&](uint64_t start, uint64_t end) { sha1.update(at(start), end - start); },
+        [&](uint64_t start, uint64_t end) { sha256.update(at(start), end - start); },
+        [&](uint64_t start, uint64_t end)
+        {
+            clip(skipped, start, end, true, [&](size_t, uint64_t first, uint64_t last) { authenticode.update(at(first), last - first); });
+        },
+        [&](uint64_t start, uint64_t end)
+        {
+            clip(section_ranges, start, end, false, [&](size_t i, uint64_t first, uint64_t last) { section_md5[i].update(at(first), last - first); });
+        },
+        [&](uint64_t start, uint64_t end)
+        {
+            clip(section_ranges, start, end, false, [&](size_t i, uint64_t first, uint64_t last) { section_sha256[i].update(at(first), last - first); });
+        }
+    };
+
+    const uint64_t chunk_size = 1 << 20;
+
+    for (uint64_t start = 0; start < size; start += chunk_size)
     {
-        if (ImGui::TreeNode("IMAGE_FILE_HEADER"))
+        if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+            return hashes;
+
+        uint64_t end = std::min<uint64_t>(start + chunk_size, size);
+
+        chunk = source_.chunk(start, end - start, buffer);
+        chunk_start = start;
+        if(chunk.empty())
+            return hashes;
+
+        if(pool != nullptr && pool->size() > 1)
         {
-            ImGui::Text("%s: %s", "Machine", get_arc_name(nt->FileHeader.Machine));
+            TaskGroup group(*pool);
 
-            ImGui::TreePop();
+            for (size_t i = 1; i < std::size(streams); ++i)
+                group.run([&, i]() { streams[i](start, end); });
+
+            streams[0](start, end);
+            group.wait();
         }
+        else
+        {
+            for (const auto& stream : streams)
+                stream(start, end);
+        }
+
+        if(progress != nullptr)
+            *progress += end - start;
+    }
+
+    md5.finish(hashes.md5);
+    sha1.finish(hashes.sha1);
+    sha256.finish(hashes.sha256);
+    authenticode.finish(hashes.authenticode);
+
+    hashes.sections.resize(all.size());
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        section_md5[i].finish(hashes.sections[i].md5);
+        section_sha256[i].finish(hashes.sections[i].sha256);
     }
 
-    if(showIMAGE_SECTION_HEADER)
+    // Same string pefile hashes: regular imports only, "dll.function" lower case with .dll/.ocx/.sys dropped and
+    // "ord<n>" for ordinals (pefile names a few well known ws2_32/oleaut32 ordinals, those hashes differ)
+    std::string text;
+    for (const PEImport& import : get_imports())
     {
-        if (ImGui::TreeNode("IMAGE_SECTION_HEADER"))
+        if(import.delayed)
+            continue;
+
+        std::string dll(import.dll);
+        std::transform(dll.begin(), dll.end(), dll.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        size_t dot = dll.rfind('.');
+        if(dot != std::string::npos)
+        {
+            std::string_view extension = std::string_view(dll).substr(dot + 1);
+            if(extension == "dll" || extension == "ocx" || extension == "sys")
+                dll.resize(dot);
+        }
+
+        for (const PEImportFunction& function : import.functions)
         {
-            for (IMAGE_SECTION_HEADER& section : sections) 
+            if(!text.empty())
+                text += ',';
+
+            text += dll;
+            text += '.';
+
+            if(function.by_ordinal)
+                text += "ord" + std::to_string(function.hint);
+            else
             {
-                if(ImGui::TreeNode(reinterpret_cast<const char*>(section.Name)))
-                {
-                    if (ImGui::BeginTable(reinterpret_cast<const char*>(section.Name), 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable)) 
-                    {
-                        ImGui::TableSetupColumn("Field");
-                        ImGui::TableSetupColumn("Value");
-                        ImGui::TableHeadersRow();
-
-                        bool is_readonly = (section.Characteristics & IMAGE_SCN_MEM_READ) && !(section.Characteristics & IMAGE_SCN_MEM_WRITE);
-                                
-                        NEW_TABLE_ENTRY("IsReadonly", is_readonly ? "true" : "false", "s");
-                        NEW_TABLE_ENTRY("VirtualAddress", section.VirtualAddress, PRIu32);
-                        NEW_TABLE_ENTRY("SizeOfRawData", section.SizeOfRawData, PRIu32);
-                        NEW_TABLE_ENTRY("PointerToRawData", section.PointerToRawData, PRIu32);
-                        NEW_TABLE_ENTRY("PointerToRelocations", section.PointerToRelocations, PRIu32);
-                        NEW_TABLE_ENTRY("PointerToLinenumbers", section.PointerToLinenumbers, PRIu32);
-                        NEW_TABLE_ENTRY("NumberOfRelocations", section.NumberOfRelocations, PRIu16);
-                        NEW_TABLE_ENTRY("NumberOfLinenumbers", section.NumberOfLinenumbers, PRIu16);
-                        NEW_TABLE_ENTRY("Characteristics", section.Characteristics, PRIu32);
-
-                        ImGui::EndTable();
-                    }
-
-                    if(ImGui::TreeNode("Misc"))
-                    {
-                        ImGui::Text("%s: %" PRIu32, "PhysicalAddress", section.Misc.PhysicalAddress);
-                        ImGui::Text("%s: %" PRIu32, "VirtualSize", section.Misc.VirtualSize);
-
-                        ImGui::TreePop();
-                    }
-
-                    ImGui::TreePop();
-                }
+                for (char c : function.name)
+                    text += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
             }
+        }
+    }
+
+    if(!text.empty())
+    {
+        Md5 imphash;
+        imphash.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        imphash.finish(hashes.imphash);
+        hashes.has_imphash = true;
+    }
+
+    // Only now, a cancelled pass returns before any digest is finished and the next call hashes again
+    hashes_computed = true;
+
+    return hashes;
+}
+
+PEOverlay PE::get_overlay()
+{
+    PEOverlay overlay;
+    overlay.offset = source_.size();
+
+    if(get_nt() == nullptr)
+        return overlay;
+
+    uint64_t file_size = source_.size();
+    uint64_t end = std::min<uint64_t>(nt->OptionalHeader.SizeOfHeaders, file_size);
+
+    // Nothing the loader maps reaches past the end of the last section's raw data
+    for (const IMAGE_SECTION_HEADER& section : get_sections())
+    {
+        uint64_t offset = std::min<uint64_t>(section.PointerToRawData, file_size);
+        end = std::max(end, offset + std::min<uint64_t>(section.SizeOfRawData, file_size - offset));
+    }
+
+    overlay.offset = end;
+    overlay.size = file_size - end;
+
+    // The security directory holds a file offset, not an RVA
+    IMAGE_DATA_DIRECTORY security = get_data_directory(IMAGE_DIRECTORY_ENTRY_SECURITY);
+    uint64_t certificates_end = std::min<uint64_t>(uint64_t(security.VirtualAddress) + security.Size, file_size);
+
+    if(security.Size != 0 && certificates_end > end)
+        overlay.certificates = certificates_end - std::max<uint64_t>(security.VirtualAddress, end);
 
-            ImGui::TreePop();
+    return overlay;
+}
+
+uint64_t PE::payload_work()
+{
+    if(get_nt() == nullptr)
+        return 0;
+
+    return source_.size() - std::min<uint64_t>(nt->OptionalHeader.SizeOfHeaders, source_.size());
+}
+
+Span<CarvedPayload> PE::get_payloads(const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    if(payloads_carved)
+        return Span<CarvedPayload>(payloads.data(), payloads.size());
+
+    payloads_carved = true;
+
+    CarveOptions options;
+    options.cancel = cancel;
+    options.progress = progress;
+
+    // The file's own "MZ" is in the headers, the sections and overlay are swept
+    payloads = carve_payloads(source_, source_.size() - payload_work(), source_.size(), options);
+
+    return Span<CarvedPayload>(payloads.data(), payloads.size());
+}
+
+std::vector<BackgroundAnalysis::Stage> PE::analysis_stages(BackgroundAnalysis& background)
+{
+    std::vector<BackgroundAnalysis::Stage> stages(static_cast<size_t>(PEStage::Count));
+
+    stages[static_cast<size_t>(PEStage::Headers)] = { "Headers", [this]() -> const char*
+    {
+        if(const char* error = get_error())
+            return error;
+
+        // Whatever the cache holds makes the stages below return straight away
+        load_cache();
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Sections)] = { "Sections", [this]() -> const char*
+    {
+        get_sections();
+
+        // Builds the lookup tables so later lookups from the render thread only read them
+        get_section_by_offset(0);
+        get_section_by_rva(0);
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Directories)] = { "Directories", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(PEStage::Directories);
+        std::atomic<uint64_t>& done = background.done_counter(stage);
+
+        background.set_total(stage, 7);
+
+        get_imports(); ++done;
+        get_exports(); ++done;
+        get_relocations(); ++done;
+        get_resources(); ++done;
+        get_tls(); ++done;
+        get_debug_entries(); ++done;
+        get_exception_entries(); ++done;
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Entropy)] = { "Entropy", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(PEStage::Entropy);
+
+        background.set_total(stage, entropy_work());
+        get_entropy(&background.cancel_flag(), &background.done_counter(stage));
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Hashes)] = { "Hashes", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(PEStage::Hashes);
+
+        background.set_total(stage, source_.size());
+        get_hashes(&background.cancel_flag(), &background.done_counter(stage));
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Strings)] = { "Strings", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(PEStage::Strings);
+        std::atomic<uint64_t>& done = background.done_counter(stage);
+
+        uint64_t rdata_size = 0;
+        for (const IMAGE_SECTION_HEADER& section : get_sections())
+        {
+            if(get_section_name(section) == ".rdata")
+                rdata_size += section.SizeOfRawData;
         }
-    } 
-}
\ No newline at end of file
+
+        background.set_total(stage, rdata_size + source_.size());
+
+        StringScanOptions options = string_options;
+        options.cancel = &background.cancel_flag();
+        options.progress = &done;
+        set_string_options(options);
+
+        get_rdata_strings();
+        get_string_index(false);
+        done += rdata_size;
+
+        if(background.cancelled())
+            return nullptr;
+
+        get_strings();
+        get_string_index(true);
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Payloads)] = { "Payloads", [this, &background]() -> const char*
+    {
+        const size_t stage = static_cast<size_t>(PEStage::Payloads);
+
+        background.set_total(stage, payload_work());
+        get_payloads(&background.cancel_flag(), &background.done_counter(stage));
+
+        return nullptr;
+    }};
+
+    stages[static_cast<size_t>(PEStage::Cache)] = { "Cache", [this]() -> const char*
+    {
+        save_cache();
+
+        return nullptr;
+    }};
+
+    return stages;
+}
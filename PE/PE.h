@@ -5,10 +5,28 @@
 
 #pragma once
 #include <cstdint>
-#include <fstream>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
-#include <imgui.h> 
 #include <inttypes.h>
+#include "../core/byte_source.h"
+#include "../core/string_scanner.h"
+#include "../core/string_index.h"
+#include "../core/page_cache.h"
+#include "../core/disassembly.h"
+#include "../core/entropy.h"
+#include "../core/hash.h"
+#include "../core/background_analysis.h"
+#include "../core/image.h"
+#include "../core/lru_cache.h"
+#include "../core/analysis_cache.h"
+#include "../core/binary_format.h"
+#include "../core/signature_scanner.h"
+#include "../core/patch_layer.h"
+#include "../core/arena.h"
+#include "../core/carver.h"
 
 // MS Dos headers, most of the fields here are unused by modern Windows. Only exists for compatability. 
 typedef struct _IMAGE_DOS_HEADER 
@@ -97,6 +115,12 @@ typedef struct _IMAGE_FILE_HEADER
     uint16_t Characteristics;
 } IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
 
+typedef struct _IMAGE_DATA_DIRECTORY
+{
+    uint32_t VirtualAddress;
+    uint32_t Size;
+} IMAGE_DATA_DIRECTORY, *PIMAGE_DATA_DIRECTORY;
+
 typedef struct _IMAGE_OPTIONAL_HEADER64 
 {
     uint16_t Magic;
@@ -128,19 +152,61 @@ typedef struct _IMAGE_OPTIONAL_HEADER64
     uint64_t SizeOfHeapCommit;
     uint32_t LoaderFlags;
     uint32_t NumberOfRvaAndSizes;
-    struct {
-        uint32_t VirtualAddress;
-        uint32_t Size;
-    } DataDirectory[16];
+    IMAGE_DATA_DIRECTORY DataDirectory[16];
 } IMAGE_OPTIONAL_HEADER64, *PIMAGE_OPTIONAL_HEADER64;
 
+// PE32 has a 32 bit ImageBase and stack/heap sizes, plus BaseOfData
+typedef struct _IMAGE_OPTIONAL_HEADER32
+{
+    uint16_t Magic;
+    uint8_t MajorLinkerVersion;
+    uint8_t MinorLinkerVersion;
+    uint32_t SizeOfCode;
+    uint32_t SizeOfInitializedData;
+    uint32_t SizeOfUninitializedData;
+    uint32_t AddressOfEntryPoint;
+    uint32_t BaseOfCode;
+    uint32_t BaseOfData;
+    uint32_t ImageBase;
+    uint32_t SectionAlignment;
+    uint32_t FileAlignment;
+    uint16_t MajorOperatingSystemVersion;
+    uint16_t MinorOperatingSystemVersion;
+    uint16_t MajorImageVersion;
+    uint16_t MinorImageVersion;
+    uint16_t MajorSubsystemVersion;
+    uint16_t MinorSubsystemVersion;
+    uint32_t Win32VersionValue;
+    uint32_t SizeOfImage;
+    uint32_t SizeOfHeaders;
+    uint32_t CheckSum;
+    uint16_t Subsystem;
+    uint16_t DllCharacteristics;
+    uint32_t SizeOfStackReserve;
+    uint32_t SizeOfStackCommit;
+    uint32_t SizeOfHeapReserve;
+    uint32_t SizeOfHeapCommit;
+    uint32_t LoaderFlags;
+    uint32_t NumberOfRvaAndSizes;
+    IMAGE_DATA_DIRECTORY DataDirectory[16];
+} IMAGE_OPTIONAL_HEADER32, *PIMAGE_OPTIONAL_HEADER32;
+
 // PE structure 
-typedef struct _IMAGE_NT_HEADERS
+typedef struct _IMAGE_NT_HEADERS64
 {
     uint32_t Signature;                           /*00: PE Signature */
-    IMAGE_FILE_HEADER FileHeader;                 /*02: Attributes */
-    IMAGE_OPTIONAL_HEADER64 OptionalHeader;
-} IMAGE_NT_HEADERS, *PIMAGE_NT_HEADERS;
+    IMAGE_FILE_HEADER FileHeader;                 /*04: Attributes */
+    IMAGE_OPTIONAL_HEADER64 OptionalHeader;       /*18: Layout depends on OptionalHeader.Magic */
+} IMAGE_NT_HEADERS64, *PIMAGE_NT_HEADERS64;
+
+typedef struct _IMAGE_NT_HEADERS32
+{
+    uint32_t Signature;
+    IMAGE_FILE_HEADER FileHeader;
+    IMAGE_OPTIONAL_HEADER32 OptionalHeader;
+} IMAGE_NT_HEADERS32, *PIMAGE_NT_HEADERS32;
+
+#define IMAGE_SCN_CNT_CODE			    0x00000020
 
 #define IMAGE_SCN_MEM_DISCARDABLE		0x02000000
 #define IMAGE_SCN_MEM_NOT_CACHED		0x04000000
@@ -150,25 +216,818 @@ typedef struct _IMAGE_NT_HEADERS
 #define IMAGE_SCN_MEM_READ			    0x40000000
 #define IMAGE_SCN_MEM_WRITE			    0x80000000
 
-class PE 
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC   0x10B
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC   0x20B
+
+// Indices into DataDirectory
+#define IMAGE_DIRECTORY_ENTRY_EXPORT          0
+#define IMAGE_DIRECTORY_ENTRY_IMPORT          1
+#define IMAGE_DIRECTORY_ENTRY_RESOURCE        2
+#define IMAGE_DIRECTORY_ENTRY_EXCEPTION       3
+#define IMAGE_DIRECTORY_ENTRY_SECURITY        4
+#define IMAGE_DIRECTORY_ENTRY_BASERELOC       5
+#define IMAGE_DIRECTORY_ENTRY_DEBUG           6
+#define IMAGE_DIRECTORY_ENTRY_ARCHITECTURE    7
+#define IMAGE_DIRECTORY_ENTRY_GLOBALPTR       8
+#define IMAGE_DIRECTORY_ENTRY_TLS             9
+#define IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG    10
+#define IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT   11
+#define IMAGE_DIRECTORY_ENTRY_IAT            12
+#define IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT   13
+#define IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR 14
+
+typedef struct _IMAGE_IMPORT_DESCRIPTOR
+{
+    uint32_t OriginalFirstThunk;  // RVA of the import lookup table
+    uint32_t TimeDateStamp;
+    uint32_t ForwarderChain;
+    uint32_t Name;                // RVA of the DLL name
+    uint32_t FirstThunk;          // RVA of the import address table
+} IMAGE_IMPORT_DESCRIPTOR, *PIMAGE_IMPORT_DESCRIPTOR;
+
+typedef struct _IMAGE_DELAYLOAD_DESCRIPTOR
+{
+    uint32_t Attributes;                  // Bit 0 set when the fields are RVAs, old images store VAs
+    uint32_t DllNameRVA;
+    uint32_t ModuleHandleRVA;
+    uint32_t ImportAddressTableRVA;
+    uint32_t ImportNameTableRVA;
+    uint32_t BoundImportAddressTableRVA;
+    uint32_t UnloadInformationTableRVA;
+    uint32_t TimeDateStamp;
+} IMAGE_DELAYLOAD_DESCRIPTOR, *PIMAGE_DELAYLOAD_DESCRIPTOR;
+
+typedef struct _IMAGE_EXPORT_DIRECTORY
+{
+    uint32_t Characteristics;
+    uint32_t TimeDateStamp;
+    uint16_t MajorVersion;
+    uint16_t MinorVersion;
+    uint32_t Name;
+    uint32_t Base;                  // Ordinal of the first entry in AddressOfFunctions
+    uint32_t NumberOfFunctions;
+    uint32_t NumberOfNames;
+    uint32_t AddressOfFunctions;    // RVA of uint32_t[NumberOfFunctions]
+    uint32_t AddressOfNames;        // RVA of uint32_t[NumberOfNames], sorted name RVAs
+    uint32_t AddressOfNameOrdinals; // RVA of uint16_t[NumberOfNames], indices into AddressOfFunctions
+} IMAGE_EXPORT_DIRECTORY, *PIMAGE_EXPORT_DIRECTORY;
+
+typedef struct _IMAGE_BASE_RELOCATION
+{
+    uint32_t VirtualAddress; // Page the entries apply to
+    uint32_t SizeOfBlock;    // Including this header, followed by uint16_t entries
+} IMAGE_BASE_RELOCATION, *PIMAGE_BASE_RELOCATION;
+
+typedef struct _IMAGE_RESOURCE_DIRECTORY
+{
+    uint32_t Characteristics;
+    uint32_t TimeDateStamp;
+    uint16_t MajorVersion;
+    uint16_t MinorVersion;
+    uint16_t NumberOfNamedEntries;
+    uint16_t NumberOfIdEntries;
+} IMAGE_RESOURCE_DIRECTORY, *PIMAGE_RESOURCE_DIRECTORY;
+
+typedef struct _IMAGE_RESOURCE_DIRECTORY_ENTRY
+{
+    uint32_t Name;         // High bit set: offset of a length prefixed UTF-16 name, otherwise an integer id
+    uint32_t OffsetToData; // High bit set: offset of a subdirectory, otherwise of an IMAGE_RESOURCE_DATA_ENTRY
+} IMAGE_RESOURCE_DIRECTORY_ENTRY, *PIMAGE_RESOURCE_DIRECTORY_ENTRY;
+
+typedef struct _IMAGE_RESOURCE_DATA_ENTRY
+{
+    uint32_t OffsetToData; // RVA, unlike the offsets in the directory entries
+    uint32_t Size;
+    uint32_t CodePage;
+    uint32_t Reserved;
+} IMAGE_RESOURCE_DATA_ENTRY, *PIMAGE_RESOURCE_DATA_ENTRY;
+
+typedef struct _IMAGE_TLS_DIRECTORY32
+{
+    uint32_t StartAddressOfRawData;
+    uint32_t EndAddressOfRawData;
+    uint32_t AddressOfIndex;
+    uint32_t AddressOfCallBacks;
+    uint32_t SizeOfZeroFill;
+    uint32_t Characteristics;
+} IMAGE_TLS_DIRECTORY32, *PIMAGE_TLS_DIRECTORY32;
+
+typedef struct _IMAGE_TLS_DIRECTORY64
+{
+    uint64_t StartAddressOfRawData;
+    uint64_t EndAddressOfRawData;
+    uint64_t AddressOfIndex;
+    uint64_t AddressOfCallBacks; // VA of a NULL terminated array of callback VAs
+    uint32_t SizeOfZeroFill;
+    uint32_t Characteristics;
+} IMAGE_TLS_DIRECTORY64, *PIMAGE_TLS_DIRECTORY64;
+
+typedef struct _IMAGE_DEBUG_DIRECTORY
+{
+    uint32_t Characteristics;
+    uint32_t TimeDateStamp;
+    uint16_t MajorVersion;
+    uint16_t MinorVersion;
+    uint32_t Type;
+    uint32_t SizeOfData;
+    uint32_t AddressOfRawData;
+    uint32_t PointerToRawData;
+} IMAGE_DEBUG_DIRECTORY, *PIMAGE_DEBUG_DIRECTORY;
+
+#define IMAGE_DEBUG_TYPE_CODEVIEW 2
+
+// x64 .pdata entry, other machines use different layouts
+typedef struct _IMAGE_RUNTIME_FUNCTION_ENTRY
+{
+    uint32_t BeginAddress;
+    uint32_t EndAddress;
+    uint32_t UnwindInfoAddress;
+} IMAGE_RUNTIME_FUNCTION_ENTRY, *PIMAGE_RUNTIME_FUNCTION_ENTRY;
+
+// Optional header flavours, code that depends on the layout or the pointer size is templated on these
+struct PE32
+{
+    using NtHeaders = IMAGE_NT_HEADERS32;
+    using Pointer = uint32_t; // Thunks, TLS callbacks
+    using TlsDirectory = IMAGE_TLS_DIRECTORY32;
+
+    static constexpr uint16_t magic = IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+    static constexpr Pointer ordinal_flag = 0x80000000u;
+};
+
+struct PE64
+{
+    using NtHeaders = IMAGE_NT_HEADERS64;
+    using Pointer = uint64_t;
+    using TlsDirectory = IMAGE_TLS_DIRECTORY64;
+
+    static constexpr uint16_t magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+    static constexpr Pointer ordinal_flag = 0x8000000000000000ull;
+};
+
+// Flavour independent copy of the NT headers, what the UI and CLI read. PE32 fields are widened into the PE32+ layout
+// and directories past NumberOfRvaAndSizes (or past the end of a short optional header) are zeroed.
+struct PENtHeaders
+{
+    uint32_t Signature;
+    IMAGE_FILE_HEADER FileHeader;
+    IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+    uint32_t BaseOfData; // PE32 only
+};
+
+#define PE_NO_RVA 0xFFFFFFFF
+#define PE_NO_OFFSET UINT64_MAX
+
+// Windows refuses to load images with more sections than this
+#define PE_MAX_LOADER_SECTIONS 96
+
+// Resource directory entries one walk reads across all levels. Subdirectories can point back at enclosing or shared ones,
+// so the work isn't bounded by the number of leaves.
+#define PE_MAX_RESOURCE_ENTRIES (1 << 18)
+
+// Problems found in malformed files. Parsers keep whatever is still in bounds, only header issues are fatal.
+enum class PEIssue : uint8_t
+{
+    TruncatedDosHeader,      // File is smaller than IMAGE_DOS_HEADER
+    BadDosSignature,         // e_magic isn't MZ
+    NtHeadersOutOfBounds,    // e_lfanew points past the end of the file
+    BadNtSignature,          // No PE\0\0 at e_lfanew
+    UnknownOptionalMagic,    // Neither PE32 nor PE32+
+    OptionalHeaderTooSmall,  // SizeOfOptionalHeader doesn't reach the data directories
+    OptionalHeaderTruncated, // File ends inside the optional header
+    TooManyDirectories,      // NumberOfRvaAndSizes above 16, the rest are ignored
+    SectionTableTruncated,   // Only the section headers that fit in the file are used
+    TooManySections,         // More than the loader accepts, still parsed
+    SectionDataOutOfBounds,  // Raw data runs past the end of the file
+    DirectoryOutOfBounds,    // Directory isn't backed by the file
+    TableLimit               // A table was cut at its allocation cap
+};
+
+struct PEDiagnostic
+{
+    PEIssue issue;
+    bool fatal;        // Nothing past the headers could be parsed
+    const char* field; // Structure or field at fault
+    uint64_t offset;   // File offset of the field, PE_NO_OFFSET if it isn't tied to one
+    uint64_t value;    // What the field held
+};
+
+// A string found in the file, tagged with where it lives in the image
+struct PEString
+{
+    StringSpan span;
+    int32_t section; // Index into get_sections(), -1 for the headers, overlay and gaps between sections
+    uint32_t rva;    // PE_NO_RVA if the string isn't mapped by the loader (overlay, gaps)
+};
+
+// A signature hit, see PE::scan_signatures
+struct PESignatureMatch
+{
+    SignatureMatch match;
+    int32_t section; // Index into get_sections(), -1 for the headers, overlay and gaps between sections
+    uint32_t rva;    // PE_NO_RVA if the bytes aren't mapped by the loader
+};
+
+struct PEImportFunction
+{
+    std::string_view name; // Empty when imported by ordinal
+    uint16_t hint;         // Ordinal when imported by ordinal, otherwise the export name table hint
+    bool by_ordinal;
+    uint32_t iat_rva;      // Import address table slot the loader patches
+};
+
+struct PEImport
+{
+    std::string_view dll;
+    bool delayed;
+    Span<PEImportFunction> functions;
+};
+
+struct PEExport
+{
+    uint32_t ordinal;
+    uint32_t rva;
+    std::string_view name;      // Empty if only exported by ordinal
+    std::string_view forwarder; // "dll.function" when the RVA points back into the export directory
+};
+
+struct PEExports
+{
+    std::string_view dll;
+    uint32_t ordinal_base = 0;
+    Span<PEExport> functions;
+};
+
+struct PERelocationBlock
+{
+    uint32_t page_rva;
+    Span<uint16_t> entries; // Type in the top 4 bits, offset into the page in the low 12
+};
+
+// Resource directory level, either an integer id or a name (narrowed from UTF-16)
+struct PEResourceId
+{
+    uint32_t id;
+    std::string_view name; // Copied into the arena
+};
+
+struct PEResource
+{
+    PEResourceId type;
+    PEResourceId name;
+    uint32_t language;
+    uint32_t rva;
+    uint32_t size;
+    uint32_t code_page;
+};
+
+// Predefined resource types that have a decoder (winuser.h)
+#define RT_CURSOR        1
+#define RT_BITMAP        2
+#define RT_ICON          3
+#define RT_STRING        6
+#define RT_GROUP_CURSOR 12
+#define RT_GROUP_ICON   14
+#define RT_VERSION      16
+#define RT_MANIFEST     24
+
+// Entry of one resource directory, read when that directory is opened instead of by a full walk
+struct PEResourceNode
+{
+    uint32_t id;      // 0 when the entry is named
+    std::string name; // Narrowed from UTF-16
+    bool directory;   // Otherwise a data entry
+    uint32_t offset;  // Of the subdirectory or the IMAGE_RESOURCE_DATA_ENTRY, from the start of the resource directory
+};
+
+enum class PEResourceKind
+{
+    Raw, // No decoder for the type, or it failed
+    VersionInfo,
+    Manifest,
+    StringTable,
+    Image,    // Icons, cursors and bitmaps
+    IconGroup // Icons and cursors of one size set
+};
+
+struct PEVersionString
+{
+    std::string table; // Language and code page, "040904B0"
+    std::string key;
+    std::string value;
+};
+
+struct PEIconGroupEntry
+{
+    uint32_t width;
+    uint32_t height;
+    uint16_t bit_count;
+    uint32_t size;
+    uint16_t id; // Name of the RT_ICON or RT_CURSOR resource holding it
+};
+
+// Arguments of PE::decode_resource, every one of them changes what's decoded (string tables number their strings from the
+// name)
+struct PEResourceKey
+{
+    uint32_t type;
+    uint32_t name;
+    uint32_t rva;
+    uint32_t size;
+
+    bool operator==(const PEResourceKey& other) const
+    {
+        return type == other.type && name == other.name && rva == other.rva && size == other.size;
+    }
+
+    struct Hash
+    {
+        size_t operator()(const PEResourceKey& key) const
+        {
+            uint64_t low = (uint64_t(key.type) << 32) | key.rva;
+            uint64_t high = (uint64_t(key.name) << 32) | key.size;
+
+            return std::hash<uint64_t>()(low ^ (high * 0x9E3779B97F4A7C15ull));
+        }
+    };
+};
+
+// One decoded resource, see PE::decode_resource. Only the members for kind are filled in.
+struct PEResourceContent
+{
+    PEResourceKind kind = PEResourceKind::Raw;
+    std::string error; // Why a type with a decoder came out Raw
+
+    // VersionInfo, versions are major, minor, build and revision in 16 bits each from the top. Zero without VS_FIXEDFILEINFO.
+    uint64_t file_version = 0;
+    uint64_t product_version = 0;
+    uint32_t file_flags = 0;
+    uint32_t file_os = 0;
+    uint32_t file_type = 0;
+    std::vector<PEVersionString> version_strings;
+
+    std::string text; // Manifest, UTF-8
+
+    // StringTable, id and UTF-8 text of the non-empty strings of the block
+    std::vector<std::pair<uint32_t, std::string>> strings;
+
+    Image image;
+    std::vector<PEIconGroupEntry> icons;
+
+    // Approximate heap use
+    uint64_t memory_usage() const;
+};
+
+struct PETls
+{
+    bool present = false;
+    uint64_t start = 0;     // VAs, as stored in the directory
+    uint64_t end = 0;
+    uint64_t index = 0;
+    uint64_t callbacks_va = 0;
+    uint32_t zero_fill = 0;
+    uint32_t characteristics = 0;
+    Span<uint64_t> callbacks;
+};
+
+struct PEDebugEntry
+{
+    const IMAGE_DEBUG_DIRECTORY* directory;
+    std::string_view pdb_path; // From a CodeView RSDS record
+    uint32_t pdb_age;
+};
+
+// Byte statistics of the whole file, see PE::get_entropy
+struct PEEntropy
+{
+    ByteHistogram file;
+    std::vector<ByteHistogram> sections; // Raw data of each section, indexed like get_sections()
+    std::vector<float> profile;          // Point i is the entropy of [i * step, i * step + window)
+    uint64_t window = 0;
+    uint64_t step = 0;
+};
+
+struct PESectionHashes
+{
+    uint8_t md5[Md5::digest_size];
+    uint8_t sha256[Sha256::digest_size];
+};
+
+// Digests of the file, see PE::get_hashes
+struct PEHashes
+{
+    uint8_t md5[Md5::digest_size] = {};
+    uint8_t sha1[Sha1::digest_size] = {};
+    uint8_t sha256[Sha256::digest_size] = {};
+    uint8_t authenticode[Sha256::digest_size] = {}; // SHA-256 of the file minus CheckSum, the security directory entry and the certificates
+    uint8_t imphash[Md5::digest_size] = {};
+    bool has_imphash = false;                       // False without regular imports
+    std::vector<PESectionHashes> sections;          // Raw data of each section, indexed like get_sections()
+};
+
+// Data after everything the loader maps, see PE::get_overlay
+struct PEOverlay
+{
+    uint64_t offset = 0;       // End of the headers or of the last section's raw data, the file size when there's no overlay
+    uint64_t size = 0;
+    uint64_t certificates = 0; // Bytes of it taken by the Authenticode certificate table, which is appended there
+};
+
+// Stages of PE::analysis_stages, in order
+enum class PEStage : size_t
+{
+    Headers,
+    Sections,
+    Directories,
+    Entropy,
+    Hashes,
+    Strings,
+    Payloads,
+    Cache,
+    Count
+};
+
+// Row of the resource tree view, one entry of an expanded directory
+struct PEResourceRow
+{
+    uint32_t directory; // Holding the entry, from the start of the resource directory
+    uint32_t index;
+    uint32_t type;      // Ids of the type and name levels above the row, 0 where the row is that level itself
+    uint32_t name;
+    uint8_t depth;
+    bool expanded;
+};
+
+// What the window shows for one file. Kept apart from PE so it survives the parser being dropped and rebuilt (see
+// Workspace), only PE_ui.cpp uses it.
+struct PEViewState : ViewState
+{
+    bool showIMAGE_DOS_HEADER = false;
+    bool showIMAGE_FILE_HEADER = false;
+    bool showIMAGE_OPTIONAL_HEADER = false;
+    bool showIMAGE_SECTION_HEADER = false;
+    bool showSTRINGS = false;
+    bool showHEX = false;
+    bool showDISASSEMBLY = false;
+    bool showENTROPY = false;
+    bool showHASHES = false;
+    bool showSIGNATURES = false;
+    bool showDIAGNOSTICS = false;
+    bool showIMPORTS = false;
+    bool showEXPORTS = false;
+    bool showRESOURCES = false;
+    bool showRELOCATIONS = false;
+    bool showTLS = false;
+    bool showDEBUG = false;
+    bool showEXCEPTIONS = false;
+    bool showPAYLOADS = false;
+    bool showAllStrings = false;
+    std::string rdataSearchQuery = "";
+    int searchMode = static_cast<int>(SearchMode::Substring);
+    std::string sectionFilter = "";
+    int selectedSection = -1;
+
+    // Rows of the section list, only rebuilt when the filter or the section table changes
+    std::vector<uint32_t> sectionRows;
+    std::string sectionRowsFilter = "";
+    const IMAGE_SECTION_HEADER* sectionRowsSource = nullptr;
+    bool sectionRowsValid = false;
+
+    uint64_t hexTop = 0;    // First visible row, rows are 16 bytes
+    uint64_t hexCursor = 0;
+    std::string hexJump = "";
+    bool hexJumpRva = false;
+    bool hexJumpFailed = false;
+    int hexNibble = -1; // First digit typed over the cursor, -1 when none
+
+    std::string savePath = ""; // Starts out as the opened file
+    std::string saveError = "";
+    uint64_t savedRevision = UINT64_MAX; // PatchLayer::revision() when last saved
+
+    int32_t disasmSection = -1;
+    const Disassembly* disasmSource = nullptr; // Detects a different file or section behind disasmSection
+    Disassembly::Position disasmTop;
+    uint64_t disasmSelected = 0;
+    std::string disasmJump = "";
+    bool disasmJumpFailed = false;
+
+    std::string rulesPath = "";
+    std::string rulesError = "";
+    std::shared_ptr<const SignatureSet> signatures; // Compiled from rulesPath, nullptr until a file loads
+    int32_t signatureScope = -1;             // Section to scan, -1 for the whole file
+    std::vector<PESignatureMatch> signatureHits;
+    std::string signatureRules = "";         // Names of the matched rules
+    bool signaturesScanned = false;
+
+    // Rows of the resource tree, a directory's entries are inserted below it when it's expanded and removed when it
+    // collapses, so only the open part of the tree is read. Offsets stay valid across parser rebuilds.
+    std::vector<PEResourceRow> resourceRows;
+    bool resourceRowsBuilt = false;
+    uint32_t resourceOffset = UINT32_MAX; // Data entry shown under the tree
+    uint32_t resourceType = 0;
+    uint32_t resourceName = 0;
+    std::shared_ptr<const PEResourceContent> resourceShown; // What resourceTexture was made from
+    std::shared_ptr<uint32_t> resourceTexture;
+
+    void detach() override
+    {
+        sectionRowsSource = nullptr;
+        sectionRowsValid = false;
+        disasmSource = nullptr;
+    }
+};
+
+class ThreadPool;
+
+class PE : public BinaryFormat
 {
 public:
-    PE(std::fstream& file) : file_(file) {}
+    // Parse results go to arena when one is given (batch workers reuse theirs between files, reset it once the PE is
+    // gone), otherwise to one the PE owns
+    PE(ByteSource& source, Arena* arena = nullptr);
+
+    BinaryKind kind() const override { return BinaryKind::PE; }
 
     const char* get_arc_name(MachineArc);
-    IMAGE_DOS_HEADER* get_dos();
-    IMAGE_NT_HEADERS* get_nt();
-    std::vector<IMAGE_SECTION_HEADER> get_sections();
-    std::vector<std::string> get_rdata_strings();
+    static const char* describe_issue(PEIssue);
+
+    // Everything wrong with the headers, section table and directory bounds, plus the table limits hit by whatever has been
+    // parsed so far. Fatal issues come first.
+    Span<PEDiagnostic> get_diagnostics();
+    // Description of the fatal issue, nullptr if the headers are valid
+    const char* get_error();
+
+    std::string_view get_section_name(const IMAGE_SECTION_HEADER&);
+    const IMAGE_DOS_HEADER* get_dos();
+    const PENtHeaders* get_nt();
+    Span<IMAGE_SECTION_HEADER> get_sections();
+    // Section holding a file offset, -1 if none does
+    int32_t get_section_by_offset(uint64_t offset);
+    uint32_t offset_to_rva(uint64_t offset);
+    // Section mapping an RVA, -1 if none does
+    int32_t get_section_by_rva(uint32_t rva);
+    // File offset backing an RVA, PE_NO_OFFSET if it's not backed by the file (virtual only or out of range)
+    uint64_t rva_to_offset(uint32_t rva);
+    // Bytes at an RVA, empty unless the whole range is backed by the file within one section (or the headers)
+    ByteSpan view_rva(uint32_t rva, uint64_t length);
+    // NUL terminated string at an RVA, cut at max_length or the end of the section
+    std::string_view get_rva_string(uint32_t rva, size_t max_length = 512);
+
+    // Structs copied out of an RVA, false unless the whole struct is backed by the file. Tables can sit at any offset, so
+    // nothing is read in place.
+    template<typename T>
+    bool read_rva_as(uint32_t rva, T& out)
+    {
+        ByteSpan span = view_rva(rva, sizeof(T));
+        if(span.empty())
+            return false;
+
+        std::memcpy(&out, span.data(), sizeof(T));
+
+        return true;
+    }
+
+    // A view when the table is aligned for T in memory, otherwise a copy in the arena. Either lives as long as the parse results.
+    template<typename T>
+    Span<T> view_rva_array(uint32_t rva, uint64_t count)
+    {
+        if(count > source_.size() / sizeof(T))
+            return {};
+
+        ByteSpan span = view_rva(rva, count * sizeof(T));
+        if(span.empty())
+            return {};
+
+        if(ByteSource::is_aligned<T>(span.data()))
+            return Span<T>(reinterpret_cast<const T*>(span.data()), count);
+
+        T* copy = static_cast<T*>(arena->allocate(span.size(), alignof(T)));
+        std::memcpy(copy, span.data(), span.size());
+
+        return Span<T>(copy, count);
+    }
+
+    bool is_64bit();
+    uint64_t get_image_base();
+    // Zeroed if the directory is absent
+    IMAGE_DATA_DIRECTORY get_data_directory(uint32_t index);
+
+    // Data directories, each is parsed the first time it's asked for (PE_directories.cpp)
+    Span<PEImport> get_imports(); // Regular imports followed by delay-load imports
+    const PEExports& get_exports();
+    Span<PERelocationBlock> get_relocations();
+    Span<PEResource> get_resources();
+    uint32_t get_resource_entries_read() const { return resource_entries; } // By the walk of get_resources()
+    const PETls& get_tls();
+    Span<PEDebugEntry> get_debug_entries();
+    Span<IMAGE_RUNTIME_FUNCTION_ENTRY> get_exception_entries(); // Only x64 images
+
+    // Resource tree read one directory at a time (PE_resources.cpp), for views that can't afford walking all of it. Directories
+    // are offsets from the start of the resource directory, the root is 0, and only the entries asked for are read.
+    uint32_t get_resource_entry_count(uint32_t directory);
+    bool get_resource_entry(uint32_t directory, uint32_t index, PEResourceNode& node);
+    bool get_resource_data(uint32_t offset, IMAGE_RESOURCE_DATA_ENTRY& data);
+    // Name of a predefined resource type, nullptr for other ids
+    static const char* get_resource_type_name(uint32_t type);
+
+    // Resource data at rva decoded according to type (the id at the top level), name is the id of the entry above the
+    // language level. The last resource_cache_size results are kept, asking for the same one every frame is cheap.
+    std::shared_ptr<const PEResourceContent> decode_resource(uint32_t type, uint32_t name, uint32_t rva, uint32_t size);
+    static constexpr size_t resource_cache_size = 32;
+
+    // Overlay and the files embedded in the sections and overlay. get_payloads carves them on first use in one sweep over
+    // everything after the headers (see carve_payloads), progress counts bytes, payload_work() of them in total.
+    PEOverlay get_overlay();
+    Span<CarvedPayload> get_payloads(const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+    uint64_t payload_work();
+
+    // Header structure or section covering a file offset, start/end are its bounds in the file
+    std::string_view describe_offset(uint64_t offset, uint64_t& start, uint64_t& end);
+
+    // Bounded cache for views that read arbitrary parts of the file (hex view)
+    PageCache& get_page_cache() { return page_cache; }
+    ByteSource& get_source() { return source_; }
+
+    // Only I386 and AMD64 images can be disassembled
+    bool is_x86();
+    // Linear sweep over an executable section, created on first use. nullptr for other sections or machines.
+    Disassembly* get_disassembly(int32_t section);
+
+    // File and per-section byte histograms plus a sliding window profile of about 1024 points, computed on first use.
+    // progress counts bytes, entropy_work() of them in total.
+    const PEEntropy& get_entropy(const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+    uint64_t entropy_work();
 
+    // MD5/SHA-1/SHA-256 of the file, MD5/SHA-256 per section, the Authenticode digest and the imphash, computed on first
+    // use from one pass over the file. Every digest is fed from the same chunk while it's in cache, on the pool when there
+    // is one. progress counts bytes, the file size in total.
+    const PEHashes& get_hashes(const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+
+    // Approximate heap use of everything parsed or computed so far (all of a shared arena), the mapped file and cache
+    // aren't counted. Not safe while analysis stages are running.
+    uint64_t memory_usage() override;
+
+    // Pool used for per-file parallel work, nullptr runs it on the calling thread (batch mode already parallelizes across files)
+    void set_thread_pool(ThreadPool*) override;
+
+    // Drops the strings found so far if the minimum length or encodings change
+    void set_string_options(const StringScanOptions&);
+    Span<PEString> get_rdata_strings();
+
+    // Every string in the file: headers, all sections and the overlay
+    Span<PEString> get_strings();
+
+    // Text of a string, ASCII is a view into the file and UTF-16 is narrowed into scratch
+    std::string_view get_string_text(const StringSpan&, std::string& scratch);
+
+    // Search index over get_strings() or get_rdata_strings(), string ids are indices into that list
+    StringIndex& get_string_index(bool whole_file);
+
+    // Hits of a compiled rule set in the whole file or in one section's raw data, sorted by offset, on the pool when there
+    // is one. Not kept, the rules can change between scans. progress counts bytes, the scanned size in total.
+    std::vector<PESignatureMatch> scan_signatures(const SignatureSet& signatures, int32_t section = -1, const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+
+    // Analysis cache (PE_cache.cpp), off until set_cache() names the file this is parsing. An empty directory keeps the
+    // cache next to the file. load_cache() takes entropy, hashes, strings and string indices from a cache written for the
+    // same contents (strings only if they were found with the current options) and save_cache() writes everything
+    // computed so far if any of it didn't come from the cache. The analysis stages call both when the cache is on.
+    void set_cache(const std::string& path, const std::string& directory) override;
+    bool load_cache();
+    bool save_cache();
+
+    // Edits made in the views (PE_edit.cpp), nullptr keeps the file read-only. Parsed structures keep describing the file
+    // as it was opened, the views read edited bytes through the layer.
+    void set_patches(PatchLayer* layer) override { patches = layer; }
+    PatchLayer* get_patches() { return patches; }
+    // File offset of OptionalHeader.CheckSum, PE_NO_OFFSET if the headers aren't valid
+    uint64_t checksum_offset();
+    // Image checksum of the file with the edits applied. The word sum of the file as opened is taken on first use, after
+    // that only the edited ranges are summed again.
+    uint32_t compute_checksum();
+    // Stores the recomputed CheckSum as one more edit when it changed and writes the edited file to path
+    bool save(const std::string& path, std::string& error);
+
+    // Stages for BackgroundAnalysis, indices follow PEStage. Until a stage is Done only the worker may call the getters it
+    // covers, after that they just return what it cached so the render thread can read them.
+    std::vector<BackgroundAnalysis::Stage> analysis_stages(BackgroundAnalysis& analysis) override;
+
+    // Panels wait for the stage they read, nullptr when everything is parsed on demand
+    void set_analysis(const BackgroundAnalysis* background) override { analysis = background; }
+
+    // A PEViewState, has to be set before rendering and outlives the PE
+    void set_view_state(ViewState* state) override { view = static_cast<PEViewState*>(state); }
+
+    // Defined in PE_ui.cpp, only part of the GUI build
     void render_sidebar();
     void render_main();
+    void render_hex();
+    void render_disassembly();
+    void render_entropy();
+    void render_hashes();
+    void render_signatures();
+    void render_directories();
+    void render_resources();
+    void render_payloads();
 
 private:
-    IMAGE_DOS_HEADER* dos = nullptr;
-    IMAGE_NT_HEADERS* nt  = nullptr;
-    std::vector<IMAGE_SECTION_HEADER> sections;
-    std::vector<std::string> rdata_strings;
+    // Everything parsed lives here, declared first so it outlives the tables below
+    std::unique_ptr<Arena> owned_arena; // When the caller didn't pass one
+    Arena* arena;
+
+    // Views into source_, nothing here is owned
+    const IMAGE_DOS_HEADER* dos = nullptr; // Points at dos_header once it's valid
+    bool dos_checked = false;
+    IMAGE_DOS_HEADER dos_header = {};
+    const PENtHeaders* nt  = nullptr; // Points at nt_headers once they're valid
+    bool nt_checked = false;
+    PENtHeaders nt_headers = {};
+    ArenaVector<PEDiagnostic> diagnostics{ *arena };
+    Span<IMAGE_SECTION_HEADER> sections;
+    ArenaVector<IMAGE_SECTION_HEADER> section_copy{ *arena }; // Backs sections when the table isn't aligned in memory
+    bool sections_loaded = false;
+    ArenaVector<PEString> rdata_strings{ *arena };
+    Span<PEString> rdata_strings_view; // rdata_strings or a block of the cache
+    bool rdata_scanned = false;
+    ArenaVector<PEString> strings{ *arena };
+    Span<PEString> strings_view;
+    bool strings_scanned = false;
+    StringIndex rdata_index;
+    bool rdata_indexed = false;
+    StringIndex strings_index;
+    bool strings_indexed = false;
+    StringScanOptions string_options;
+
+    ArenaVector<uint32_t> sections_by_offset{ *arena }; // Section indices sorted by PointerToRawData
+    ArenaVector<uint32_t> sections_by_rva{ *arena };    // Section indices sorted by VirtualAddress
+    ThreadPool* pool;
+
+    ArenaVector<PEImport> imports{ *arena };
+    ArenaVector<PEImportFunction> import_functions{ *arena }; // Of every import, each one has a span of them
+    bool imports_parsed = false;
+    PEExports exports;
+    ArenaVector<PEExport> export_functions{ *arena };
+    bool exports_parsed = false;
+    ArenaVector<PERelocationBlock> relocations{ *arena };
+    bool relocations_parsed = false;
+    ArenaVector<PEResource> resources{ *arena };
+    bool resources_parsed = false;
+    bool resources_truncated = false;
+    uint32_t resource_entries = 0; // Read by the walk so far, up to PE_MAX_RESOURCE_ENTRIES
+    LruCache<PEResourceKey, std::shared_ptr<const PEResourceContent>, PEResourceKey::Hash> resource_cache{ resource_cache_size };
+    PETls tls;
+    ArenaVector<uint64_t> tls_callbacks{ *arena };
+    bool tls_parsed = false;
+    ArenaVector<PEDebugEntry> debug_entries{ *arena };
+    bool debug_parsed = false;
+    Span<IMAGE_RUNTIME_FUNCTION_ENTRY> exception_entries;
+    bool exceptions_parsed = false;
+
+    std::vector<std::unique_ptr<Disassembly>> disassemblies; // Indexed by section
+
+    PEEntropy entropy;
+    bool entropy_computed = false;
+    PEHashes hashes;
+    bool hashes_computed = false;
+    std::vector<CarvedPayload> payloads;
+    bool payloads_carved = false;
+
+    std::string cache_file; // Empty while the cache is off
+    std::string cache_directory;
+    CacheKey cache_key = {};
+    bool cache_keyed = false;
+    std::unique_ptr<CacheReader> cache; // Loaded string lists and indices point into it
+    uint32_t cache_loaded = 0;          // Parts load_cache() filled, see PE_cache.cpp
+
+    bool make_key();
+    uint32_t cache_parts();
+
+    PatchLayer* patches = nullptr;
+    uint64_t word_sum = 0; // Of the file as opened, CheckSum included
+    bool word_sum_computed = false;
+
+    template<typename Flavour> bool load_nt_headers(uint64_t offset);
+    template<typename Flavour> void parse_imports();
+    template<typename Flavour> void parse_import_thunks(uint32_t lookup_rva, uint32_t iat_rva);
+    template<typename Flavour> void parse_tls();
+    void parse_resource_directory(uint32_t offset, int depth, PEResource& leaf);
+    std::string get_resource_name(uint32_t offset);
+
+    void report(PEIssue issue, const char* field, uint64_t offset, uint64_t value, bool fatal = false);
+    void check_layout(uint64_t section_table);
+
+    void tag_strings(const std::vector<StringSpan>&, ArenaVector<PEString>&);
+
+    const BackgroundAnalysis* analysis = nullptr;
+    PEViewState* view = nullptr;
+
+    ByteSource& source_;
+    PageCache page_cache;
+
+    // Scan started from the SIGNATURES panel, a one stage analysis so the render thread only polls it. Its results move to
+    // the view once it's done. Last so it's cancelled and joined before anything it reads goes away.
+    std::vector<PESignatureMatch> signature_hits;
+    std::string signature_rules;
+    std::unique_ptr<BackgroundAnalysis> signature_scan;
 
-    std::fstream& file_;
+    void start_signature_scan(std::shared_ptr<const SignatureSet> signatures, int32_t section);
 };
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "PE.h"
+#include <cstring>
+
+namespace
+{
+    // Bump whenever a cached structure or the code producing it changes, caches of other formats are ignored
+    const uint32_t cache_format = 1;
+
+    enum CacheBlock : uint32_t
+    {
+        StringOptionsBlock = 1,
+        EntropyInfoBlock,
+        EntropyFileBlock,
+        EntropySectionsBlock,
+        EntropyProfileBlock,
+        HashesBlock,
+        SectionHashesBlock,
+        RdataStringsBlock,
+        StringsBlock,
+        RdataIndexBlock,                   // Arena, folded arena, offsets, bucket offsets and postings
+        StringsIndexBlock = RdataIndexBlock + 5
+    };
+
+    enum CachePart : uint32_t
+    {
+        EntropyPart = 1 << 0,
+        HashesPart = 1 << 1,
+        RdataStringsPart = 1 << 2,
+        StringsPart = 1 << 3,
+        RdataIndexPart = 1 << 4,
+        StringsIndexPart = 1 << 5
+    };
+
+    struct CachedStringOptions
+    {
+        uint64_t min_length;
+        uint8_t ascii;
+        uint8_t utf16;
+    };
+
+    struct CachedEntropy
+    {
+        uint64_t window;
+        uint64_t step;
+    };
+
+    struct CachedHashes
+    {
+        uint8_t md5[Md5::digest_size];
+        uint8_t sha1[Sha1::digest_size];
+        uint8_t sha256[Sha256::digest_size];
+        uint8_t authenticode[Sha256::digest_size];
+        uint8_t imphash[Md5::digest_size];
+        uint8_t has_imphash;
+    };
+
+    void add_index(CacheWriter& writer, uint32_t first, const StringIndex::Tables& tables)
+    {
+        writer.add(first, tables.arena.data(), tables.arena.size());
+        writer.add(first + 1, tables.folded.data(), tables.folded.size());
+        writer.add_array(first + 2, tables.offsets.data(), tables.offsets.size());
+        writer.add_array(first + 3, tables.bucket_offsets.data(), tables.bucket_offsets.size());
+        writer.add_array(first + 4, tables.postings.data(), tables.postings.size());
+    }
+
+    StringIndex::Tables index_blocks(const CacheReader& reader, uint32_t first)
+    {
+        ByteSpan arena = reader.block(first);
+        ByteSpan folded = reader.block(first + 1);
+
+        return
+        {
+            std::string_view(reinterpret_cast<const char*>(arena.data()), arena.size()),
+            std::string_view(reinterpret_cast<const char*>(folded.data()), folded.size()),
+            reader.block_array<uint32_t>(first + 2),
+            reader.block_array<uint32_t>(first + 3),
+            reader.block_array<uint32_t>(first + 4)
+        };
+    }
+}
+
+void PE::set_cache(const std::string& path, const std::string& directory)
+{
+    cache_file = path;
+    cache_directory = directory;
+    cache_keyed = false;
+}
+
+bool PE::make_key()
+{
+    if(!cache_keyed)
+        cache_keyed = make_cache_key(cache_file, source_, cache_key);
+
+    return cache_keyed;
+}
+
+uint32_t PE::cache_parts()
+{
+    uint32_t parts = 0;
+
+    if(entropy_computed)
+        parts |= EntropyPart;
+    if(hashes_computed)
+        parts |= HashesPart;
+    if(rdata_scanned)
+        parts |= RdataStringsPart;
+    if(strings_scanned)
+        parts |= StringsPart;
+    if(rdata_indexed)
+        parts |= RdataIndexPart;
+    if(strings_indexed)
+        parts |= StringsIndexPart;
+
+    return parts;
+}
+
+bool PE::load_cache()
+{
+    if(cache_file.empty() || get_nt() == nullptr || !make_key())
+        return false;
+
+    cache = CacheReader::open(cache_path(cache_directory, cache_file, cache_key), cache_format, cache_key, source_);
+    if(cache == nullptr)
+        return false;
+
+    size_t section_count = get_sections().size();
+
+    Span<CachedEntropy> entropy_info = cache->block_array<CachedEntropy>(EntropyInfoBlock);
+    Span<ByteHistogram> file_histogram = cache->block_array<ByteHistogram>(EntropyFileBlock);
+    Span<ByteHistogram> section_histograms = cache->block_array<ByteHistogram>(EntropySectionsBlock);
+    Span<float> profile = cache->block_array<float>(EntropyProfileBlock);
+
+    if(!entropy_computed && entropy_info.size() == 1 && file_histogram.size() == 1 && section_histograms.size() == section_count && cache->has(EntropyProfileBlock))
+    {
+        entropy.window = entropy_info[0].window;
+        entropy.step = entropy_info[0].step;
+        entropy.file = file_histogram[0];
+        entropy.sections.assign(section_histograms.begin(), section_histograms.end());
+        entropy.profile.assign(profile.begin(), profile.end());
+
+        entropy_computed = true;
+        cache_loaded |= EntropyPart;
+    }
+
+    Span<CachedHashes> digests = cache->block_array<CachedHashes>(HashesBlock);
+    Span<PESectionHashes> section_digests = cache->block_array<PESectionHashes>(SectionHashesBlock);
+
+    if(!hashes_computed && digests.size() == 1 && section_digests.size() == section_count)
+    {
+        std::memcpy(hashes.md5, digests[0].md5, sizeof(hashes.md5));
+        std::memcpy(hashes.sha1, digests[0].sha1, sizeof(hashes.sha1));
+        std::memcpy(hashes.sha256, digests[0].sha256, sizeof(hashes.sha256));
+        std::memcpy(hashes.authenticode, digests[0].authenticode, sizeof(hashes.authenticode));
+        std::memcpy(hashes.imphash, digests[0].imphash, sizeof(hashes.imphash));
+        hashes.has_imphash = digests[0].has_imphash != 0;
+        hashes.sections.assign(section_digests.begin(), section_digests.end());
+
+        hashes_computed = true;
+        cache_loaded |= HashesPart;
+    }
+
+    // Strings found with other options aren't the ones the caller would get
+    Span<CachedStringOptions> options = cache->block_array<CachedStringOptions>(StringOptionsBlock);
+    if(options.size() != 1 || options[0].min_length != string_options.min_length || (options[0].ascii != 0) != string_options.ascii || (options[0].utf16 != 0) != string_options.utf16)
+        return cache_loaded != 0;
+
+    // The string lists are used in place, every entry has to point into this file and its section table
+    auto load_strings = [&](uint32_t block, Span<PEString>& view, bool& scanned, uint32_t part)
+    {
+        Span<PEString> entries = cache->block_array<PEString>(block);
+        if(scanned || !cache->has(block) || (entries.empty() && !cache->block(block).empty()))
+            return;
+
+        for (const PEString& entry : entries)
+        {
+            if(entry.span.offset > source_.size() || entry.span.length > source_.size() - entry.span.offset || entry.section < -1 || entry.section >= static_cast<int32_t>(section_count) ||
+                (entry.span.encoding != StringEncoding::ASCII && entry.span.encoding != StringEncoding::UTF16LE))
+                return;
+        }
+
+        view = entries;
+        scanned = true;
+        cache_loaded |= part;
+    };
+
+    auto load_index = [&](uint32_t block, Span<PEString> entries, StringIndex& index, bool& indexed, uint32_t part)
+    {
+        if(indexed || !cache->has(block))
+            return;
+
+        if(index.attach(index_blocks(*cache, block)) && index.size() == entries.size())
+        {
+            indexed = true;
+            cache_loaded |= part;
+        }
+        else
+            index.clear();
+    };
+
+    load_strings(RdataStringsBlock, rdata_strings_view, rdata_scanned, RdataStringsPart);
+    load_strings(StringsBlock, strings_view, strings_scanned, StringsPart);
+
+    if(cache_loaded & RdataStringsPart)
+        load_index(RdataIndexBlock, rdata_strings_view, rdata_index, rdata_indexed, RdataIndexPart);
+    if(cache_loaded & StringsPart)
+        load_index(StringsIndexBlock, strings_view, strings_index, strings_indexed, StringsIndexPart);
+
+    return cache_loaded != 0;
+}
+
+bool PE::save_cache()
+{
+    uint32_t parts = cache_parts();
+
+    // Nothing new since the cache was read
+    if(cache_file.empty() || get_nt() == nullptr || (parts & ~cache_loaded) == 0 || !make_key())
+        return false;
+
+    CacheWriter writer;
+
+    CachedStringOptions options = { string_options.min_length, string_options.ascii, string_options.utf16 };
+    writer.add(StringOptionsBlock, &options, sizeof(options));
+
+    CachedEntropy entropy_info = { entropy.window, entropy.step };
+    if(parts & EntropyPart)
+    {
+        writer.add(EntropyInfoBlock, &entropy_info, sizeof(entropy_info));
+        writer.add(EntropyFileBlock, &entropy.file, sizeof(entropy.file));
+        writer.add_array(EntropySectionsBlock, entropy.sections.data(), entropy.sections.size());
+        writer.add_array(EntropyProfileBlock, entropy.profile.data(), entropy.profile.size());
+    }
+
+    CachedHashes digests = {};
+    if(parts & HashesPart)
+    {
+        std::memcpy(digests.md5, hashes.md5, sizeof(digests.md5));
+        std::memcpy(digests.sha1, hashes.sha1, sizeof(digests.sha1));
+        std::memcpy(digests.sha256, hashes.sha256, sizeof(digests.sha256));
+        std::memcpy(digests.authenticode, hashes.authenticode, sizeof(digests.authenticode));
+        std::memcpy(digests.imphash, hashes.imphash, sizeof(digests.imphash));
+        digests.has_imphash = hashes.has_imphash;
+
+        writer.add(HashesBlock, &digests, sizeof(digests));
+        writer.add_array(SectionHashesBlock, hashes.sections.data(), hashes.sections.size());
+    }
+
+    if(parts & RdataStringsPart)
+        writer.add_array(RdataStringsBlock, rdata_strings_view.data(), rdata_strings_view.size());
+    if(parts & StringsPart)
+        writer.add_array(StringsBlock, strings_view.data(), strings_view.size());
+    if(parts & RdataIndexPart)
+        add_index(writer, RdataIndexBlock, rdata_index.tables());
+    if(parts & StringsIndexPart)
+        add_index(writer, StringsIndexBlock, strings_index.tables());
+
+    return writer.write(cache_path(cache_directory, cache_file, cache_key), cache_format, cache_key, (parts & HashesPart) ? hashes.sha256 : nullptr);
+}
@@ -0,0 +1,379 @@
+#include "PE_diff.h"
+#include "../core/thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iterator>
+
+namespace
+{
+    const char* directory_names[16] = { "Export", "Import", "Resource", "Exception", "Security", "BaseReloc", "Debug", "Architecture",
+        "GlobalPtr", "TLS", "LoadConfig", "BoundImport", "IAT", "DelayImport", "CLR", "Reserved" };
+
+    void compare(std::vector<PEFieldChange>& out, std::string field, uint64_t old_value, uint64_t new_value)
+    {
+        if(old_value != new_value)
+            out.push_back({ std::move(field), old_value, new_value });
+    }
+
+    void compare_headers(const PENtHeaders& a, const PENtHeaders& b, std::vector<PEFieldChange>& out)
+    {
+        const IMAGE_FILE_HEADER& fa = a.FileHeader;
+        const IMAGE_FILE_HEADER& fb = b.FileHeader;
+
+        compare(out, "FileHeader.Machine", static_cast<uint64_t>(fa.Machine), static_cast<uint64_t>(fb.Machine));
+        compare(out, "FileHeader.NumberOfSections", fa.NumberOfSections, fb.NumberOfSections);
+        compare(out, "FileHeader.TimeDateStamp", fa.TimeDateStamp, fb.TimeDateStamp);
+        compare(out, "FileHeader.PointerToSymbolTable", fa.PointerToSymbolTable, fb.PointerToSymbolTable);
+        compare(out, "FileHeader.NumberOfSymbols", fa.NumberOfSymbols, fb.NumberOfSymbols);
+        compare(out, "FileHeader.SizeOfOptionalHeader", fa.SizeOfOptionalHeader, fb.SizeOfOptionalHeader);
+        compare(out, "FileHeader.Characteristics", fa.Characteristics, fb.Characteristics);
+
+        const IMAGE_OPTIONAL_HEADER64& oa = a.OptionalHeader;
+        const IMAGE_OPTIONAL_HEADER64& ob = b.OptionalHeader;
+
+        compare(out, "OptionalHeader.Magic", oa.Magic, ob.Magic);
+        compare(out, "OptionalHeader.MajorLinkerVersion", oa.MajorLinkerVersion, ob.MajorLinkerVersion);
+        compare(out, "OptionalHeader.MinorLinkerVersion", oa.MinorLinkerVersion, ob.MinorLinkerVersion);
+        compare(out, "OptionalHeader.SizeOfCode", oa.SizeOfCode, ob.SizeOfCode);
+        compare(out, "OptionalHeader.SizeOfInitializedData", oa.SizeOfInitializedData, ob.SizeOfInitializedData);
+        compare(out, "OptionalHeader.SizeOfUninitializedData", oa.SizeOfUninitializedData, ob.SizeOfUninitializedData);
+        compare(out, "OptionalHeader.AddressOfEntryPoint", oa.AddressOfEntryPoint, ob.AddressOfEntryPoint);
+        compare(out, "OptionalHeader.BaseOfCode", oa.BaseOfCode, ob.BaseOfCode);
+        compare(out, "OptionalHeader.BaseOfData", a.BaseOfData, b.BaseOfData);
+        compare(out, "OptionalHeader.ImageBase", oa.ImageBase, ob.ImageBase);
+        compare(out, "OptionalHeader.SectionAlignment", oa.SectionAlignment, ob.SectionAlignment);
+        compare(out, "OptionalHeader.FileAlignment", oa.FileAlignment, ob.FileAlignment);
+        compare(out, "OptionalHeader.MajorOperatingSystemVersion", oa.MajorOperatingSystemVersion, ob.MajorOperatingSystemVersion);
+        compare(out, "OptionalHeader.MinorOperatingSystemVersion", oa.MinorOperatingSystemVersion, ob.MinorOperatingSystemVersion);
+        compare(out, "OptionalHeader.MajorImageVersion", oa.MajorImageVersion, ob.MajorImageVersion);
+        compare(out, "OptionalHeader.MinorImageVersion", oa.MinorImageVersion, ob.MinorImageVersion);
+        compare(out, "OptionalHeader.MajorSubsystemVersion", oa.MajorSubsystemVersion, ob.MajorSubsystemVersion);
+        compare(out, "OptionalHeader.MinorSubsystemVersion", oa.MinorSubsystemVersion, ob.MinorSubsystemVersion);
+        compare(out, "OptionalHeader.Win32VersionValue", oa.Win32VersionValue, ob.Win32VersionValue);
+        compare(out, "OptionalHeader.SizeOfImage", oa.SizeOfImage, ob.SizeOfImage);
+        compare(out, "OptionalHeader.SizeOfHeaders", oa.SizeOfHeaders, ob.SizeOfHeaders);
+        compare(out, "OptionalHeader.CheckSum", oa.CheckSum, ob.CheckSum);
+        compare(out, "OptionalHeader.Subsystem", oa.Subsystem, ob.Subsystem);
+        compare(out, "OptionalHeader.DllCharacteristics", oa.DllCharacteristics, ob.DllCharacteristics);
+        compare(out, "OptionalHeader.SizeOfStackReserve", oa.SizeOfStackReserve, ob.SizeOfStackReserve);
+        compare(out, "OptionalHeader.SizeOfStackCommit", oa.SizeOfStackCommit, ob.SizeOfStackCommit);
+        compare(out, "OptionalHeader.SizeOfHeapReserve", oa.SizeOfHeapReserve, ob.SizeOfHeapReserve);
+        compare(out, "OptionalHeader.SizeOfHeapCommit", oa.SizeOfHeapCommit, ob.SizeOfHeapCommit);
+        compare(out, "OptionalHeader.LoaderFlags", oa.LoaderFlags, ob.LoaderFlags);
+        compare(out, "OptionalHeader.NumberOfRvaAndSizes", oa.NumberOfRvaAndSizes, ob.NumberOfRvaAndSizes);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            std::string name = std::string("DataDirectory[") + directory_names[i] + "].";
+
+            compare(out, name + "VirtualAddress", oa.DataDirectory[i].VirtualAddress, ob.DataDirectory[i].VirtualAddress);
+            compare(out, name + "Size", oa.DataDirectory[i].Size, ob.DataDirectory[i].Size);
+        }
+    }
+
+    void compare_section(const std::string& name, const IMAGE_SECTION_HEADER& a, const IMAGE_SECTION_HEADER& b, std::vector<PEFieldChange>& out)
+    {
+        std::string prefix = "Section " + name + " ";
+
+        compare(out, prefix + "VirtualAddress", a.VirtualAddress, b.VirtualAddress);
+        compare(out, prefix + "VirtualSize", a.Misc.VirtualSize, b.Misc.VirtualSize);
+        compare(out, prefix + "PointerToRawData", a.PointerToRawData, b.PointerToRawData);
+        compare(out, prefix + "SizeOfRawData", a.SizeOfRawData, b.SizeOfRawData);
+        compare(out, prefix + "Characteristics", a.Characteristics, b.Characteristics);
+    }
+
+    // Raw data of a section, cut at the end of the file
+    void raw_range(const IMAGE_SECTION_HEADER& section, uint64_t file_size, uint64_t& offset, uint64_t& size)
+    {
+        offset = std::min<uint64_t>(section.PointerToRawData, file_size);
+        size = std::min<uint64_t>(section.SizeOfRawData, file_size - offset);
+    }
+
+    uint64_t headers_end(PE& pe)
+    {
+        return std::min<uint64_t>(pe.get_nt()->OptionalHeader.SizeOfHeaders, pe.get_source().size());
+    }
+
+    PEDiffRegion make_region(std::string name, int32_t old_section, int32_t new_section, uint64_t old_offset, uint64_t old_size, uint64_t new_offset, uint64_t new_size)
+    {
+        PEDiffRegion region;
+        region.name = std::move(name);
+        region.old_section = old_section;
+        region.new_section = new_section;
+        region.old_offset = old_offset;
+        region.old_size = old_size;
+        region.new_offset = new_offset;
+        region.new_size = new_size;
+
+        return region;
+    }
+
+    // Sections are paired by name, the nth section called .text in one file with the nth one in the other
+    void pair_regions(PE& old_pe, PE& new_pe, PEDiff& diff)
+    {
+        uint64_t old_file = old_pe.get_source().size();
+        uint64_t new_file = new_pe.get_source().size();
+
+        diff.regions.push_back(make_region("headers", -1, -1, 0, headers_end(old_pe), 0, headers_end(new_pe)));
+
+        Span<IMAGE_SECTION_HEADER> old_sections = old_pe.get_sections();
+        Span<IMAGE_SECTION_HEADER> new_sections = new_pe.get_sections();
+        std::vector<bool> paired(new_sections.size(), false);
+
+        for (size_t i = 0; i < old_sections.size(); ++i)
+        {
+            std::string name(old_pe.get_section_name(old_sections[i]));
+
+            size_t occurrence = 0;
+            for (size_t j = 0; j < i; ++j)
+                occurrence += old_pe.get_section_name(old_sections[j]) == name;
+
+            int32_t match = -1;
+            for (size_t j = 0; j < new_sections.size() && match < 0; ++j)
+            {
+                if(new_pe.get_section_name(new_sections[j]) == name && occurrence-- == 0)
+                    match = static_cast<int32_t>(j);
+            }
+
+            uint64_t old_offset;
+            uint64_t old_size;
+            raw_range(old_sections[i], old_file, old_offset, old_size);
+
+            uint64_t new_offset = 0;
+            uint64_t new_size = 0;
+
+            if(match >= 0)
+            {
+                paired[match] = true;
+                raw_range(new_sections[match], new_file, new_offset, new_size);
+                compare_section(name, old_sections[i], new_sections[match], diff.fields);
+            }
+
+            diff.regions.push_back(make_region(name, static_cast<int32_t>(i), match, old_offset, old_size, new_offset, new_size));
+        }
+
+        for (size_t j = 0; j < new_sections.size(); ++j)
+        {
+            if(paired[j])
+                continue;
+
+            uint64_t new_offset;
+            uint64_t new_size;
+            raw_range(new_sections[j], new_file, new_offset, new_size);
+
+            diff.regions.push_back(make_region(std::string(new_pe.get_section_name(new_sections[j])), -1, static_cast<int32_t>(j), 0, 0, new_offset, new_size));
+        }
+
+        uint64_t old_overlay = old_pe.get_overlay().offset;
+        uint64_t new_overlay = new_pe.get_overlay().offset;
+
+        if(old_overlay < old_file || new_overlay < new_file)
+            diff.regions.push_back(make_region("overlay", -1, -1, old_overlay, old_file - old_overlay, new_overlay, new_file - new_overlay));
+    }
+
+    void diff_region(PE& old_pe, PE& new_pe, PEDiffRegion& region, const DiffOptions& options)
+    {
+        ByteSpan old_bytes = old_pe.get_source().view(region.old_offset, region.old_size);
+        ByteSpan new_bytes = new_pe.get_source().view(region.new_offset, region.new_size);
+
+        diff_bytes(old_bytes.data(), old_bytes.size(), region.old_offset, new_bytes.data(), new_bytes.size(), region.new_offset, options, region.hunks);
+
+        for (const DiffHunk& hunk : region.hunks)
+        {
+            if(hunk.kind == DiffKind::Equal)
+                continue;
+
+            region.changed_old += hunk.old_size;
+            region.changed_new += hunk.new_size;
+        }
+    }
+
+    std::vector<std::string> import_names(PE& pe)
+    {
+        std::vector<std::string> names;
+
+        for (const PEImport& import : pe.get_imports())
+        {
+            // The loader doesn't care about the case of DLL names, linkers don't agree on it either
+            std::string dll(import.dll);
+            std::transform(dll.begin(), dll.end(), dll.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            for (const PEImportFunction& function : import.functions)
+                names.push_back(dll + "!" + (function.by_ordinal ? "#" + std::to_string(function.hint) : std::string(function.name)));
+        }
+
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        return names;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> export_names(PE& pe)
+    {
+        std::vector<std::pair<std::string, uint32_t>> names;
+
+        for (const PEExport& entry : pe.get_exports().functions)
+            names.emplace_back(entry.name.empty() ? "#" + std::to_string(entry.ordinal) : std::string(entry.name), entry.rva);
+
+        std::sort(names.begin(), names.end());
+
+        return names;
+    }
+
+    void compare_symbols(PE& old_pe, PE& new_pe, PEDiff& diff)
+    {
+        std::vector<std::string> old_imports = import_names(old_pe);
+        std::vector<std::string> new_imports = import_names(new_pe);
+
+        std::set_difference(new_imports.begin(), new_imports.end(), old_imports.begin(), old_imports.end(), std::back_inserter(diff.imports_added));
+        std::set_difference(old_imports.begin(), old_imports.end(), new_imports.begin(), new_imports.end(), std::back_inserter(diff.imports_removed));
+
+        std::vector<std::pair<std::string, uint32_t>> old_exports = export_names(old_pe);
+        std::vector<std::pair<std::string, uint32_t>> new_exports = export_names(new_pe);
+
+        size_t i = 0;
+        size_t j = 0;
+
+        while(i < old_exports.size() || j < new_exports.size())
+        {
+            if(j == new_exports.size() || (i < old_exports.size() && old_exports[i].first < new_exports[j].first))
+                diff.exports_removed.push_back(old_exports[i++].first);
+            else if(i == old_exports.size() || new_exports[j].first < old_exports[i].first)
+                diff.exports_added.push_back(new_exports[j++].first);
+            else
+            {
+                if(old_exports[i].second != new_exports[j].second)
+                    diff.exports_moved.push_back({ old_exports[i].first, old_exports[i].second, new_exports[j].second });
+
+                ++i;
+                ++j;
+            }
+        }
+    }
+}
+
+uint64_t PEDiff::changed_bytes() const
+{
+    uint64_t total = 0;
+    for (const PEDiffRegion& region : regions)
+        total += region.changed_new;
+
+    return total;
+}
+
+PEDiff diff_pe(PE& old_pe, PE& new_pe, ThreadPool* pool, const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    PEDiff diff;
+
+    if(old_pe.get_error() != nullptr || new_pe.get_error() != nullptr)
+        return diff;
+
+    compare(diff.fields, "DosHeader.e_lfanew", old_pe.get_dos()->e_lfanew, new_pe.get_dos()->e_lfanew);
+    compare_headers(*old_pe.get_nt(), *new_pe.get_nt(), diff.fields);
+    pair_regions(old_pe, new_pe, diff);
+    compare_symbols(old_pe, new_pe, diff);
+
+    DiffOptions options;
+    options.cancel = cancel;
+    options.progress = progress;
+
+    // Biggest regions first so the long ones don't start last
+    std::vector<PEDiffRegion*> order;
+    for (PEDiffRegion& region : diff.regions)
+        order.push_back(&region);
+
+    std::sort(order.begin(), order.end(), [](const PEDiffRegion* a, const PEDiffRegion* b) { return std::max(a->old_size, a->new_size) > std::max(b->old_size, b->new_size); });
+
+    if(pool == nullptr)
+    {
+        for (PEDiffRegion* region : order)
+            diff_region(old_pe, new_pe, *region, options);
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (PEDiffRegion* region : order)
+            group.run([&old_pe, &new_pe, region, &options]() { diff_region(old_pe, new_pe, *region, options); });
+
+        group.wait();
+    }
+
+    diff.cancelled = cancel != nullptr && cancel->load(std::memory_order_relaxed);
+
+    return diff;
+}
+
+std::unique_ptr<PEDiffSession> PEDiffSession::open(const std::string& old_path, const std::string& new_path, ThreadPool& pool)
+{
+    std::unique_ptr<PEDiffSession> session(new PEDiffSession());
+    session->old_path = old_path;
+    session->new_path = new_path;
+    session->title_ = std::filesystem::path(old_path).filename().string() + " -> " + std::filesystem::path(new_path).filename().string();
+
+    session->old_file = ByteSource::open(old_path);
+    session->new_file = ByteSource::open(new_path);
+    if(session->old_file == nullptr || session->new_file == nullptr)
+        return nullptr;
+
+    session->old_pe = std::make_unique<PE>(*session->old_file);
+    session->new_pe = std::make_unique<PE>(*session->new_file);
+
+    // Regions are already spread over the pool, the parsers don't need it for the little they do here
+    session->old_pe->set_thread_pool(nullptr);
+    session->new_pe->set_thread_pool(nullptr);
+
+    session->analysis = std::make_unique<BackgroundAnalysis>(pool);
+
+    PEDiffSession* self = session.get();
+    BackgroundAnalysis* analysis = session->analysis.get();
+
+    std::vector<BackgroundAnalysis::Stage> stages;
+    stages.push_back({ "Diff", [self, analysis, &pool]() -> const char*
+    {
+        if(self->old_pe->get_error() != nullptr)
+            return "Old file isn't a valid PE";
+
+        if(self->new_pe->get_error() != nullptr)
+            return "New file isn't a valid PE";
+
+        analysis->set_total(0, self->new_file->size());
+        self->diff = diff_pe(*self->old_pe, *self->new_pe, &pool, &analysis->cancel_flag(), &analysis->done_counter(0));
+
+        return nullptr;
+    } });
+
+    session->analysis->start(std::move(stages));
+
+    return session;
+}
+
+const PEDiff* PEDiffSession::result() const
+{
+    return analysis->ready(0) ? &diff : nullptr;
+}
+
+void PEDiffSession::layout_rows()
+{
+    rowHunks.clear();
+    rowStarts.clear();
+
+    uint64_t rows = 0;
+    for (const PEDiffRegion& region : diff.regions)
+    {
+        for (const DiffHunk& hunk : region.hunks)
+        {
+            rowHunks.push_back(&hunk);
+            rowStarts.push_back(rows);
+
+            // A folded equal hunk is one summary row
+            if(hunk.kind == DiffKind::Equal && foldEqual)
+                rows += 1;
+            else
+                rows += (std::max(hunk.old_size, hunk.new_size) + 15) / 16;
+        }
+    }
+
+    rowStarts.push_back(rows);
+    rowsValid = true;
+}
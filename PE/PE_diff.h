@@ -0,0 +1,101 @@
+/*
+* Differences between two versions of a PE
+* Header fields, the section table, imports and exports are compared structurally. The bytes are compared per region
+* (headers, each section matched by name, overlay) on the thread pool, see diff_bytes for how moved content is aligned.
+*/
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "PE.h"
+#include "../core/binary_diff.h"
+
+struct PEFieldChange
+{
+    std::string field; // "OptionalHeader.CheckSum", "DataDirectory[1].Size", "Section .text VirtualSize"
+    uint64_t old_value;
+    uint64_t new_value;
+};
+
+// Part of the file diffed on its own. Sections only present in one version are a single Inserted or Deleted hunk.
+struct PEDiffRegion
+{
+    std::string name;    // "headers", the section name or "overlay"
+    int32_t old_section; // Index into get_sections() of either file, -1 if it isn't a section or isn't in that version
+    int32_t new_section;
+    uint64_t old_offset;
+    uint64_t old_size;
+    uint64_t new_offset;
+    uint64_t new_size;
+    std::vector<DiffHunk> hunks; // File offsets, in order
+    uint64_t changed_old = 0;    // Bytes outside Equal hunks
+    uint64_t changed_new = 0;
+};
+
+struct PEExportChange
+{
+    std::string name; // Export name, "#ordinal" for ordinal-only exports
+    uint32_t old_rva;
+    uint32_t new_rva;
+};
+
+struct PEDiff
+{
+    std::vector<PEFieldChange> fields;
+    std::vector<PEDiffRegion> regions;
+    std::vector<std::string> imports_added;   // "dll!function", "dll!#ordinal" when imported by ordinal
+    std::vector<std::string> imports_removed;
+    std::vector<std::string> exports_added;
+    std::vector<std::string> exports_removed;
+    std::vector<PEExportChange> exports_moved;
+    bool cancelled = false; // Regions not reached are missing or end in one Changed hunk
+
+    uint64_t changed_bytes() const; // New side bytes outside Equal hunks
+};
+
+// Both files need valid headers (get_error() == nullptr). Regions are diffed in parallel on pool, nullptr runs them on the
+// calling thread. progress counts bytes of the new file.
+PEDiff diff_pe(PE& old_pe, PE& new_pe, ThreadPool* pool, const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+
+// Two files compared in the background for the diff window. Owns its own mappings and parsers so the documents it was
+// started from can be closed or evicted meanwhile.
+class PEDiffSession
+{
+public:
+    // nullptr if either file can't be opened
+    static std::unique_ptr<PEDiffSession> open(const std::string& old_path, const std::string& new_path, ThreadPool& pool);
+
+    const std::string& title() const { return title_; }
+
+    // nullptr until the diff has finished
+    const PEDiff* result() const;
+
+    // Defined in PE_diff_ui.cpp, only part of the GUI build
+    void render();
+
+private:
+    PEDiffSession() = default;
+
+    // Maps the virtual hex rows onto hunks, only rebuilt when the result or the equal hunk folding changes
+    void layout_rows();
+
+    std::string title_;
+    std::string old_path;
+    std::string new_path;
+    std::unique_ptr<ByteSource> old_file;
+    std::unique_ptr<ByteSource> new_file;
+    std::unique_ptr<PE> old_pe;
+    std::unique_ptr<PE> new_pe;
+    PEDiff diff;
+
+    // View state
+    bool foldEqual = true;
+    bool rowsValid = false;
+    std::vector<const DiffHunk*> rowHunks;
+    std::vector<uint64_t> rowStarts; // First row of each entry of rowHunks, plus the total at the end
+    uint64_t hexTop = 0;
+
+    // Last member, destroyed first so the diff stops before what it reads goes away
+    std::unique_ptr<BackgroundAnalysis> analysis;
+};
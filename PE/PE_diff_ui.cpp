@@ -0,0 +1,355 @@
+#include "PE_diff.h"
+#include "../widgets/widgets.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace
+{
+    const int visible_rows = 32;
+    const int hex_column = 18;                // "%016X  " offset prefix
+    const int ascii_column = hex_column + 49; // 16 "XX " cells and a separator
+    const int new_column = ascii_column + 20; // The new file's side starts here
+
+    const char* describe_kind(DiffKind kind)
+    {
+        switch (kind)
+        {
+            case DiffKind::Equal: return "Equal";
+            case DiffKind::Changed: return "Changed";
+            case DiffKind::Inserted: return "Inserted";
+            case DiffKind::Deleted: return "Deleted";
+        }
+
+        return "";
+    }
+
+    ImU32 kind_color(DiffKind kind)
+    {
+        switch (kind)
+        {
+            case DiffKind::Changed: return IM_COL32(200, 160, 40, 90);
+            case DiffKind::Inserted: return IM_COL32(60, 160, 60, 90);
+            case DiffKind::Deleted: return IM_COL32(180, 60, 60, 90);
+            default: return 0;
+        }
+    }
+
+    // One side of a hex row into text at column, padded so the other side lines up. Nothing but padding if count is 0.
+    void format_side(char* text, int column, uint64_t offset, const uint8_t* bytes, uint64_t count)
+    {
+        std::fill(text + column, text + column + new_column, ' ');
+
+        if(count == 0)
+            return;
+
+        char cell[20];
+        std::snprintf(cell, sizeof(cell), "%016" PRIX64, offset);
+        std::copy(cell, cell + 16, text + column);
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            std::snprintf(cell, sizeof(cell), "%02X", bytes[i]);
+            text[column + hex_column + i * 3] = cell[0];
+            text[column + hex_column + i * 3 + 1] = cell[1];
+            text[column + ascii_column + i] = bytes[i] >= 0x20 && bytes[i] < 0x7F ? static_cast<char>(bytes[i]) : '.';
+        }
+    }
+}
+
+void PEDiffSession::render()
+{
+    const PEDiff* result = this->result();
+
+    if(result == nullptr)
+    {
+        switch (analysis->state(0))
+        {
+            case StageState::Failed:
+                ImGui::TextDisabled("%s", analysis->error(0));
+                break;
+            case StageState::Cancelled:
+                ImGui::TextDisabled("Diff cancelled");
+                break;
+            default:
+            {
+                char overlay[64];
+                std::snprintf(overlay, sizeof(overlay), "Diff %.0f%%", analysis->progress(0) * 100.0f);
+                ImGui::ProgressBar(analysis->progress(0), ImVec2(-1, 0), overlay);
+            }
+        }
+
+        return;
+    }
+
+    if(!rowsValid)
+        layout_rows();
+
+    ImGui::Text("Old: %s", old_path.c_str());
+    ImGui::Text("New: %s", new_path.c_str());
+    ImGui::Text("%" PRIu64 " bytes changed, %zu fields, %zu imports and %zu exports differ", result->changed_bytes(), result->fields.size(),
+        result->imports_added.size() + result->imports_removed.size(), result->exports_added.size() + result->exports_removed.size() + result->exports_moved.size());
+
+    if (ImGui::TreeNode("REGIONS"))
+    {
+        clipped_table("regions", { "Region", "Old offset", "Old size", "New offset", "New size", "Changed" }, result->regions.size(), [&](size_t i)
+        {
+            const PEDiffRegion& region = result->regions[i];
+
+            // Selecting a region scrolls the byte view to its first hunk
+            ImGui::TableSetColumnIndex(0);
+            ImGui::PushID(static_cast<int>(i));
+            if (ImGui::Selectable(region.name.c_str(), false, ImGuiSelectableFlags_SpanAllColumns) && !region.hunks.empty())
+            {
+                auto first = std::find(rowHunks.begin(), rowHunks.end(), &region.hunks.front());
+                hexTop = rowStarts[first - rowHunks.begin()];
+            }
+            ImGui::PopID();
+
+            ImGui::TableSetColumnIndex(1);
+            if(region.old_size > 0)
+                ImGui::Text("%016" PRIX64, region.old_offset);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%" PRIX64, region.old_size);
+            ImGui::TableSetColumnIndex(3);
+            if(region.new_size > 0)
+                ImGui::Text("%016" PRIX64, region.new_offset);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%" PRIX64, region.new_size);
+            ImGui::TableSetColumnIndex(5);
+            ImGui::Text("%" PRIu64, std::max(region.changed_old, region.changed_new));
+        });
+
+        ImGui::TreePop();
+    }
+
+    if (!result->fields.empty() && ImGui::TreeNode("FIELDS"))
+    {
+        clipped_table("fields", { "Field", "Old", "New" }, result->fields.size(), [&](size_t i)
+        {
+            const PEFieldChange& change = result->fields[i];
+
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", change.field.c_str());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%" PRIX64, change.old_value);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%" PRIX64, change.new_value);
+        });
+
+        ImGui::TreePop();
+    }
+
+    size_t import_rows = result->imports_added.size() + result->imports_removed.size();
+    if (import_rows > 0 && ImGui::TreeNode("IMPORTS"))
+    {
+        clipped_table("imports", { "Change", "Import" }, import_rows, [&](size_t i)
+        {
+            bool added = i < result->imports_added.size();
+            const std::string& name = added ? result->imports_added[i] : result->imports_removed[i - result->imports_added.size()];
+
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(added ? "Added" : "Removed");
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%s", name.c_str());
+        });
+
+        ImGui::TreePop();
+    }
+
+    size_t export_rows = result->exports_added.size() + result->exports_removed.size() + result->exports_moved.size();
+    if (export_rows > 0 && ImGui::TreeNode("EXPORTS"))
+    {
+        size_t added = result->exports_added.size();
+        size_t removed = result->exports_removed.size();
+
+        clipped_table("exports", { "Change", "Export", "Old RVA", "New RVA" }, export_rows, [&](size_t i)
+        {
+            ImGui::TableSetColumnIndex(0);
+
+            if(i < added)
+            {
+                ImGui::Text("Added");
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", result->exports_added[i].c_str());
+            }
+            else if(i < added + removed)
+            {
+                ImGui::Text("Removed");
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", result->exports_removed[i - added].c_str());
+            }
+            else
+            {
+                const PEExportChange& change = result->exports_moved[i - added - removed];
+
+                ImGui::Text("Moved");
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", change.name.c_str());
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%08" PRIX32, change.old_rva);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%08" PRIX32, change.new_rva);
+            }
+        });
+
+        ImGui::TreePop();
+    }
+
+    if (!ImGui::TreeNode("BYTES"))
+        return;
+
+    uint64_t last_row = rowStarts.back() == 0 ? 0 : rowStarts.back() - 1;
+    size_t current = std::upper_bound(rowStarts.begin(), rowStarts.end() - 1, hexTop) - rowStarts.begin() - 1;
+
+    if (ImGui::Checkbox("Fold equal bytes", &foldEqual))
+    {
+        // Keeps the hunk at the top in view
+        const DiffHunk* top = current < rowHunks.size() ? rowHunks[current] : nullptr;
+        layout_rows();
+
+        if(top != nullptr)
+            hexTop = rowStarts[std::find(rowHunks.begin(), rowHunks.end(), top) - rowHunks.begin()];
+
+        last_row = rowStarts.back() == 0 ? 0 : rowStarts.back() - 1;
+        current = std::upper_bound(rowStarts.begin(), rowStarts.end() - 1, hexTop) - rowStarts.begin() - 1;
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Previous change"))
+    {
+        for (size_t i = std::min(current, rowHunks.size()); i-- > 0;)
+        {
+            if(rowHunks[i]->kind != DiffKind::Equal)
+            {
+                hexTop = rowStarts[i];
+                break;
+            }
+        }
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Next change"))
+    {
+        for (size_t i = current + 1; i < rowHunks.size(); ++i)
+        {
+            if(rowHunks[i]->kind != DiffKind::Equal)
+            {
+                hexTop = rowStarts[i];
+                break;
+            }
+        }
+    }
+
+    if(current < rowHunks.size())
+    {
+        const DiffHunk& hunk = *rowHunks[current];
+
+        ImGui::SameLine();
+        ImGui::Text("%s: old [%" PRIX64 ", %" PRIX64 ") new [%" PRIX64 ", %" PRIX64 ")", describe_kind(hunk.kind),
+            hunk.old_offset, hunk.old_offset + hunk.old_size, hunk.new_offset, hunk.new_offset + hunk.new_size);
+    }
+
+    float line = ImGui::GetTextLineHeightWithSpacing();
+    float height = line * visible_rows + ImGui::GetStyle().FramePadding.y * 2;
+    float slider_width = 20;
+
+    ImGui::BeginChild("diff", ImVec2(ImGui::GetContentRegionAvail().x - slider_width - ImGui::GetStyle().ItemSpacing.x, height), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_HorizontalScrollbar);
+    {
+        // Rows rather than pixels like the hex view, a multi-GB diff has more rows than a float scroll offset can address
+        if(ImGui::IsWindowHovered())
+        {
+            float wheel = ImGui::GetIO().MouseWheel;
+            uint64_t step = static_cast<uint64_t>(wheel < 0 ? -wheel * 3 : wheel * 3);
+
+            if(wheel > 0)
+                hexTop = hexTop > step ? hexTop - step : 0;
+            else if(wheel < 0)
+                hexTop = std::min(hexTop + step, last_row);
+        }
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float char_width = ImGui::CalcTextSize("0").x;
+        ImDrawList* draw = ImGui::GetWindowDrawList();
+
+        PageCache& old_cache = old_pe->get_page_cache();
+        PageCache& new_cache = new_pe->get_page_cache();
+
+        uint8_t old_bytes[16];
+        uint8_t new_bytes[16];
+        char text[2 * new_column + 1];
+
+        // Only the visible rows are looked up and read, the hunk of the first one by binary search over the row starts
+        size_t index = current;
+
+        for (int row = 0; row < visible_rows && hexTop + row <= last_row && index < rowHunks.size(); ++row)
+        {
+            uint64_t position = hexTop + row;
+            while(position >= rowStarts[index + 1])
+                ++index;
+
+            const DiffHunk& hunk = *rowHunks[index];
+            float y = origin.y + row * line;
+
+            if(hunk.kind == DiffKind::Equal && foldEqual)
+            {
+                ImGui::TextDisabled("%016" PRIX64 "  %" PRIu64 " equal bytes (new %016" PRIX64 ")", hunk.old_offset, hunk.old_size, hunk.new_offset);
+                continue;
+            }
+
+            uint64_t skip = (position - rowStarts[index]) * 16;
+            uint64_t old_count = hunk.old_size > skip ? std::min<uint64_t>(16, hunk.old_size - skip) : 0;
+            uint64_t new_count = hunk.new_size > skip ? std::min<uint64_t>(16, hunk.new_size - skip) : 0;
+
+            old_count = old_cache.read(hunk.old_offset + skip, old_bytes, old_count);
+            new_count = new_cache.read(hunk.new_offset + skip, new_bytes, new_count);
+
+            format_side(text, 0, hunk.old_offset + skip, old_bytes, old_count);
+            format_side(text, new_column, hunk.new_offset + skip, new_bytes, new_count);
+            text[2 * new_column] = '\0';
+
+            // Changed hunks mark only the bytes that differ at the same position, the others their whole side
+            ImU32 color = kind_color(hunk.kind);
+
+            for (uint64_t i = 0; i < 16 && color != 0; ++i)
+            {
+                bool in_old = i < old_count;
+                bool in_new = i < new_count;
+
+                if(!in_old && !in_new)
+                    break;
+
+                if(hunk.kind == DiffKind::Changed && in_old && in_new && old_bytes[i] == new_bytes[i])
+                    continue;
+
+                for (int side = 0; side < 2; ++side)
+                {
+                    if(!(side == 0 ? in_old : in_new))
+                        continue;
+
+                    float base = origin.x + side * new_column * char_width;
+                    float hex_x = base + (hex_column + i * 3) * char_width;
+                    float ascii_x = base + (ascii_column + i) * char_width;
+
+                    draw->AddRectFilled(ImVec2(hex_x, y), ImVec2(hex_x + char_width * 2, y + line), color);
+                    draw->AddRectFilled(ImVec2(ascii_x, y), ImVec2(ascii_x + char_width, y + line), color);
+                }
+            }
+
+            ImGui::TextUnformatted(text, text + 2 * new_column);
+        }
+
+        ImGui::EndChild();
+    }
+
+    ImGui::SameLine();
+
+    // Top of the slider is the first hunk
+    uint64_t inverted = last_row - std::min(hexTop, last_row);
+    uint64_t zero = 0;
+
+    if (ImGui::VSliderScalar("##rows", ImVec2(slider_width, height), ImGuiDataType_U64, &inverted, &zero, &last_row, ""))
+        hexTop = last_row - inverted;
+
+    ImGui::TreePop();
+}
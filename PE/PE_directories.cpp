@@ -0,0 +1,410 @@
+#include "PE.h"
+
+/*
+* Data directory parsers
+* Everything is read through view_rva so malformed RVAs and sizes turn into empty results instead of reads past the file.
+*/
+
+// Upper bounds for tables that are only terminated by a zero entry
+static const size_t max_import_descriptors = 4096;
+static const size_t max_thunks = 65536;
+static const size_t max_tls_callbacks = 4096;
+static const size_t max_resources = 65536;
+
+// Counts that come straight from the file and size allocations, a few bytes of header could otherwise ask for gigabytes
+static const size_t max_import_functions = 1 << 20; // Across all descriptors, they can share one lookup table
+static const size_t max_exports = 1 << 20;
+static const size_t max_relocation_blocks = 1 << 20;
+
+template<typename Flavour>
+void PE::parse_import_thunks(uint32_t lookup_rva, uint32_t iat_rva)
+{
+    using Pointer = typename Flavour::Pointer;
+
+    // Bound images overwrite the IAT with addresses, the lookup table keeps the names. Old linkers leave it out though.
+    if(lookup_rva == 0)
+        lookup_rva = iat_rva;
+
+    for (size_t i = 0; i < max_thunks; ++i)
+    {
+        Pointer thunk;
+        if(!read_rva_as(lookup_rva + static_cast<uint32_t>(i * sizeof(Pointer)), thunk) || thunk == 0)
+            break;
+
+        if(import_functions.size() == max_import_functions)
+        {
+            report(PEIssue::TableLimit, "Import", PE_NO_OFFSET, max_import_functions);
+
+            return;
+        }
+
+        PEImportFunction function = {};
+        function.iat_rva = iat_rva + static_cast<uint32_t>(i * sizeof(Pointer));
+
+        if(thunk & Flavour::ordinal_flag)
+        {
+            function.by_ordinal = true;
+            function.hint = static_cast<uint16_t>(thunk & 0xFFFF);
+        }
+        else
+        {
+            // IMAGE_IMPORT_BY_NAME, a hint followed by the name
+            uint32_t name_rva = static_cast<uint32_t>(thunk & 0x7FFFFFFF);
+
+            read_rva_as(name_rva, function.hint);
+
+            function.name = get_rva_string(name_rva + 2);
+        }
+
+        import_functions.push_back(function);
+    }
+}
+
+template<typename Flavour>
+void PE::parse_imports()
+{
+    // Functions go to one list for every import, the spans are only taken once it's stopped growing
+    std::vector<size_t> ends;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_IMPORT);
+    for (size_t i = 0; directory.VirtualAddress != 0 && i < max_import_descriptors; ++i)
+    {
+        IMAGE_IMPORT_DESCRIPTOR descriptor;
+        if(!read_rva_as(directory.VirtualAddress + static_cast<uint32_t>(i * sizeof(IMAGE_IMPORT_DESCRIPTOR)), descriptor) || (descriptor.Name == 0 && descriptor.FirstThunk == 0))
+            break;
+
+        PEImport import = {};
+        import.dll = get_rva_string(descriptor.Name);
+        import.delayed = false;
+        parse_import_thunks<Flavour>(descriptor.OriginalFirstThunk, descriptor.FirstThunk);
+
+        imports.push_back(import);
+        ends.push_back(import_functions.size());
+    }
+
+    directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT);
+    uint64_t image_base = get_image_base();
+
+    for (size_t i = 0; directory.VirtualAddress != 0 && i < max_import_descriptors; ++i)
+    {
+        IMAGE_DELAYLOAD_DESCRIPTOR descriptor;
+        if(!read_rva_as(directory.VirtualAddress + static_cast<uint32_t>(i * sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)), descriptor) || descriptor.DllNameRVA == 0)
+            break;
+
+        // Version 1 descriptors hold VAs
+        uint32_t bias = (descriptor.Attributes & 1) ? 0 : static_cast<uint32_t>(image_base);
+
+        PEImport import = {};
+        import.dll = get_rva_string(descriptor.DllNameRVA - bias);
+        import.delayed = true;
+        parse_import_thunks<Flavour>(descriptor.ImportNameTableRVA - bias, descriptor.ImportAddressTableRVA - bias);
+
+        imports.push_back(import);
+        ends.push_back(import_functions.size());
+    }
+
+    size_t begin = 0;
+    for (size_t i = 0; i < imports.size(); ++i)
+    {
+        imports[i].functions = Span<PEImportFunction>(import_functions.data() + begin, ends[i] - begin);
+        begin = ends[i];
+    }
+}
+
+Span<PEImport> PE::get_imports()
+{
+    if(!imports_parsed)
+    {
+        imports_parsed = true;
+
+        if(is_64bit())
+            parse_imports<PE64>();
+        else if(get_nt() != nullptr)
+            parse_imports<PE32>();
+    }
+
+    return Span<PEImport>(imports.data(), imports.size());
+}
+
+const PEExports& PE::get_exports()
+{
+    if(exports_parsed)
+        return exports;
+
+    exports_parsed = true;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_EXPORT);
+    IMAGE_EXPORT_DIRECTORY header;
+    if(directory.VirtualAddress == 0 || !read_rva_as(directory.VirtualAddress, header))
+        return exports;
+
+    exports.dll = get_rva_string(header.Name);
+    exports.ordinal_base = header.Base;
+
+    uint32_t function_count = header.NumberOfFunctions;
+    if(function_count > max_exports)
+    {
+        report(PEIssue::TableLimit, "NumberOfFunctions", rva_to_offset(directory.VirtualAddress + offsetof(IMAGE_EXPORT_DIRECTORY, NumberOfFunctions)), function_count);
+        function_count = max_exports;
+    }
+
+    Span<uint32_t> functions = view_rva_array<uint32_t>(header.AddressOfFunctions, function_count);
+    Span<uint32_t> names = view_rva_array<uint32_t>(header.AddressOfNames, header.NumberOfNames);
+    Span<uint16_t> name_ordinals = view_rva_array<uint16_t>(header.AddressOfNameOrdinals, header.NumberOfNames);
+
+    // Names point at function indices, invert that so each function finds its name in one pass
+    std::vector<uint32_t> name_of(functions.size(), UINT32_MAX);
+    if(names.size() == name_ordinals.size())
+    {
+        for (uint32_t i = 0; i < names.size(); ++i)
+        {
+            if(name_ordinals[i] < name_of.size())
+                name_of[name_ordinals[i]] = i;
+        }
+    }
+
+    export_functions.reserve(functions.size());
+
+    for (uint32_t i = 0; i < functions.size(); ++i)
+    {
+        if(functions[i] == 0)
+            continue;
+
+        PEExport entry = {};
+        entry.ordinal = header.Base + i;
+        entry.rva = functions[i];
+
+        if(name_of[i] != UINT32_MAX)
+            entry.name = get_rva_string(names[name_of[i]]);
+
+        if(functions[i] >= directory.VirtualAddress && functions[i] - directory.VirtualAddress < directory.Size)
+            entry.forwarder = get_rva_string(functions[i]);
+
+        export_functions.push_back(entry);
+    }
+
+    exports.functions = Span<PEExport>(export_functions.data(), export_functions.size());
+
+    return exports;
+}
+
+Span<PERelocationBlock> PE::get_relocations()
+{
+    if(relocations_parsed)
+        return Span<PERelocationBlock>(relocations.data(), relocations.size());
+
+    relocations_parsed = true;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_BASERELOC);
+
+    uint32_t position = 0;
+    while(directory.VirtualAddress != 0 && position + sizeof(IMAGE_BASE_RELOCATION) <= directory.Size)
+    {
+        IMAGE_BASE_RELOCATION block;
+        if(!read_rva_as(directory.VirtualAddress + position, block) || block.SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION) || block.SizeOfBlock > directory.Size - position)
+            break;
+
+        if(relocations.size() == max_relocation_blocks)
+        {
+            report(PEIssue::TableLimit, "BaseReloc", PE_NO_OFFSET, max_relocation_blocks);
+            break;
+        }
+
+        uint32_t count = (block.SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / sizeof(uint16_t);
+        Span<uint16_t> entries = view_rva_array<uint16_t>(directory.VirtualAddress + position + sizeof(IMAGE_BASE_RELOCATION), count);
+
+        relocations.push_back({ block.VirtualAddress, entries });
+
+        position += block.SizeOfBlock;
+    }
+
+    return Span<PERelocationBlock>(relocations.data(), relocations.size());
+}
+
+void PE::parse_resource_directory(uint32_t offset, int depth, PEResource& leaf)
+{
+    // Offsets are relative to the start of the resource directory
+    uint32_t root = get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress;
+
+    IMAGE_RESOURCE_DIRECTORY directory;
+    if(!read_rva_as(root + offset, directory))
+        return;
+
+    uint32_t count = uint32_t(directory.NumberOfNamedEntries) + directory.NumberOfIdEntries;
+    Span<IMAGE_RESOURCE_DIRECTORY_ENTRY> entries = view_rva_array<IMAGE_RESOURCE_DIRECTORY_ENTRY>(root + offset + sizeof(IMAGE_RESOURCE_DIRECTORY), count);
+
+    for (const IMAGE_RESOURCE_DIRECTORY_ENTRY& entry : entries)
+    {
+        if(resources.size() >= max_resources || resource_entries >= PE_MAX_RESOURCE_ENTRIES)
+        {
+            // Every level returns through here, only the first one to hit the limit reports it
+            if(!resources_truncated)
+                report(PEIssue::TableLimit, "Resource", PE_NO_OFFSET, resources.size() >= max_resources ? max_resources : PE_MAX_RESOURCE_ENTRIES);
+
+            resources_truncated = true;
+
+            return;
+        }
+
+        ++resource_entries;
+
+        PEResourceId id = { entry.Name & 0x7FFFFFFF, {} };
+
+        if(entry.Name & 0x80000000)
+        {
+            id.name = arena->copy(get_resource_name(id.id));
+            id.id = 0;
+        }
+
+        // Type, name and language, in that order
+        if(depth == 0)
+            leaf.type = id;
+        else if(depth == 1)
+            leaf.name = id;
+        else
+            leaf.language = id.id;
+
+        if(entry.OffsetToData & 0x80000000)
+        {
+            // Anything deeper than the language level is malformed, it also stops directories that point at themselves
+            if(depth < 2)
+                parse_resource_directory(entry.OffsetToData & 0x7FFFFFFF, depth + 1, leaf);
+
+            continue;
+        }
+
+        IMAGE_RESOURCE_DATA_ENTRY data;
+        if(!read_rva_as(root + entry.OffsetToData, data))
+            continue;
+
+        leaf.rva = data.OffsetToData;
+        leaf.size = data.Size;
+        leaf.code_page = data.CodePage;
+
+        resources.push_back(leaf);
+    }
+}
+
+Span<PEResource> PE::get_resources()
+{
+    if(!resources_parsed)
+    {
+        resources_parsed = true;
+
+        if(get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress != 0)
+        {
+            PEResource leaf = {};
+            parse_resource_directory(0, 0, leaf);
+        }
+    }
+
+    return Span<PEResource>(resources.data(), resources.size());
+}
+
+template<typename Flavour>
+void PE::parse_tls()
+{
+    using Pointer = typename Flavour::Pointer;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_TLS);
+
+    typename Flavour::TlsDirectory header;
+    if(directory.VirtualAddress == 0 || !read_rva_as(directory.VirtualAddress, header))
+        return;
+
+    tls = { true, header.StartAddressOfRawData, header.EndAddressOfRawData, header.AddressOfIndex, header.AddressOfCallBacks, header.SizeOfZeroFill, header.Characteristics, {} };
+
+    // The callback array is NULL terminated and holds VAs
+    uint64_t image_base = get_image_base();
+    if(tls.callbacks_va <= image_base || tls.callbacks_va - image_base > UINT32_MAX)
+        return;
+
+    uint32_t rva = static_cast<uint32_t>(tls.callbacks_va - image_base);
+
+    for (size_t i = 0; ; ++i)
+    {
+        Pointer callback;
+        if(!read_rva_as(rva + static_cast<uint32_t>(i * sizeof(Pointer)), callback) || callback == 0)
+            break;
+
+        if(i == max_tls_callbacks)
+        {
+            report(PEIssue::TableLimit, "AddressOfCallBacks", PE_NO_OFFSET, max_tls_callbacks);
+            break;
+        }
+
+        tls_callbacks.push_back(callback);
+    }
+
+    tls.callbacks = Span<uint64_t>(tls_callbacks.data(), tls_callbacks.size());
+}
+
+const PETls& PE::get_tls()
+{
+    if(tls_parsed)
+        return tls;
+
+    tls_parsed = true;
+
+    if(is_64bit())
+        parse_tls<PE64>();
+    else if(get_nt() != nullptr)
+        parse_tls<PE32>();
+
+    return tls;
+}
+
+Span<PEDebugEntry> PE::get_debug_entries()
+{
+    if(debug_parsed)
+        return Span<PEDebugEntry>(debug_entries.data(), debug_entries.size());
+
+    debug_parsed = true;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_DEBUG);
+    Span<IMAGE_DEBUG_DIRECTORY> entries = view_rva_array<IMAGE_DEBUG_DIRECTORY>(directory.VirtualAddress, directory.Size / sizeof(IMAGE_DEBUG_DIRECTORY));
+
+    for (const IMAGE_DEBUG_DIRECTORY& entry : entries)
+    {
+        PEDebugEntry debug = { &entry, {}, 0 };
+
+        // RSDS: signature, GUID, age, then the NUL terminated PDB path
+        if(entry.Type == IMAGE_DEBUG_TYPE_CODEVIEW && entry.SizeOfData > 24)
+        {
+            ByteSpan data = source_.view(entry.PointerToRawData, entry.SizeOfData);
+
+            if(!data.empty() && data[0] == 'R' && data[1] == 'S' && data[2] == 'D' && data[3] == 'S')
+            {
+                debug.pdb_age = uint32_t(data[20]) | (uint32_t(data[21]) << 8) | (uint32_t(data[22]) << 16) | (uint32_t(data[23]) << 24);
+
+                const char* path = reinterpret_cast<const char*>(data.data() + 24);
+                size_t length = 0;
+                while(24 + length < data.size() && path[length] != '\0')
+                    ++length;
+
+                debug.pdb_path = std::string_view(path, length);
+            }
+        }
+
+        debug_entries.push_back(debug);
+    }
+
+    return Span<PEDebugEntry>(debug_entries.data(), debug_entries.size());
+}
+
+Span<IMAGE_RUNTIME_FUNCTION_ENTRY> PE::get_exception_entries()
+{
+    if(exceptions_parsed)
+        return exception_entries;
+
+    exceptions_parsed = true;
+
+    // ARM64 and others use a packed 8 byte layout
+    if(get_nt() == nullptr || nt->FileHeader.Machine != MachineArc::AMD64)
+        return exception_entries;
+
+    IMAGE_DATA_DIRECTORY directory = get_data_directory(IMAGE_DIRECTORY_ENTRY_EXCEPTION);
+    exception_entries = view_rva_array<IMAGE_RUNTIME_FUNCTION_ENTRY>(directory.VirtualAddress, directory.Size / sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY));
+
+    return exception_entries;
+}
@@ -0,0 +1,127 @@
+#include "PE.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace
+{
+    const uint64_t chunk_size = 1 << 20; // Even, so every chunk starts a word
+
+    // Sum of the 16-bit little endian words of data, which starts at an even file offset. An odd last byte is a word of
+    // its own.
+    uint64_t sum_words(const uint8_t* data, uint64_t size)
+    {
+        uint64_t sum = 0;
+        uint64_t i = 0;
+
+        for (; i + 1 < size; i += 2)
+            sum += data[i] | (uint32_t(data[i + 1]) << 8);
+
+        if(i < size)
+            sum += data[i];
+
+        return sum;
+    }
+
+    // Word sum of [offset, offset + length) as read by read(offset, dst, length), offset has to be even
+    template<typename Reader>
+    uint64_t sum_range(Reader&& read, uint64_t offset, uint64_t length, std::vector<uint8_t>& buffer)
+    {
+        uint64_t sum = 0;
+
+        for (uint64_t done = 0; done < length; )
+        {
+            uint64_t count = std::min(chunk_size, length - done);
+            buffer.resize(count);
+
+            count = read(offset + done, buffer.data(), count);
+            if(count == 0)
+                break;
+
+            sum += sum_words(buffer.data(), count);
+            done += count;
+        }
+
+        return sum;
+    }
+}
+
+uint64_t PE::checksum_offset()
+{
+    if(get_nt() == nullptr)
+        return PE_NO_OFFSET;
+
+    return uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + offsetof(IMAGE_OPTIONAL_HEADER64, CheckSum); // Same offset in PE32
+}
+
+uint32_t PE::compute_checksum()
+{
+    uint64_t field = checksum_offset();
+    if(field == PE_NO_OFFSET)
+        return 0;
+
+    std::vector<uint8_t> buffer;
+    auto read_source = [this](uint64_t offset, void* dst, uint64_t length) { return source_.read(offset, dst, length); };
+
+    if(!word_sum_computed)
+    {
+        word_sum = sum_range(read_source, 0, source_.size(), buffer);
+        word_sum_computed = true;
+    }
+
+    // Arithmetic wraps, the exact sum is never negative so it comes out right
+    uint64_t sum = word_sum;
+
+    if(patches != nullptr)
+    {
+        auto read_patched = [this](uint64_t offset, void* dst, uint64_t length) { return patches->read(offset, dst, length); };
+
+        // Widened to whole words, merged ranges never share one
+        for (const PatchLayer::Range& range : patches->modified_ranges())
+        {
+            uint64_t start = range.offset & ~uint64_t(1);
+            uint64_t end = std::min(source_.size(), (range.offset + range.length + 1) & ~uint64_t(1));
+
+            sum -= sum_range(read_source, start, end - start, buffer);
+            sum += sum_range(read_patched, start, end - start, buffer);
+        }
+    }
+
+    // The field itself counts as zero
+    uint8_t current[4] = {};
+    if(patches != nullptr)
+        patches->read(field, current, sizeof(current));
+    else
+        source_.read(field, current, sizeof(current));
+
+    for (uint64_t i = 0; i < sizeof(current); ++i)
+        sum -= uint64_t(current[i]) << (((field + i) & 1) * 8);
+
+    while(sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return static_cast<uint32_t>(sum + source_.size());
+}
+
+bool PE::save(const std::string& path, std::string& error)
+{
+    if(patches == nullptr)
+    {
+        error = "the file isn't editable";
+
+        return false;
+    }
+
+    uint64_t field = checksum_offset();
+    if(field != PE_NO_OFFSET && field + sizeof(uint32_t) <= source_.size())
+    {
+        uint32_t checksum = compute_checksum();
+        uint8_t bytes[4] = { uint8_t(checksum), uint8_t(checksum >> 8), uint8_t(checksum >> 16), uint8_t(checksum >> 24) };
+        uint8_t current[4] = {};
+        patches->read(field, current, sizeof(current));
+
+        if(!std::equal(bytes, bytes + sizeof(bytes), current))
+            patches->write(field, bytes, sizeof(bytes));
+    }
+
+    return patches->save(path, error);
+}
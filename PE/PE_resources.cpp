@@ -0,0 +1,409 @@
+#include "PE.h"
+#include "../core/profiler.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t max_decoded_size = 16 * 1024 * 1024; // Larger resources are only shown raw
+static const uint32_t max_icon_dimension = 1024;
+static const uint32_t max_bitmap_dimension = 4096;
+
+namespace
+{
+    uint16_t read_u16(ByteSpan data, size_t offset)
+    {
+        return static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8));
+    }
+
+    uint32_t read_u32(ByteSpan data, size_t offset)
+    {
+        return read_u16(data, offset) | (uint32_t(read_u16(data, offset + 2)) << 16);
+    }
+
+    // count UTF-16 code units, stops at the first NUL. Unpaired surrogates become U+FFFD.
+    std::string utf16_to_utf8(const uint8_t* data, size_t count)
+    {
+        std::string out;
+        out.reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t c = data[i * 2] | (data[i * 2 + 1] << 8);
+            if(c == 0)
+                break;
+
+            if(c >= 0xD800 && c < 0xDC00 && i + 1 < count)
+            {
+                uint32_t low = data[i * 2 + 2] | (data[i * 2 + 3] << 8);
+                if(low >= 0xDC00 && low < 0xE000)
+                {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+
+            if(c >= 0xD800 && c < 0xE000)
+                c = 0xFFFD;
+
+            if(c < 0x80)
+                out += static_cast<char>(c);
+            else if(c < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (c >> 6));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else if(c < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (c >> 12));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (c >> 18));
+                out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+
+        return out;
+    }
+
+    // Node of VS_VERSIONINFO: length, value length and type, a NUL terminated UTF-16 key, the value and the children, each
+    // starting 32-bit aligned
+    struct VersionBlock
+    {
+        std::string key;
+        ByteSpan value;
+        bool text;
+        ByteSpan children;
+    };
+
+    // Block at the start of data, size is how far the next one starts
+    bool read_version_block(ByteSpan data, VersionBlock& block, size_t& size)
+    {
+        if(data.size() < 6)
+            return false;
+
+        size_t length = read_u16(data, 0);
+        size_t value_length = read_u16(data, 2);
+        block.text = read_u16(data, 4) == 1;
+
+        if(length < 6 || length > data.size())
+            return false;
+
+        size_t position = 6;
+        size_t key_start = position;
+        while(position + 2 <= length && read_u16(data, position) != 0)
+            position += 2;
+
+        block.key = utf16_to_utf8(data.data() + key_start, (position - key_start) / 2);
+        position = std::min(length, (position + 2 + 3) & ~size_t(3));
+
+        // Text lengths are in characters, though some linkers write bytes, the block length bounds both
+        size_t value_size = std::min(block.text ? value_length * 2 : value_length, length - position);
+        block.value = data.subspan(position, value_size);
+
+        position = std::min(length, (position + value_size + 3) & ~size_t(3));
+        block.children = data.subspan(position, length - position);
+        size = (length + 3) & ~size_t(3);
+
+        return true;
+    }
+
+    template<typename Visit>
+    void for_each_version_block(ByteSpan data, Visit&& visit)
+    {
+        VersionBlock block;
+        size_t size;
+
+        for (size_t position = 0; position < data.size(); position += size)
+        {
+            if(!read_version_block(data.subspan(position, data.size() - position), block, size))
+                break;
+
+            visit(block);
+        }
+    }
+
+    void decode_version_info(ByteSpan data, PEResourceContent& out)
+    {
+        VersionBlock root;
+        size_t size;
+
+        if(!read_version_block(data, root, size) || root.key != "VS_VERSION_INFO")
+        {
+            out.error = "missing VS_VERSION_INFO";
+            return;
+        }
+
+        out.kind = PEResourceKind::VersionInfo;
+
+        // VS_FIXEDFILEINFO starts with its signature
+        if(root.value.size() >= 52 && read_u32(root.value, 0) == 0xFEEF04BD)
+        {
+            out.file_version = (uint64_t(read_u32(root.value, 8)) << 32) | read_u32(root.value, 12);
+            out.product_version = (uint64_t(read_u32(root.value, 16)) << 32) | read_u32(root.value, 20);
+            out.file_flags = read_u32(root.value, 28) & read_u32(root.value, 24);
+            out.file_os = read_u32(root.value, 32);
+            out.file_type = read_u32(root.value, 36);
+        }
+
+        // StringFileInfo holds a StringTable per language, VarFileInfo only the translation list
+        for_each_version_block(root.children, [&](const VersionBlock& info)
+        {
+            if(info.key != "StringFileInfo")
+                return;
+
+            for_each_version_block(info.children, [&](const VersionBlock& table)
+            {
+                for_each_version_block(table.children, [&](const VersionBlock& entry)
+                {
+                    std::string value = entry.text ? utf16_to_utf8(entry.value.data(), entry.value.size() / 2) : std::string();
+                    out.version_strings.push_back({ table.key, entry.key, value });
+                });
+            });
+        });
+    }
+
+    void decode_manifest(ByteSpan data, PEResourceContent& out)
+    {
+        out.kind = PEResourceKind::Manifest;
+
+        if(data.size() >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+        {
+            out.text = utf16_to_utf8(data.data() + 2, (data.size() - 2) / 2);
+            return;
+        }
+
+        size_t start = data.size() >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF ? 3 : 0;
+        const uint8_t* end = std::find(data.begin() + start, data.end(), uint8_t(0));
+
+        out.text.assign(reinterpret_cast<const char*>(data.data()) + start, reinterpret_cast<const char*>(end));
+    }
+
+    // 16 length prefixed UTF-16 strings, block n holds ids (n - 1) * 16 to n * 16 - 1
+    void decode_string_table(ByteSpan data, uint32_t block, PEResourceContent& out)
+    {
+        out.kind = PEResourceKind::StringTable;
+
+        size_t position = 0;
+        for (uint32_t i = 0; i < 16 && position + 2 <= data.size(); ++i)
+        {
+            size_t length = read_u16(data, position);
+            position += 2;
+
+            if(length > (data.size() - position) / 2)
+            {
+                out.error = "string table is truncated";
+                break;
+            }
+
+            if(length > 0)
+                out.strings.push_back({ block > 0 ? (block - 1) * 16 + i : i, utf16_to_utf8(data.data() + position, length) });
+
+            position += length * 2;
+        }
+    }
+
+    void decode_image(ByteSpan data, uint32_t type, PEResourceContent& out)
+    {
+        // Cursors start with their hotspot
+        if(type == RT_CURSOR)
+            data = data.size() >= 4 ? data.subspan(4, data.size() - 4) : ByteSpan();
+
+        bool decoded;
+        if(is_png(data))
+            decoded = decode_png(data, max_icon_dimension, out.image, out.error);
+        else
+            decoded = decode_dib(data, type != RT_BITMAP, type == RT_BITMAP ? max_bitmap_dimension : max_icon_dimension, out.image, out.error);
+
+        if(decoded)
+            out.kind = PEResourceKind::Image;
+    }
+
+    // GRPICONDIR: reserved, type and count, then 14-byte entries. Cursor entries store 16-bit sizes with the height doubled.
+    void decode_icon_group(ByteSpan data, uint32_t type, PEResourceContent& out)
+    {
+        if(data.size() < 6)
+        {
+            out.error = "missing group header";
+            return;
+        }
+
+        out.kind = PEResourceKind::IconGroup;
+
+        uint32_t count = read_u16(data, 4);
+        for (uint32_t i = 0; i < count && 6 + (i + 1) * 14 <= data.size(); ++i)
+        {
+            size_t entry = 6 + i * 14;
+            PEIconGroupEntry icon = {};
+
+            if(type == RT_GROUP_CURSOR)
+            {
+                icon.width = read_u16(data, entry);
+                icon.height = read_u16(data, entry + 2) / 2;
+            }
+            else
+            {
+                icon.width = data[entry] == 0 ? 256 : data[entry]; // 0 stands for 256
+                icon.height = data[entry + 1] == 0 ? 256 : data[entry + 1];
+            }
+
+            icon.bit_count = read_u16(data, entry + 6);
+            icon.size = read_u32(data, entry + 8);
+            icon.id = read_u16(data, entry + 12);
+            out.icons.push_back(icon);
+        }
+    }
+}
+
+uint64_t PEResourceContent::memory_usage() const
+{
+    uint64_t total = sizeof(*this) + error.capacity() + text.capacity() + image.rgba.capacity() + icons.capacity() * sizeof(PEIconGroupEntry);
+
+    for (const PEVersionString& entry : version_strings)
+        total += sizeof(entry) + entry.table.capacity() + entry.key.capacity() + entry.value.capacity();
+
+    for (const auto& entry : strings)
+        total += sizeof(entry) + entry.second.capacity();
+
+    return total;
+}
+
+std::string PE::get_resource_name(uint32_t offset)
+{
+    // Length prefixed UTF-16, narrowed since it's shown next to ASCII everywhere else
+    uint32_t root = get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress;
+
+    uint16_t length;
+    ByteSpan characters = read_rva_as(root + offset, length) ? view_rva(root + offset + 2, uint64_t(length) * 2) : ByteSpan();
+
+    std::string name;
+    for (size_t i = 0; i < characters.size(); i += 2)
+    {
+        uint16_t c = uint16_t(characters[i] | (characters[i + 1] << 8));
+        name += c < 0x80 ? static_cast<char>(c) : '?';
+    }
+
+    return name;
+}
+
+uint32_t PE::get_resource_entry_count(uint32_t directory)
+{
+    uint32_t root = get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress;
+    if(root == 0)
+        return 0;
+
+    IMAGE_RESOURCE_DIRECTORY header;
+    if(!read_rva_as(root + directory, header))
+        return 0;
+
+    // Entries that run past the section don't exist as far as the views are concerned
+    uint32_t count = uint32_t(header.NumberOfNamedEntries) + header.NumberOfIdEntries;
+    if(view_rva(root + directory + sizeof(IMAGE_RESOURCE_DIRECTORY), uint64_t(count) * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY)).empty())
+        return 0;
+
+    return count;
+}
+
+bool PE::get_resource_entry(uint32_t directory, uint32_t index, PEResourceNode& node)
+{
+    uint32_t root = get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress;
+    if(index >= get_resource_entry_count(directory))
+        return false;
+
+    IMAGE_RESOURCE_DIRECTORY_ENTRY entry;
+    if(!read_rva_as(root + directory + sizeof(IMAGE_RESOURCE_DIRECTORY) + index * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY), entry))
+        return false;
+
+    bool named = (entry.Name & 0x80000000) != 0;
+
+    node.id = named ? 0 : entry.Name;
+    node.name = named ? get_resource_name(entry.Name & 0x7FFFFFFF) : std::string();
+    node.directory = (entry.OffsetToData & 0x80000000) != 0;
+    node.offset = entry.OffsetToData & 0x7FFFFFFF;
+
+    return true;
+}
+
+bool PE::get_resource_data(uint32_t offset, IMAGE_RESOURCE_DATA_ENTRY& data)
+{
+    uint32_t root = get_data_directory(IMAGE_DIRECTORY_ENTRY_RESOURCE).VirtualAddress;
+    if(root == 0)
+        return false;
+
+    return read_rva_as(root + offset, data);
+}
+
+const char* PE::get_resource_type_name(uint32_t type)
+{
+    switch (type)
+    {
+        case 1: return "CURSOR";
+        case 2: return "BITMAP";
+        case 3: return "ICON";
+        case 4: return "MENU";
+        case 5: return "DIALOG";
+        case 6: return "STRING";
+        case 7: return "FONTDIR";
+        case 8: return "FONT";
+        case 9: return "ACCELERATOR";
+        case 10: return "RCDATA";
+        case 11: return "MESSAGETABLE";
+        case 12: return "GROUP_CURSOR";
+        case 14: return "GROUP_ICON";
+        case 16: return "VERSION";
+        case 17: return "DLGINCLUDE";
+        case 19: return "PLUGPLAY";
+        case 20: return "VXD";
+        case 21: return "ANICURSOR";
+        case 22: return "ANIICON";
+        case 23: return "HTML";
+        case 24: return "MANIFEST";
+        default: return nullptr;
+    }
+}
+
+std::shared_ptr<const PEResourceContent> PE::decode_resource(uint32_t type, uint32_t name, uint32_t rva, uint32_t size)
+{
+    PEResourceKey key = { type, name, rva, size };
+    if(std::shared_ptr<const PEResourceContent>* cached = resource_cache.find(key))
+        return *cached;
+
+    PROFILE_SCOPE("PE::decode_resource");
+
+    auto content = std::make_shared<PEResourceContent>();
+    ByteSpan data = size <= max_decoded_size ? view_rva(rva, size) : ByteSpan();
+
+    if(size > max_decoded_size)
+        content->error = "too large to decode";
+    else if(data.empty() && size > 0)
+        content->error = "data isn't backed by the file";
+    else
+    {
+        switch (type)
+        {
+            case RT_VERSION:
+                decode_version_info(data, *content);
+                break;
+            case RT_MANIFEST:
+                decode_manifest(data, *content);
+                break;
+            case RT_STRING:
+                decode_string_table(data, name, *content);
+                break;
+            case RT_CURSOR:
+            case RT_BITMAP:
+            case RT_ICON:
+                decode_image(data, type, *content);
+                break;
+            case RT_GROUP_CURSOR:
+            case RT_GROUP_ICON:
+                decode_icon_group(data, type, *content);
+                break;
+        }
+    }
+
+    return resource_cache.insert(key, std::move(content));
+}
@@ -0,0 +1,1705 @@
+#include "PE.h"
+#include "../widgets/widgets.h"
+#include "../core/profiler.h"
+#include "../core/thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+
+/*
+* UI Elements
+*/
+
+// Raw section data above this is almost always compressed or encrypted
+static const float highEntropy = 7.2f;
+
+#define NEW_TABLE_ENTRY(field, value, type) ImGui::TableNextRow(); \
+                    ImGui::TableSetColumnIndex(0); \
+                    ImGui::Text("%s", field); \
+                    ImGui::TableSetColumnIndex(1); \
+                    ImGui::Text("%" type, value);
+
+// Editable NEW_TABLE_ENTRY for a field at a file offset, see edit_table_entry
+#define EDIT_TABLE_ENTRY(field, offset, type, format) edit_table_entry<type>(*this, field, offset, "%" format);
+
+// Row for a header field that shows its edited value and writes the new one through the patch layer when Enter is
+// pressed, as one undo step. Read-only without a patch layer.
+template<typename T>
+static void edit_table_entry(PE& pe, const char* field, uint64_t offset, const char* format)
+{
+    PatchLayer* patches = pe.get_patches();
+
+    // Little endian like the host, the same as the header structures
+    T value = 0;
+    if(patches != nullptr)
+        patches->read(offset, &value, sizeof(T));
+    else
+        pe.get_source().read(offset, &value, sizeof(T));
+
+    ImGui::TableNextRow();
+    ImGui::TableSetColumnIndex(0);
+    ImGui::Text("%s", field);
+    ImGui::TableSetColumnIndex(1);
+
+    if(patches == nullptr)
+    {
+        ImGui::Text(format, value);
+
+        return;
+    }
+
+    ImGuiDataType type = sizeof(T) == 8 ? ImGuiDataType_U64 : sizeof(T) == 4 ? ImGuiDataType_U32 : ImGuiDataType_U16;
+    ImGuiInputTextFlags flags = ImGuiInputTextFlags_EnterReturnsTrue;
+    if(format[std::strlen(format) - 1] == 'X')
+        flags |= ImGuiInputTextFlags_CharsHexadecimal;
+
+    T edited = value;
+
+    ImGui::PushID(field);
+    ImGui::SetNextItemWidth(-1);
+    if (ImGui::InputScalar("##value", type, &edited, nullptr, nullptr, format, flags) && edited != value)
+        patches->write(offset, &edited, sizeof(T));
+    ImGui::PopID();
+}
+
+void PE::render_sidebar()
+{
+    if(analysis != nullptr && !analysis->finished())
+    {
+        for (size_t i = 0; i < analysis->stage_count(); ++i)
+            ImGui::ProgressBar(analysis->progress(i), ImVec2(-1, 0), analysis->stage_name(i));
+
+        ImGui::Separator();
+    }
+
+    // Edits stay in the patch layer until they're saved, the file on disk is never written in place
+    if(patches != nullptr)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+
+        // Text fields keep Ctrl+Z for themselves
+        if(!io.WantTextInput && io.KeyCtrl)
+        {
+            if(ImGui::IsKeyPressed(ImGuiKey_Z))
+                io.KeyShift ? patches->redo() : patches->undo();
+            else if(ImGui::IsKeyPressed(ImGuiKey_Y))
+                patches->redo();
+        }
+
+        float half = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) / 2;
+
+        ImGui::BeginDisabled(!patches->can_undo());
+        if (ImGui::Button("UNDO", ImVec2(half, 0)))
+            patches->undo();
+        ImGui::EndDisabled();
+
+        ImGui::SameLine();
+
+        ImGui::BeginDisabled(!patches->can_redo());
+        if (ImGui::Button("REDO", ImVec2(half, 0)))
+            patches->redo();
+        ImGui::EndDisabled();
+
+        if(view->savePath.empty())
+            view->savePath = cache_file;
+
+        ImGui::SetNextItemWidth(-1);
+        ImGui::InputTextWithHintR("Save to", view->savePath);
+
+        // CheckSum is recomputed from the section table and headers the stages parse
+        ImGui::BeginDisabled(view->savePath.empty() || (analysis != nullptr && !analysis->finished()));
+        if (ImGui::Button("SAVE", ImVec2(-1, 0)))
+        {
+            view->saveError.clear();
+
+            if(save(view->savePath, view->saveError))
+                view->savedRevision = patches->revision();
+        }
+        ImGui::EndDisabled();
+
+        if(!view->saveError.empty())
+            ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", view->saveError.c_str());
+        else if(patches->revision() == view->savedRevision)
+            ImGui::TextDisabled("Saved");
+        else if(patches->modified())
+            ImGui::TextDisabled("Unsaved changes");
+
+        ImGui::Separator();
+    }
+
+    if (ImGui::Button("STRINGS", ImVec2(-1, 0)))
+        view->showSTRINGS = !view->showSTRINGS;
+
+    if (ImGui::Button("HEX", ImVec2(-1, 0)))
+        view->showHEX = !view->showHEX;
+
+    if (ImGui::Button("DISASSEMBLY", ImVec2(-1, 0)))
+        view->showDISASSEMBLY = !view->showDISASSEMBLY;
+
+    if (ImGui::Button("ENTROPY", ImVec2(-1, 0)))
+        view->showENTROPY = !view->showENTROPY;
+
+    if (ImGui::Button("HASHES", ImVec2(-1, 0)))
+        view->showHASHES = !view->showHASHES;
+
+    if (ImGui::Button("SIGNATURES", ImVec2(-1, 0)))
+        view->showSIGNATURES = !view->showSIGNATURES;
+
+    if (ImGui::Button("IMPORTS", ImVec2(-1, 0)))
+        view->showIMPORTS = !view->showIMPORTS;
+
+    if (ImGui::Button("EXPORTS", ImVec2(-1, 0)))
+        view->showEXPORTS = !view->showEXPORTS;
+
+    if (ImGui::Button("RESOURCES", ImVec2(-1, 0)))
+        view->showRESOURCES = !view->showRESOURCES;
+
+    if (ImGui::Button("RELOCATIONS", ImVec2(-1, 0)))
+        view->showRELOCATIONS = !view->showRELOCATIONS;
+
+    if (ImGui::Button("TLS", ImVec2(-1, 0)))
+        view->showTLS = !view->showTLS;
+
+    if (ImGui::Button("DEBUG", ImVec2(-1, 0)))
+        view->showDEBUG = !view->showDEBUG;
+
+    if (ImGui::Button("EXCEPTIONS", ImVec2(-1, 0)))
+        view->showEXCEPTIONS = !view->showEXCEPTIONS;
+
+    if (ImGui::Button("PAYLOADS", ImVec2(-1, 0)))
+        view->showPAYLOADS = !view->showPAYLOADS;
+
+    if (ImGui::Button("DIAGNOSTICS", ImVec2(-1, 0)))
+        view->showDIAGNOSTICS = !view->showDIAGNOSTICS;
+
+    if (ImGui::Button("IMAGE_DOS_HEADER", ImVec2(-1, 0)))
+        view->showIMAGE_DOS_HEADER = !view->showIMAGE_DOS_HEADER;
+
+    if (ImGui::Button("IMAGE_FILE_HEADER", ImVec2(-1, 0)))
+        view->showIMAGE_FILE_HEADER = !view->showIMAGE_FILE_HEADER;
+
+    if (ImGui::Button("IMAGE_OPTIONAL_HEADER", ImVec2(-1, 0)))
+        view->showIMAGE_OPTIONAL_HEADER = !view->showIMAGE_OPTIONAL_HEADER;
+
+    if (ImGui::Button("IMAGE_SECTION_HEADER", ImVec2(-1, 0)))
+        view->showIMAGE_SECTION_HEADER = !view->showIMAGE_SECTION_HEADER;
+}
+
+void PE::render_main()
+{
+    PROFILE_SCOPE("PE::render_main");
+
+    // Nothing else makes sense without valid headers, files no backend recognises (carved archives) are shown as raw bytes
+    if(!stage_ready(analysis, PEStage::Headers, "File"))
+    {
+        if(analysis != nullptr && analysis->state(static_cast<size_t>(PEStage::Headers)) == StageState::Failed && ImGui::TreeNodeEx("HEX", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            render_hex();
+
+            ImGui::TreePop();
+        }
+
+        return;
+    }
+
+    if(view->showSTRINGS && stage_ready(analysis, PEStage::Strings, "STRINGS"))
+    {
+        if (ImGui::TreeNode("STRINGS"))
+        {
+            ImGui::Checkbox("Whole file", &view->showAllStrings);
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(150);
+            ImGui::Combo("##mode", &view->searchMode, "Substring\0Ignore case\0Regex\0");
+            ImGui::SameLine();
+            ImGui::InputTextWithHintR("Search", view->rdataSearchQuery);
+
+            Span<PEString> entries = view->showAllStrings ? get_strings() : get_rdata_strings();
+            StringIndex& index = get_string_index(view->showAllStrings);
+
+            // Cached by the index, only does work when the query or mode changed since the last frame
+            const std::vector<uint32_t>& matches = index.search(view->rdataSearchQuery, static_cast<SearchMode>(view->searchMode));
+
+            if(index.invalid_query())
+                ImGui::TextDisabled("Invalid regex");
+
+            ImGui::Text("%zu / %zu", matches.size(), entries.size());
+
+            if (ImGui::BeginTable("strings", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, ImVec2(0, list_height(matches.size()))))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("RVA", ImGuiTableColumnFlags_WidthFixed);
+                ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthFixed);
+                ImGui::TableSetupColumn("String", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableHeadersRow();
+
+                // Only the rows in view get formatted, the cost per frame doesn't depend on how many strings matched
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(matches.size()));
+
+                while (clipper.Step())
+                {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+                    {
+                        uint32_t id = matches[row];
+                        const PEString& entry = entries[id];
+                        std::string_view string = index.text(id);
+                        std::string_view section = entry.section >= 0 ? get_section_name(sections[entry.section]) : std::string_view(entry.rva == PE_NO_RVA ? "overlay" : "headers");
+
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("%08" PRIX32, entry.rva);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%.*s", static_cast<int>(section.size()), section.data());
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::TextUnformatted(string.data(), string.data() + string.size());
+                    }
+                }
+
+                ImGui::EndTable();
+            }
+           
+            ImGui::TreePop();
+        }
+    }   
+
+    if(view->showHEX && stage_ready(analysis, PEStage::Sections, "HEX"))
+    {
+        if (ImGui::TreeNode("HEX"))
+        {
+            render_hex();
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showDISASSEMBLY && stage_ready(analysis, PEStage::Sections, "DISASSEMBLY"))
+    {
+        if (ImGui::TreeNode("DISASSEMBLY"))
+        {
+            render_disassembly();
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showENTROPY && stage_ready(analysis, PEStage::Entropy, "ENTROPY"))
+    {
+        if (ImGui::TreeNode("ENTROPY"))
+        {
+            render_entropy();
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showHASHES && stage_ready(analysis, PEStage::Hashes, "HASHES"))
+    {
+        if (ImGui::TreeNode("HASHES"))
+        {
+            render_hashes();
+
+            ImGui::TreePop();
+        }
+    }
+
+    // Scans tag hits through the section lookup the stages build, so they wait for all of them like DIAGNOSTICS
+    if(view->showSIGNATURES && (analysis == nullptr || analysis->finished()))
+    {
+        if (ImGui::TreeNode("SIGNATURES"))
+        {
+            render_signatures();
+
+            ImGui::TreePop();
+        }
+    }
+
+    render_directories();
+
+    // Every stage can add to the list, it's only read once they're all done
+    if(view->showDIAGNOSTICS && (analysis == nullptr || analysis->finished()))
+    {
+        if (ImGui::TreeNode("DIAGNOSTICS"))
+        {
+            Span<PEDiagnostic> entries = get_diagnostics();
+
+            if(entries.empty())
+                ImGui::TextDisabled("No issues found");
+            else
+            {
+                clipped_table("diagnostics", { "Issue", "Field", "Offset", "Value" }, entries.size(), [&](size_t i)
+                {
+                    const PEDiagnostic& entry = entries[i];
+
+                    ImGui::TableSetColumnIndex(0);
+                    if(entry.fatal)
+                        ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", describe_issue(entry.issue));
+                    else
+                        ImGui::Text("%s", describe_issue(entry.issue));
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%s", entry.field);
+                    ImGui::TableSetColumnIndex(2);
+                    if(entry.offset != PE_NO_OFFSET)
+                        ImGui::Text("%016" PRIX64, entry.offset);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%" PRIX64, entry.value);
+                });
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showIMAGE_DOS_HEADER && stage_ready(analysis, PEStage::Headers, "IMAGE_DOS_HEADER"))
+    {
+        if (ImGui::TreeNode("IMAGE_DOS_HEADER"))
+        {
+            if (ImGui::BeginTable("IMAGE_DOS_HEADER", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable)) 
+            {
+                ImGui::TableSetupColumn("Field");
+                ImGui::TableSetupColumn("Value");
+                ImGui::TableHeadersRow();
+
+                EDIT_TABLE_ENTRY("e_magic", offsetof(IMAGE_DOS_HEADER, e_magic), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_cblp", offsetof(IMAGE_DOS_HEADER, e_cblp), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_cp", offsetof(IMAGE_DOS_HEADER, e_cp), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_crlc", offsetof(IMAGE_DOS_HEADER, e_crlc), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_cparhdr", offsetof(IMAGE_DOS_HEADER, e_cparhdr), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_minalloc", offsetof(IMAGE_DOS_HEADER, e_minalloc), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_maxalloc", offsetof(IMAGE_DOS_HEADER, e_maxalloc), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_ss", offsetof(IMAGE_DOS_HEADER, e_ss), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_sp", offsetof(IMAGE_DOS_HEADER, e_sp), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_csum", offsetof(IMAGE_DOS_HEADER, e_csum), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_ip", offsetof(IMAGE_DOS_HEADER, e_ip), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_cs", offsetof(IMAGE_DOS_HEADER, e_cs), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_lfarlc", offsetof(IMAGE_DOS_HEADER, e_lfarlc), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_ovno", offsetof(IMAGE_DOS_HEADER, e_ovno), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_oemid", offsetof(IMAGE_DOS_HEADER, e_oemid), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_oeminfo", offsetof(IMAGE_DOS_HEADER, e_oeminfo), uint16_t, PRIX16);
+                EDIT_TABLE_ENTRY("e_lfanew", offsetof(IMAGE_DOS_HEADER, e_lfanew), uint32_t, PRIX32);
+
+                ImGui::EndTable();
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showIMAGE_FILE_HEADER && stage_ready(analysis, PEStage::Headers, "IMAGE_FILE_HEADER"))
+    {
+        if (ImGui::TreeNode("IMAGE_FILE_HEADER"))
+        {
+            ImGui::Text("%s: %s", "Machine", get_arc_name(nt->FileHeader.Machine));
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showIMAGE_OPTIONAL_HEADER && stage_ready(analysis, PEStage::Headers, "IMAGE_OPTIONAL_HEADER"))
+    {
+        if (ImGui::TreeNode("IMAGE_OPTIONAL_HEADER"))
+        {
+            // Fields are read from the file rather than the widened copy in nt so edits show up. Everything past BaseOfCode
+            // moves between PE32 and PE32+, ImageBase and the stack and heap sizes are 32-bit in PE32.
+            uint64_t optional = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader);
+            bool wide = is_64bit();
+
+#define OPTIONAL_FIELD(name) optional + (wide ? offsetof(IMAGE_OPTIONAL_HEADER64, name) : offsetof(IMAGE_OPTIONAL_HEADER32, name))
+#define OPTIONAL_WIDE_ENTRY(name) if(wide) { EDIT_TABLE_ENTRY(#name, OPTIONAL_FIELD(name), uint64_t, PRIX64) } else { EDIT_TABLE_ENTRY(#name, OPTIONAL_FIELD(name), uint32_t, PRIX32) }
+
+            if (ImGui::BeginTable("IMAGE_OPTIONAL_HEADER", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable)) 
+            {
+                ImGui::TableSetupColumn("Field");
+                ImGui::TableSetupColumn("Value");
+                ImGui::TableHeadersRow();
+
+                NEW_TABLE_ENTRY("Magic", wide ? "PE32+" : "PE32", "s");
+                EDIT_TABLE_ENTRY("AddressOfEntryPoint", OPTIONAL_FIELD(AddressOfEntryPoint), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("BaseOfCode", OPTIONAL_FIELD(BaseOfCode), uint32_t, PRIX32);
+
+                if(!wide)
+                {
+                    EDIT_TABLE_ENTRY("BaseOfData", optional + offsetof(IMAGE_OPTIONAL_HEADER32, BaseOfData), uint32_t, PRIX32);
+                }
+
+                OPTIONAL_WIDE_ENTRY(ImageBase);
+                EDIT_TABLE_ENTRY("SectionAlignment", OPTIONAL_FIELD(SectionAlignment), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("FileAlignment", OPTIONAL_FIELD(FileAlignment), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("SizeOfImage", OPTIONAL_FIELD(SizeOfImage), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("SizeOfHeaders", OPTIONAL_FIELD(SizeOfHeaders), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("CheckSum", OPTIONAL_FIELD(CheckSum), uint32_t, PRIX32);
+                EDIT_TABLE_ENTRY("Subsystem", OPTIONAL_FIELD(Subsystem), uint16_t, PRIu16);
+                EDIT_TABLE_ENTRY("DllCharacteristics", OPTIONAL_FIELD(DllCharacteristics), uint16_t, PRIX16);
+                OPTIONAL_WIDE_ENTRY(SizeOfStackReserve);
+                OPTIONAL_WIDE_ENTRY(SizeOfStackCommit);
+                OPTIONAL_WIDE_ENTRY(SizeOfHeapReserve);
+                OPTIONAL_WIDE_ENTRY(SizeOfHeapCommit);
+                EDIT_TABLE_ENTRY("NumberOfRvaAndSizes", OPTIONAL_FIELD(NumberOfRvaAndSizes), uint32_t, PRIu32);
+
+                ImGui::EndTable();
+            }
+
+#undef OPTIONAL_WIDE_ENTRY
+#undef OPTIONAL_FIELD
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showIMAGE_SECTION_HEADER && stage_ready(analysis, PEStage::Sections, "IMAGE_SECTION_HEADER"))
+    {
+        if (ImGui::TreeNode("IMAGE_SECTION_HEADER"))
+        {
+            ImGui::InputTextWithHintR("Filter", view->sectionFilter);
+
+            if(!view->sectionRowsValid || view->sectionRowsSource != sections.data() || view->sectionRowsFilter != view->sectionFilter)
+            {
+                view->sectionRows.clear();
+
+                for (uint32_t i = 0; i < sections.size(); ++i)
+                {
+                    if(get_section_name(sections[i]).find(view->sectionFilter) != std::string_view::npos)
+                        view->sectionRows.push_back(i);
+                }
+
+                view->sectionRowsFilter = view->sectionFilter;
+                view->sectionRowsSource = sections.data();
+                view->sectionRowsValid = true;
+            }
+
+            if (ImGui::BeginTable("sections", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, ImVec2(0, list_height(view->sectionRows.size()))))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Name");
+                ImGui::TableSetupColumn("VirtualAddress");
+                ImGui::TableSetupColumn("VirtualSize");
+                ImGui::TableSetupColumn("PointerToRawData");
+                ImGui::TableSetupColumn("SizeOfRawData");
+                ImGui::TableSetupColumn("Characteristics");
+                ImGui::TableHeadersRow();
+
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(view->sectionRows.size()));
+
+                while (clipper.Step())
+                {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+                    {
+                        uint32_t index = view->sectionRows[row];
+                        const IMAGE_SECTION_HEADER& section = sections[index];
+                        std::string_view name = get_section_name(section);
+
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::PushID(static_cast<int>(index));
+
+                        std::string label(name);
+                        if (ImGui::Selectable(label.c_str(), view->selectedSection == static_cast<int>(index), ImGuiSelectableFlags_SpanAllColumns))
+                            view->selectedSection = view->selectedSection == static_cast<int>(index) ? -1 : static_cast<int>(index);
+
+                        ImGui::PopID();
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%08" PRIX32, section.VirtualAddress);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%08" PRIX32, section.Misc.VirtualSize);
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%08" PRIX32, section.PointerToRawData);
+                        ImGui::TableSetColumnIndex(4);
+                        ImGui::Text("%08" PRIX32, section.SizeOfRawData);
+                        ImGui::TableSetColumnIndex(5);
+                        ImGui::Text("%08" PRIX32, section.Characteristics);
+                    }
+                }
+
+                ImGui::EndTable();
+            }
+
+            // Full header of the selected section
+            if(view->selectedSection >= 0 && static_cast<size_t>(view->selectedSection) < sections.size())
+            {
+                const IMAGE_SECTION_HEADER& section = sections[view->selectedSection];
+                uint64_t header = uint64_t(dos->e_lfanew) + offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + nt->FileHeader.SizeOfOptionalHeader + view->selectedSection * sizeof(IMAGE_SECTION_HEADER);
+
+                if (ImGui::BeginTable("section", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable)) 
+                {
+                    ImGui::TableSetupColumn("Field");
+                    ImGui::TableSetupColumn("Value");
+                    ImGui::TableHeadersRow();
+
+                    bool is_readonly = (section.Characteristics & IMAGE_SCN_MEM_READ) && !(section.Characteristics & IMAGE_SCN_MEM_WRITE);
+                            
+                    NEW_TABLE_ENTRY("IsReadonly", is_readonly ? "true" : "false", "s");
+                    EDIT_TABLE_ENTRY("VirtualAddress", header + offsetof(IMAGE_SECTION_HEADER, VirtualAddress), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("SizeOfRawData", header + offsetof(IMAGE_SECTION_HEADER, SizeOfRawData), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("PointerToRawData", header + offsetof(IMAGE_SECTION_HEADER, PointerToRawData), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("PointerToRelocations", header + offsetof(IMAGE_SECTION_HEADER, PointerToRelocations), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("PointerToLinenumbers", header + offsetof(IMAGE_SECTION_HEADER, PointerToLinenumbers), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("NumberOfRelocations", header + offsetof(IMAGE_SECTION_HEADER, NumberOfRelocations), uint16_t, PRIu16);
+                    EDIT_TABLE_ENTRY("NumberOfLinenumbers", header + offsetof(IMAGE_SECTION_HEADER, NumberOfLinenumbers), uint16_t, PRIu16);
+                    EDIT_TABLE_ENTRY("Characteristics", header + offsetof(IMAGE_SECTION_HEADER, Characteristics), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("PhysicalAddress", header + offsetof(IMAGE_SECTION_HEADER, Misc), uint32_t, PRIu32);
+                    EDIT_TABLE_ENTRY("VirtualSize", header + offsetof(IMAGE_SECTION_HEADER, Misc), uint32_t, PRIu32);
+
+                    ImGui::EndTable();
+                }
+            }
+
+            ImGui::TreePop();
+        }
+    } 
+}
+void PE::render_hex()
+{
+    PROFILE_SCOPE("PE::render_hex");
+
+    const int visible_rows = 32;
+    const int hex_column = 18;               // "%016X  " offset prefix
+    const int ascii_column = hex_column + 49; // 16 "XX " cells and a separator
+
+    PageCache& cache = get_page_cache();
+    uint64_t last_row = cache.size() == 0 ? 0 : (cache.size() - 1) / 16;
+
+    ImGui::Checkbox("RVA", &view->hexJumpRva);
+    ImGui::SameLine();
+
+    if (ImGui::InputTextWithHintR("Go to (hex)", view->hexJump, ImVec2(0, 0), ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue) && !view->hexJump.empty())
+    {
+        uint64_t value = std::strtoull(view->hexJump.c_str(), nullptr, 16);
+        uint64_t offset = value;
+
+        if(view->hexJumpRva)
+            offset = value <= UINT32_MAX ? rva_to_offset(static_cast<uint32_t>(value)) : PE_NO_OFFSET;
+
+        view->hexJumpFailed = offset >= cache.size();
+        if(!view->hexJumpFailed)
+        {
+            view->hexCursor = offset;
+            view->hexTop = offset / 16;
+        }
+    }
+
+    if(view->hexJumpFailed)
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled(view->hexJumpRva ? "RVA isn't backed by the file" : "Offset is past the end of the file");
+    }
+
+    uint64_t region_start = 0;
+    uint64_t region_end = 0;
+    std::string_view region = describe_offset(view->hexCursor, region_start, region_end);
+    uint32_t rva = offset_to_rva(view->hexCursor);
+
+    ImGui::Text("Offset %016" PRIX64 "  RVA %08" PRIX32 "  %.*s [%" PRIX64 ", %" PRIX64 ")", view->hexCursor, rva, static_cast<int>(region.size()), region.data(), region_start, region_end);
+
+    if(view->hexNibble >= 0)
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("Typing %X_", view->hexNibble);
+    }
+
+    float line = ImGui::GetTextLineHeightWithSpacing();
+    float height = line * visible_rows + ImGui::GetStyle().FramePadding.y * 2;
+    float slider_width = 20;
+
+    ImGui::BeginChild("hex", ImVec2(ImGui::GetContentRegionAvail().x - slider_width - ImGui::GetStyle().ItemSpacing.x, height), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+    {
+        // Scrolling is done in rows rather than pixels, ImGui's float scroll offsets lose row precision on multi-GB files
+        if(ImGui::IsWindowHovered())
+        {
+            float wheel = ImGui::GetIO().MouseWheel;
+            uint64_t step = static_cast<uint64_t>(wheel < 0 ? -wheel * 3 : wheel * 3);
+
+            if(wheel > 0)
+                view->hexTop = view->hexTop > step ? view->hexTop - step : 0;
+            else if(wheel < 0)
+                view->hexTop = std::min(view->hexTop + step, last_row);
+        }
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float char_width = ImGui::CalcTextSize("0").x;
+        ImDrawList* draw = ImGui::GetWindowDrawList();
+
+        // Only the visible rows are read, through the page cache until something is edited
+        uint8_t bytes[16];
+        char text[96];
+        bool edited = patches != nullptr && patches->modified();
+        std::vector<PatchLayer::Range> ranges;
+        if(edited)
+            ranges = patches->modified_ranges();
+
+        for (int row = 0; row < visible_rows && view->hexTop + row <= last_row; ++row)
+        {
+            uint64_t offset = (view->hexTop + row) * 16;
+            uint64_t count = edited ? patches->read(offset, bytes, sizeof(bytes)) : cache.read(offset, bytes, sizeof(bytes));
+
+            int length = std::snprintf(text, sizeof(text), "%016" PRIX64 "  ", offset);
+            for (uint64_t i = 0; i < 16; ++i)
+                length += i < count ? std::snprintf(text + length, sizeof(text) - length, "%02X ", bytes[i]) : std::snprintf(text + length, sizeof(text) - length, "   ");
+
+            text[length++] = ' ';
+            for (uint64_t i = 0; i < count; ++i)
+                text[length++] = bytes[i] >= 0x20 && bytes[i] < 0x7F ? static_cast<char>(bytes[i]) : '.';
+
+            text[length] = '\0';
+
+            float y = origin.y + row * line;
+
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                uint64_t position = offset + i;
+                auto range = std::upper_bound(ranges.begin(), ranges.end(), position, [](uint64_t value, const PatchLayer::Range& r) { return value < r.offset; });
+                bool changed = range != ranges.begin() && position - std::prev(range)->offset < std::prev(range)->length;
+
+                ImU32 color;
+                if(position == view->hexCursor)
+                    color = IM_COL32(220, 160, 40, 160);
+                else if(changed)
+                    color = IM_COL32(200, 70, 70, 110);
+                else if(position >= region_start && position < region_end)
+                    color = IM_COL32(70, 110, 160, 90);
+                else
+                    continue;
+
+                float hex_x = origin.x + (hex_column + i * 3) * char_width;
+                float ascii_x = origin.x + (ascii_column + i) * char_width;
+
+                draw->AddRectFilled(ImVec2(hex_x, y), ImVec2(hex_x + char_width * 2, y + line), color);
+                draw->AddRectFilled(ImVec2(ascii_x, y), ImVec2(ascii_x + char_width, y + line), color);
+            }
+
+            ImGui::TextUnformatted(text, text + length);
+        }
+
+        // Clicking a byte in either column moves the cursor
+        if(ImGui::IsWindowHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+        {
+            ImVec2 mouse = ImGui::GetMousePos();
+            int row = static_cast<int>((mouse.y - origin.y) / line);
+            int column = static_cast<int>((mouse.x - origin.x) / char_width);
+
+            int byte = -1;
+            if(column >= hex_column && column < hex_column + 48)
+                byte = (column - hex_column) / 3;
+            else if(column >= ascii_column && column < ascii_column + 16)
+                byte = column - ascii_column;
+
+            uint64_t position = (view->hexTop + row) * 16 + byte;
+            if(row >= 0 && byte >= 0 && position < cache.size())
+            {
+                view->hexCursor = position;
+                view->hexNibble = -1;
+            }
+        }
+
+        // Hex digits typed while the view has focus overwrite the byte under the cursor, a byte at a time so each one is a
+        // single undo step
+        if(patches != nullptr && ImGui::IsWindowFocused())
+        {
+            ImGuiIO& io = ImGui::GetIO();
+
+            for (int i = 0; i < io.InputQueueCharacters.Size; ++i)
+            {
+                ImWchar c = io.InputQueueCharacters[i];
+                int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+
+                if(digit < 0 || view->hexCursor >= cache.size())
+                    continue;
+
+                if(view->hexNibble < 0)
+                {
+                    view->hexNibble = digit;
+                    continue;
+                }
+
+                uint8_t value = static_cast<uint8_t>(view->hexNibble << 4 | digit);
+                patches->write(view->hexCursor, &value, 1);
+                view->hexNibble = -1;
+
+                if(view->hexCursor + 1 < cache.size())
+                    ++view->hexCursor;
+
+                // Keep the cursor on screen while typing
+                if(view->hexCursor / 16 >= view->hexTop + visible_rows)
+                    view->hexTop = view->hexCursor / 16 - visible_rows + 1;
+            }
+        }
+
+        ImGui::EndChild();
+    }
+
+    ImGui::SameLine();
+
+    // Top of the slider is the start of the file
+    uint64_t inverted = last_row - std::min(view->hexTop, last_row);
+    uint64_t zero = 0;
+
+    if (ImGui::VSliderScalar("##rows", ImVec2(slider_width, height), ImGuiDataType_U64, &inverted, &zero, &last_row, ""))
+        view->hexTop = last_row - inverted;
+}
+
+// Moves the disassembly to the code section holding address, false if no executable section maps it
+static bool disasm_jump(PE& pe, PEViewState* view, uint64_t address)
+{
+    uint64_t base = pe.get_image_base();
+    if(address < base || address - base > UINT32_MAX)
+        return false;
+
+    int32_t section = pe.get_section_by_rva(static_cast<uint32_t>(address - base));
+    Disassembly* disassembly = pe.get_disassembly(section);
+    if(disassembly == nullptr || address - disassembly->address() >= disassembly->size())
+        return false;
+
+    view->disasmSection = section;
+    view->disasmSource = disassembly;
+    view->disasmTop = disassembly->locate(address);
+    view->disasmSelected = disassembly->address_of(view->disasmTop);
+
+    return true;
+}
+
+void PE::render_disassembly()
+{
+    const int visible_rows = 32;
+
+    if(!is_x86())
+    {
+        ImGui::TextDisabled("Only x86 and x64 images can be disassembled");
+        return;
+    }
+
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    uint64_t entry_point = get_image_base() + get_nt()->OptionalHeader.AddressOfEntryPoint;
+
+    // Opens at the entry point, or the first code section when the entry point isn't in one
+    Disassembly* disassembly = get_disassembly(view->disasmSection);
+    if(disassembly == nullptr || disassembly != view->disasmSource)
+    {
+        if(!disasm_jump(*this, view, entry_point))
+        {
+            for (uint32_t i = 0; i < all.size(); ++i)
+            {
+                if(get_disassembly(i) != nullptr && disasm_jump(*this, view, get_disassembly(i)->address()))
+                    break;
+            }
+        }
+
+        disassembly = get_disassembly(view->disasmSection);
+        if(disassembly == nullptr || disassembly != view->disasmSource)
+        {
+            ImGui::TextDisabled("No executable sections");
+            return;
+        }
+    }
+
+    std::string_view current = get_section_name(all[view->disasmSection]);
+    std::string preview(current);
+
+    ImGui::SetNextItemWidth(160);
+    if (ImGui::BeginCombo("Section", preview.c_str()))
+    {
+        for (uint32_t i = 0; i < all.size(); ++i)
+        {
+            Disassembly* candidate = get_disassembly(i);
+            if(candidate == nullptr)
+                continue;
+
+            std::string name(get_section_name(all[i]));
+            if (ImGui::Selectable(name.c_str(), int32_t(i) == view->disasmSection))
+                disasm_jump(*this, view, candidate->address());
+        }
+
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Entry point"))
+        view->disasmJumpFailed = !disasm_jump(*this, view, entry_point);
+
+    ImGui::SameLine();
+    if (ImGui::InputTextWithHintR("Go to VA (hex)", view->disasmJump, ImVec2(0, 0), ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue) && !view->disasmJump.empty())
+        view->disasmJumpFailed = !disasm_jump(*this, view, std::strtoull(view->disasmJump.c_str(), nullptr, 16));
+
+    if(view->disasmJumpFailed)
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("Address isn't in an executable section");
+    }
+
+    // A jump can land in another section
+    disassembly = get_disassembly(view->disasmSection);
+
+    float line = ImGui::GetTextLineHeightWithSpacing();
+    float height = line * visible_rows + ImGui::GetStyle().FramePadding.y * 2;
+    float slider_width = 20;
+
+    X86Instruction instruction;
+    uint8_t bytes[16];
+    std::string text;
+    char row_text[192];
+
+    ImGui::BeginChild("disassembly", ImVec2(ImGui::GetContentRegionAvail().x - slider_width - ImGui::GetStyle().ItemSpacing.x, height), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+    {
+        // Scrolling is by instruction, only the blocks around the visible rows ever get decoded
+        if(ImGui::IsWindowHovered())
+        {
+            float wheel = ImGui::GetIO().MouseWheel;
+            int steps = static_cast<int>(wheel < 0 ? -wheel * 3 : wheel * 3);
+
+            for (int i = 0; i < steps; ++i)
+            {
+                if(!(wheel > 0 ? disassembly->prev(view->disasmTop) : disassembly->next(view->disasmTop)))
+                    break;
+            }
+        }
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImDrawList* draw = ImGui::GetWindowDrawList();
+        float width = ImGui::GetContentRegionAvail().x;
+
+        Disassembly::Position position = view->disasmTop;
+        uint64_t row_addresses[visible_rows];
+        uint64_t row_targets[visible_rows];
+        int rows = 0;
+
+        for (; rows < visible_rows; ++rows)
+        {
+            uint64_t address = disassembly->address_of(position);
+            disassembly->instruction(position, instruction, bytes);
+            x86_format(instruction, address, text);
+
+            int length = std::snprintf(row_text, sizeof(row_text), "%016" PRIX64 "  ", address);
+            for (int i = 0; i < 10; ++i)
+                length += i < instruction.length ? std::snprintf(row_text + length, sizeof(row_text) - length, "%02X ", bytes[i]) : std::snprintf(row_text + length, sizeof(row_text) - length, "   ");
+
+            length += std::snprintf(row_text + length, sizeof(row_text) - length, "%s %s", instruction.length > 10 ? ".." : "  ", text.c_str());
+
+            row_addresses[rows] = address;
+            row_targets[rows] = x86_branch_target(instruction, address);
+
+            float y = origin.y + rows * line;
+            if(address == view->disasmSelected)
+                draw->AddRectFilled(ImVec2(origin.x, y), ImVec2(origin.x + width, y + line), IM_COL32(220, 160, 40, 90));
+            else if(address == entry_point)
+                draw->AddRectFilled(ImVec2(origin.x, y), ImVec2(origin.x + width, y + line), IM_COL32(70, 160, 90, 90));
+
+            ImGui::TextUnformatted(row_text, row_text + std::min<int>(length, sizeof(row_text) - 1));
+
+            if(!disassembly->next(position))
+            {
+                ++rows;
+                break;
+            }
+        }
+
+        // Click selects a row, double click follows a branch
+        if(ImGui::IsWindowHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+        {
+            int row = static_cast<int>((ImGui::GetMousePos().y - origin.y) / line);
+            if(row >= 0 && row < rows)
+            {
+                view->disasmSelected = row_addresses[row];
+
+                if(ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left) && row_targets[row] != 0)
+                    view->disasmJumpFailed = !disasm_jump(*this, view, row_targets[row]);
+            }
+        }
+
+        ImGui::EndChild();
+    }
+
+    ImGui::SameLine();
+
+    // The slider works in bytes of the section, landing on whichever instruction covers that byte
+    uint64_t last = disassembly->size() > 0 ? disassembly->size() - 1 : 0;
+    uint64_t top = disassembly->address_of(view->disasmTop) - disassembly->address();
+    uint64_t inverted = last - std::min(top, last);
+    uint64_t zero = 0;
+
+    if (ImGui::VSliderScalar("##instructions", ImVec2(slider_width, height), ImGuiDataType_U64, &inverted, &zero, &last, ""))
+        view->disasmTop = disassembly->locate(disassembly->address() + (last - inverted));
+}
+
+static void text_view(std::string_view text)
+{
+    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+}
+
+// Directories are only parsed once their panel is open
+void PE::render_directories()
+{
+    if(view->showIMPORTS && stage_ready(analysis, PEStage::Directories, "IMPORTS"))
+    {
+        if (ImGui::TreeNode("IMPORTS"))
+        {
+            for (const PEImport& import : get_imports())
+            {
+                if (ImGui::TreeNode(&import, "%.*s%s (%zu)", static_cast<int>(import.dll.size()), import.dll.data(), import.delayed ? " [delay]" : "", import.functions.size()))
+                {
+                    clipped_table("functions", { "Name", "Hint/Ordinal", "IAT" }, import.functions.size(), [&](size_t i)
+                    {
+                        const PEImportFunction& function = import.functions[i];
+
+                        ImGui::TableSetColumnIndex(0);
+                        if(function.by_ordinal)
+                            ImGui::Text("#%" PRIu16, function.hint);
+                        else
+                            text_view(function.name);
+
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%" PRIu16, function.hint);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%08" PRIX32, function.iat_rva);
+                    });
+
+                    ImGui::TreePop();
+                }
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showEXPORTS && stage_ready(analysis, PEStage::Directories, "EXPORTS"))
+    {
+        if (ImGui::TreeNode("EXPORTS"))
+        {
+            const PEExports& exported = get_exports();
+
+            ImGui::Text("%.*s, ordinal base %" PRIu32, static_cast<int>(exported.dll.size()), exported.dll.data(), exported.ordinal_base);
+
+            clipped_table("exports", { "Ordinal", "RVA", "Name", "Forwarder" }, exported.functions.size(), [&](size_t i)
+            {
+                const PEExport& entry = exported.functions[i];
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%" PRIu32, entry.ordinal);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%08" PRIX32, entry.rva);
+                ImGui::TableSetColumnIndex(2);
+                text_view(entry.name);
+                ImGui::TableSetColumnIndex(3);
+                text_view(entry.forwarder);
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showRESOURCES && stage_ready(analysis, PEStage::Directories, "RESOURCES"))
+    {
+        if (ImGui::TreeNode("RESOURCES"))
+        {
+            render_resources();
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showRELOCATIONS && stage_ready(analysis, PEStage::Directories, "RELOCATIONS"))
+    {
+        if (ImGui::TreeNode("RELOCATIONS"))
+        {
+            Span<PERelocationBlock> blocks = get_relocations();
+
+            clipped_table("relocations", { "Page RVA", "Entries" }, blocks.size(), [&](size_t i)
+            {
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%08" PRIX32, blocks[i].page_rva);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%zu", blocks[i].entries.size());
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showTLS && stage_ready(analysis, PEStage::Directories, "TLS"))
+    {
+        if (ImGui::TreeNode("TLS"))
+        {
+            const PETls& directory = get_tls();
+
+            if(!directory.present)
+                ImGui::TextDisabled("No TLS directory");
+            else if (ImGui::BeginTable("TLS", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable))
+            {
+                ImGui::TableSetupColumn("Field");
+                ImGui::TableSetupColumn("Value");
+                ImGui::TableHeadersRow();
+
+                NEW_TABLE_ENTRY("StartAddressOfRawData", directory.start, PRIX64);
+                NEW_TABLE_ENTRY("EndAddressOfRawData", directory.end, PRIX64);
+                NEW_TABLE_ENTRY("AddressOfIndex", directory.index, PRIX64);
+                NEW_TABLE_ENTRY("AddressOfCallBacks", directory.callbacks_va, PRIX64);
+                NEW_TABLE_ENTRY("SizeOfZeroFill", directory.zero_fill, PRIu32);
+                NEW_TABLE_ENTRY("Characteristics", directory.characteristics, PRIX32);
+
+                for (uint64_t callback : directory.callbacks)
+                {
+                    NEW_TABLE_ENTRY("Callback", callback, PRIX64);
+                }
+
+                ImGui::EndTable();
+            }
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showDEBUG && stage_ready(analysis, PEStage::Directories, "DEBUG"))
+    {
+        if (ImGui::TreeNode("DEBUG"))
+        {
+            Span<PEDebugEntry> entries = get_debug_entries();
+
+            clipped_table("debug", { "Type", "TimeDateStamp", "SizeOfData", "PointerToRawData", "PDB" }, entries.size(), [&](size_t i)
+            {
+                const PEDebugEntry& entry = entries[i];
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%" PRIu32, entry.directory->Type);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%08" PRIX32, entry.directory->TimeDateStamp);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%" PRIu32, entry.directory->SizeOfData);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%08" PRIX32, entry.directory->PointerToRawData);
+                ImGui::TableSetColumnIndex(4);
+                text_view(entry.pdb_path);
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showEXCEPTIONS && stage_ready(analysis, PEStage::Directories, "EXCEPTIONS"))
+    {
+        if (ImGui::TreeNode("EXCEPTIONS"))
+        {
+            Span<IMAGE_RUNTIME_FUNCTION_ENTRY> entries = get_exception_entries();
+
+            clipped_table("exceptions", { "Begin", "End", "UnwindInfo" }, entries.size(), [&](size_t i)
+            {
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%08" PRIX32, entries[i].BeginAddress);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%08" PRIX32, entries[i].EndAddress);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%08" PRIX32, entries[i].UnwindInfoAddress);
+            });
+
+            ImGui::TreePop();
+        }
+    }
+
+    if(view->showPAYLOADS && stage_ready(analysis, PEStage::Payloads, "PAYLOADS"))
+    {
+        if (ImGui::TreeNode("PAYLOADS"))
+        {
+            render_payloads();
+
+            ImGui::TreePop();
+        }
+    }
+}
+
+// Opens or closes the directory at row, its entries go right below it
+static void toggle_resource_row(PE& pe, std::vector<PEResourceRow>& rows, size_t row)
+{
+    PEResourceRow parent = rows[row];
+
+    if(parent.expanded)
+    {
+        size_t end = row + 1;
+        while(end < rows.size() && rows[end].depth > parent.depth)
+            ++end;
+
+        rows.erase(rows.begin() + row + 1, rows.begin() + end);
+        rows[row].expanded = false;
+
+        return;
+    }
+
+    PEResourceNode node;
+    if(!pe.get_resource_entry(parent.directory, parent.index, node) || !node.directory)
+        return;
+
+    // Entries aren't read here, only the rows that end up on screen are
+    PEResourceRow child = { node.offset, 0, parent.depth == 0 ? node.id : parent.type, parent.depth == 1 ? node.id : parent.name, static_cast<uint8_t>(parent.depth + 1), false };
+    uint32_t count = pe.get_resource_entry_count(node.offset);
+
+    std::vector<PEResourceRow> children(count, child);
+    for (uint32_t i = 0; i < count; ++i)
+        children[i].index = i;
+
+    rows.insert(rows.begin() + row + 1, children.begin(), children.end());
+    rows[row].expanded = true;
+}
+
+static std::string resource_label(const PEResourceNode& node, uint8_t depth)
+{
+    if(!node.name.empty())
+        return node.name;
+
+    char label[64];
+    const char* type = depth == 0 ? PE::get_resource_type_name(node.id) : nullptr;
+
+    if(type != nullptr)
+        std::snprintf(label, sizeof(label), "%s", type);
+    else if(depth == 2)
+        std::snprintf(label, sizeof(label), "Language %" PRIu32, node.id);
+    else
+        std::snprintf(label, sizeof(label), "#%" PRIu32, node.id);
+
+    return label;
+}
+
+static void render_resource_content(PEViewState* view, const std::shared_ptr<const PEResourceContent>& content)
+{
+    if(!content->error.empty())
+        ImGui::TextDisabled("%s", content->error.c_str());
+
+    switch (content->kind)
+    {
+        case PEResourceKind::VersionInfo:
+        {
+            auto version = [](uint64_t value) { return std::to_string(value >> 48) + "." + std::to_string((value >> 32) & 0xFFFF) + "." + std::to_string((value >> 16) & 0xFFFF) + "." + std::to_string(value & 0xFFFF); };
+
+            ImGui::Text("File version %s, product version %s, flags %08" PRIX32, version(content->file_version).c_str(), version(content->product_version).c_str(), content->file_flags);
+
+            clipped_table("version strings", { "Table", "Key", "Value" }, content->version_strings.size(), [&](size_t i)
+            {
+                const PEVersionString& entry = content->version_strings[i];
+
+                ImGui::TableSetColumnIndex(0);
+                text_view(entry.table);
+                ImGui::TableSetColumnIndex(1);
+                text_view(entry.key);
+                ImGui::TableSetColumnIndex(2);
+                text_view(entry.value);
+            });
+            break;
+        }
+        case PEResourceKind::Manifest:
+        {
+            size_t lines = std::count(content->text.begin(), content->text.end(), '\n') + 1;
+
+            ImGui::BeginChild("manifest", ImVec2(0, list_height(lines)), true, ImGuiWindowFlags_HorizontalScrollbar);
+            text_view(content->text);
+            ImGui::EndChild();
+            break;
+        }
+        case PEResourceKind::StringTable:
+            clipped_table("resource strings", { "ID", "Text" }, content->strings.size(), [&](size_t i)
+            {
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%" PRIu32, content->strings[i].first);
+                ImGui::TableSetColumnIndex(1);
+                text_view(content->strings[i].second);
+            });
+            break;
+        case PEResourceKind::Image:
+        {
+            // Uploaded once per decoded image, not every frame
+            if(view->resourceShown != content)
+            {
+                view->resourceShown = content;
+                view->resourceTexture = create_texture(content->image.rgba.data(), content->image.width, content->image.height);
+            }
+
+            // Small icons are scaled up by whole steps
+            uint32_t largest = std::max(content->image.width, content->image.height);
+            float scale = largest < 64 ? static_cast<float>(64 / largest) : 1.0f;
+
+            ImGui::Text("%" PRIu32 " x %" PRIu32, content->image.width, content->image.height);
+            ImGui::Image(texture_id(view->resourceTexture), ImVec2(content->image.width * scale, content->image.height * scale));
+            break;
+        }
+        case PEResourceKind::IconGroup:
+            clipped_table("icon group", { "ID", "Size", "Bits", "Bytes" }, content->icons.size(), [&](size_t i)
+            {
+                const PEIconGroupEntry& icon = content->icons[i];
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%" PRIu16, icon.id);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%" PRIu32 " x %" PRIu32, icon.width, icon.height);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%" PRIu16, icon.bit_count);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%" PRIu32, icon.size);
+            });
+            break;
+        default:
+            break;
+    }
+}
+
+// Type, name and language levels as one tree, walked as it's expanded, with the selected entry decoded under it
+void PE::render_resources()
+{
+    PROFILE_SCOPE("PE::render_resources");
+
+    if(!view->resourceRowsBuilt)
+    {
+        view->resourceRowsBuilt = true;
+        view->resourceRows.clear();
+
+        uint32_t count = get_resource_entry_count(0);
+        for (uint32_t i = 0; i < count; ++i)
+            view->resourceRows.push_back({ 0, i, 0, 0, 0, false });
+    }
+
+    if(view->resourceRows.empty())
+    {
+        ImGui::TextDisabled("No resources");
+        return;
+    }
+
+    size_t toggle = SIZE_MAX;
+    float indent = ImGui::GetStyle().IndentSpacing;
+
+    clipped_table("resource tree", { "Entry", "RVA", "Size", "CodePage" }, view->resourceRows.size(), [&](size_t i)
+    {
+        const PEResourceRow& row = view->resourceRows[i];
+
+        PEResourceNode node;
+        if(!get_resource_entry(row.directory, row.index, node))
+            return;
+
+        ImGui::TableSetColumnIndex(0);
+        ImGui::PushID(static_cast<int>(i));
+        if(row.depth > 0)
+            ImGui::Indent(indent * row.depth);
+
+        std::string label = resource_label(node, row.depth);
+
+        // Anything deeper than the language level is malformed, it also stops directories that point at themselves
+        if(node.directory && row.depth < 2)
+        {
+            ImGui::SetNextItemOpen(row.expanded, ImGuiCond_Always);
+            if (ImGui::TreeNodeEx(label.c_str(), ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanFullWidth) != row.expanded)
+                toggle = i;
+        }
+        else if(node.directory)
+            ImGui::TextDisabled("%s (nested too deep)", label.c_str());
+        else
+        {
+            bool selected = node.offset == view->resourceOffset;
+            ImGui::TreeNodeEx(label.c_str(), ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_SpanFullWidth | (selected ? ImGuiTreeNodeFlags_Selected : 0));
+
+            if (ImGui::IsItemClicked())
+            {
+                view->resourceOffset = node.offset;
+                view->resourceType = row.depth == 0 ? node.id : row.type;
+                view->resourceName = row.depth == 1 ? node.id : row.name;
+            }
+
+            IMAGE_RESOURCE_DATA_ENTRY data;
+            if(get_resource_data(node.offset, data))
+            {
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%08" PRIX32, data.OffsetToData);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%" PRIu32, data.Size);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%" PRIu32, data.CodePage);
+            }
+        }
+
+        if(row.depth > 0)
+            ImGui::Unindent(indent * row.depth);
+        ImGui::PopID();
+    });
+
+    // After the table, the rows can move
+    if(toggle != SIZE_MAX)
+        toggle_resource_row(*this, view->resourceRows, toggle);
+
+    IMAGE_RESOURCE_DATA_ENTRY data;
+    if(view->resourceOffset == UINT32_MAX || !get_resource_data(view->resourceOffset, data))
+        return;
+
+    const char* type = get_resource_type_name(view->resourceType);
+    ImGui::Text("%s #%" PRIu32 ", %" PRIu32 " bytes at RVA %08" PRIX32, type != nullptr ? type : "Type", view->resourceName, data.Size, data.OffsetToData);
+
+    uint64_t offset = rva_to_offset(data.OffsetToData);
+    if(offset != PE_NO_OFFSET)
+    {
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Show in hex"))
+        {
+            view->showHEX = true;
+            view->hexCursor = offset;
+            view->hexTop = offset / 16;
+        }
+    }
+
+    render_resource_content(view, decode_resource(view->resourceType, view->resourceName, data.OffsetToData, data.Size));
+}
+
+void PE::render_payloads()
+{
+    auto show_in_hex = [this](uint64_t offset)
+    {
+        view->showHEX = true;
+        view->hexCursor = offset;
+        view->hexTop = offset / 16;
+    };
+
+    PEOverlay overlay = get_overlay();
+
+    if(overlay.size == 0)
+        ImGui::TextDisabled("No overlay");
+    else
+    {
+        ImGui::Text("Overlay at %08" PRIX64 ", %" PRIu64 " bytes", overlay.offset, overlay.size);
+
+        if(overlay.certificates != 0)
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(%" PRIu64 " of them certificates)", overlay.certificates);
+        }
+
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Show in hex"))
+            show_in_hex(overlay.offset);
+    }
+
+    Span<CarvedPayload> found = get_payloads();
+    if(found.empty())
+    {
+        ImGui::TextDisabled("No embedded files");
+        return;
+    }
+
+    clipped_table("payloads", { "Type", "Offset", "Size", "In", "" }, found.size(), [&](size_t i)
+    {
+        const CarvedPayload& payload = found[i];
+
+        uint64_t start = 0;
+        uint64_t end = source_.size();
+        std::string_view in = describe_offset(payload.offset, start, end);
+
+        ImGui::PushID(static_cast<int>(i));
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("%s", payload_kind_name(payload.kind));
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%08" PRIX64, payload.offset);
+        ImGui::TableSetColumnIndex(2);
+        // Without a size in the headers (or past the end of the file) it runs up to the next payload
+        ImGui::Text("%" PRIu64 "%s", payload.size, payload.exact ? "" : " (estimated)");
+        ImGui::TableSetColumnIndex(3);
+        ImGui::Text("%.*s", static_cast<int>(in.size()), in.data());
+        ImGui::TableSetColumnIndex(4);
+
+        if (ImGui::SmallButton("Hex"))
+            show_in_hex(payload.offset);
+
+        // The workspace opens its carved extent from the mapping of this file once the frame is drawn, formats without a
+        // backend as raw bytes
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Open"))
+        {
+            view->openOffset = payload.offset;
+            view->openSize = payload.size;
+            view->openLabel = payload_kind_name(payload.kind);
+        }
+
+        // Installers read what they unpack from the data after their own image, it only comes along as the overlay when
+        // asked for
+        if(payload.kind == PayloadKind::PE && payload.size < source_.size() - payload.offset)
+        {
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Open with trailing data"))
+            {
+                view->openOffset = payload.offset;
+                view->openSize = source_.size() - payload.offset;
+                view->openLabel = "PE with trailing data";
+            }
+        }
+
+        ImGui::PopID();
+    });
+}
+
+void PE::render_entropy()
+{
+    const PEEntropy& result = get_entropy();
+
+    ImGui::Text("File %.4f bits/byte over %" PRIu64 " bytes", result.file.entropy(), result.file.total);
+
+    if(!result.profile.empty())
+    {
+        char overlay[96];
+        std::snprintf(overlay, sizeof(overlay), "%" PRIu64 " byte windows every %" PRIu64 " bytes", result.window, result.step);
+
+        ImGui::PlotLines("##profile", result.profile.data(), static_cast<int>(result.profile.size()), 0, overlay, 0.0f, 8.0f, ImVec2(-1, 120));
+
+        // The plot doesn't report which point was clicked, map the mouse back onto the windows and open it in the hex view
+        if(ImGui::IsItemClicked())
+        {
+            ImVec2 min = ImGui::GetItemRectMin();
+            ImVec2 max = ImGui::GetItemRectMax();
+            float t = max.x > min.x ? (ImGui::GetMousePos().x - min.x) / (max.x - min.x) : 0.0f;
+
+            size_t point = std::min(result.profile.size() - 1, static_cast<size_t>(std::max(0.0f, t) * result.profile.size()));
+
+            view->hexCursor = point * result.step;
+            view->hexTop = view->hexCursor / 16;
+            view->showHEX = true;
+        }
+
+        ImGui::TextDisabled("Click the profile to open that offset in the hex view");
+    }
+
+    float counts[256];
+    for (int i = 0; i < 256; ++i)
+        counts[i] = static_cast<float>(result.file.counts[i]);
+
+    ImGui::PlotHistogram("##histogram", counts, 256, 0, "Byte values 00-FF", 0.0f, 3.4e38f, ImVec2(-1, 120));
+
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    size_t rows = std::min(all.size(), result.sections.size());
+
+    clipped_table("entropy_sections", { "Section", "Raw size", "Entropy" }, rows, [&](size_t i)
+    {
+        float value = static_cast<float>(result.sections[i].entropy());
+
+        ImGui::TableSetColumnIndex(0);
+        std::string_view name = get_section_name(all[i]);
+        ImGui::Text("%.*s", static_cast<int>(name.size()), name.data());
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%" PRIu64, result.sections[i].total);
+        ImGui::TableSetColumnIndex(2);
+
+        char label[32];
+        std::snprintf(label, sizeof(label), value > highEntropy ? "%.4f packed?" : "%.4f", value);
+
+        if(value > highEntropy)
+            ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.85f, 0.25f, 0.2f, 1.0f));
+
+        ImGui::ProgressBar(value / 8.0f, ImVec2(-1, 0), label);
+
+        if(value > highEntropy)
+            ImGui::PopStyleColor();
+    });
+}
+
+// Digest cell, clicking it copies the hex
+static void digest_cell(const uint8_t* digest, size_t size)
+{
+    std::string hex = digest_hex(digest, size);
+
+    ImGui::PushID(digest);
+    if (ImGui::Selectable(hex.c_str()))
+        ImGui::SetClipboardText(hex.c_str());
+    ImGui::PopID();
+}
+
+void PE::render_hashes()
+{
+    const PEHashes& result = get_hashes();
+
+    if (ImGui::BeginTable("hashes", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable))
+    {
+        ImGui::TableSetupColumn("Digest");
+        ImGui::TableSetupColumn("Value (click to copy)");
+        ImGui::TableHeadersRow();
+
+        auto row = [](const char* name, const uint8_t* digest, size_t size)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", name);
+            ImGui::TableSetColumnIndex(1);
+            digest_cell(digest, size);
+        };
+
+        row("MD5", result.md5, sizeof(result.md5));
+        row("SHA-1", result.sha1, sizeof(result.sha1));
+        row("SHA-256", result.sha256, sizeof(result.sha256));
+        row("Authenticode SHA-256", result.authenticode, sizeof(result.authenticode));
+
+        if(result.has_imphash)
+            row("Imphash", result.imphash, sizeof(result.imphash));
+
+        ImGui::EndTable();
+    }
+
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+    size_t rows = std::min(all.size(), result.sections.size());
+
+    clipped_table("section_hashes", { "Section", "MD5", "SHA-256" }, rows, [&](size_t i)
+    {
+        ImGui::TableSetColumnIndex(0);
+        std::string_view name = get_section_name(all[i]);
+        ImGui::Text("%.*s", static_cast<int>(name.size()), name.data());
+        ImGui::TableSetColumnIndex(1);
+        digest_cell(result.sections[i].md5, sizeof(result.sections[i].md5));
+        ImGui::TableSetColumnIndex(2);
+        digest_cell(result.sections[i].sha256, sizeof(result.sections[i].sha256));
+    });
+}
+
+void PE::start_signature_scan(std::shared_ptr<const SignatureSet> signatures, int32_t section)
+{
+    uint64_t total = source_.size();
+    if(section >= 0)
+    {
+        uint64_t offset = std::min<uint64_t>(sections[section].PointerToRawData, total);
+        total = std::min<uint64_t>(sections[section].SizeOfRawData, total - offset);
+    }
+
+    signature_scan = std::make_unique<BackgroundAnalysis>(pool != nullptr ? *pool : ThreadPool::shared());
+    BackgroundAnalysis& scan = *signature_scan;
+
+    // The stage keeps the rules alive, loading others while it runs doesn't pull them away
+    signature_scan->start({ { "Signatures", [this, &scan, signatures, section, total]() -> const char*
+    {
+        scan.set_total(0, total);
+        signature_hits = scan_signatures(*signatures, section, &scan.cancel_flag(), &scan.done_counter(0));
+
+        std::vector<SignatureMatch> matches;
+        matches.reserve(signature_hits.size());
+        for (const PESignatureMatch& hit : signature_hits)
+            matches.push_back(hit.match);
+
+        signature_rules.clear();
+        for (uint32_t rule : signatures->matched_rules(matches))
+        {
+            if(!signature_rules.empty())
+                signature_rules += ", ";
+
+            signature_rules += signatures->rules()[rule].name;
+        }
+
+        return nullptr;
+    }}});
+}
+
+void PE::render_signatures()
+{
+    bool load = ImGui::InputTextWithHintR("Rules file", view->rulesPath, ImVec2(0, 0), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    load |= ImGui::Button("Load");
+
+    if(load && !view->rulesPath.empty())
+    {
+        auto signatures = std::make_shared<SignatureSet>();
+
+        // Hits of the old rules shouldn't land after the new ones are loaded
+        signature_scan.reset();
+
+        view->rulesError.clear();
+        if(signatures->load(view->rulesPath, view->rulesError) && signatures->compile(view->rulesError))
+            view->signatures = std::move(signatures);
+
+        view->signatureHits.clear();
+        view->signatureRules.clear();
+        view->signaturesScanned = false;
+    }
+
+    if(!view->rulesError.empty())
+        ImGui::TextColored(ImVec4(0.9f, 0.3f, 0.3f, 1.0f), "%s", view->rulesError.c_str());
+
+    if(view->signatures == nullptr)
+    {
+        ImGui::TextDisabled("Load a YARA-style rule file to scan with");
+        return;
+    }
+
+    const SignatureSet& signatures = *view->signatures;
+    Span<IMAGE_SECTION_HEADER> all = get_sections();
+
+    if(view->signatureScope >= static_cast<int32_t>(all.size()))
+        view->signatureScope = -1;
+
+    std::string preview = view->signatureScope >= 0 ? std::string(get_section_name(all[view->signatureScope])) : "Whole file";
+
+    ImGui::SetNextItemWidth(160);
+    if (ImGui::BeginCombo("Scope", preview.c_str()))
+    {
+        if (ImGui::Selectable("Whole file", view->signatureScope < 0))
+            view->signatureScope = -1;
+
+        for (uint32_t i = 0; i < all.size(); ++i)
+        {
+            std::string name(get_section_name(all[i]));
+
+            ImGui::PushID(static_cast<int>(i));
+            if (ImGui::Selectable(name.c_str(), int32_t(i) == view->signatureScope))
+                view->signatureScope = static_cast<int32_t>(i);
+            ImGui::PopID();
+        }
+
+        ImGui::EndCombo();
+    }
+
+    bool scanning = signature_scan != nullptr && !signature_scan->finished();
+
+    ImGui::SameLine();
+    ImGui::BeginDisabled(scanning);
+    if (ImGui::Button("Scan"))
+        start_signature_scan(view->signatures, view->signatureScope);
+    ImGui::EndDisabled();
+
+    if(scanning)
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel"))
+            signature_scan->cancel();
+    }
+
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu rules, %zu strings, %zu states (%s)", signatures.rules().size(), signatures.patterns().size(), signatures.state_count(), signature_scanner_isa());
+
+    // Progress while it runs, "cancelled" stays until the next scan. Finished hits replace the shown ones.
+    if(signature_scan != nullptr && stage_ready(signature_scan.get(), size_t(0), "Scan"))
+    {
+        view->signatureHits = std::move(signature_hits);
+        view->signatureRules = std::move(signature_rules);
+        view->signaturesScanned = true;
+
+        signature_scan.reset();
+    }
+
+    if(!view->signaturesScanned)
+        return;
+
+    if(view->signatureRules.empty())
+        ImGui::Text("No rules matched");
+    else
+        ImGui::TextWrapped("Matched: %s", view->signatureRules.c_str());
+
+    const std::vector<PESignatureMatch>& hits = view->signatureHits;
+
+    clipped_table("signatures", { "Rule", "String", "Section", "RVA", "Offset" }, hits.size(), [&](size_t i)
+    {
+        const PESignatureMatch& hit = hits[i];
+        const SignaturePattern& pattern = signatures.patterns()[hit.match.pattern];
+        std::string_view section = hit.section >= 0 ? get_section_name(all[hit.section]) : std::string_view(hit.rva == PE_NO_RVA ? "overlay" : "headers");
+
+        // Clicking a hit opens it in the hex view
+        ImGui::TableSetColumnIndex(0);
+        ImGui::PushID(static_cast<int>(i));
+        if (ImGui::Selectable(signatures.rules()[pattern.rule].name.c_str(), false, ImGuiSelectableFlags_SpanAllColumns))
+        {
+            view->hexCursor = hit.match.offset;
+            view->hexTop = hit.match.offset / 16;
+            view->showHEX = true;
+        }
+        ImGui::PopID();
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%s", pattern.id.c_str());
+        ImGui::TableSetColumnIndex(2);
+        ImGui::Text("%.*s", static_cast<int>(section.size()), section.data());
+        ImGui::TableSetColumnIndex(3);
+        if(hit.rva != PE_NO_RVA)
+            ImGui::Text("%08" PRIX32, hit.rva);
+        ImGui::TableSetColumnIndex(4);
+        ImGui::Text("%016" PRIX64, hit.match.offset);
+    });
+}
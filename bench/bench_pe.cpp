@@ -0,0 +1,451 @@
+/*
+* Google Benchmark suite for the PE parser
+* Parse latency per structure and per file over a generated corpus in three size classes, plus signature scans with growing
+* rule sets, everything on the calling thread.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "../PE/PE.h"
+
+namespace
+{
+
+    // Shape of a generated PE32+ image, the tables all live in one extra section after the code/data ones
+    struct SyntheticOptions
+    {
+        uint32_t sections = 4;
+        uint32_t section_size = 64 * 1024;
+        uint32_t dlls = 8;
+        uint32_t imports_per_dll = 32;
+        uint32_t exports = 256;
+        uint32_t relocation_blocks = 64; // 16 entries each
+    };
+
+    const uint32_t file_alignment = 0x200;
+    const uint32_t section_alignment = 0x1000;
+    const uint32_t headers_size = 0x400;
+
+    uint32_t align(uint32_t value, uint32_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+    template<typename T>
+    void put(std::vector<uint8_t>& out, uint32_t offset, const T& value)
+    {
+        if(out.size() < offset + sizeof(T))
+            out.resize(offset + sizeof(T));
+
+        std::memcpy(out.data() + offset, &value, sizeof(T));
+    }
+
+    uint32_t put_string(std::vector<uint8_t>& out, const std::string& text)
+    {
+        uint32_t offset = static_cast<uint32_t>(out.size());
+        out.insert(out.end(), text.begin(), text.end());
+        out.push_back(0);
+
+        return offset;
+    }
+
+    // Same options and seed give the same bytes
+    std::vector<uint8_t> build_synthetic_pe(const SyntheticOptions& options, uint32_t seed)
+    {
+        uint32_t section_count = options.sections + 1;
+        uint32_t raw_size = align(options.section_size, file_alignment);
+        uint32_t tables_rva = section_alignment * (options.sections + 1);
+
+        // Tables first, their size decides the last section's
+        std::vector<uint8_t> tables;
+
+        IMAGE_DATA_DIRECTORY import_directory = { tables_rva, (options.dlls + 1) * uint32_t(sizeof(IMAGE_IMPORT_DESCRIPTOR)) };
+        tables.resize(import_directory.Size);
+
+        for (uint32_t dll = 0; dll < options.dlls; ++dll)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "LIBRARY%u.dll", dll);
+
+            IMAGE_IMPORT_DESCRIPTOR descriptor = {};
+            descriptor.Name = tables_rva + put_string(tables, name);
+
+            // Lookup table and IAT, both zero terminated
+            uint32_t thunks = static_cast<uint32_t>(tables.size());
+            tables.resize(thunks + 2 * (options.imports_per_dll + 1) * sizeof(uint64_t));
+
+            descriptor.OriginalFirstThunk = tables_rva + thunks;
+            descriptor.FirstThunk = tables_rva + thunks + (options.imports_per_dll + 1) * sizeof(uint64_t);
+
+            for (uint32_t i = 0; i < options.imports_per_dll; ++i)
+            {
+                char function[48];
+                std::snprintf(function, sizeof(function), "ImportedFunction_%u_%u", dll, i);
+
+                uint32_t hint = static_cast<uint32_t>(tables.size());
+                tables.push_back(static_cast<uint8_t>(i));
+                tables.push_back(0);
+                put_string(tables, function);
+
+                uint64_t thunk = tables_rva + hint;
+                put(tables, thunks + i * sizeof(uint64_t), thunk);
+                put(tables, thunks + (options.imports_per_dll + 1 + i) * sizeof(uint64_t), thunk);
+            }
+
+            put(tables, dll * uint32_t(sizeof(IMAGE_IMPORT_DESCRIPTOR)), descriptor);
+        }
+
+        IMAGE_DATA_DIRECTORY export_directory = {};
+        if(options.exports > 0)
+        {
+            tables.resize(align(static_cast<uint32_t>(tables.size()), 4));
+
+            uint32_t header = static_cast<uint32_t>(tables.size());
+            uint32_t functions = header + sizeof(IMAGE_EXPORT_DIRECTORY);
+            uint32_t names = functions + options.exports * 4;
+            uint32_t ordinals = names + options.exports * 4;
+            tables.resize(ordinals + options.exports * 2);
+
+            IMAGE_EXPORT_DIRECTORY directory = {};
+            directory.Name = tables_rva + put_string(tables, "synthetic.dll");
+            directory.Base = 1;
+            directory.NumberOfFunctions = options.exports;
+            directory.NumberOfNames = options.exports;
+            directory.AddressOfFunctions = tables_rva + functions;
+            directory.AddressOfNames = tables_rva + names;
+            directory.AddressOfNameOrdinals = tables_rva + ordinals;
+            put(tables, header, directory);
+
+            // Zero padded so the name table is sorted like the loader expects
+            for (uint32_t i = 0; i < options.exports; ++i)
+            {
+                char name[32];
+                std::snprintf(name, sizeof(name), "Export%06u", i);
+
+                put(tables, functions + i * 4, uint32_t(section_alignment + (i * 16) % options.section_size));
+                put(tables, names + i * 4, uint32_t(tables_rva + put_string(tables, name)));
+                put(tables, ordinals + i * 2, uint16_t(i));
+            }
+
+            export_directory = { tables_rva + header, static_cast<uint32_t>(tables.size()) - header };
+        }
+
+        IMAGE_DATA_DIRECTORY relocation_directory = {};
+        if(options.relocation_blocks > 0)
+        {
+            tables.resize(align(static_cast<uint32_t>(tables.size()), 4));
+
+            uint32_t start = static_cast<uint32_t>(tables.size());
+            for (uint32_t block = 0; block < options.relocation_blocks; ++block)
+            {
+                uint32_t offset = static_cast<uint32_t>(tables.size());
+                put(tables, offset, IMAGE_BASE_RELOCATION{ section_alignment * (1 + block % options.sections), uint32_t(sizeof(IMAGE_BASE_RELOCATION) + 16 * 2) });
+
+                for (uint16_t entry = 0; entry < 16; ++entry)
+                    put(tables, offset + sizeof(IMAGE_BASE_RELOCATION) + entry * 2, uint16_t(0xA000 | (entry * 8)));
+            }
+
+            relocation_directory = { tables_rva + start, static_cast<uint32_t>(tables.size()) - start };
+        }
+
+        uint32_t tables_raw = align(static_cast<uint32_t>(tables.size()), file_alignment);
+        std::vector<uint8_t> image(headers_size + raw_size * options.sections + tables_raw);
+
+        IMAGE_DOS_HEADER dos = {};
+        dos.e_magic = 0x5A4D;
+        dos.e_lfanew = 0x80;
+        put(image, 0, dos);
+
+        IMAGE_NT_HEADERS64 nt = {};
+        nt.Signature = 0x4550;
+        nt.FileHeader.Machine = MachineArc::AMD64;
+        nt.FileHeader.NumberOfSections = static_cast<uint16_t>(section_count);
+        nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER64);
+        nt.FileHeader.Characteristics = 0x2022;
+        nt.OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+        nt.OptionalHeader.AddressOfEntryPoint = section_alignment;
+        nt.OptionalHeader.BaseOfCode = section_alignment;
+        nt.OptionalHeader.ImageBase = 0x180000000ull;
+        nt.OptionalHeader.SectionAlignment = section_alignment;
+        nt.OptionalHeader.FileAlignment = file_alignment;
+        nt.OptionalHeader.MajorSubsystemVersion = 6;
+        nt.OptionalHeader.SizeOfImage = tables_rva + align(static_cast<uint32_t>(tables.size()), section_alignment);
+        nt.OptionalHeader.SizeOfHeaders = headers_size;
+        nt.OptionalHeader.Subsystem = 3;
+        nt.OptionalHeader.NumberOfRvaAndSizes = 16;
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT] = import_directory;
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT] = export_directory;
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC] = relocation_directory;
+        put(image, dos.e_lfanew, nt);
+
+        uint32_t table_offset = dos.e_lfanew + sizeof(IMAGE_NT_HEADERS64);
+
+        for (uint32_t i = 0; i < section_count; ++i)
+        {
+            bool last = i == options.sections;
+
+            IMAGE_SECTION_HEADER section = {};
+            std::memcpy(section.Name, last ? ".rdata" : (i == 0 ? ".text" : ".data"), last ? 6 : 5);
+            section.Misc.VirtualSize = last ? static_cast<uint32_t>(tables.size()) : options.section_size;
+            section.VirtualAddress = section_alignment * (i + 1);
+            section.SizeOfRawData = last ? tables_raw : raw_size;
+            section.PointerToRawData = headers_size + raw_size * i;
+            section.Characteristics = i == 0 ? (IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ) : (IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE);
+            put(image, table_offset + i * sizeof(IMAGE_SECTION_HEADER), section);
+        }
+
+        // Section bodies: noise with a printable run every 256 bytes so the string scanner finds something
+        uint32_t state = seed * 2654435761u + 1;
+        for (uint32_t i = 0; i < options.sections; ++i)
+        {
+            uint8_t* body = image.data() + headers_size + raw_size * i;
+
+            for (uint32_t j = 0; j < options.section_size; ++j)
+            {
+                state = state * 1664525u + 1013904223u;
+                body[j] = (j & 255) < 24 ? static_cast<uint8_t>('a' + (state >> 24) % 26) : static_cast<uint8_t>(state >> 24);
+            }
+        }
+
+        std::memcpy(image.data() + headers_size + raw_size * options.sections, tables.data(), tables.size());
+
+        return image;
+    }
+
+    struct CorpusFile
+    {
+        std::vector<uint8_t> bytes;
+        std::unique_ptr<ByteSource> source;
+    };
+
+    const char* const corpus_names[] = { "small", "medium", "large" };
+
+    // 16 images per size class, the table counts vary between half and one and a half times the class' shape
+    const std::vector<CorpusFile>& corpus(int64_t size_class)
+    {
+        static std::vector<CorpusFile> corpora[3];
+
+        std::vector<CorpusFile>& files = corpora[size_class];
+        if(!files.empty())
+            return files;
+
+        SyntheticOptions shape;
+        if(size_class == 0)
+            shape = { 1, 16 * 1024, 2, 8, 16, 4 };
+        else if(size_class == 2)
+            shape = { 8, 1024 * 1024, 32, 128, 4096, 2048 };
+
+        for (uint32_t seed = 0; seed < 16; ++seed)
+        {
+            auto vary = [seed](uint32_t value) { return value / 2 + (value * seed) / 16; };
+
+            SyntheticOptions options = shape;
+            options.dlls = std::max(1u, vary(shape.dlls));
+            options.imports_per_dll = vary(shape.imports_per_dll);
+            options.exports = vary(shape.exports);
+            options.relocation_blocks = vary(shape.relocation_blocks);
+
+            CorpusFile file;
+            file.bytes = build_synthetic_pe(options, seed);
+            file.source = ByteSource::from_memory(file.bytes.data(), file.bytes.size());
+            files.push_back(std::move(file));
+        }
+
+        return files;
+    }
+
+    // Times parse() alone, building the PE and reading the headers (and section table) it depends on happen with the clock stopped
+    template<typename Parse>
+    void parse_structure(benchmark::State& state, bool read_sections, Parse parse)
+    {
+        const std::vector<CorpusFile>& files = corpus(state.range(0));
+        std::unique_ptr<PE> pe;
+        size_t next = 0;
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            pe.reset(new PE(*files[next++ % files.size()].source));
+            pe->set_thread_pool(nullptr);
+            pe->get_nt();
+            if(read_sections)
+                pe->get_sections();
+            state.ResumeTiming();
+
+            parse(*pe);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+        state.SetLabel(corpus_names[state.range(0)]);
+    }
+
+    // Whole-file passes, reported as bytes per second. With an arena it's reset after every file like a batch worker's.
+    template<typename Parse>
+    void parse_file(benchmark::State& state, Parse parse, Arena* arena = nullptr)
+    {
+        const std::vector<CorpusFile>& files = corpus(state.range(0));
+        uint64_t bytes = 0;
+        size_t next = 0;
+
+        for (auto _ : state)
+        {
+            ByteSource& source = *files[next++ % files.size()].source;
+
+            {
+                PE pe(source, arena);
+                pe.set_thread_pool(nullptr);
+                parse(pe);
+            }
+
+            if(arena != nullptr)
+                arena->reset();
+
+            bytes += source.size();
+        }
+
+        state.SetBytesProcessed(bytes);
+        state.SetItemsProcessed(state.iterations());
+        state.SetLabel(corpus_names[state.range(0)]);
+    }
+}
+
+static void BM_Headers(benchmark::State& state)
+{
+    const std::vector<CorpusFile>& files = corpus(state.range(0));
+    size_t next = 0;
+
+    for (auto _ : state)
+    {
+        PE pe(*files[next++ % files.size()].source);
+        benchmark::DoNotOptimize(pe.get_nt());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(corpus_names[state.range(0)]);
+}
+
+static void BM_Sections(benchmark::State& state)
+{
+    parse_structure(state, false, [](PE& pe) { benchmark::DoNotOptimize(pe.get_sections().size()); });
+}
+
+static void BM_Imports(benchmark::State& state)
+{
+    parse_structure(state, true, [](PE& pe) { benchmark::DoNotOptimize(pe.get_imports().size()); });
+}
+
+static void BM_Exports(benchmark::State& state)
+{
+    parse_structure(state, true, [](PE& pe) { benchmark::DoNotOptimize(pe.get_exports().functions.size()); });
+}
+
+static void BM_Relocations(benchmark::State& state)
+{
+    parse_structure(state, true, [](PE& pe) { benchmark::DoNotOptimize(pe.get_relocations().size()); });
+}
+
+// Everything the report reads up front: headers, section checks and every directory
+static void parse_everything(PE& pe)
+{
+    pe.get_sections();
+    pe.get_imports();
+    pe.get_exports();
+    pe.get_relocations();
+    pe.get_resources();
+    pe.get_tls();
+    pe.get_debug_entries();
+    pe.get_exception_entries();
+    benchmark::DoNotOptimize(pe.get_diagnostics().size());
+}
+
+static void BM_ParseFile(benchmark::State& state)
+{
+    parse_file(state, parse_everything);
+}
+
+// Same with one arena reused for every file instead of one per PE
+static void BM_ParseFileArena(benchmark::State& state)
+{
+    Arena arena;
+    parse_file(state, parse_everything, &arena);
+}
+
+static void BM_Entropy(benchmark::State& state)
+{
+    parse_file(state, [](PE& pe) { benchmark::DoNotOptimize(pe.get_entropy().file.entropy()); });
+}
+
+static void BM_Hashes(benchmark::State& state)
+{
+    parse_file(state, [](PE& pe) { benchmark::DoNotOptimize(pe.get_hashes().sha256[0]); });
+}
+
+// One sweep after the headers, every "MZ" in the section data gets its header checked
+static void BM_Payloads(benchmark::State& state)
+{
+    parse_file(state, [](PE& pe) { benchmark::DoNotOptimize(pe.get_payloads().size()); });
+}
+
+// Large corpus with 10, 100, 1000 and 10000 rules. Past a few dozen rules most bytes start an atom and the gram kernel
+// replaces the start byte skip; the throughput still drops at 10000 rules as more positions reach the automaton.
+static void BM_Signatures(benchmark::State& state)
+{
+    uint32_t seed = 1;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 24; };
+
+    // One hex string with a wildcard and one text string per rule
+    std::string text;
+    for (int64_t rule = 0; rule < state.range(0); ++rule)
+    {
+        unsigned bytes[7];
+        for (unsigned& byte : bytes)
+            byte = next();
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "rule r%u { strings: $a = { %02X %02X %02X ?? %02X %02X %02X %02X } $b = \"name_%02x%02x\" nocase }\n",
+            static_cast<unsigned>(rule), bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5], bytes[6], next(), next());
+        text += line;
+    }
+
+    SignatureSet signatures;
+    std::string error;
+    if(!signatures.parse(text, error) || !signatures.compile(error))
+    {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+
+    const std::vector<CorpusFile>& files = corpus(2);
+    uint64_t bytes = 0;
+    size_t index = 0;
+
+    for (auto _ : state)
+    {
+        ByteSource& source = *files[index++ % files.size()].source;
+
+        PE pe(source);
+        pe.set_thread_pool(nullptr);
+        benchmark::DoNotOptimize(pe.scan_signatures(signatures).size());
+
+        bytes += source.size();
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.SetLabel(signature_scanner_isa());
+}
+
+BENCHMARK(BM_Headers)->DenseRange(0, 2);
+BENCHMARK(BM_Sections)->DenseRange(0, 2);
+BENCHMARK(BM_Imports)->DenseRange(0, 2);
+BENCHMARK(BM_Exports)->DenseRange(0, 2);
+BENCHMARK(BM_Relocations)->DenseRange(0, 2);
+BENCHMARK(BM_ParseFile)->DenseRange(0, 2);
+BENCHMARK(BM_ParseFileArena)->DenseRange(0, 2);
+BENCHMARK(BM_Entropy)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Hashes)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Payloads)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Signatures)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
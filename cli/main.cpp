@@ -0,0 +1,298 @@
+/*
+* binaryview-cli, headless batch mode
+* Dumps headers, sections and strings of PE files (headers, segments, sections and symbols of ELF files) for every file given (directories are walked recursively) without touching GL/ImGui. --rules adds signature hits, --trace profiles the run.
+*/
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "report.h"
+#include "../core/batch_scanner.h"
+#include "../core/analysis_cache.h"
+#include "../core/signature_scanner.h"
+#include "../core/profiler.h"
+
+static void print_usage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] <file|directory>...\n"
+        "       %s [options] --diff <old> <new>\n"
+        "  --format json|csv   Output format (default json, one object per line)\n"
+        "  --no-directories    Don't parse imports, exports, resources and the other data directories\n"
+        "  --no-entropy        Don't compute byte entropy\n"
+        "  --no-hashes         Don't compute MD5/SHA-1/SHA-256, Authenticode and imphash digests\n"
+        "  --no-strings        Don't extract strings\n"
+        "  --no-payloads       Don't look for files (PE, ZIP, 7z, CAB, MSI) embedded in the sections and overlay\n"
+        "  --min-length <n>    Minimum string length in characters (default 4)\n"
+        "  --all-strings       Extract strings from the whole file instead of only .rdata\n"
+        "  --cache             Reuse entropy, hashes and strings from the analysis cache and save new results to it\n"
+        "  --cache-dir <dir>   Same as --cache with the cache files in dir (default $BINARYVIEW_CACHE_DIR or ~/.cache/binaryview)\n"
+        "  --rules <file>      Scan for the signatures in a YARA-style rule file (can be repeated) and list hits and matched rules\n"
+        "  -o <file>           Write to a file instead of stdout\n"
+        "  -j <threads>        Worker threads (default one per hardware thread)\n"
+        "  --unordered         Write results as soon as they're done instead of in input order\n"
+        "  --stats             Print throughput to stderr when finished\n"
+        "  --trace <file>      Write the timed scopes and counters of the run as a Chrome trace (chrome://tracing, Perfetto)\n"
+        "  --diff <old> <new>  Compare two files: header fields, regions, changed byte ranges, imports and exports\n",
+        program, program);
+}
+
+static void collect_files(const std::string& path, std::vector<std::string>& files)
+{
+    std::error_code error;
+
+    if(!std::filesystem::is_directory(path, error))
+    {
+        files.push_back(path);
+
+        return;
+    }
+
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto it = std::filesystem::recursive_directory_iterator(path, options, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if(it->is_regular_file(error))
+            files.push_back(it->path().string());
+    }
+}
+
+static bool write_trace(const char* path)
+{
+    std::string error;
+    if(Profiler::write_trace(path, error))
+        return true;
+
+    std::fprintf(stderr, "%s\n", error.c_str());
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    ReportOptions options;
+    std::vector<std::string> inputs;
+    const char* output_path = nullptr;
+    size_t threads = 0;
+    bool ordered = true;
+    bool print_stats = false;
+    const char* diff_old = nullptr;
+    const char* diff_new = nullptr;
+    std::vector<const char*> rule_files;
+    const char* trace_path = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+
+        if(std::strcmp(arg, "--format") == 0 && i + 1 < argc)
+        {
+            const char* format = argv[++i];
+
+            if(std::strcmp(format, "json") == 0)
+                options.format = ReportFormat::JSON;
+            else if(std::strcmp(format, "csv") == 0)
+                options.format = ReportFormat::CSV;
+            else
+            {
+                std::fprintf(stderr, "Unknown format %s\n", format);
+
+                return -1;
+            }
+        }
+        else if(std::strcmp(arg, "--no-directories") == 0)
+            options.directories = false;
+        else if(std::strcmp(arg, "--no-entropy") == 0)
+            options.entropy = false;
+        else if(std::strcmp(arg, "--no-hashes") == 0)
+            options.hashes = false;
+        else if(std::strcmp(arg, "--no-strings") == 0)
+            options.strings = false;
+        else if(std::strcmp(arg, "--no-payloads") == 0)
+            options.payloads = false;
+        else if(std::strcmp(arg, "--all-strings") == 0)
+            options.all_strings = true;
+        else if(std::strcmp(arg, "--min-length") == 0 && i + 1 < argc)
+            options.min_string_length = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        else if(std::strcmp(arg, "--cache") == 0)
+        {
+            options.cache = true;
+            options.cache_directory = default_cache_directory();
+        }
+        else if(std::strcmp(arg, "--cache-dir") == 0 && i + 1 < argc)
+        {
+            options.cache = true;
+            options.cache_directory = argv[++i];
+        }
+        else if(std::strcmp(arg, "--rules") == 0 && i + 1 < argc)
+            rule_files.push_back(argv[++i]);
+        else if(std::strcmp(arg, "-o") == 0 && i + 1 < argc)
+            output_path = argv[++i];
+        else if(std::strcmp(arg, "-j") == 0 && i + 1 < argc)
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        else if(std::strcmp(arg, "--unordered") == 0)
+            ordered = false;
+        else if(std::strcmp(arg, "--stats") == 0)
+            print_stats = true;
+        else if(std::strcmp(arg, "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+
+            if(!Profiler::enabled())
+            {
+                std::fprintf(stderr, "--trace needs a build with BINARYVIEW_PROFILING\n");
+
+                return -1;
+            }
+        }
+        else if(std::strcmp(arg, "--diff") == 0 && i + 2 < argc)
+        {
+            diff_old = argv[++i];
+            diff_new = argv[++i];
+        }
+        else if(std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+        {
+            print_usage(argv[0]);
+
+            return 0;
+        }
+        else if(arg[0] == '-' && arg[1] != '\0')
+        {
+            std::fprintf(stderr, "Unknown option %s\n", arg);
+            print_usage(argv[0]);
+
+            return -1;
+        }
+        else
+            inputs.emplace_back(arg);
+    }
+
+    if(inputs.empty() && diff_old == nullptr)
+    {
+        print_usage(argv[0]);
+
+        return -1;
+    }
+
+    // Compiled once, every worker scans with the same set
+    SignatureSet signatures;
+    if(!rule_files.empty())
+    {
+        std::string error;
+
+        for (const char* path : rule_files)
+        {
+            if(!signatures.load(path, error))
+            {
+                std::fprintf(stderr, "%s: %s\n", path, error.c_str());
+
+                return -1;
+            }
+        }
+
+        if(!signatures.compile(error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+
+            return -1;
+        }
+
+        options.signatures = &signatures;
+    }
+
+    std::FILE* output = stdout;
+    if(output_path != nullptr)
+    {
+        output = std::fopen(output_path, "wb");
+
+        if(output == nullptr)
+        {
+            std::fprintf(stderr, "Failed to open %s\n", output_path);
+
+            return -1;
+        }
+    }
+
+    if(diff_old != nullptr)
+    {
+        std::unique_ptr<ByteSource> old_source = ByteSource::open(diff_old);
+        std::unique_ptr<ByteSource> new_source = ByteSource::open(diff_new);
+
+        std::string out;
+        write_report_header(options, out);
+
+        bool valid = false;
+        if(old_source == nullptr || new_source == nullptr)
+            write_report_error(old_source == nullptr ? diff_old : diff_new, "Failed to open file", options, out);
+        else
+        {
+            ThreadPool pool(threads);
+            options.pool = &pool;
+
+            valid = write_diff_report(diff_old, *old_source, diff_new, *new_source, options, out);
+        }
+
+        std::fwrite(out.data(), 1, out.size(), output);
+
+        if(output != stdout)
+            std::fclose(output);
+
+        if(trace_path != nullptr && !write_trace(trace_path))
+            return -1;
+
+        return valid ? 0 : 1;
+    }
+
+    std::vector<std::string> files;
+    for (const std::string& input : inputs)
+        collect_files(input, files);
+
+    std::string header;
+    write_report_header(options, header);
+
+    FileSink sink(output);
+    sink.write(header);
+
+    BatchScanner::Job job = [&options](ScanContext& context, const std::string& path, ByteSource* source, std::string& out)
+    {
+        if(source == nullptr)
+        {
+            write_report_error(path, "Failed to open file", options, out);
+
+            return false;
+        }
+
+        // Everything the parser allocated goes at once, the arena keeps its memory for the next file
+        bool valid = write_report(path, *source, options, out, &context.arena);
+        context.arena.reset();
+
+        return valid;
+    };
+
+    ThreadPool pool(threads);
+
+    // A single big file gets split across the pool instead
+    if(files.size() == 1)
+        options.pool = &pool;
+    ScanStats stats = BatchScanner(pool).run(files, job, sink, ordered);
+
+    if(print_stats)
+    {
+        std::fprintf(stderr, "%" PRIu64 " files (%" PRIu64 " failed), %.1f MB in %.3fs: %.0f files/s, %.1f MB/s on %zu threads\n",
+            stats.files, stats.failures, stats.bytes / (1024.0 * 1024.0), stats.seconds, stats.files_per_second(), stats.mb_per_second(), pool.size());
+    }
+
+    if(output != stdout)
+        std::fclose(output);
+
+    if(trace_path != nullptr && !write_trace(trace_path))
+        return -1;
+
+    return stats.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,921 @@
+#include "report.h"
+#include "../PE/PE.h"
+#include "../PE/PE_diff.h"
+#include "../ELF/ELF.h"
+#include "../core/profiler.h"
+#include "../core/thread_pool.h"
+#include <cinttypes>
+#include <cstdio>
+
+namespace
+{
+    void append_escaped_json(std::string& out, std::string_view value)
+    {
+        out += '"';
+
+        for (char c : value)
+        {
+            switch (c)
+            {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if(static_cast<uint8_t>(c) < 0x20 || static_cast<uint8_t>(c) >= 0x7F)
+                    {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<uint8_t>(c));
+                        out += escaped;
+                    }
+                    else
+                        out += c;
+            }
+        }
+
+        out += '"';
+    }
+
+    void append_escaped_csv(std::string& out, std::string_view value)
+    {
+        bool quote = value.find_first_of(",\"\r\n") != std::string_view::npos;
+        if(!quote)
+        {
+            out.append(value.data(), value.size());
+
+            return;
+        }
+
+        out += '"';
+
+        for (char c : value)
+        {
+            if(c == '"')
+                out += '"';
+
+            out += c;
+        }
+
+        out += '"';
+    }
+
+    void append_number(std::string& out, uint64_t value)
+    {
+        char buffer[24];
+        int length = std::snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+        out.append(buffer, length);
+    }
+
+    void append_real(std::string& out, double value)
+    {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.6f", value);
+        out.append(buffer, length);
+    }
+
+    // Builds one JSON object per file, records become nested objects and lists become arrays
+    class JsonSink
+    {
+    public:
+        JsonSink(const std::string& path, std::string& out) : out_(out)
+        {
+            out_ += '{';
+            key("file");
+            append_escaped_json(out_, path);
+        }
+
+        void finish() { out_ += "}\n"; }
+
+        void begin_record(const char* name) { key(name); open('{'); }
+        void begin_list_record() { separator(); open('{'); }
+        void end_record() { close('}'); }
+
+        void begin_list(const char* name) { key(name); open('['); }
+        void end_list() { close(']'); }
+
+        void field(const char* name, uint64_t value) { key(name); append_number(out_, value); }
+        void field(const char* name, std::string_view value) { key(name); append_escaped_json(out_, value); }
+        // Not a field overload, integers of every width would be ambiguous between it and uint64_t
+        void field_real(const char* name, double value) { key(name); append_real(out_, value); }
+
+    private:
+        void separator()
+        {
+            if(need_comma_)
+                out_ += ',';
+
+            need_comma_ = true;
+        }
+
+        void key(const char* name)
+        {
+            separator();
+            append_escaped_json(out_, name);
+            out_ += ':';
+        }
+
+        void open(char c) { out_ += c; need_comma_ = false; }
+        void close(char c) { out_ += c; need_comma_ = true; }
+
+        std::string& out_;
+        bool need_comma_ = false;
+    };
+
+    // Flattens the same structure into file,record,index,field,value rows
+    class CsvSink
+    {
+    public:
+        CsvSink(const std::string& path, std::string& out) : path_(path), out_(out) {}
+
+        void finish() {}
+
+        void begin_record(const char* name) { record_ = name; index_ = -1; }
+        void begin_list_record() { ++index_; }
+        void end_record() { if(!in_list_) reset(); }
+
+        void begin_list(const char* name) { record_ = name; index_ = -1; in_list_ = true; }
+        void end_list() { in_list_ = false; reset(); }
+
+        void field(const char* name, uint64_t value)
+        {
+            std::string text;
+            append_number(text, value);
+            row(name, text);
+        }
+
+        void field(const char* name, std::string_view value) { row(name, value); }
+
+        void field_real(const char* name, double value)
+        {
+            std::string text;
+            append_real(text, value);
+            row(name, text);
+        }
+
+    private:
+        void reset() { record_ = "file"; index_ = -1; }
+
+        void row(const char* name, std::string_view value)
+        {
+            append_escaped_csv(out_, path_);
+            out_ += ',';
+            out_ += record_;
+            out_ += ',';
+            if(index_ >= 0)
+                append_number(out_, index_);
+            out_ += ',';
+            out_ += name;
+            out_ += ',';
+            append_escaped_csv(out_, value);
+            out_ += '\n';
+        }
+
+        const std::string& path_;
+        std::string& out_;
+        const char* record_ = "file";
+        int64_t index_ = -1;
+        bool in_list_ = false;
+    };
+
+    template<typename Sink>
+    void visit_directories(PE& pe, Sink& sink)
+    {
+        // One record per imported function so CSV stays flat
+        sink.begin_list("imports");
+        for (const PEImport& import : pe.get_imports())
+        {
+            for (const PEImportFunction& function : import.functions)
+            {
+                sink.begin_list_record();
+                sink.field("dll", import.dll);
+
+                if(function.by_ordinal)
+                    sink.field("ordinal", function.hint);
+                else
+                    sink.field("name", function.name);
+
+                sink.field("iat_rva", function.iat_rva);
+
+                if(import.delayed)
+                    sink.field("delayed", 1);
+
+                sink.end_record();
+            }
+        }
+        sink.end_list();
+
+        const PEExports& exports = pe.get_exports();
+
+        sink.begin_list("exports");
+        for (const PEExport& entry : exports.functions)
+        {
+            sink.begin_list_record();
+            sink.field("ordinal", entry.ordinal);
+            sink.field("rva", entry.rva);
+
+            if(!entry.name.empty())
+                sink.field("name", entry.name);
+
+            if(!entry.forwarder.empty())
+                sink.field("forwarder", entry.forwarder);
+
+            sink.end_record();
+        }
+        sink.end_list();
+
+        sink.begin_list("resources");
+        for (const PEResource& entry : pe.get_resources())
+        {
+            sink.begin_list_record();
+
+            if(entry.type.name.empty())
+                sink.field("type", entry.type.id);
+            else
+                sink.field("type", entry.type.name);
+
+            if(entry.name.name.empty())
+                sink.field("name", entry.name.id);
+            else
+                sink.field("name", entry.name.name);
+
+            sink.field("language", entry.language);
+            sink.field("rva", entry.rva);
+            sink.field("size", entry.size);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        // Strings of the first VERSION resource (CompanyName, OriginalFilename...), usually the first thing looked at
+        sink.begin_list("version_info");
+        for (const PEResource& entry : pe.get_resources())
+        {
+            if(!entry.type.name.empty() || entry.type.id != RT_VERSION)
+                continue;
+
+            std::shared_ptr<const PEResourceContent> content = pe.decode_resource(RT_VERSION, entry.name.id, entry.rva, entry.size);
+            for (const PEVersionString& version : content->version_strings)
+            {
+                sink.begin_list_record();
+                sink.field("table", version.table);
+                sink.field("key", version.key);
+                sink.field("value", version.value);
+                sink.end_record();
+            }
+
+            break;
+        }
+        sink.end_list();
+
+        sink.begin_list("debug");
+        for (const PEDebugEntry& entry : pe.get_debug_entries())
+        {
+            sink.begin_list_record();
+            sink.field("type", entry.directory->Type);
+            sink.field("TimeDateStamp", entry.directory->TimeDateStamp);
+
+            if(!entry.pdb_path.empty())
+            {
+                sink.field("pdb", entry.pdb_path);
+                sink.field("pdb_age", entry.pdb_age);
+            }
+
+            sink.end_record();
+        }
+        sink.end_list();
+
+        const PETls& tls = pe.get_tls();
+        if(tls.present)
+        {
+            sink.begin_record("tls");
+            sink.field("AddressOfIndex", tls.index);
+            sink.field("AddressOfCallBacks", tls.callbacks_va);
+            sink.field("callbacks", tls.callbacks.size());
+            sink.end_record();
+        }
+
+        uint64_t relocation_count = 0;
+        for (const PERelocationBlock& block : pe.get_relocations())
+            relocation_count += block.entries.size();
+
+        sink.begin_record("counts");
+        if(!exports.dll.empty())
+            sink.field("export_name", exports.dll);
+        sink.field("relocation_blocks", pe.get_relocations().size());
+        sink.field("relocations", relocation_count);
+        sink.field("runtime_functions", pe.get_exception_entries().size());
+        sink.end_record();
+    }
+
+    // Written last since parsing the directories can add table limits
+    template<typename Sink>
+    void visit_diagnostics(PE& pe, Sink& sink)
+    {
+        Span<PEDiagnostic> diagnostics = pe.get_diagnostics();
+        if(diagnostics.empty())
+            return;
+
+        sink.begin_list("diagnostics");
+        for (const PEDiagnostic& diagnostic : diagnostics)
+        {
+            sink.begin_list_record();
+            sink.field("issue", PE::describe_issue(diagnostic.issue));
+            sink.field("field", diagnostic.field);
+
+            if(diagnostic.offset != PE_NO_OFFSET)
+                sink.field("offset", diagnostic.offset);
+
+            sink.field("value", diagnostic.value);
+            sink.end_record();
+        }
+        sink.end_list();
+    }
+
+    // Start of a "signatures" hit record, the caller adds where the hit is and ends it
+    template<typename Sink>
+    void begin_signature_hit(const SignatureSet& signatures, const SignatureMatch& match, Sink& sink)
+    {
+        const SignaturePattern& pattern = signatures.patterns()[match.pattern];
+
+        sink.begin_list_record();
+        sink.field("rule", signatures.rules()[pattern.rule].name);
+        sink.field("id", pattern.id);
+        sink.field("offset", match.offset);
+        sink.field("length", match.length);
+    }
+
+    template<typename Sink>
+    void visit_matched_rules(const SignatureSet& signatures, const std::vector<SignatureMatch>& matches, Sink& sink)
+    {
+        sink.begin_list("rules_matched");
+        for (uint32_t rule : signatures.matched_rules(matches))
+        {
+            sink.begin_list_record();
+            sink.field("name", signatures.rules()[rule].name);
+            sink.end_record();
+        }
+        sink.end_list();
+    }
+
+    template<typename Sink>
+    bool visit_pe(const std::string& path, ByteSource& source, Arena* arena, const ReportOptions& options, Sink& sink)
+    {
+        PE pe(source, arena);
+        pe.set_thread_pool(options.pool);
+
+        // Before the cache is read, it only supplies strings found with the same options
+        StringScanOptions string_options;
+        string_options.min_length = options.min_string_length;
+        pe.set_string_options(string_options);
+
+        if(options.cache)
+        {
+            pe.set_cache(path, options.cache_directory);
+            pe.load_cache();
+        }
+
+        sink.field("size", source.size());
+
+        if(const char* error = pe.get_error())
+        {
+            sink.field("error", error);
+            visit_diagnostics(pe, sink);
+
+            return false;
+        }
+
+        const IMAGE_DOS_HEADER* dos = pe.get_dos();
+        sink.begin_record("dos");
+        sink.field("e_magic", dos->e_magic);
+        sink.field("e_lfanew", dos->e_lfanew);
+        sink.end_record();
+
+        const PENtHeaders* nt = pe.get_nt();
+
+        sink.begin_record("file_header");
+        sink.field("Machine", static_cast<uint64_t>(nt->FileHeader.Machine));
+        sink.field("MachineName", pe.get_arc_name(nt->FileHeader.Machine));
+        sink.field("NumberOfSections", nt->FileHeader.NumberOfSections);
+        sink.field("TimeDateStamp", nt->FileHeader.TimeDateStamp);
+        sink.field("SizeOfOptionalHeader", nt->FileHeader.SizeOfOptionalHeader);
+        sink.field("Characteristics", nt->FileHeader.Characteristics);
+        sink.end_record();
+
+        sink.begin_record("optional_header");
+        sink.field("Magic", nt->OptionalHeader.Magic);
+        sink.field("AddressOfEntryPoint", nt->OptionalHeader.AddressOfEntryPoint);
+        sink.field("BaseOfCode", nt->OptionalHeader.BaseOfCode);
+
+        if(!pe.is_64bit())
+            sink.field("BaseOfData", nt->BaseOfData);
+
+        sink.field("ImageBase", nt->OptionalHeader.ImageBase);
+        sink.field("SectionAlignment", nt->OptionalHeader.SectionAlignment);
+        sink.field("FileAlignment", nt->OptionalHeader.FileAlignment);
+        sink.field("SizeOfImage", nt->OptionalHeader.SizeOfImage);
+        sink.field("SizeOfHeaders", nt->OptionalHeader.SizeOfHeaders);
+        sink.field("CheckSum", nt->OptionalHeader.CheckSum);
+        sink.field("Subsystem", nt->OptionalHeader.Subsystem);
+        sink.field("DllCharacteristics", nt->OptionalHeader.DllCharacteristics);
+        sink.field("SizeOfStackReserve", nt->OptionalHeader.SizeOfStackReserve);
+        sink.field("SizeOfStackCommit", nt->OptionalHeader.SizeOfStackCommit);
+        sink.field("SizeOfHeapReserve", nt->OptionalHeader.SizeOfHeapReserve);
+        sink.field("SizeOfHeapCommit", nt->OptionalHeader.SizeOfHeapCommit);
+        sink.field("NumberOfRvaAndSizes", nt->OptionalHeader.NumberOfRvaAndSizes);
+        sink.end_record();
+
+        const PEEntropy* entropy = options.entropy ? &pe.get_entropy() : nullptr;
+        const PEHashes* hashes = options.hashes ? &pe.get_hashes() : nullptr;
+        Span<IMAGE_SECTION_HEADER> sections = pe.get_sections();
+
+        if(hashes != nullptr)
+        {
+            sink.begin_record("hashes");
+            sink.field("md5", digest_hex(hashes->md5, sizeof(hashes->md5)));
+            sink.field("sha1", digest_hex(hashes->sha1, sizeof(hashes->sha1)));
+            sink.field("sha256", digest_hex(hashes->sha256, sizeof(hashes->sha256)));
+            sink.field("authenticode_sha256", digest_hex(hashes->authenticode, sizeof(hashes->authenticode)));
+
+            if(hashes->has_imphash)
+                sink.field("imphash", digest_hex(hashes->imphash, sizeof(hashes->imphash)));
+
+            sink.end_record();
+        }
+
+        if(entropy != nullptr)
+        {
+            sink.begin_record("entropy");
+            sink.field_real("file", entropy->file.entropy());
+            sink.field("window", entropy->window);
+            sink.field("step", entropy->step);
+
+            // The profile itself is too long for a report, its extremes are what point at packed or empty regions
+            if(!entropy->profile.empty())
+            {
+                size_t low = 0;
+                size_t high = 0;
+                for (size_t i = 1; i < entropy->profile.size(); ++i)
+                {
+                    if(entropy->profile[i] < entropy->profile[low])
+                        low = i;
+                    if(entropy->profile[i] > entropy->profile[high])
+                        high = i;
+                }
+
+                sink.field_real("min", entropy->profile[low]);
+                sink.field("min_offset", low * entropy->step);
+                sink.field_real("max", entropy->profile[high]);
+                sink.field("max_offset", high * entropy->step);
+            }
+
+            sink.end_record();
+        }
+
+        sink.begin_list("sections");
+        for (size_t i = 0; i < sections.size(); ++i)
+        {
+            const IMAGE_SECTION_HEADER& section = sections[i];
+
+            sink.begin_list_record();
+            sink.field("Name", pe.get_section_name(section));
+            sink.field("VirtualAddress", section.VirtualAddress);
+            sink.field("VirtualSize", section.Misc.VirtualSize);
+            sink.field("PointerToRawData", section.PointerToRawData);
+            sink.field("SizeOfRawData", section.SizeOfRawData);
+            sink.field("Characteristics", section.Characteristics);
+
+            if(entropy != nullptr)
+                sink.field_real("entropy", entropy->sections[i].entropy());
+
+            if(hashes != nullptr)
+            {
+                sink.field("md5", digest_hex(hashes->sections[i].md5, sizeof(hashes->sections[i].md5)));
+                sink.field("sha256", digest_hex(hashes->sections[i].sha256, sizeof(hashes->sections[i].sha256)));
+            }
+
+            sink.end_record();
+        }
+        sink.end_list();
+
+        PEOverlay overlay = pe.get_overlay();
+        sink.field("overlay_offset", overlay.offset);
+        sink.field("overlay_size", overlay.size);
+
+        if(overlay.certificates != 0)
+            sink.field("overlay_certificates", overlay.certificates);
+
+        if(options.payloads)
+        {
+            sink.begin_list("payloads");
+            for (const CarvedPayload& payload : pe.get_payloads())
+            {
+                sink.begin_list_record();
+                sink.field("type", payload_kind_name(payload.kind));
+                sink.field("offset", payload.offset);
+                sink.field("size", payload.size);
+
+                if(!payload.exact)
+                    sink.field("estimated", 1);
+
+                sink.end_record();
+            }
+            sink.end_list();
+        }
+
+        if(options.directories)
+            visit_directories(pe, sink);
+
+        if(options.strings)
+        {
+            std::string scratch;
+
+            sink.begin_list("strings");
+            for (const PEString& entry : options.all_strings ? pe.get_strings() : pe.get_rdata_strings())
+            {
+                sink.begin_list_record();
+                sink.field("offset", entry.span.offset);
+                sink.field("encoding", entry.span.encoding == StringEncoding::ASCII ? "ascii" : "utf16le");
+
+                if(entry.section >= 0)
+                    sink.field("section", pe.get_section_name(pe.get_sections()[entry.section]));
+
+                if(entry.rva != PE_NO_RVA)
+                    sink.field("rva", entry.rva);
+
+                sink.field("text", pe.get_string_text(entry.span, scratch));
+                sink.end_record();
+            }
+            sink.end_list();
+        }
+
+        if(options.signatures != nullptr)
+        {
+            std::vector<PESignatureMatch> hits = pe.scan_signatures(*options.signatures);
+            std::vector<SignatureMatch> matches;
+            matches.reserve(hits.size());
+
+            sink.begin_list("signatures");
+            for (const PESignatureMatch& hit : hits)
+            {
+                begin_signature_hit(*options.signatures, hit.match, sink);
+
+                if(hit.section >= 0)
+                    sink.field("section", pe.get_section_name(pe.get_sections()[hit.section]));
+
+                if(hit.rva != PE_NO_RVA)
+                    sink.field("rva", hit.rva);
+
+                sink.end_record();
+                matches.push_back(hit.match);
+            }
+            sink.end_list();
+
+            visit_matched_rules(*options.signatures, matches, sink);
+        }
+
+        if(options.cache)
+            pe.save_cache();
+
+        visit_diagnostics(pe, sink);
+
+        return true;
+    }
+
+    template<typename Sink>
+    bool visit_elf(ByteSource& source, Arena* arena, const ReportOptions& options, Sink& sink)
+    {
+        ELF elf(source, arena);
+
+        sink.field("size", source.size());
+
+        auto visit_elf_diagnostics = [&]()
+        {
+            Span<ELFDiagnostic> diagnostics = elf.get_diagnostics();
+            if(diagnostics.empty())
+                return;
+
+            sink.begin_list("diagnostics");
+            for (const ELFDiagnostic& diagnostic : diagnostics)
+            {
+                sink.begin_list_record();
+                sink.field("issue", ELF::describe_issue(diagnostic.issue));
+                sink.field("field", diagnostic.field);
+
+                if(diagnostic.offset != ELF_NO_OFFSET)
+                    sink.field("offset", diagnostic.offset);
+
+                sink.field("value", diagnostic.value);
+                sink.end_record();
+            }
+            sink.end_list();
+        };
+
+        if(const char* error = elf.get_error())
+        {
+            sink.field("error", error);
+            visit_elf_diagnostics();
+
+            return false;
+        }
+
+        const Elf64_Ehdr* header = elf.get_header();
+        sink.begin_record("elf_header");
+        sink.field("Class", elf.is_64bit() ? "ELF64" : "ELF32");
+        sink.field("Data", elf.is_big_endian() ? "big" : "little");
+        sink.field("Type", header->e_type);
+        sink.field("TypeName", elf.get_type_name(header->e_type));
+        sink.field("Machine", header->e_machine);
+        sink.field("MachineName", elf.get_machine_name(header->e_machine));
+        sink.field("Entry", header->e_entry);
+        sink.field("Flags", header->e_flags);
+
+        std::string_view interpreter = elf.get_interpreter();
+        if(!interpreter.empty())
+            sink.field("Interpreter", interpreter);
+
+        sink.end_record();
+
+        sink.begin_list("segments");
+        for (const ELFSegment& segment : elf.get_segments())
+        {
+            sink.begin_list_record();
+            sink.field("type", elf.get_segment_type_name(segment.type));
+            sink.field("flags", segment.flags);
+            sink.field("offset", segment.offset);
+            sink.field("vaddr", segment.vaddr);
+            sink.field("filesz", segment.filesz);
+            sink.field("memsz", segment.memsz);
+            sink.field("align", segment.align);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        sink.begin_list("sections");
+        for (const ELFSection& section : elf.get_sections())
+        {
+            sink.begin_list_record();
+            sink.field("name", section.name);
+            sink.field("type", elf.get_section_type_name(section.type));
+            sink.field("flags", section.flags);
+            sink.field("addr", section.addr);
+            sink.field("offset", section.offset);
+            sink.field("size", section.size);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        // The dynamic table and symbols stand in for the PE data directories
+        if(options.directories)
+        {
+            Span<ELFSymbol> dynamic_symbols = elf.get_dynamic_symbols();
+
+            sink.begin_record("symbols");
+            sink.field("symtab", elf.get_symbols().size());
+            sink.field("dynsym", dynamic_symbols.size());
+            sink.end_record();
+
+            sink.begin_list("dynamic");
+            for (const ELFDynamic& entry : elf.get_dynamic())
+            {
+                sink.begin_list_record();
+                sink.field("tag", elf.get_dynamic_tag_name(entry.tag));
+
+                if(!entry.text.empty())
+                    sink.field("text", entry.text);
+                else
+                    sink.field("value", entry.value);
+
+                sink.end_record();
+            }
+            sink.end_list();
+
+            sink.begin_list("dynamic_symbols");
+            for (const ELFSymbol& symbol : dynamic_symbols)
+            {
+                if(symbol.name.empty())
+                    continue;
+
+                sink.begin_list_record();
+                sink.field("name", symbol.name);
+                sink.field("type", ELF::get_symbol_type_name(symbol.info));
+                sink.field("bind", ELF::get_symbol_binding_name(symbol.info));
+
+                if(symbol.shndx == SHN_UNDEF)
+                    sink.field("undefined", 1);
+                else
+                    sink.field("value", symbol.value);
+
+                sink.end_record();
+            }
+            sink.end_list();
+        }
+
+        if(options.signatures != nullptr)
+        {
+            ByteSpan data = source.view(0, source.size());
+            std::vector<SignatureMatch> matches;
+
+            if(options.pool != nullptr)
+                options.signatures->scan_parallel(data.data(), data.size(), 0, SignatureScanOptions(), *options.pool, matches);
+            else
+                options.signatures->scan(data.data(), data.size(), 0, SignatureScanOptions(), matches);
+
+            Span<ELFSection> sections = elf.get_sections();
+
+            sink.begin_list("signatures");
+            for (const SignatureMatch& match : matches)
+            {
+                begin_signature_hit(*options.signatures, match, sink);
+
+                int32_t section = elf.get_section_by_offset(match.offset);
+                if(section >= 0)
+                    sink.field("section", sections[section].name);
+
+                uint64_t address = elf.offset_to_address(match.offset);
+                if(address != ELF_NO_ADDRESS)
+                    sink.field("address", address);
+
+                sink.end_record();
+            }
+            sink.end_list();
+
+            visit_matched_rules(*options.signatures, matches, sink);
+        }
+
+        visit_elf_diagnostics();
+
+        return true;
+    }
+
+    template<typename Sink>
+    void visit_names(const char* list, const std::vector<std::string>& names, Sink& sink)
+    {
+        sink.begin_list(list);
+        for (const std::string& name : names)
+        {
+            sink.begin_list_record();
+            sink.field("name", name);
+            sink.end_record();
+        }
+        sink.end_list();
+    }
+
+    template<typename Sink>
+    bool visit_diff(const std::string& old_path, ByteSource& old_source, ByteSource& new_source, const ReportOptions& options, Sink& sink)
+    {
+        PE old_pe(old_source);
+        PE new_pe(new_source);
+
+        sink.field("old", old_path);
+
+        for (PE* pe : { &old_pe, &new_pe })
+        {
+            if(const char* error = pe->get_error())
+            {
+                sink.field("error", error);
+
+                return false;
+            }
+        }
+
+        // Regions run on the pool themselves, the parsers stay on this thread
+        old_pe.set_thread_pool(nullptr);
+        new_pe.set_thread_pool(nullptr);
+
+        PEDiff diff = diff_pe(old_pe, new_pe, options.pool);
+
+        sink.field("changed_bytes", diff.changed_bytes());
+
+        sink.begin_list("fields");
+        for (const PEFieldChange& change : diff.fields)
+        {
+            sink.begin_list_record();
+            sink.field("field", change.field);
+            sink.field("old", change.old_value);
+            sink.field("new", change.new_value);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        sink.begin_list("regions");
+        for (const PEDiffRegion& region : diff.regions)
+        {
+            sink.begin_list_record();
+            sink.field("name", region.name);
+            sink.field("old_offset", region.old_offset);
+            sink.field("old_size", region.old_size);
+            sink.field("new_offset", region.new_offset);
+            sink.field("new_size", region.new_size);
+            sink.field("changed_old", region.changed_old);
+            sink.field("changed_new", region.changed_new);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        // Equal hunks are whatever the changes leave out
+        static const char* kinds[] = { "equal", "changed", "inserted", "deleted" };
+
+        sink.begin_list("hunks");
+        for (const PEDiffRegion& region : diff.regions)
+        {
+            for (const DiffHunk& hunk : region.hunks)
+            {
+                if(hunk.kind == DiffKind::Equal)
+                    continue;
+
+                sink.begin_list_record();
+                sink.field("region", region.name);
+                sink.field("kind", kinds[static_cast<size_t>(hunk.kind)]);
+                sink.field("old_offset", hunk.old_offset);
+                sink.field("old_size", hunk.old_size);
+                sink.field("new_offset", hunk.new_offset);
+                sink.field("new_size", hunk.new_size);
+                sink.end_record();
+            }
+        }
+        sink.end_list();
+
+        visit_names("imports_added", diff.imports_added, sink);
+        visit_names("imports_removed", diff.imports_removed, sink);
+        visit_names("exports_added", diff.exports_added, sink);
+        visit_names("exports_removed", diff.exports_removed, sink);
+
+        sink.begin_list("exports_moved");
+        for (const PEExportChange& change : diff.exports_moved)
+        {
+            sink.begin_list_record();
+            sink.field("name", change.name);
+            sink.field("old_rva", change.old_rva);
+            sink.field("new_rva", change.new_rva);
+            sink.end_record();
+        }
+        sink.end_list();
+
+        return true;
+    }
+
+    template<typename Sink>
+    bool write_diff_with(const std::string& old_path, ByteSource& old_source, const std::string& new_path, ByteSource& new_source, const ReportOptions& options, std::string& out)
+    {
+        Sink sink(new_path, out);
+        bool valid = visit_diff(old_path, old_source, new_source, options, sink);
+        sink.finish();
+
+        return valid;
+    }
+
+    template<typename Sink>
+    bool write_with(const std::string& path, ByteSource& source, Arena* arena, const ReportOptions& options, std::string& out)
+    {
+        Sink sink(path, out);
+        BinaryKind kind = detect_format(source);
+
+        // Unrecognized files go through the PE parser, its diagnostics say what's wrong with them
+        sink.field("format", format_name(kind == BinaryKind::Unknown ? BinaryKind::PE : kind));
+        bool valid = kind == BinaryKind::ELF ? visit_elf(source, arena, options, sink) : visit_pe(path, source, arena, options, sink);
+        sink.finish();
+
+        return valid;
+    }
+}
+
+void write_report_header(const ReportOptions& options, std::string& out)
+{
+    if(options.format == ReportFormat::CSV)
+        out += "file,record,index,field,value\n";
+}
+
+bool write_report(const std::string& path, ByteSource& source, const ReportOptions& options, std::string& out, Arena* arena)
+{
+    PROFILE_SCOPE("write_report");
+
+    if(options.format == ReportFormat::CSV)
+        return write_with<CsvSink>(path, source, arena, options, out);
+
+    return write_with<JsonSink>(path, source, arena, options, out);
+}
+
+void write_report_error(const std::string& path, const char* error, const ReportOptions& options, std::string& out)
+{
+    if(options.format == ReportFormat::CSV)
+    {
+        CsvSink sink(path, out);
+        sink.field("error", error);
+
+        return;
+    }
+
+    JsonSink sink(path, out);
+    sink.field("error", error);
+    sink.finish();
+}
+
+bool write_diff_report(const std::string& old_path, ByteSource& old_source, const std::string& new_path, ByteSource& new_source, const ReportOptions& options, std::string& out)
+{
+    PROFILE_SCOPE("write_diff_report");
+
+    if(options.format == ReportFormat::CSV)
+        return write_diff_with<CsvSink>(old_path, old_source, new_path, new_source, options, out);
+
+    return write_diff_with<JsonSink>(old_path, old_source, new_path, new_source, options, out);
+}
@@ -0,0 +1,47 @@
+/*
+* Headless report output for binaryview-cli
+*/
+
+#pragma once
+#include <string>
+#include "../core/byte_source.h"
+
+class Arena;
+class ThreadPool;
+class SignatureSet;
+
+enum class ReportFormat
+{
+    JSON, // One object per line (JSON Lines) so batches can be streamed
+    CSV   // file,record,index,field,value rows
+};
+
+struct ReportOptions
+{
+    ReportFormat format = ReportFormat::JSON;
+    bool directories = true; // Imports, exports, resources, TLS, debug and relocation/exception counts
+    bool entropy = true;     // File, per-section and min/max sliding window entropy
+    bool hashes = true;      // File and per-section digests, Authenticode and imphash
+    bool strings = true;
+    bool payloads = true;    // Files embedded in the sections and overlay
+    size_t min_string_length = 4;
+    bool all_strings = false; // Whole file instead of .rdata only
+    bool cache = false;       // Reuse and update the analysis cache of each file
+    std::string cache_directory; // Empty keeps caches next to the files
+    const SignatureSet* signatures = nullptr; // Compiled rules to scan every file with, nullptr skips the scan
+
+    ThreadPool* pool = nullptr; // Per-file parallelism, only worth it when there are fewer files than threads
+};
+
+// Written once before any report when the format needs it
+void write_report_header(const ReportOptions& options, std::string& out);
+
+// Appends the report for one file to out, picking the backend from its magic bytes. Returns false if the file isn't a
+// valid PE or ELF (an error record is still written). Parse results go to arena when one is given, the caller resets it.
+bool write_report(const std::string& path, ByteSource& source, const ReportOptions& options, std::string& out, Arena* arena = nullptr);
+
+// Error record for files that couldn't be opened
+void write_report_error(const std::string& path, const char* error, const ReportOptions& options, std::string& out);
+
+// Appends one record with the differences between two files, false if either isn't a valid PE (an error record is written)
+bool write_diff_report(const std::string& old_path, ByteSource& old_source, const std::string& new_path, ByteSource& new_source, const ReportOptions& options, std::string& out);
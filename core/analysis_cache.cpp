@@ -0,0 +1,253 @@
+#include "analysis_cache.h"
+#include "atomic_file.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+    const char magic[8] = { 'B', 'V', 'C', 'A', 'C', 'H', 'E', '1' };
+    const uint64_t block_alignment = 16;
+
+    const uint64_t edge_sample = 64 * 1024;
+    const uint64_t inner_sample = 4 * 1024;
+    const uint64_t inner_samples = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t format;
+        uint32_t block_count;
+        uint64_t size;
+        int64_t mtime;
+        uint8_t fingerprint[Sha256::digest_size];
+        uint8_t sha256[Sha256::digest_size]; // All zero if the writer didn't know it
+    };
+
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    void hash_range(ByteSource& source, uint64_t offset, uint64_t length, std::vector<uint8_t>& buffer, Sha256& sha256)
+    {
+        while(length > 0)
+        {
+            uint64_t chunk = std::min<uint64_t>(length, buffer.size());
+            uint64_t got = source.read(offset, buffer.data(), chunk);
+            if(got == 0)
+                break;
+
+            sha256.update(buffer.data(), got);
+            offset += got;
+            length -= got;
+        }
+    }
+
+    bool is_zero(const uint8_t* data, size_t size)
+    {
+        return std::all_of(data, data + size, [](uint8_t byte) { return byte == 0; });
+    }
+}
+
+bool make_cache_key(const std::string& path, ByteSource& source, CacheKey& key)
+{
+    std::error_code error;
+    auto mtime = std::filesystem::last_write_time(path, error);
+    if(error)
+        return false;
+
+    key.size = source.size();
+    key.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+
+    Sha256 sha256;
+    sha256.update(reinterpret_cast<const uint8_t*>(&key.size), sizeof(key.size));
+
+    std::vector<uint8_t> buffer(edge_sample);
+
+    // Small files are hashed whole, the samples would cover most of them anyway
+    if(key.size <= 2 * edge_sample + inner_samples * inner_sample)
+        hash_range(source, 0, key.size, buffer, sha256);
+    else
+    {
+        hash_range(source, 0, edge_sample, buffer, sha256);
+
+        uint64_t stride = (key.size - 2 * edge_sample) / inner_samples;
+        for (uint64_t i = 0; i < inner_samples; ++i)
+            hash_range(source, edge_sample + i * stride, inner_sample, buffer, sha256);
+
+        hash_range(source, key.size - edge_sample, edge_sample, buffer, sha256);
+    }
+
+    sha256.finish(key.fingerprint);
+
+    return true;
+}
+
+std::string default_cache_directory()
+{
+    if(const char* directory = std::getenv("BINARYVIEW_CACHE_DIR"))
+        return directory;
+
+#ifdef _WIN32
+    if(const char* local = std::getenv("LOCALAPPDATA"))
+        return (std::filesystem::path(local) / "BinaryView").string();
+#else
+    if(const char* xdg = std::getenv("XDG_CACHE_HOME"))
+        return (std::filesystem::path(xdg) / "binaryview").string();
+
+    if(const char* home = std::getenv("HOME"))
+        return (std::filesystem::path(home) / ".cache" / "binaryview").string();
+#endif
+
+    return {};
+}
+
+std::string cache_path(const std::string& directory, const std::string& file, const CacheKey& key)
+{
+    if(directory.empty())
+        return file + ".bvcache";
+
+    return (std::filesystem::path(directory) / (digest_hex(key.fingerprint, sizeof(key.fingerprint)) + ".bvcache")).string();
+}
+
+void CacheWriter::add(uint32_t id, const void* data, uint64_t size)
+{
+    blocks.push_back({ id, data, size });
+}
+
+bool CacheWriter::write(const std::string& path, uint32_t format, const CacheKey& key, const uint8_t* sha256)
+{
+    std::error_code error;
+    std::filesystem::path target(path);
+    if(target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), error);
+
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.format = format;
+    header.block_count = static_cast<uint32_t>(blocks.size());
+    header.size = key.size;
+    header.mtime = key.mtime;
+    std::memcpy(header.fingerprint, key.fingerprint, sizeof(header.fingerprint));
+
+    if(sha256 != nullptr)
+        std::memcpy(header.sha256, sha256, sizeof(header.sha256));
+
+    std::vector<Entry> entries;
+    uint64_t offset = sizeof(Header) + blocks.size() * sizeof(Entry);
+
+    for (const Pending& block : blocks)
+    {
+        offset = (offset + block_alignment - 1) & ~(block_alignment - 1);
+        entries.push_back({ block.id, 0, offset, block.size });
+        offset += block.size;
+    }
+
+    std::string write_error;
+
+    return replace_file(path, [&](std::FILE* file)
+    {
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        if(!entries.empty())
+            ok = ok && std::fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size();
+
+        uint64_t written = sizeof(Header) + entries.size() * sizeof(Entry);
+        const uint8_t padding[block_alignment] = {};
+
+        for (size_t i = 0; i < blocks.size() && ok; ++i)
+        {
+            ok = std::fwrite(padding, 1, entries[i].offset - written, file) == entries[i].offset - written;
+            if(blocks[i].size > 0)
+                ok = ok && std::fwrite(blocks[i].data, 1, blocks[i].size, file) == blocks[i].size;
+
+            written = entries[i].offset + blocks[i].size;
+        }
+
+        return ok;
+    }, write_error);
+}
+
+std::unique_ptr<CacheReader> CacheReader::open(const std::string& path, uint32_t format, const CacheKey& key, ByteSource& file)
+{
+    std::error_code error;
+    if(!std::filesystem::is_regular_file(path, error))
+        return nullptr;
+
+    std::unique_ptr<CacheReader> reader(new CacheReader());
+    reader->source = ByteSource::open(path);
+    if(reader->source == nullptr)
+        return nullptr;
+
+    const Header* header = reader->source->view_as<Header>(0);
+    if(header == nullptr || std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->format != format)
+        return nullptr;
+
+    if(header->size != key.size || std::memcmp(header->fingerprint, key.fingerprint, sizeof(key.fingerprint)) != 0)
+        return nullptr;
+
+    Span<Entry> entries = reader->source->view_array<Entry>(sizeof(Header), header->block_count);
+    if(header->block_count > 0 && entries.empty())
+        return nullptr;
+
+    for (const Entry& entry : entries)
+    {
+        if(entry.offset % block_alignment != 0 || entry.offset > reader->source->size() || entry.size > reader->source->size() - entry.offset)
+            return nullptr;
+    }
+
+    if(header->mtime != key.mtime)
+    {
+        if(is_zero(header->sha256, sizeof(header->sha256)))
+            return nullptr;
+
+        Sha256 sha256;
+        std::vector<uint8_t> buffer(1 << 20);
+        hash_range(file, 0, file.size(), buffer, sha256);
+
+        uint8_t digest[Sha256::digest_size];
+        sha256.finish(digest);
+
+        if(std::memcmp(digest, header->sha256, sizeof(digest)) != 0)
+            return nullptr;
+
+        // Same contents, storing the new time lets the next open skip the hashing
+        if(std::FILE* update = std::fopen(path.c_str(), "r+b"))
+        {
+            if(std::fseek(update, offsetof(Header, mtime), SEEK_SET) == 0)
+                std::fwrite(&key.mtime, sizeof(key.mtime), 1, update);
+
+            std::fclose(update);
+        }
+    }
+
+    reader->table = ByteSpan(reinterpret_cast<const uint8_t*>(entries.data()), entries.size() * sizeof(Entry));
+
+    return reader;
+}
+
+bool CacheReader::has(uint32_t id) const
+{
+    Span<Entry> entries(reinterpret_cast<const Entry*>(table.data()), table.size() / sizeof(Entry));
+
+    return std::any_of(entries.begin(), entries.end(), [id](const Entry& entry) { return entry.id == id; });
+}
+
+ByteSpan CacheReader::block(uint32_t id) const
+{
+    Span<Entry> entries(reinterpret_cast<const Entry*>(table.data()), table.size() / sizeof(Entry));
+
+    for (const Entry& entry : entries)
+    {
+        if(entry.id == id)
+            return source->view(entry.offset, entry.size);
+    }
+
+    return {};
+}
@@ -0,0 +1,83 @@
+/*
+* On-disk analysis cache
+* A cache file is a header identifying the file it was written for, a table of blocks and the blocks themselves, 16 byte
+* aligned so a mapped cache can be used in place. What the blocks hold is up to the format using it.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "byte_source.h"
+#include "hash.h"
+
+// Identity of a file: a SHA-256 over its size and about 384 KB sampled from the start, the end and evenly in between, so
+// it can be computed in well under a millisecond no matter how large the file is
+struct CacheKey
+{
+    uint8_t fingerprint[Sha256::digest_size];
+    uint64_t size;
+    int64_t mtime; // Only checked to skip hashing the whole file, see CacheReader::open
+};
+
+bool make_cache_key(const std::string& path, ByteSource& source, CacheKey& key);
+
+// $BINARYVIEW_CACHE_DIR, else $XDG_CACHE_HOME/binaryview or ~/.cache/binaryview (%LOCALAPPDATA%\BinaryView on Windows),
+// empty if none of them is set
+std::string default_cache_directory();
+
+// <directory>/<fingerprint>.bvcache, or <file>.bvcache next to the file when directory is empty
+std::string cache_path(const std::string& directory, const std::string& file, const CacheKey& key);
+
+class CacheWriter
+{
+public:
+    // data has to stay valid until write()
+    void add(uint32_t id, const void* data, uint64_t size);
+
+    template<typename T>
+    void add_array(uint32_t id, const T* data, size_t count) { add(id, data, count * sizeof(T)); }
+
+    // sha256 is the digest of the whole file or nullptr if it isn't known. Written to a temporary file and renamed over
+    // path, a reader never sees a partial cache.
+    bool write(const std::string& path, uint32_t format, const CacheKey& key, const uint8_t* sha256);
+
+private:
+    struct Pending
+    {
+        uint32_t id;
+        const void* data;
+        uint64_t size;
+    };
+
+    std::vector<Pending> blocks;
+};
+
+class CacheReader
+{
+public:
+    // nullptr unless path is a well formed cache of this format written for a file with the same size and fingerprint.
+    // If the modification time changed too (a copy, a touch, an edit the samples missed) the whole file is hashed and has
+    // to match the digest the cache was written with.
+    static std::unique_ptr<CacheReader> open(const std::string& path, uint32_t format, const CacheKey& key, ByteSource& file);
+
+    bool has(uint32_t id) const;
+
+    // Views into the mapped cache, empty if the block is missing (or its size isn't a multiple of T, or it isn't aligned for T)
+    ByteSpan block(uint32_t id) const;
+
+    template<typename T>
+    Span<T> block_array(uint32_t id) const
+    {
+        ByteSpan span = block(id);
+        if(span.size() % sizeof(T) != 0 || !ByteSource::is_aligned<T>(span.data()))
+            return {};
+
+        return Span<T>(reinterpret_cast<const T*>(span.data()), span.size() / sizeof(T));
+    }
+
+private:
+    std::unique_ptr<ByteSource> source;
+    ByteSpan table; // Block entries, checked against the size of the cache by open()
+};
@@ -0,0 +1,84 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstring>
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(!chunks.empty())
+    {
+        Chunk& chunk = chunks.back();
+        size_t start = (reinterpret_cast<uintptr_t>(chunk.data.get()) + position + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(chunk.data.get());
+
+        if(start <= chunk.size && size <= chunk.size - start)
+        {
+            position = start + size;
+            used_ += size;
+
+            return chunk.data.get() + start;
+        }
+    }
+
+    // new[] only aligns to the fundamental alignment, anything stricter gets slack at the front
+    size_t chunk_size = chunks.empty() ? first_chunk : std::min(chunks.back().size * 2, max_chunk);
+    chunk_size = std::max(chunk_size, size + alignment);
+
+    chunks.push_back({ std::unique_ptr<uint8_t[]>(new uint8_t[chunk_size]), chunk_size });
+
+    Chunk& chunk = chunks.back();
+    size_t start = (reinterpret_cast<uintptr_t>(chunk.data.get()) + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(chunk.data.get());
+
+    position = start + size;
+    used_ += size;
+
+    return chunk.data.get() + start;
+}
+
+std::string_view Arena::copy(std::string_view text)
+{
+    if(text.empty())
+        return {};
+
+    char* out = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(out, text.data(), text.size());
+
+    return std::string_view(out, text.size());
+}
+
+void Arena::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto largest = std::max_element(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) { return a.size < b.size; });
+
+    if(largest != chunks.end() && largest->size <= retained_limit)
+    {
+        Chunk kept = std::move(*largest);
+        chunks.clear();
+        chunks.push_back(std::move(kept));
+    }
+    else
+        chunks.clear();
+
+    position = 0;
+    used_ = 0;
+}
+
+uint64_t Arena::memory_usage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t total = chunks.capacity() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks)
+        total += chunk.size;
+
+    return total;
+}
+
+uint64_t Arena::used() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return used_;
+}
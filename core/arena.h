@@ -0,0 +1,83 @@
+/*
+* Bump allocator for the results of parsing one file
+* Tables, string lists and copied names are carved out of a few large chunks instead of one heap block each, nothing is
+* freed on its own and reset() drops everything at once. Batch workers keep one arena and reset it between files, so the
+* chunks are reused instead of going back to the allocator. Allocation takes a lock, a parser can be called from the
+* analysis worker and the render thread.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+class Arena
+{
+public:
+    Arena() = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    // Copy that lives until the next reset
+    std::string_view copy(std::string_view text);
+
+    // Frees everything allocated so far. The largest chunk is kept for the next file unless it's bigger than
+    // retained_limit, whatever pointed into the arena must be gone by then.
+    void reset();
+
+    // Bytes reserved in chunks, and how many of them have been handed out
+    uint64_t memory_usage() const;
+    uint64_t used() const;
+
+    static constexpr size_t first_chunk = 64 * 1024;
+    static constexpr size_t max_chunk = 4 * 1024 * 1024;      // Chunks double up to this, bigger requests get one of their own
+    static constexpr size_t retained_limit = 16 * 1024 * 1024;
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Chunk> chunks; // The last one is being filled
+    size_t position = 0;       // In the last chunk
+    uint64_t used_ = 0;
+};
+
+// Standard allocator over an arena, deallocation is a no-op. Containers that grow leave their old buffers behind until
+// the reset, at most as much again as they end up holding.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena) : arena_(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    Arena* arena() const { return arena_; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    Arena* arena_;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,32 @@
+#include "atomic_file.h"
+#include <filesystem>
+#include <random>
+
+bool replace_file(const std::string& path, const std::function<bool(std::FILE* file)>& write, std::string& error)
+{
+    // Random suffix so two instances saving the same file don't write into each other's temporary
+    std::string temporary = path + ".tmp" + std::to_string(std::random_device()());
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if(file == nullptr)
+    {
+        error = "can't create " + temporary;
+        return false;
+    }
+
+    bool ok = write(file);
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code rename_error;
+    if(ok)
+        std::filesystem::rename(temporary, path, rename_error);
+
+    if(!ok || rename_error)
+    {
+        error = ok ? "can't replace " + path + ": " + rename_error.message() : "can't write " + temporary;
+        std::filesystem::remove(temporary, rename_error);
+
+        return false;
+    }
+
+    return true;
+}
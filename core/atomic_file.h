@@ -0,0 +1,14 @@
+/*
+* Files replaced in one step
+* Everything is written to a temporary next to the target, which is renamed over it once the writes and the close
+* succeeded. Readers, and a crash halfway through, see either the old file or the new one.
+*/
+
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// write fills the temporary and returns false if it failed. On any failure the temporary is removed, path is untouched
+// and error says what went wrong.
+bool replace_file(const std::string& path, const std::function<bool(std::FILE* file)>& write, std::string& error);
@@ -0,0 +1,95 @@
+#include "background_analysis.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+BackgroundAnalysis::~BackgroundAnalysis()
+{
+    cancel();
+    wait();
+}
+
+void BackgroundAnalysis::start(std::vector<Stage> stages)
+{
+    wait();
+
+    stages_ = std::move(stages);
+    slots.reset(new Slot[stages_.size()]);
+
+    cancel_.store(false, std::memory_order_relaxed);
+    finished_.store(false, std::memory_order_release);
+
+    pool_.submit([this] { run(); });
+}
+
+void BackgroundAnalysis::run()
+{
+    bool stopped = false;
+
+    for (size_t i = 0; i < stages_.size(); ++i)
+    {
+        Slot& slot = slots[i];
+
+        if(stopped || cancelled())
+        {
+            slot.state.store(static_cast<uint8_t>(StageState::Cancelled), std::memory_order_release);
+            stopped = true;
+
+            continue;
+        }
+
+        slot.state.store(static_cast<uint8_t>(StageState::Running), std::memory_order_release);
+
+        const char* error;
+        {
+            PROFILE_SCOPE(stages_[i].name);
+            error = stages_[i].run();
+        }
+
+        if(error != nullptr)
+        {
+            slot.error.store(error, std::memory_order_release);
+            slot.state.store(static_cast<uint8_t>(StageState::Failed), std::memory_order_release);
+            stopped = true;
+        }
+        else if(cancelled())
+        {
+            // Whatever the stage produced may be partial
+            slot.state.store(static_cast<uint8_t>(StageState::Cancelled), std::memory_order_release);
+            stopped = true;
+        }
+        else
+        {
+            // Publishes everything the stage wrote
+            slot.state.store(static_cast<uint8_t>(StageState::Done), std::memory_order_release);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished_.store(true, std::memory_order_release);
+    finished_cv.notify_all();
+}
+
+void BackgroundAnalysis::cancel()
+{
+    cancel_.store(true, std::memory_order_relaxed);
+}
+
+void BackgroundAnalysis::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished_cv.wait(lock, [this] { return finished_.load(std::memory_order_acquire); });
+}
+
+float BackgroundAnalysis::progress(size_t stage) const
+{
+    if(state(stage) == StageState::Done)
+        return 1.0f;
+
+    uint64_t total = slots[stage].total.load(std::memory_order_relaxed);
+    if(total == 0)
+        return 0.0f;
+
+    uint64_t done = slots[stage].done.load(std::memory_order_relaxed);
+
+    return done >= total ? 1.0f : static_cast<float>(static_cast<double>(done) / total);
+}
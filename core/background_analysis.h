@@ -0,0 +1,87 @@
+/*
+* Runs a file's analysis stages on the thread pool
+* Each stage publishes its state and progress through atomics. The render thread polls them every frame without taking a
+* lock and only touches a stage's results once it reads Done, the release/acquire pair on the state makes them visible.
+*/
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ThreadPool;
+
+enum class StageState : uint8_t
+{
+    Pending,
+    Running,
+    Done,
+    Failed,
+    Cancelled
+};
+
+class BackgroundAnalysis
+{
+public:
+    struct Stage
+    {
+        const char* name;
+        std::function<const char*()> run; // Returns nullptr on success or a static error message, a failure skips the remaining stages
+    };
+
+    explicit BackgroundAnalysis(ThreadPool& pool) : pool_(pool) {}
+    ~BackgroundAnalysis(); // Cancels and waits, stages may still be using what they captured
+
+    BackgroundAnalysis(const BackgroundAnalysis&) = delete;
+    BackgroundAnalysis& operator=(const BackgroundAnalysis&) = delete;
+
+    // Stages run in order on one pool task, they can use the pool themselves
+    void start(std::vector<Stage> stages);
+
+    // Stages notice at their next check, everything that hasn't finished ends up Cancelled
+    void cancel();
+    void wait();
+
+    bool cancelled() const { return cancel_.load(std::memory_order_relaxed); }
+    const std::atomic<bool>& cancel_flag() const { return cancel_; }
+
+    size_t stage_count() const { return stages_.size(); }
+    const char* stage_name(size_t stage) const { return stages_[stage].name; }
+    StageState state(size_t stage) const { return static_cast<StageState>(slots[stage].state.load(std::memory_order_acquire)); }
+    bool ready(size_t stage) const { return state(stage) == StageState::Done; }
+    const char* error(size_t stage) const { return slots[stage].error.load(std::memory_order_acquire); }
+
+    // Fraction done, 0 until the stage reports a total
+    float progress(size_t stage) const;
+
+    bool finished() const { return finished_.load(std::memory_order_acquire); }
+
+    // For stages, done can also be bumped directly through the counter from worker threads
+    void set_total(size_t stage, uint64_t total) { slots[stage].total.store(total, std::memory_order_relaxed); }
+    std::atomic<uint64_t>& done_counter(size_t stage) { return slots[stage].done; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint8_t> state{ static_cast<uint8_t>(StageState::Pending) };
+        std::atomic<uint64_t> done{ 0 };
+        std::atomic<uint64_t> total{ 0 };
+        std::atomic<const char*> error{ nullptr };
+    };
+
+    void run();
+
+    ThreadPool& pool_;
+    std::vector<Stage> stages_;
+    std::unique_ptr<Slot[]> slots;
+
+    std::atomic<bool> cancel_{ false };
+    std::atomic<bool> finished_{ true };
+
+    std::mutex mutex;
+    std::condition_variable finished_cv;
+};
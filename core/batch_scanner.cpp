@@ -0,0 +1,106 @@
+#include "batch_scanner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+// Files are handed out in small consecutive batches so ordered output only has to hold back a few batches at a time
+static const size_t batch_size = 8;
+
+ScanStats BatchScanner::run(const std::vector<std::string>& files, const Job& job, OutputSink& sink, bool ordered)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // One context per worker plus one for the calling thread, which helps while it waits
+    std::vector<ScanContext> contexts(pool_.size() + 1);
+
+    for (size_t i = 0; i < contexts.size(); ++i)
+        contexts[i].worker = i;
+
+    std::atomic<size_t> next_file{ 0 };
+
+    std::mutex sink_mutex;
+    std::map<size_t, std::string> held_back; // Finished batches waiting for earlier ones in ordered mode
+    size_t next_batch = 0;
+
+    auto emit = [&](size_t batch, std::string& output)
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+
+        if(!ordered)
+        {
+            sink.write(output);
+
+            return;
+        }
+
+        if(batch != next_batch)
+        {
+            held_back.emplace(batch, std::move(output));
+
+            return;
+        }
+
+        sink.write(output);
+        ++next_batch;
+
+        for (auto it = held_back.begin(); it != held_back.end() && it->first == next_batch; it = held_back.erase(it))
+        {
+            sink.write(it->second);
+            ++next_batch;
+        }
+    };
+
+    auto work = [&]
+    {
+        ScanContext& context = contexts[pool_.current_worker()];
+        ScanStats& local = context.stats;
+
+        while(true)
+        {
+            size_t begin = next_file.fetch_add(batch_size, std::memory_order_relaxed);
+            if(begin >= files.size())
+                return;
+
+            size_t end = std::min(files.size(), begin + batch_size);
+
+            context.output.clear();
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                std::unique_ptr<ByteSource> source = ByteSource::open(files[i]);
+
+                if(!job(context, files[i], source.get(), context.output))
+                    ++local.failures;
+
+                ++local.files;
+                if(source != nullptr)
+                    local.bytes += source->size();
+            }
+
+            emit(begin / batch_size, context.output);
+        }
+    };
+
+    {
+        TaskGroup group(pool_);
+
+        for (size_t i = 0; i < pool_.size(); ++i)
+            group.run(work);
+
+        group.wait();
+    }
+
+    ScanStats total;
+    for (const ScanContext& context : contexts)
+    {
+        total.files += context.stats.files;
+        total.failures += context.stats.failures;
+        total.bytes += context.stats.bytes;
+    }
+
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return total;
+}
@@ -0,0 +1,68 @@
+/*
+* Batch scanning of many files over the work-stealing pool
+* Every worker has its own ScanContext, nothing mutable is shared between workers except the output sink.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "byte_source.h"
+#include "thread_pool.h"
+
+struct ScanStats
+{
+    uint64_t files = 0;
+    uint64_t failures = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+
+    double files_per_second() const { return seconds > 0.0 ? files / seconds : 0.0; }
+    double mb_per_second() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+};
+
+// Per worker scratch state, reused for every file the worker handles. Cache line aligned so workers don't false share.
+struct alignas(64) ScanContext
+{
+    size_t worker = 0;
+    std::string output;
+    Arena arena; // Parse results of the current file
+    ScanStats stats;
+};
+
+// Receives formatted results, writes are serialized by the scanner
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+    virtual void write(const std::string& data) = 0;
+};
+
+class FileSink : public OutputSink
+{
+public:
+    FileSink(std::FILE* file) : file_(file) {}
+
+    void write(const std::string& data) override { std::fwrite(data.data(), 1, data.size(), file_); }
+
+private:
+    std::FILE* file_;
+};
+
+class BatchScanner
+{
+public:
+    // Appends the result for one file to out, source is nullptr if the file couldn't be opened. Returns false on failure.
+    using Job = std::function<bool(ScanContext& context, const std::string& path, ByteSource* source, std::string& out)>;
+
+    BatchScanner(ThreadPool& pool) : pool_(pool) {}
+
+    // ordered keeps results in the order of files, otherwise they're written as soon as a worker finishes them
+    ScanStats run(const std::vector<std::string>& files, const Job& job, OutputSink& sink, bool ordered);
+
+private:
+    ThreadPool& pool_;
+};
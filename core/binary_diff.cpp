@@ -0,0 +1,312 @@
+#include "binary_diff.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint32_t prime = 0x01000193;
+    const size_t progress_interval = 1 << 20;
+    const uint32_t no_block = UINT32_MAX;
+
+    // Candidates verified per hash hit, runs of identical blocks (padding) would otherwise make the scan quadratic
+    const int max_candidates = 16;
+
+    struct Match
+    {
+        uint64_t old_offset;
+        uint64_t new_offset;
+        uint64_t size;
+    };
+
+    size_t pick_block_size(size_t size)
+    {
+        size_t block = 32;
+        while(block < 1024 && size / block > (1 << 20))
+            block *= 2;
+
+        return block;
+    }
+
+    uint32_t hash_block(const uint8_t* data, size_t size)
+    {
+        uint32_t hash = 0;
+        for (size_t i = 0; i < size; ++i)
+            hash = hash * prime + data[i];
+
+        return hash;
+    }
+
+    size_t common_prefix(const uint8_t* a, const uint8_t* b, size_t limit)
+    {
+        size_t i = 0;
+        for (; i + 8 <= limit; i += 8)
+        {
+            uint64_t x;
+            uint64_t y;
+            std::memcpy(&x, a + i, 8);
+            std::memcpy(&y, b + i, 8);
+
+            if(x != y)
+                break;
+        }
+
+        while(i < limit && a[i] == b[i])
+            ++i;
+
+        return i;
+    }
+
+    // Counts back from a_end/b_end
+    size_t common_suffix(const uint8_t* a_end, const uint8_t* b_end, size_t limit)
+    {
+        size_t i = 0;
+        while(i < limit && a_end[-1 - static_cast<ptrdiff_t>(i)] == b_end[-1 - static_cast<ptrdiff_t>(i)])
+            ++i;
+
+        return i;
+    }
+
+    // Blocks of the old buffer by hash, chained so every block with the same hash stays reachable (lowest offset first)
+    class BlockIndex
+    {
+    public:
+        BlockIndex(const uint8_t* data, size_t size, size_t block)
+        {
+            size_t count = size / block;
+
+            size_t buckets = 1;
+            while(buckets < count * 2)
+                buckets *= 2;
+
+            mask = static_cast<uint32_t>(buckets - 1);
+            heads.assign(buckets, no_block);
+            hashes.resize(count);
+            chain.resize(count);
+
+            for (size_t i = count; i-- > 0;)
+            {
+                uint32_t hash = hash_block(data + i * block, block);
+                uint32_t bucket = hash & mask;
+
+                hashes[i] = hash;
+                chain[i] = heads[bucket];
+                heads[bucket] = static_cast<uint32_t>(i);
+            }
+        }
+
+        uint32_t first(uint32_t hash) const { return heads[hash & mask]; }
+        uint32_t next(uint32_t block) const { return chain[block]; }
+        uint32_t hash(uint32_t block) const { return hashes[block]; }
+
+    private:
+        uint32_t mask = 0;
+        std::vector<uint32_t> heads;
+        std::vector<uint32_t> hashes;
+        std::vector<uint32_t> chain;
+    };
+
+    void find_matches(const uint8_t* old_data, size_t old_size, const uint8_t* new_data, size_t new_size, const DiffOptions& options, std::vector<Match>& matches)
+    {
+        size_t block = options.block_size != 0 ? options.block_size : pick_block_size(std::max(old_size, new_size));
+        if(old_size < block || new_size < block)
+        {
+            if(options.progress != nullptr)
+                *options.progress += new_size;
+
+            return;
+        }
+
+        BlockIndex index(old_data, old_size, block);
+
+        uint32_t top = 1;
+        for (size_t i = 1; i < block; ++i)
+            top *= prime;
+
+        size_t position = 0;
+        size_t gap_start = 0;
+        uint64_t expected = 0; // Where the old buffer would continue if nothing had been inserted
+        size_t reported = 0;
+        uint32_t hash = hash_block(new_data, block);
+
+        while(position + block <= new_size)
+        {
+            if(position - reported >= progress_interval)
+            {
+                if(options.progress != nullptr)
+                    *options.progress += position - reported;
+
+                reported = position;
+
+                if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                    break;
+            }
+
+            // Of the blocks that really match, the one closest to where the old side should continue keeps the alignment straight
+            uint32_t best = no_block;
+            uint64_t best_distance = UINT64_MAX;
+            int candidates = 0;
+
+            for (uint32_t candidate = index.first(hash); candidate != no_block && candidates < max_candidates; candidate = index.next(candidate))
+            {
+                if(index.hash(candidate) != hash)
+                    continue;
+
+                ++candidates;
+
+                uint64_t offset = uint64_t(candidate) * block;
+                if(std::memcmp(old_data + offset, new_data + position, block) != 0)
+                    continue;
+
+                uint64_t distance = offset > expected ? offset - expected : expected - offset;
+                if(distance < best_distance)
+                {
+                    best = candidate;
+                    best_distance = distance;
+                }
+            }
+
+            if(best == no_block)
+            {
+                if(position + block < new_size)
+                    hash = (hash - new_data[position] * top) * prime + new_data[position + block];
+
+                ++position;
+                continue;
+            }
+
+            // Grown back into the unmatched bytes before it and forward as far as both sides agree
+            size_t old_start = size_t(best) * block;
+            size_t new_start = position;
+            size_t back = common_suffix(old_data + old_start, new_data + new_start, std::min(old_start, new_start - gap_start));
+            size_t forward = common_prefix(old_data + old_start + block, new_data + new_start + block, std::min(old_size - old_start, new_size - new_start) - block);
+
+            matches.push_back({ old_start - back, new_start - back, back + block + forward });
+
+            position = new_start + block + forward;
+            gap_start = position;
+            expected = old_start + block + forward;
+
+            if(position + block <= new_size)
+                hash = hash_block(new_data + position, block);
+        }
+
+        if(options.progress != nullptr)
+            *options.progress += new_size - reported;
+    }
+
+    // Heaviest chain of matches increasing on both sides without overlapping: matches are already ordered and disjoint in
+    // the new buffer, a Fenwick tree over the old end offsets gives the best chain ending before each match's old start
+    std::vector<Match> align(const std::vector<Match>& matches)
+    {
+        std::vector<uint64_t> ends;
+        for (const Match& match : matches)
+            ends.push_back(match.old_offset + match.size);
+
+        std::sort(ends.begin(), ends.end());
+        ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+
+        struct Best
+        {
+            uint64_t weight = 0;
+            size_t match = SIZE_MAX;
+        };
+
+        std::vector<Best> tree(ends.size() + 1);
+        std::vector<size_t> parent(matches.size(), SIZE_MAX);
+        Best overall;
+
+        for (size_t i = 0; i < matches.size(); ++i)
+        {
+            const Match& match = matches[i];
+
+            Best before;
+            for (size_t k = std::upper_bound(ends.begin(), ends.end(), match.old_offset) - ends.begin(); k > 0; k -= k & (~k + 1))
+            {
+                if(tree[k].weight > before.weight)
+                    before = tree[k];
+            }
+
+            Best current = { before.weight + match.size, i };
+            parent[i] = before.match;
+
+            if(current.weight > overall.weight)
+                overall = current;
+
+            for (size_t k = std::lower_bound(ends.begin(), ends.end(), match.old_offset + match.size) - ends.begin() + 1; k < tree.size(); k += k & (~k + 1))
+            {
+                if(current.weight > tree[k].weight)
+                    tree[k] = current;
+            }
+        }
+
+        std::vector<Match> chain;
+        for (size_t i = overall.match; i != SIZE_MAX; i = parent[i])
+            chain.push_back(matches[i]);
+
+        std::reverse(chain.begin(), chain.end());
+
+        return chain;
+    }
+
+    void push(std::vector<DiffHunk>& out, DiffKind kind, uint64_t old_offset, uint64_t old_size, uint64_t new_offset, uint64_t new_size)
+    {
+        if(old_size == 0 && new_size == 0)
+            return;
+
+        if(!out.empty())
+        {
+            DiffHunk& last = out.back();
+            if(last.kind == kind && last.old_offset + last.old_size == old_offset && last.new_offset + last.new_size == new_offset)
+            {
+                last.old_size += old_size;
+                last.new_size += new_size;
+                return;
+            }
+        }
+
+        out.push_back({ kind, old_offset, old_size, new_offset, new_size });
+    }
+
+    void push_gap(std::vector<DiffHunk>& out, uint64_t old_offset, uint64_t old_size, uint64_t new_offset, uint64_t new_size)
+    {
+        DiffKind kind = old_size != 0 && new_size != 0 ? DiffKind::Changed : (new_size != 0 ? DiffKind::Inserted : DiffKind::Deleted);
+
+        push(out, kind, old_offset, old_size, new_offset, new_size);
+    }
+}
+
+void diff_bytes(const uint8_t* old_data, size_t old_size, uint64_t old_base, const uint8_t* new_data, size_t new_size, uint64_t new_base,
+    const DiffOptions& options, std::vector<DiffHunk>& out)
+{
+    // Most of a patched binary is unchanged at either end, those parts never reach the index
+    size_t prefix = common_prefix(old_data, new_data, std::min(old_size, new_size));
+    size_t suffix = common_suffix(old_data + old_size, new_data + new_size, std::min(old_size, new_size) - prefix);
+
+    push(out, DiffKind::Equal, old_base, prefix, new_base, prefix);
+
+    const uint8_t* old_middle = old_data + prefix;
+    const uint8_t* new_middle = new_data + prefix;
+    size_t old_remaining = old_size - prefix - suffix;
+    size_t new_remaining = new_size - prefix - suffix;
+
+    if(options.progress != nullptr)
+        *options.progress += prefix + suffix;
+
+    std::vector<Match> matches;
+    find_matches(old_middle, old_remaining, new_middle, new_remaining, options, matches);
+
+    uint64_t old_position = 0;
+    uint64_t new_position = 0;
+
+    for (const Match& match : align(matches))
+    {
+        push_gap(out, old_base + prefix + old_position, match.old_offset - old_position, new_base + prefix + new_position, match.new_offset - new_position);
+        push(out, DiffKind::Equal, old_base + prefix + match.old_offset, match.size, new_base + prefix + match.new_offset, match.size);
+
+        old_position = match.old_offset + match.size;
+        new_position = match.new_offset + match.size;
+    }
+
+    push_gap(out, old_base + prefix + old_position, old_remaining - old_position, new_base + prefix + new_position, new_remaining - new_position);
+    push(out, DiffKind::Equal, old_base + old_size - suffix, suffix, new_base + new_size - suffix, suffix);
+}
@@ -0,0 +1,42 @@
+/*
+* Byte level diff of two buffers
+* The old buffer is cut into fixed size blocks indexed by a rolling hash, the new one is scanned a byte at a time and every
+* hash hit is verified and extended in both directions. The longest set of matches that keeps both sides in order becomes
+* the alignment, so content that moved by a few bytes lines up again instead of turning everything after it into one change.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class DiffKind : uint8_t
+{
+    Equal,
+    Changed,  // Both sides have bytes here, they differ
+    Inserted, // Only in the new buffer
+    Deleted   // Only in the old buffer
+};
+
+struct DiffHunk
+{
+    DiffKind kind;
+    uint64_t old_offset;
+    uint64_t old_size;
+    uint64_t new_offset;
+    uint64_t new_size;
+};
+
+struct DiffOptions
+{
+    size_t block_size = 0; // Shortest match that can be found, 0 picks one from the buffer size (32 to 1024 bytes)
+
+    // Checked and reported between 1 MB of the new buffer, a cancelled diff returns partial hunks
+    const std::atomic<bool>* cancel = nullptr;
+    std::atomic<uint64_t>* progress = nullptr; // Bytes of the new buffer scanned
+};
+
+// Appends hunks covering both buffers from start to end, in order. Offsets are buffer relative plus the bases.
+void diff_bytes(const uint8_t* old_data, size_t old_size, uint64_t old_base, const uint8_t* new_data, size_t new_size, uint64_t new_base,
+    const DiffOptions& options, std::vector<DiffHunk>& out);
@@ -0,0 +1,61 @@
+#include "binary_format.h"
+#include "../PE/PE.h"
+#include "../ELF/ELF.h"
+#include <cstring>
+
+namespace
+{
+    struct Backend
+    {
+        BinaryKind kind;
+        const char* name;
+        const char* magic;
+        size_t magic_size;
+    };
+
+    // Checked in order against the start of the file
+    const Backend backends[] = {
+        { BinaryKind::ELF, "ELF", "\x7F" "ELF", 4 },
+        { BinaryKind::PE, "PE", "MZ", 2 },
+    };
+}
+
+BinaryKind detect_format(ByteSource& source)
+{
+    for (const Backend& backend : backends)
+    {
+        ByteSpan start = source.view(0, backend.magic_size);
+
+        if(!start.empty() && std::memcmp(start.data(), backend.magic, backend.magic_size) == 0)
+            return backend.kind;
+    }
+
+    return BinaryKind::Unknown;
+}
+
+const char* format_name(BinaryKind kind)
+{
+    for (const Backend& backend : backends)
+    {
+        if(backend.kind == kind)
+            return backend.name;
+    }
+
+    return "Unknown";
+}
+
+std::unique_ptr<BinaryFormat> create_format(BinaryKind kind, ByteSource& source)
+{
+    if(kind == BinaryKind::ELF)
+        return std::make_unique<ELF>(source);
+
+    return std::make_unique<PE>(source);
+}
+
+std::unique_ptr<ViewState> create_view_state(BinaryKind kind)
+{
+    if(kind == BinaryKind::ELF)
+        return std::make_unique<ELFViewState>();
+
+    return std::make_unique<PEViewState>();
+}
@@ -0,0 +1,73 @@
+/*
+* Common interface of the executable format backends
+* Only what the workspace needs once per file goes through it: detection, the analysis stages, memory use and view state.
+* Headers, tables and symbols stay on the concrete parser classes, callers switch on kind() once per file and use those
+* directly, so reading a field never costs a virtual call.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "byte_source.h"
+#include "background_analysis.h"
+
+class ThreadPool;
+class PatchLayer;
+
+enum class BinaryKind : uint8_t
+{
+    Unknown,
+    PE,
+    ELF
+};
+
+// What the window shows for one file. The workspace keeps it while the parser is dropped and rebuilt, each backend
+// derives its own.
+struct ViewState
+{
+    virtual ~ViewState() = default;
+
+    // Embedded file the view asked to open as a document of its own, size 0 when none. The window takes it after
+    // rendering, see Workspace::open_embedded.
+    uint64_t openOffset = 0;
+    uint64_t openSize = 0;
+    std::string openLabel = "";
+
+    // Forgets everything pointing into the parser, called before it's destroyed
+    virtual void detach() {}
+};
+
+class BinaryFormat
+{
+public:
+    virtual ~BinaryFormat() = default;
+
+    virtual BinaryKind kind() const = 0;
+
+    // Stages for BackgroundAnalysis, see the backend for what each covers
+    virtual std::vector<BackgroundAnalysis::Stage> analysis_stages(BackgroundAnalysis& analysis) = 0;
+    virtual void set_analysis(const BackgroundAnalysis* background) = 0;
+
+    // Has to be the kind create_view_state() made for this backend
+    virtual void set_view_state(ViewState* state) = 0;
+    virtual void set_thread_pool(ThreadPool* pool) = 0;
+
+    // Analysis cache, backends without one ignore it
+    virtual void set_cache(const std::string&, const std::string&) {}
+
+    // Edits made in the views, owned by the workspace so they outlive the parser. Backends that can't save ignore it.
+    virtual void set_patches(PatchLayer*) {}
+
+    // Approximate heap use of everything parsed so far, not safe while analysis stages are running
+    virtual uint64_t memory_usage() = 0;
+};
+
+// Backend whose magic bytes start the file, Unknown if none matches
+BinaryKind detect_format(ByteSource& source);
+const char* format_name(BinaryKind kind);
+
+// Files no backend recognizes get the PE parser, its diagnostics explain what's wrong with them
+std::unique_ptr<BinaryFormat> create_format(BinaryKind kind, ByteSource& source);
+std::unique_ptr<ViewState> create_view_state(BinaryKind kind);
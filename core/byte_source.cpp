@@ -0,0 +1,297 @@
+#include "byte_source.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    using native_handle = HANDLE;
+    const native_handle invalid_handle = INVALID_HANDLE_VALUE;
+
+    void close_native(native_handle handle) { CloseHandle(handle); }
+#else
+    using native_handle = int;
+    const native_handle invalid_handle = -1;
+
+    void close_native(native_handle handle) { ::close(handle); }
+#endif
+
+    class MappedSource : public ByteSource
+    {
+    public:
+        MappedSource(const uint8_t* base, uint64_t size, void* mapping) : base_(base), size_(size), mapping_(mapping) {}
+
+        ~MappedSource() override
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(base_);
+            CloseHandle(static_cast<HANDLE>(mapping_));
+#else
+            munmap(const_cast<uint8_t*>(base_), size_);
+#endif
+        }
+
+        uint64_t size() const override { return size_; }
+        bool is_mapped() const override { return true; }
+
+        ByteSpan view(uint64_t offset, uint64_t length) override
+        {
+            return ByteSpan(base_, size_).subspan(offset, length);
+        }
+
+        uint64_t read(uint64_t offset, void* dst, uint64_t length) override
+        {
+            if(offset >= size_)
+                return 0;
+
+            if(length > size_ - offset)
+                length = size_ - offset;
+
+            std::memcpy(dst, base_ + offset, length);
+            PROFILE_COUNT("bytes read", length);
+
+            return length;
+        }
+
+    private:
+        const uint8_t* base_;
+        uint64_t size_;
+        void* mapping_; // Only used on Windows, the file mapping object
+    };
+
+    class MemorySource : public ByteSource
+    {
+    public:
+        MemorySource(const uint8_t* data, uint64_t size) : data_(data), size_(size) {}
+
+        uint64_t size() const override { return size_; }
+        bool is_mapped() const override { return true; }
+
+        ByteSpan view(uint64_t offset, uint64_t length) override
+        {
+            return ByteSpan(data_, size_).subspan(offset, length);
+        }
+
+        uint64_t read(uint64_t offset, void* dst, uint64_t length) override
+        {
+            if(offset >= size_)
+                return 0;
+
+            if(length > size_ - offset)
+                length = size_ - offset;
+
+            std::memcpy(dst, data_ + offset, length);
+
+            return length;
+        }
+
+    private:
+        const uint8_t* data_;
+        uint64_t size_;
+    };
+
+    // Used when mmap isn't available (pipes, some network filesystems, empty files).
+    // Views are read once and pinned so they remain valid like a mapping would, passes over the whole file use chunk().
+    class PreadSource : public ByteSource
+    {
+    public:
+        PreadSource(native_handle handle, uint64_t size) : handle_(handle), size_(size) {}
+
+        ~PreadSource() override { close_native(handle_); }
+
+        uint64_t size() const override { return size_; }
+        bool is_mapped() const override { return false; }
+
+        ByteSpan view(uint64_t offset, uint64_t length) override
+        {
+            if(length == 0 || offset > size_ || length > size_ - offset)
+                return {};
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            std::unique_ptr<uint8_t[]>& buffer = pinned_[{ offset, length }];
+            if(buffer == nullptr)
+            {
+                buffer.reset(new uint8_t[length]);
+
+                if(read_at(offset, buffer.get(), length) != length)
+                {
+                    pinned_.erase({ offset, length });
+
+                    return {};
+                }
+            }
+
+            return ByteSpan(buffer.get(), length);
+        }
+
+        uint64_t read(uint64_t offset, void* dst, uint64_t length) override
+        {
+            if(offset >= size_)
+                return 0;
+
+            if(length > size_ - offset)
+                length = size_ - offset;
+
+            return read_at(offset, static_cast<uint8_t*>(dst), length);
+        }
+
+    private:
+        uint64_t read_at(uint64_t offset, uint8_t* dst, uint64_t length)
+        {
+            uint64_t total = 0;
+
+            while(total < length)
+            {
+#ifdef _WIN32
+                OVERLAPPED overlapped = {};
+                overlapped.Offset = static_cast<DWORD>(offset + total);
+                overlapped.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+
+                DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(length - total, 1u << 30));
+                DWORD got = 0;
+                if(!ReadFile(handle_, dst + total, chunk, &got, &overlapped) || got == 0)
+                    break;
+#else
+                ssize_t got = ::pread(handle_, dst + total, length - total, static_cast<off_t>(offset + total));
+                if(got <= 0)
+                    break;
+#endif
+                total += got;
+            }
+
+            PROFILE_COUNT("bytes read", total);
+
+            return total;
+        }
+
+        native_handle handle_;
+        uint64_t size_;
+
+        std::mutex mutex_;
+        std::map<std::pair<uint64_t, uint64_t>, std::unique_ptr<uint8_t[]>> pinned_;
+    };
+
+    class SliceSource : public ByteSource
+    {
+    public:
+        SliceSource(std::shared_ptr<ByteSource> parent, uint64_t offset, uint64_t size) : parent_(std::move(parent)), offset_(offset), size_(size) {}
+
+        uint64_t size() const override { return size_; }
+        bool is_mapped() const override { return parent_->is_mapped(); }
+
+        ByteSpan view(uint64_t offset, uint64_t length) override
+        {
+            if(offset > size_ || length > size_ - offset)
+                return {};
+
+            return parent_->view(offset_ + offset, length);
+        }
+
+        uint64_t read(uint64_t offset, void* dst, uint64_t length) override
+        {
+            if(offset >= size_)
+                return 0;
+
+            return parent_->read(offset_ + offset, dst, std::min(length, size_ - offset));
+        }
+
+    private:
+        std::shared_ptr<ByteSource> parent_;
+        uint64_t offset_;
+        uint64_t size_;
+    };
+}
+
+std::unique_ptr<ByteSource> ByteSource::open(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(handle == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size = {};
+    if(!GetFileSizeEx(handle, &file_size))
+    {
+        CloseHandle(handle);
+
+        return nullptr;
+    }
+
+    uint64_t size = static_cast<uint64_t>(file_size.QuadPart);
+
+    if(size != 0)
+    {
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping != nullptr)
+        {
+            void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if(base != nullptr)
+            {
+                CloseHandle(handle); // The mapping keeps the file alive
+
+                return std::make_unique<MappedSource>(static_cast<const uint8_t*>(base), size, mapping);
+            }
+
+            CloseHandle(mapping);
+        }
+    }
+
+    return std::make_unique<PreadSource>(handle, size);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == invalid_handle)
+        return nullptr;
+
+    struct stat st = {};
+    if(fstat(fd, &st) != 0 || S_ISDIR(st.st_mode))
+    {
+        ::close(fd);
+
+        return nullptr;
+    }
+
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+
+    if(size != 0 && S_ISREG(st.st_mode))
+    {
+        void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(base != MAP_FAILED)
+        {
+            ::close(fd); // The mapping keeps the file alive
+
+            return std::make_unique<MappedSource>(static_cast<const uint8_t*>(base), size, nullptr);
+        }
+    }
+
+    return std::make_unique<PreadSource>(fd, size);
+#endif
+}
+
+std::unique_ptr<ByteSource> ByteSource::from_memory(const uint8_t* data, uint64_t size)
+{
+    return std::make_unique<MemorySource>(data, size);
+}
+
+std::unique_ptr<ByteSource> ByteSource::slice(std::shared_ptr<ByteSource> parent, uint64_t offset, uint64_t size)
+{
+    offset = std::min(offset, parent->size());
+    size = std::min(size, parent->size() - offset);
+
+    return std::make_unique<SliceSource>(std::move(parent), offset, size);
+}
@@ -0,0 +1,110 @@
+/*
+* Read-only backing store for the parsers
+* Files are memory-mapped so headers, sections and strings are views into the mapping instead of copies.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "span.h"
+
+class ByteSource
+{
+public:
+    virtual ~ByteSource() = default;
+
+    // Maps the file read-only, falls back to buffered pread if it can't be mapped. Returns nullptr if the file can't be opened.
+    static std::unique_ptr<ByteSource> open(const std::string& path);
+
+    // Wraps a buffer the caller keeps alive (fuzzing, benchmarks, generated images), nothing is copied
+    static std::unique_ptr<ByteSource> from_memory(const uint8_t* data, uint64_t size);
+
+    // [offset, offset + size) of parent (cut at its end) as a source of its own, for files embedded in others. Views and
+    // reads go to parent, which the slice keeps alive, nothing is copied.
+    static std::unique_ptr<ByteSource> slice(std::shared_ptr<ByteSource> parent, uint64_t offset, uint64_t size);
+
+    virtual uint64_t size() const = 0;
+    virtual bool is_mapped() const = 0;
+
+    // Views stay valid for the lifetime of the source. Empty if [offset, offset + length) is out of bounds.
+    virtual ByteSpan view(uint64_t offset, uint64_t length) = 0;
+
+    // Copies up to length bytes into dst, returns the amount copied (short at the end of the file)
+    virtual uint64_t read(uint64_t offset, void* dst, uint64_t length) = 0;
+
+    // For passes over large ranges: a view when the source is mapped, otherwise a copy in buffer so nothing is pinned. Valid
+    // until the next call with the same buffer, empty if [offset, offset + length) is out of bounds.
+    ByteSpan chunk(uint64_t offset, uint64_t length, std::vector<uint8_t>& buffer)
+    {
+        if(is_mapped())
+            return view(offset, length);
+
+        if(length == 0 || offset > size() || length > size() - offset)
+            return {};
+
+        buffer.resize(length);
+        if(read(offset, buffer.data(), length) != length)
+            return {};
+
+        return ByteSpan(buffer.data(), length);
+    }
+
+    // Views of a T are nullptr (empty) when offset isn't aligned for T in memory, like when they're out of bounds. Headers in
+    // untrusted files, or in files embedded at odd offsets, can sit anywhere: read_as and the copying view_array take any offset.
+    template<typename T>
+    const T* view_as(uint64_t offset)
+    {
+        ByteSpan span = view(offset, sizeof(T));
+        if(span.empty() || !is_aligned<T>(span.data()))
+            return nullptr;
+
+        return reinterpret_cast<const T*>(span.data());
+    }
+
+    template<typename T>
+    Span<T> view_array(uint64_t offset, uint64_t count)
+    {
+        if(count > size() / sizeof(T))
+            return {};
+
+        ByteSpan span = view(offset, count * sizeof(T));
+        if(span.empty() || !is_aligned<T>(span.data()))
+            return {};
+
+        return Span<T>(reinterpret_cast<const T*>(span.data()), count);
+    }
+
+    // Copies a T from any offset, false if it's out of bounds
+    template<typename T>
+    bool read_as(uint64_t offset, T& out)
+    {
+        return read(offset, &out, sizeof(T)) == sizeof(T);
+    }
+
+    // A view when the table is aligned, otherwise a copy in fallback. Empty if it's out of bounds.
+    template<typename T, typename Allocator>
+    Span<T> view_array(uint64_t offset, uint64_t count, std::vector<T, Allocator>& fallback)
+    {
+        Span<T> span = view_array<T>(offset, count);
+        if(!span.empty() || count == 0 || count > size() / sizeof(T))
+            return span;
+
+        fallback.resize(count);
+        if(read(offset, fallback.data(), count * sizeof(T)) != count * sizeof(T))
+        {
+            fallback.clear();
+
+            return {};
+        }
+
+        return Span<T>(fallback.data(), count);
+    }
+
+    template<typename T>
+    static bool is_aligned(const uint8_t* data)
+    {
+        return reinterpret_cast<uintptr_t>(data) % alignof(T) == 0;
+    }
+};
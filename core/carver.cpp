@@ -0,0 +1,444 @@
+#include "carver.h"
+#include "profiler.h"
+#include "signature_scanner.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+    // Rules follow PayloadKind, strings of the ZIP rule follow zip_*_string
+    const char magic_rules[] =
+        "rule PE { strings: $mz = \"MZ\" }\n"
+        "rule ZIP { strings: $local = { 50 4B 03 04 } $end = { 50 4B 05 06 } }\n"
+        "rule SevenZip { strings: $signature = { 37 7A BC AF 27 1C } }\n"
+        "rule CAB { strings: $signature = { 4D 53 43 46 00 00 00 00 } }\n"
+        "rule Compound { strings: $signature = { D0 CF 11 E0 A1 B1 1A E1 } }\n";
+
+    const uint32_t zip_local_string = 0;
+    const uint32_t zip_end_string = 1;
+    const uint16_t zip_reserved_flags = 0xD780;
+    const uint32_t max_zip_name = 1024;
+
+    const uint32_t max_lfanew = 0x10000;
+    const uint32_t max_sections = 96; // What the loader accepts
+    const uint32_t max_sector_size = 4096;
+    const uint32_t free_sector = 0xFFFFFFFF;
+    const uint32_t max_regular_sector = 0xFFFFFFFA;
+
+    const SignatureSet& magics()
+    {
+        static const SignatureSet set = []()
+        {
+            SignatureSet compiled;
+            std::string error;
+
+            compiled.parse(magic_rules, error);
+            compiled.compile(error);
+
+            return compiled;
+        }();
+
+        return set;
+    }
+
+    uint16_t read_u16_le(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t read_u32_le(const uint8_t* p)
+    {
+        return p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    uint64_t read_u64_le(const uint8_t* p)
+    {
+        return read_u32_le(p) | (uint64_t(read_u32_le(p + 4)) << 32);
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= data[i];
+
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+        }
+
+        return ~crc;
+    }
+
+    // Headers are only read inside the swept range
+    bool read_exact(ByteSource& source, uint64_t offset, uint64_t end, void* dst, uint64_t length)
+    {
+        return offset <= end && length <= end - offset && source.read(offset, dst, length) == length;
+    }
+
+    // End of the headers, the last section's raw data or the certificates appended after it, 0 if it's not a PE
+    uint64_t pe_size(ByteSource& source, uint64_t offset, uint64_t end)
+    {
+        uint8_t dos[64];
+        if(!read_exact(source, offset, end, dos, sizeof(dos)))
+            return 0;
+
+        uint32_t e_lfanew = read_u32_le(dos + 0x3C);
+        if(e_lfanew < 4 || e_lfanew > max_lfanew)
+            return 0;
+
+        // Signature, file header and a PE32+ optional header with every data directory
+        uint8_t nt[4 + 20 + 240];
+        if(!read_exact(source, offset + e_lfanew, end, nt, sizeof(nt)) || std::memcmp(nt, "PE\0\0", 4) != 0)
+            return 0;
+
+        uint16_t section_count = read_u16_le(nt + 6);
+        uint16_t optional_size = read_u16_le(nt + 20);
+        const uint8_t* optional = nt + 24;
+
+        uint32_t directories;
+        switch (read_u16_le(optional))
+        {
+            case 0x10B: directories = 96; break;
+            case 0x20B: directories = 112; break;
+            default: return 0;
+        }
+
+        if(section_count == 0 || section_count > max_sections)
+            return 0;
+
+        uint64_t size = read_u32_le(optional + 60); // SizeOfHeaders
+
+        // The security directory entry holds the file offset of the certificates
+        if(read_u32_le(optional + directories - 4) > 4 && optional_size >= directories + 5 * 8)
+        {
+            uint32_t certificates = read_u32_le(optional + directories + 4 * 8);
+            uint32_t length = read_u32_le(optional + directories + 4 * 8 + 4);
+
+            if(certificates != 0 && length != 0)
+                size = std::max(size, uint64_t(certificates) + length);
+        }
+
+        uint8_t table[max_sections * 40];
+        if(!read_exact(source, offset + e_lfanew + 24 + optional_size, end, table, section_count * 40))
+            return 0;
+
+        for (uint32_t i = 0; i < section_count; ++i)
+        {
+            const uint8_t* section = table + i * 40;
+            uint32_t raw_size = read_u32_le(section + 16);
+
+            if(raw_size != 0)
+                size = std::max(size, uint64_t(read_u32_le(section + 20)) + raw_size);
+        }
+
+        return size;
+    }
+
+    bool is_zip_entry(ByteSource& source, uint64_t offset, uint64_t end)
+    {
+        uint8_t header[30];
+        if(!read_exact(source, offset, end, header, sizeof(header)) || std::memcmp(header, "PK\x03\x04", 4) != 0)
+            return false;
+
+        // Versions are major * 10 + minor with the host system above, methods stay below 100 (stored, deflate, bzip2,
+        // LZMA, zstd, AES) and the flags have reserved bits. Code that compares against the magic fails one of them.
+        uint16_t version = read_u16_le(header + 4);
+        uint16_t name_length = read_u16_le(header + 26);
+
+        if((version & 0xFF) > 63 || (version >> 8) > 19 || (read_u16_le(header + 6) & zip_reserved_flags) != 0 || read_u16_le(header + 8) > 99)
+            return false;
+
+        uint8_t name[max_zip_name];
+        if(name_length == 0 || name_length > max_zip_name || !read_exact(source, offset + sizeof(header), end, name, name_length))
+            return false;
+
+        return std::none_of(name, name + name_length, [](uint8_t c) { return c < 0x20; });
+    }
+
+    // First local header of the archive an end of central directory record closes, UINT64_MAX if the record doesn't hold
+    // up. Split and ZIP64 archives aren't carved.
+    uint64_t zip_start(ByteSource& source, uint64_t offset, uint64_t begin, uint64_t end, uint64_t& size)
+    {
+        uint8_t record[22];
+        if(!read_exact(source, offset, end, record, sizeof(record)))
+            return UINT64_MAX;
+
+        uint16_t entries = read_u16_le(record + 10);
+        uint32_t directory_size = read_u32_le(record + 12);
+        uint32_t directory_offset = read_u32_le(record + 16);
+
+        if(read_u16_le(record + 4) != 0 || read_u16_le(record + 6) != 0 || read_u16_le(record + 8) != entries || entries == 0)
+            return UINT64_MAX;
+
+        if(directory_size > offset - begin || directory_offset > offset - directory_size)
+            return UINT64_MAX;
+
+        uint64_t directory = offset - directory_size;
+
+        uint8_t entry[46];
+        if(!read_exact(source, directory, end, entry, sizeof(entry)) || std::memcmp(entry, "PK\x01\x02", 4) != 0)
+            return UINT64_MAX;
+
+        // Offsets count from the start of the archive, or from the start of the file holding it when a self-extractor
+        // fixed them up. The first entry's local header tells the two apart.
+        uint64_t start = directory - directory_offset + read_u32_le(entry + 42);
+        if(start < begin || start >= directory || !is_zip_entry(source, start, end))
+            return UINT64_MAX;
+
+        size = offset + sizeof(record) + read_u16_le(record + 20) - start;
+
+        return start;
+    }
+
+    // Signature header plus the next header it points at, 0 if the header's CRC doesn't match
+    uint64_t seven_zip_size(ByteSource& source, uint64_t offset, uint64_t end)
+    {
+        uint8_t header[32];
+        if(!read_exact(source, offset, end, header, sizeof(header)) || header[6] != 0)
+            return 0;
+
+        if(crc32(header + 12, 20) != read_u32_le(header + 8))
+            return 0;
+
+        uint64_t next_offset = read_u64_le(header + 12);
+        uint64_t next_size = read_u64_le(header + 20);
+        if(next_offset > (uint64_t(1) << 48) || next_size > (uint64_t(1) << 48))
+            return 0;
+
+        return sizeof(header) + next_offset + next_size;
+    }
+
+    // cbCabinet, 0 if the reserved fields or the version don't match
+    uint64_t cab_size(ByteSource& source, uint64_t offset, uint64_t end)
+    {
+        uint8_t header[36];
+        if(!read_exact(source, offset, end, header, sizeof(header)))
+            return 0;
+
+        uint32_t cabinet = read_u32_le(header + 8);
+        uint32_t files = read_u32_le(header + 16);
+
+        if(read_u32_le(header + 12) != 0 || read_u32_le(header + 20) != 0 || header[25] != 1)
+            return 0;
+
+        if(cabinet < sizeof(header) || files >= cabinet || read_u16_le(header + 26) == 0)
+            return 0;
+
+        return cabinet;
+    }
+
+    // Up to the highest sector the allocation table uses, which is in its last sector. Only the first 109 FAT sectors are
+    // listed in the header, past them (or when that sector can't be read) the size is every sector the table can describe.
+    uint64_t compound_size(ByteSource& source, uint64_t offset, uint64_t end, bool& exact)
+    {
+        uint8_t header[512];
+        if(!read_exact(source, offset, end, header, sizeof(header)))
+            return 0;
+
+        uint16_t major = read_u16_le(header + 0x1A);
+        uint16_t shift = read_u16_le(header + 0x1E);
+
+        if(read_u16_le(header + 0x1C) != 0xFFFE || read_u16_le(header + 0x20) != 6)
+            return 0;
+
+        if(!(major == 3 && shift == 9) && !(major == 4 && shift == 12))
+            return 0;
+
+        uint64_t sector_size = uint64_t(1) << shift;
+        uint64_t per_sector = sector_size / 4;
+        uint32_t fat_sectors = read_u32_le(header + 0x2C);
+
+        if(fat_sectors == 0 || fat_sectors > (end - offset) / sector_size)
+            return 0;
+
+        exact = false;
+
+        if(fat_sectors <= 109)
+        {
+            uint32_t last = read_u32_le(header + 0x4C + 4 * (fat_sectors - 1));
+
+            uint8_t fat[max_sector_size];
+            if(last < max_regular_sector && read_exact(source, offset + (uint64_t(last) + 1) * sector_size, end, fat, sector_size))
+            {
+                for (uint64_t i = per_sector; i-- > 0;)
+                {
+                    if(read_u32_le(fat + i * 4) != free_sector)
+                    {
+                        exact = true;
+
+                        // Sector n starts after the header sector
+                        return ((fat_sectors - 1) * per_sector + i + 2) * sector_size;
+                    }
+                }
+            }
+        }
+
+        return (fat_sectors * per_sector + 1) * sector_size;
+    }
+
+    // Index of the last ZIP found, -1 if none
+    ptrdiff_t last_zip(const std::vector<CarvedPayload>& out)
+    {
+        for (size_t i = out.size(); i-- > 0;)
+        {
+            if(out[i].kind == PayloadKind::ZIP)
+                return static_cast<ptrdiff_t>(i);
+        }
+
+        return -1;
+    }
+
+    // Checks a magic found at offset and records the payload it starts. covered is the end of the last PE payload.
+    void carve_hit(ByteSource& source, PayloadKind kind, uint32_t string, uint64_t offset, uint64_t begin, uint64_t end, std::vector<CarvedPayload>& out, uint64_t& covered)
+    {
+        uint64_t size = 0;
+        bool exact = true;
+
+        switch (kind)
+        {
+            case PayloadKind::PE:
+                size = pe_size(source, offset, end);
+                if(size != 0)
+                    covered = offset + std::min(size, end - offset);
+                break;
+            case PayloadKind::ZIP:
+            {
+                if(string == zip_local_string)
+                {
+                    // Later entries of an archive whose end hasn't been seen yet
+                    ptrdiff_t zip = last_zip(out);
+                    if(zip >= 0 && !out[zip].exact)
+                        return;
+
+                    if(!is_zip_entry(source, offset, end))
+                        return;
+
+                    out.push_back({ offset, 0, PayloadKind::ZIP, false });
+
+                    return;
+                }
+
+                uint64_t start = zip_start(source, offset, begin, end, size);
+                if(start == UINT64_MAX)
+                    return;
+
+                // The archive replaces the runs of local headers found inside it, what's stored in it stays
+                auto by_offset = [](const CarvedPayload& payload, uint64_t value) { return payload.offset < value; };
+                auto first = std::lower_bound(out.begin(), out.end(), start, by_offset);
+                out.erase(std::remove_if(first, out.end(), [](const CarvedPayload& payload) { return payload.kind == PayloadKind::ZIP && !payload.exact; }), out.end());
+
+                out.insert(std::lower_bound(out.begin(), out.end(), start, by_offset), { start, size, PayloadKind::ZIP, true });
+
+                return;
+            }
+            case PayloadKind::SevenZip:
+                size = seven_zip_size(source, offset, end);
+                break;
+            case PayloadKind::CAB:
+                size = cab_size(source, offset, end);
+                break;
+            case PayloadKind::Compound:
+                size = compound_size(source, offset, end, exact);
+                break;
+        }
+
+        if(size != 0)
+            out.push_back({ offset, size, kind, exact });
+    }
+}
+
+const char* payload_kind_name(PayloadKind kind)
+{
+    switch (kind)
+    {
+        case PayloadKind::PE: return "PE";
+        case PayloadKind::ZIP: return "ZIP";
+        case PayloadKind::SevenZip: return "7z";
+        case PayloadKind::CAB: return "CAB";
+        case PayloadKind::Compound: return "Compound file";
+    }
+
+    return "Unknown";
+}
+
+std::vector<CarvedPayload> carve_payloads(ByteSource& source, uint64_t begin, uint64_t end, const CarveOptions& options)
+{
+    PROFILE_SCOPE("carve_payloads");
+
+    std::vector<CarvedPayload> out;
+
+    end = std::min(end, source.size());
+    if(begin >= end)
+        return out;
+
+    const SignatureSet& set = magics();
+
+    // The end of each chunk is kept in front of the next one so magics across the boundary are matched whole
+    size_t carry = 0;
+    for (const SignaturePattern& pattern : set.patterns())
+        carry = std::max(carry, pattern.bytes.size() - 1);
+
+    uint64_t chunk = std::max<uint32_t>(options.buffer_size, 4096);
+    std::vector<uint8_t> buffer(carry + chunk);
+    std::vector<SignatureMatch> hits;
+
+    // "MZ" can be anywhere in compressed data, every hit is checked
+    SignatureScanOptions scan_options;
+    scan_options.max_matches_per_pattern = UINT32_MAX;
+
+    uint64_t covered = begin;
+    size_t kept = 0;
+
+    for (uint64_t position = begin; position < end;)
+    {
+        if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+            break;
+
+        uint64_t got = source.read(position, buffer.data() + kept, std::min(chunk, end - position));
+        if(got == 0)
+            break;
+
+        hits.clear();
+        set.scan(buffer.data(), kept + got, position - kept, scan_options, hits);
+
+        for (const SignatureMatch& hit : hits)
+        {
+            // Hits that fit in the carried bytes were seen with the previous chunk, the ones inside a PE belong to it
+            if(hit.offset + hit.length <= position || hit.offset < covered)
+                continue;
+
+            const SignaturePattern& pattern = set.patterns()[hit.pattern];
+            carve_hit(source, static_cast<PayloadKind>(pattern.rule), pattern.string, hit.offset, begin, end, out, covered);
+        }
+
+        position += got;
+
+        if(options.progress != nullptr)
+            *options.progress += got;
+
+        size_t total = kept + got;
+        kept = std::min(carry, total);
+        std::memmove(buffer.data(), buffer.data() + total - kept, kept);
+    }
+
+    // Sizes the headers didn't give run to the next payload, the ones they did are cut at the end of the range
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        CarvedPayload& payload = out[i];
+        uint64_t limit = end - payload.offset;
+
+        if(!payload.exact && i + 1 < out.size())
+            limit = std::min(limit, out[i + 1].offset - payload.offset);
+
+        if(payload.size == 0 || payload.size > limit)
+        {
+            payload.size = limit;
+            payload.exact = false;
+        }
+    }
+
+    return out;
+}
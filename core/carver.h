@@ -0,0 +1,48 @@
+/*
+* Carving of files embedded in other files
+* Installers, self-extractors and droppers keep what they unpack as plain files inside their sections or overlay. A range
+* of the source is swept once through a fixed-size buffer (the tail of each chunk is carried over so headers that cross
+* a chunk boundary are still seen) and the magic of every supported format is matched in the same pass by a SignatureSet.
+* Each hit is checked against the rest of its header before it's reported, "MZ" alone is everywhere.
+*
+* Sizes come from the payload's own headers where the format records them: the section table of a PE, the cabinet size
+* of a CAB, the next header of a 7z archive, the allocation table of a compound file and the end of central directory of
+* a ZIP. Anything else runs up to the next payload or the end of the range.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "byte_source.h"
+
+enum class PayloadKind : uint8_t
+{
+    PE,
+    ZIP,
+    SevenZip,
+    CAB,
+    Compound // OLE compound file: MSI packages, old Office documents
+};
+
+struct CarvedPayload
+{
+    uint64_t offset;
+    uint64_t size;
+    PayloadKind kind;
+    bool exact; // size comes from the payload's headers and fits in the range
+};
+
+struct CarveOptions
+{
+    uint32_t buffer_size = 1 << 20;
+
+    const std::atomic<bool>* cancel = nullptr; // Checked between chunks, a cancelled sweep returns what it found so far
+    std::atomic<uint64_t>* progress = nullptr; // Bytes swept
+};
+
+const char* payload_kind_name(PayloadKind kind);
+
+// Payloads in [begin, end) of source, sorted by offset. Headers inside a PE payload aren't reported, carving that PE finds
+// them, and neither are the local headers of a ZIP after its first one.
+std::vector<CarvedPayload> carve_payloads(ByteSource& source, uint64_t begin, uint64_t end, const CarveOptions& options = {});
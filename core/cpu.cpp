@@ -0,0 +1,64 @@
+#include "cpu.h"
+
+#if BINARYVIEW_X86 && defined(_MSC_VER)
+    #include <intrin.h>
+    #include <immintrin.h>
+#elif BINARYVIEW_X86
+    #include <cpuid.h>
+#endif
+
+namespace
+{
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool ssse3 = false;
+        bool avx2 = false;
+        bool sha = false;
+
+        CpuFeatures()
+        {
+#if BINARYVIEW_X86 && defined(_MSC_VER)
+            int info[4] = {};
+            __cpuid(info, 0);
+            int max_leaf = info[0];
+
+            __cpuid(info, 1);
+            sse2 = (info[3] & (1 << 26)) != 0;
+            ssse3 = (info[2] & (1 << 9)) != 0;
+            bool sse41 = (info[2] & (1 << 19)) != 0;
+
+            bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE and XMM/YMM state enabled
+
+            if(max_leaf >= 7)
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = os_saves_ymm && (info[1] & (1 << 5)) != 0;
+                sha = ssse3 && sse41 && (info[1] & (1 << 29)) != 0;
+            }
+#elif BINARYVIEW_X86
+            __builtin_cpu_init();
+            sse2 = __builtin_cpu_supports("sse2");
+            ssse3 = __builtin_cpu_supports("ssse3");
+            avx2 = __builtin_cpu_supports("avx2");
+
+            // Not every compiler's __builtin_cpu_supports knows "sha", leaf 7 has it in EBX bit 29
+            unsigned int eax, ebx, ecx, edx;
+            if(__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+                sha = ssse3 && __builtin_cpu_supports("sse4.1") && (ebx & (1u << 29)) != 0;
+#endif
+        }
+    };
+
+    const CpuFeatures& features()
+    {
+        static const CpuFeatures detected;
+
+        return detected;
+    }
+}
+
+bool cpu_has_sse2() { return features().sse2; }
+bool cpu_has_ssse3() { return features().ssse3; }
+bool cpu_has_avx2() { return features().avx2; }
+bool cpu_has_sha() { return features().sha; }
@@ -0,0 +1,23 @@
+/*
+* Runtime CPU feature detection for the SIMD kernels
+* Kernels are compiled with per-function target attributes so the binary still runs on CPUs without them.
+*/
+
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define BINARYVIEW_X86 1
+#else
+    #define BINARYVIEW_X86 0
+#endif
+
+#if BINARYVIEW_X86 && (defined(__GNUC__) || defined(__clang__))
+    #define BINARYVIEW_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define BINARYVIEW_TARGET(isa) // MSVC allows intrinsics from any ISA without flags
+#endif
+
+bool cpu_has_sse2();
+bool cpu_has_ssse3();
+bool cpu_has_avx2();
+bool cpu_has_sha(); // SHA-1/SHA-256 extensions, only reported together with the SSSE3/SSE4.1 they are used with
@@ -0,0 +1,248 @@
+#include "disassembly.h"
+#include <algorithm>
+
+namespace
+{
+    const uint64_t block_size = 16 * 1024;
+
+    // Linear sweep realigns with the true instruction stream within a few instructions of a wrong start
+    const uint64_t resync_window = 64;
+
+    const uint64_t max_instruction = 15;
+}
+
+Disassembly::Disassembly(PageCache& cache, uint64_t offset, uint64_t size, uint64_t address, bool x64, uint32_t max_blocks) :
+    cache(cache), offset(offset), size_(size), address_(address), x64(x64), max_blocks(max_blocks > 0 ? max_blocks : 1)
+{
+    block_count_ = (size_ + block_size - 1) / block_size;
+}
+
+void Disassembly::unlink(uint32_t slot)
+{
+    Block& block = blocks[slot];
+
+    if(block.prev != UINT32_MAX)
+        blocks[block.prev].next = block.next;
+    else
+        head = block.next;
+
+    if(block.next != UINT32_MAX)
+        blocks[block.next].prev = block.prev;
+    else
+        tail = block.prev;
+
+    block.prev = UINT32_MAX;
+    block.next = UINT32_MAX;
+}
+
+void Disassembly::push_front(uint32_t slot)
+{
+    Block& block = blocks[slot];
+
+    block.prev = UINT32_MAX;
+    block.next = head;
+
+    if(head != UINT32_MAX)
+        blocks[head].prev = slot;
+
+    head = slot;
+
+    if(tail == UINT32_MAX)
+        tail = slot;
+}
+
+uint64_t Disassembly::entry(uint64_t index)
+{
+    if(index == 0)
+        return 0;
+
+    uint64_t base = index * block_size;
+    if(base >= size_)
+        return size_;
+
+    uint64_t start = base - std::min(base, resync_window);
+    uint64_t length = std::min(size_ - start, base - start + max_instruction);
+
+    uint8_t window[resync_window + max_instruction];
+    length = cache.read(offset + start, window, length);
+
+    uint64_t position = 0;
+    while(start + position < base && position < length)
+    {
+        X86Instruction instruction;
+        x86_decode(window + position, length - position, x64, instruction);
+
+        position += instruction.length;
+    }
+
+    return std::min(start + position, size_);
+}
+
+void Disassembly::decode(uint64_t index, Block& block)
+{
+    uint64_t base = index * block_size;
+    uint64_t first = entry(index);
+    uint64_t last = index + 1 < block_count_ ? entry(index + 1) : size_;
+
+    block.index = index;
+    block.end = static_cast<uint32_t>(last - base);
+    block.starts.clear();
+
+    if(last <= first)
+        return;
+
+    buffer.resize(last - first);
+    uint64_t length = cache.read(offset + first, buffer.data(), last - first);
+
+    // Instructions never run past the next block's entry, whatever would is shown as single bytes
+    uint64_t position = 0;
+    while(position < length)
+    {
+        X86Instruction instruction;
+        x86_decode(buffer.data() + position, length - position, x64, instruction);
+
+        block.starts.push_back(static_cast<uint16_t>(first + position - base));
+        position += instruction.length;
+    }
+}
+
+const Disassembly::Block& Disassembly::fetch(uint64_t index)
+{
+    auto it = slots.find(index);
+    if(it != slots.end())
+    {
+        if(it->second != head)
+        {
+            unlink(it->second);
+            push_front(it->second);
+        }
+
+        return blocks[it->second];
+    }
+
+    uint32_t slot;
+    if(blocks.size() < max_blocks)
+    {
+        slot = static_cast<uint32_t>(blocks.size());
+        blocks.emplace_back();
+    }
+    else
+    {
+        slot = tail;
+        unlink(slot);
+        slots.erase(blocks[slot].index);
+    }
+
+    decode(index, blocks[slot]);
+    slots[index] = slot;
+    push_front(slot);
+
+    return blocks[slot];
+}
+
+Disassembly::Position Disassembly::locate(uint64_t address)
+{
+    Position position;
+    if(block_count_ == 0)
+        return position;
+
+    uint64_t relative = address > address_ ? std::min(address - address_, size_ - 1) : 0;
+    position.block = relative / block_size;
+
+    // The head of a block can still belong to the previous block's last instruction
+    uint64_t base = position.block * block_size;
+    const Block* block = &fetch(position.block);
+
+    while(position.block > 0 && (block->starts.empty() || base + block->starts.front() > relative))
+    {
+        --position.block;
+        base -= block_size;
+        block = &fetch(position.block);
+    }
+
+    if(block->starts.empty())
+        return position;
+
+    auto it = std::upper_bound(block->starts.begin(), block->starts.end(), relative - base);
+    position.index = static_cast<uint32_t>(it == block->starts.begin() ? 0 : (it - block->starts.begin()) - 1);
+
+    return position;
+}
+
+bool Disassembly::next(Position& position)
+{
+    if(position.index + 1 < fetch(position.block).starts.size())
+    {
+        ++position.index;
+        return true;
+    }
+
+    for (uint64_t index = position.block + 1; index < block_count_; ++index)
+    {
+        if(!fetch(index).starts.empty())
+        {
+            position.block = index;
+            position.index = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Disassembly::prev(Position& position)
+{
+    if(position.index > 0)
+    {
+        --position.index;
+        return true;
+    }
+
+    for (uint64_t index = position.block; index-- > 0;)
+    {
+        const Block& block = fetch(index);
+        if(!block.starts.empty())
+        {
+            position.block = index;
+            position.index = static_cast<uint32_t>(block.starts.size() - 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t Disassembly::memory_usage() const
+{
+    uint64_t total = blocks.capacity() * sizeof(Block) + buffer.capacity() + slots.size() * (sizeof(std::pair<uint64_t, uint32_t>) + sizeof(void*));
+    for (const Block& block : blocks)
+        total += block.starts.capacity() * sizeof(uint16_t);
+
+    return total;
+}
+
+uint64_t Disassembly::address_of(Position position)
+{
+    const Block& block = fetch(position.block);
+    if(position.index >= block.starts.size())
+        return address_ + std::min(position.block * block_size, size_);
+
+    return address_ + position.block * block_size + block.starts[position.index];
+}
+
+void Disassembly::instruction(Position position, X86Instruction& out, uint8_t* bytes)
+{
+    const Block& block = fetch(position.block);
+    if(position.index >= block.starts.size())
+    {
+        out = X86Instruction();
+        return;
+    }
+
+    uint64_t start = position.block * block_size + block.starts[position.index];
+    uint64_t end = position.index + 1 < block.starts.size() ? position.block * block_size + block.starts[position.index + 1] : position.block * block_size + block.end;
+
+    // Same limit the sweep used, so an instruction cut short by a block entry decodes to the same single byte
+    uint64_t length = cache.read(offset + start, bytes, std::min<uint64_t>(end - start, max_instruction));
+    x86_decode(bytes, length, x64, out);
+}
@@ -0,0 +1,83 @@
+/*
+* Lazily decoded linear sweep over a code region
+* The region is cut into fixed size blocks that are decoded the first time they're looked at and kept in a bounded LRU, a
+* block only stores the 16 bit offset of each instruction. Every block starts at the first instruction boundary reached by a
+* sweep that begins a few bytes before it, so any block decodes on its own and jumping deep into a large section costs one
+* block rather than everything in front of it.
+*/
+
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "page_cache.h"
+#include "x86_decoder.h"
+
+class Disassembly
+{
+public:
+    // Region [offset, offset + size) of the file, loaded at address
+    Disassembly(PageCache& cache, uint64_t offset, uint64_t size, uint64_t address, bool x64, uint32_t max_blocks = 256);
+
+    struct Position
+    {
+        uint64_t block = 0;
+        uint32_t index = 0; // Instruction within the block
+    };
+
+    uint64_t address() const { return address_; }
+    uint64_t size() const { return size_; }
+    uint64_t block_count() const { return block_count_; }
+
+    // Instruction covering address, or the closest one when address is outside the region
+    Position locate(uint64_t address);
+
+    // Moves to the neighbouring instruction, false at either end of the region
+    bool next(Position&);
+    bool prev(Position&);
+
+    uint64_t address_of(Position);
+
+    // Decodes the instruction at a position again for display, bytes receives its raw bytes (at most 15)
+    void instruction(Position, X86Instruction& out, uint8_t* bytes);
+
+    size_t cached_blocks() const { return slots.size(); }
+    // Approximate heap use
+    uint64_t memory_usage() const;
+
+private:
+    struct Block
+    {
+        uint64_t index = UINT64_MAX;
+        uint32_t end = 0;             // Offset from the block base where the next block's first instruction starts
+        std::vector<uint16_t> starts; // Instruction offsets from the block base
+        uint32_t prev = UINT32_MAX;
+        uint32_t next = UINT32_MAX;
+    };
+
+    // Returns the slot holding block index, decoding it over the least recently used block on a miss. The reference
+    // stays valid until the next call.
+    const Block& fetch(uint64_t index);
+
+    // Region offset of the first instruction in block index
+    uint64_t entry(uint64_t index);
+    void decode(uint64_t index, Block& block);
+
+    void unlink(uint32_t slot);
+    void push_front(uint32_t slot);
+
+    PageCache& cache;
+    uint64_t offset;
+    uint64_t size_;
+    uint64_t address_;
+    bool x64;
+    uint64_t block_count_;
+    uint32_t max_blocks;
+
+    std::vector<Block> blocks;
+    std::unordered_map<uint64_t, uint32_t> slots;
+    uint32_t head = UINT32_MAX;
+    uint32_t tail = UINT32_MAX;
+
+    std::vector<uint8_t> buffer;
+};
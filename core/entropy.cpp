@@ -0,0 +1,362 @@
+#include "entropy.h"
+#include "cpu.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#if BINARYVIEW_X86
+    #include <immintrin.h>
+#endif
+
+namespace
+{
+    const size_t chunk_size = 1 << 20;
+
+    // Every sub-histogram gets a quarter of the bytes, flushing at 1 GB keeps their sum within 32 bits
+    const size_t flush_size = size_t(1) << 30;
+
+    // Tables past this size cost more to build than the logs they save
+    const size_t max_table_size = 1 << 16;
+
+    struct SubHistograms
+    {
+        alignas(32) uint32_t counts[4][256];
+    };
+
+    using FoldFn = void (*)(const SubHistograms& sub, uint64_t* totals);
+
+    void count_sub(const uint8_t* data, size_t size, SubHistograms& sub)
+    {
+        size_t i = 0;
+
+        for (; i + 16 <= size; i += 16)
+        {
+            uint64_t a;
+            uint64_t b;
+            std::memcpy(&a, data + i, 8);
+            std::memcpy(&b, data + i + 8, 8);
+
+            ++sub.counts[0][a & 0xFF];
+            ++sub.counts[1][(a >> 8) & 0xFF];
+            ++sub.counts[2][(a >> 16) & 0xFF];
+            ++sub.counts[3][(a >> 24) & 0xFF];
+            ++sub.counts[0][(a >> 32) & 0xFF];
+            ++sub.counts[1][(a >> 40) & 0xFF];
+            ++sub.counts[2][(a >> 48) & 0xFF];
+            ++sub.counts[3][a >> 56];
+
+            ++sub.counts[0][b & 0xFF];
+            ++sub.counts[1][(b >> 8) & 0xFF];
+            ++sub.counts[2][(b >> 16) & 0xFF];
+            ++sub.counts[3][(b >> 24) & 0xFF];
+            ++sub.counts[0][(b >> 32) & 0xFF];
+            ++sub.counts[1][(b >> 40) & 0xFF];
+            ++sub.counts[2][(b >> 48) & 0xFF];
+            ++sub.counts[3][b >> 56];
+        }
+
+        for (; i < size; ++i)
+            ++sub.counts[i & 3][data[i]];
+    }
+
+    void fold_scalar(const SubHistograms& sub, uint64_t* totals)
+    {
+        for (int i = 0; i < 256; ++i)
+            totals[i] += uint64_t(sub.counts[0][i]) + sub.counts[1][i] + sub.counts[2][i] + sub.counts[3][i];
+    }
+
+#if BINARYVIEW_X86
+    BINARYVIEW_TARGET("sse2")
+    void fold_sse2(const SubHistograms& sub, uint64_t* totals)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        for (int i = 0; i < 256; i += 4)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(sub.counts[0] + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(sub.counts[1] + i));
+            __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(sub.counts[2] + i));
+            __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(sub.counts[3] + i));
+            __m128i sum = _mm_add_epi32(_mm_add_epi32(a, b), _mm_add_epi32(c, d));
+
+            __m128i* out = reinterpret_cast<__m128i*>(totals + i);
+            _mm_storeu_si128(out, _mm_add_epi64(_mm_loadu_si128(out), _mm_unpacklo_epi32(sum, zero)));
+            _mm_storeu_si128(out + 1, _mm_add_epi64(_mm_loadu_si128(out + 1), _mm_unpackhi_epi32(sum, zero)));
+        }
+    }
+
+    BINARYVIEW_TARGET("avx2")
+    void fold_avx2(const SubHistograms& sub, uint64_t* totals)
+    {
+        for (int i = 0; i < 256; i += 8)
+        {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(sub.counts[0] + i));
+            __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(sub.counts[1] + i));
+            __m256i c = _mm256_load_si256(reinterpret_cast<const __m256i*>(sub.counts[2] + i));
+            __m256i d = _mm256_load_si256(reinterpret_cast<const __m256i*>(sub.counts[3] + i));
+            __m256i sum = _mm256_add_epi32(_mm256_add_epi32(a, b), _mm256_add_epi32(c, d));
+
+            __m256i* out = reinterpret_cast<__m256i*>(totals + i);
+            _mm256_storeu_si256(out, _mm256_add_epi64(_mm256_loadu_si256(out), _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sum))));
+            _mm256_storeu_si256(out + 1, _mm256_add_epi64(_mm256_loadu_si256(out + 1), _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sum, 1))));
+        }
+    }
+#endif
+
+    struct Kernel
+    {
+        FoldFn fold;
+        const char* name;
+    };
+
+    const Kernel& kernel()
+    {
+        static const Kernel selected = []() -> Kernel
+        {
+#if BINARYVIEW_X86
+            if(cpu_has_avx2())
+                return { fold_avx2, "avx2" };
+
+            if(cpu_has_sse2())
+                return { fold_sse2, "sse2" };
+#endif
+            return { fold_scalar, "scalar" };
+        }();
+
+        return selected;
+    }
+
+    // Counts one window from scratch
+    void count_window(const uint8_t* data, size_t size, uint64_t* counts)
+    {
+        std::memset(counts, 0, 256 * sizeof(uint64_t));
+
+        for (size_t offset = 0; offset < size; offset += flush_size)
+        {
+            SubHistograms sub = {};
+            count_sub(data + offset, std::min(flush_size, size - offset), sub);
+            kernel().fold(sub, counts);
+        }
+    }
+
+    // c * log2(c), tabulated for the counts a window can reach
+    class CLogC
+    {
+    public:
+        explicit CLogC(size_t window) : table(std::min(window, max_table_size) + 1)
+        {
+            for (size_t c = 1; c < table.size(); ++c)
+                table[c] = double(c) * std::log2(double(c));
+        }
+
+        double operator()(uint64_t c) const
+        {
+            return c < table.size() ? table[c] : double(c) * std::log2(double(c));
+        }
+
+    private:
+        std::vector<double> table;
+    };
+
+    // H = -sum(p log2 p) = log2(n) - sum(c log2 c) / n
+    float entropy_from(double sum, size_t total)
+    {
+        if(total == 0)
+            return 0.0f;
+
+        double entropy = std::log2(double(total)) - sum / double(total);
+
+        return static_cast<float>(std::min(8.0, std::max(0.0, entropy)));
+    }
+
+    size_t window_count(size_t size, size_t window, size_t step)
+    {
+        if(size == 0)
+            return 0;
+
+        return size <= window ? 1 : (size - window) / step + 1;
+    }
+
+    // Windows [first, last), restarting from a full count at first so runs can be computed independently
+    void entropy_windows(const uint8_t* data, size_t window, size_t step, size_t first, size_t last, const CLogC& c_log_c, float* out)
+    {
+        uint64_t counts[256];
+
+        // Windows that barely overlap are cheaper to count from scratch than to slide
+        if(step * 2 >= window)
+        {
+            for (size_t index = first; index < last; ++index)
+            {
+                count_window(data + index * step, window, counts);
+
+                double sum = 0;
+                for (uint64_t count : counts)
+                    sum += c_log_c(count);
+
+                out[index] = entropy_from(sum, window);
+            }
+
+            return;
+        }
+
+        count_window(data + first * step, window, counts);
+
+        double sum = 0;
+        for (uint64_t count : counts)
+            sum += c_log_c(count);
+
+        out[first] = entropy_from(sum, window);
+
+        for (size_t index = first + 1; index < last; ++index)
+        {
+            const uint8_t* leaving = data + (index - 1) * step;
+            const uint8_t* entering = leaving + window;
+
+            for (size_t i = 0; i < step; ++i)
+            {
+                uint64_t& out_count = counts[leaving[i]];
+                sum += c_log_c(out_count - 1) - c_log_c(out_count);
+                --out_count;
+
+                uint64_t& in_count = counts[entering[i]];
+                sum += c_log_c(in_count + 1) - c_log_c(in_count);
+                ++in_count;
+            }
+
+            out[index] = entropy_from(sum, window);
+        }
+    }
+}
+
+void ByteHistogram::add(const ByteHistogram& other)
+{
+    for (int i = 0; i < 256; ++i)
+        counts[i] += other.counts[i];
+
+    total += other.total;
+}
+
+double ByteHistogram::entropy() const
+{
+    if(total == 0)
+        return 0.0;
+
+    double entropy = 0.0;
+    for (uint64_t count : counts)
+    {
+        if(count == 0)
+            continue;
+
+        double p = double(count) / double(total);
+        entropy -= p * std::log2(p);
+    }
+
+    return entropy;
+}
+
+void count_bytes(const uint8_t* data, size_t size, ByteHistogram& histogram)
+{
+    for (size_t offset = 0; offset < size; offset += flush_size)
+    {
+        SubHistograms sub = {};
+        count_sub(data + offset, std::min(flush_size, size - offset), sub);
+        kernel().fold(sub, histogram.counts);
+    }
+
+    histogram.total += size;
+}
+
+void count_bytes_parallel(const uint8_t* data, size_t size, ThreadPool& pool, ByteHistogram& histogram, const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    size_t chunks = (size + chunk_size - 1) / chunk_size;
+    bool observed = cancel != nullptr || progress != nullptr;
+
+    if(chunks <= 1 || (pool.size() <= 1 && !observed))
+    {
+        count_bytes(data, size, histogram);
+
+        if(progress != nullptr)
+            progress->fetch_add(size, std::memory_order_relaxed);
+
+        return;
+    }
+
+    // Each range of chunks counts into its own histogram and merges once at the end
+    std::mutex merge;
+
+    parallel_for(pool, chunks, 1, [&](size_t begin, size_t end)
+    {
+        ByteHistogram local;
+
+        for (size_t chunk = begin; chunk < end; ++chunk)
+        {
+            if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+                break;
+
+            size_t offset = chunk * chunk_size;
+            size_t length = std::min(chunk_size, size - offset);
+
+            count_bytes(data + offset, length, local);
+
+            if(progress != nullptr)
+                progress->fetch_add(length, std::memory_order_relaxed);
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        histogram.add(local);
+    });
+}
+
+void sliding_entropy(const uint8_t* data, size_t size, size_t window, size_t step, std::vector<float>& out)
+{
+    out.clear();
+
+    if(window == 0 || step == 0)
+        return;
+
+    window = std::min(window, size);
+    out.resize(window_count(size, window, step));
+
+    if(!out.empty())
+        entropy_windows(data, window, step, 0, out.size(), CLogC(window), out.data());
+}
+
+void sliding_entropy_parallel(const uint8_t* data, size_t size, size_t window, size_t step, ThreadPool& pool, std::vector<float>& out, const std::atomic<bool>* cancel, std::atomic<uint64_t>* progress)
+{
+    out.clear();
+
+    if(window == 0 || step == 0)
+        return;
+
+    window = std::min(window, size);
+    out.resize(window_count(size, window, step));
+
+    size_t per_run = std::max<size_t>(1, chunk_size / step);
+    size_t runs = (out.size() + per_run - 1) / per_run;
+
+    CLogC c_log_c(window);
+
+    parallel_for(pool, runs, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t run = begin; run < end; ++run)
+        {
+            if(cancel != nullptr && cancel->load(std::memory_order_relaxed))
+                return;
+
+            size_t first = run * per_run;
+            size_t last = std::min(out.size(), first + per_run);
+
+            entropy_windows(data, window, step, first, last, c_log_c, out.data());
+
+            if(progress != nullptr)
+                progress->fetch_add(uint64_t(last - first) * step, std::memory_order_relaxed);
+        }
+    });
+}
+
+const char* entropy_isa()
+{
+    return kernel().name;
+}
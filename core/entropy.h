@@ -0,0 +1,44 @@
+/*
+* Byte histograms and Shannon entropy
+* Counting is a scatter, not something SIMD lanes can do directly, so consecutive bytes go to four interleaved 32 bit
+* sub-histograms (increments of the same value don't wait on each other) and the sub-histograms are folded into the 64 bit
+* totals with AVX2/SSE2 adds picked at runtime. Window entropies come from a table of c * log2(c) instead of a log per count.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+struct ByteHistogram
+{
+    uint64_t counts[256] = {};
+    uint64_t total = 0;
+
+    void add(const ByteHistogram& other);
+
+    // Bits per byte, 0 (one value) to 8 (uniform)
+    double entropy() const;
+};
+
+// Adds the bytes of data to histogram
+void count_bytes(const uint8_t* data, size_t size, ByteHistogram& histogram);
+
+// Same result as count_bytes, 1 MB chunks are counted across the pool. cancel and progress (bytes counted) are checked and
+// reported between chunks, a cancelled count is partial.
+void count_bytes_parallel(const uint8_t* data, size_t size, ThreadPool& pool, ByteHistogram& histogram,
+    const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+
+// Entropy of every window [i * step, i * step + window) that fits in data (one window over everything when data is
+// smaller). Overlapping windows are updated incrementally from the bytes entering and leaving them.
+void sliding_entropy(const uint8_t* data, size_t size, size_t window, size_t step, std::vector<float>& out);
+
+// Same result as sliding_entropy with runs of windows spread over the pool
+void sliding_entropy_parallel(const uint8_t* data, size_t size, size_t window, size_t step, ThreadPool& pool, std::vector<float>& out,
+    const std::atomic<bool>* cancel = nullptr, std::atomic<uint64_t>* progress = nullptr);
+
+// Name of the fold kernel picked for this CPU
+const char* entropy_isa();
@@ -0,0 +1,438 @@
+#include "hash.h"
+#include "cpu.h"
+#include <algorithm>
+#include <cstring>
+
+#if BINARYVIEW_X86
+    #include <immintrin.h>
+#endif
+
+namespace
+{
+    using CompressFn = void (*)(uint32_t* state, const uint8_t* blocks, size_t count);
+
+    uint32_t rotl(uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); }
+    uint32_t rotr(uint32_t value, int bits) { return (value >> bits) | (value << (32 - bits)); }
+
+    uint32_t load_le(const uint8_t* p) { return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24; }
+    uint32_t load_be(const uint8_t* p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]); }
+
+    void store_le(uint8_t* p, uint32_t value) { for (int i = 0; i < 4; ++i) p[i] = uint8_t(value >> (i * 8)); }
+    void store_be(uint8_t* p, uint32_t value) { for (int i = 0; i < 4; ++i) p[i] = uint8_t(value >> (24 - i * 8)); }
+
+    // Whole blocks go straight to compress, only a partial block at either end is copied
+    void absorb(uint8_t* buffer, size_t& buffered, uint64_t& length, const uint8_t* data, size_t size, uint32_t* state, CompressFn compress)
+    {
+        length += size;
+
+        if(buffered > 0)
+        {
+            size_t take = std::min(size, 64 - buffered);
+            std::memcpy(buffer + buffered, data, take);
+            buffered += take;
+            data += take;
+            size -= take;
+
+            if(buffered < 64)
+                return;
+
+            compress(state, buffer, 1);
+            buffered = 0;
+        }
+
+        if(size >= 64)
+        {
+            compress(state, data, size / 64);
+            data += size & ~size_t(63);
+            size &= 63;
+        }
+
+        std::memcpy(buffer, data, size);
+        buffered = size;
+    }
+
+    // 0x80, zeros, then the bit length in the last 8 bytes
+    void pad(uint8_t* buffer, size_t buffered, uint64_t length, bool big_endian, uint32_t* state, CompressFn compress)
+    {
+        buffer[buffered++] = 0x80;
+
+        if(buffered > 56)
+        {
+            std::memset(buffer + buffered, 0, 64 - buffered);
+            compress(state, buffer, 1);
+            buffered = 0;
+        }
+
+        std::memset(buffer + buffered, 0, 56 - buffered);
+
+        uint64_t bits = length * 8;
+        for (int i = 0; i < 8; ++i)
+            buffer[56 + i] = uint8_t(big_endian ? bits >> (56 - i * 8) : bits >> (i * 8));
+
+        compress(state, buffer, 1);
+    }
+
+    void md5_step(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d, uint32_t input, int shift)
+    {
+        uint32_t next = b + rotl(a + input, shift);
+        a = d;
+        d = c;
+        c = b;
+        b = next;
+    }
+
+    void md5_compress(uint32_t* state, const uint8_t* blocks, size_t count)
+    {
+        static const uint32_t k[64] =
+        {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+
+        static const int shifts[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+        for (; count > 0; --count, blocks += 64)
+        {
+            uint32_t m[16];
+            for (int i = 0; i < 16; ++i)
+                m[i] = load_le(blocks + i * 4);
+
+            uint32_t a = state[0];
+            uint32_t b = state[1];
+            uint32_t c = state[2];
+            uint32_t d = state[3];
+
+            // One loop per round so each has a fixed function and can be unrolled
+            for (int i = 0; i < 16; ++i)
+                md5_step(a, b, c, d, ((b & c) | (~b & d)) + k[i] + m[i], shifts[0][i & 3]);
+            for (int i = 16; i < 32; ++i)
+                md5_step(a, b, c, d, ((d & b) | (~d & c)) + k[i] + m[(5 * i + 1) & 15], shifts[1][i & 3]);
+            for (int i = 32; i < 48; ++i)
+                md5_step(a, b, c, d, (b ^ c ^ d) + k[i] + m[(3 * i + 5) & 15], shifts[2][i & 3]);
+            for (int i = 48; i < 64; ++i)
+                md5_step(a, b, c, d, (c ^ (b | ~d)) + k[i] + m[(7 * i) & 15], shifts[3][i & 3]);
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+        }
+    }
+
+    void sha1_scalar(uint32_t* state, const uint8_t* blocks, size_t count)
+    {
+        for (; count > 0; --count, blocks += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+                w[i] = load_be(blocks + i * 4);
+            for (int i = 16; i < 80; ++i)
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            uint32_t a = state[0];
+            uint32_t b = state[1];
+            uint32_t c = state[2];
+            uint32_t d = state[3];
+            uint32_t e = state[4];
+
+            for (int i = 0; i < 80; ++i)
+            {
+                uint32_t f;
+                uint32_t k;
+
+                if(i < 20) { f = (b & c) | (~b & d); k = 0x5a827999; }
+                else if(i < 40) { f = b ^ c ^ d; k = 0x6ed9eba1; }
+                else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+                else { f = b ^ c ^ d; k = 0xca62c1d6; }
+
+                uint32_t next = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = next;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    alignas(16) const uint32_t sha256_k[64] =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    void sha256_scalar(uint32_t* state, const uint8_t* blocks, size_t count)
+    {
+        for (; count > 0; --count, blocks += 64)
+        {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i)
+                w[i] = load_be(blocks + i * 4);
+            for (int i = 16; i < 64; ++i)
+            {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t v[8];
+            std::memcpy(v, state, sizeof(v));
+
+            for (int i = 0; i < 64; ++i)
+            {
+                uint32_t s1 = rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25);
+                uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+                uint32_t t1 = v[7] + s1 + ch + sha256_k[i] + w[i];
+                uint32_t s0 = rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22);
+                uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+                std::memmove(v + 1, v, 7 * sizeof(uint32_t));
+                v[4] += t1;
+                v[0] = t1 + s0 + maj;
+            }
+
+            for (int i = 0; i < 8; ++i)
+                state[i] += v[i];
+        }
+    }
+
+#if BINARYVIEW_X86
+    // Four rounds on current, then the schedule work current contributes to the next three groups. The round function is
+    // an immediate, hence the template.
+    template<int Function>
+    BINARYVIEW_TARGET("sha,sse4.1,ssse3")
+    inline void sha1_ni_group(__m128i& abcd, __m128i& e_prev, __m128i current, __m128i& next, __m128i& second, __m128i& third)
+    {
+        __m128i saved = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, _mm_sha1nexte_epu32(e_prev, current), Function);
+        e_prev = saved;
+
+        next = _mm_sha1msg2_epu32(next, current);
+        second = _mm_xor_si128(second, current);
+        third = _mm_sha1msg1_epu32(third, current);
+    }
+
+    BINARYVIEW_TARGET("sha,sse4.1,ssse3")
+    void sha1_ni(uint32_t* state, const uint8_t* blocks, size_t count)
+    {
+        const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+        __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+        for (; count > 0; --count, blocks += 64)
+        {
+            __m128i abcd_save = abcd;
+            __m128i e_save = e0;
+
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks)), mask);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)), mask);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 32)), mask);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 48)), mask);
+
+            // The first groups have no previous abcd to take e from and only start the schedule
+            __m128i e_prev = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, _mm_add_epi32(e0, m0), 0);
+
+            __m128i saved = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, _mm_sha1nexte_epu32(e_prev, m1), 0);
+            e_prev = saved;
+            m0 = _mm_sha1msg1_epu32(m0, m1);
+
+            saved = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, _mm_sha1nexte_epu32(e_prev, m2), 0);
+            e_prev = saved;
+            m1 = _mm_sha1msg1_epu32(m1, m2);
+            m0 = _mm_xor_si128(m0, m2);
+
+            sha1_ni_group<0>(abcd, e_prev, m3, m0, m1, m2);
+            sha1_ni_group<0>(abcd, e_prev, m0, m1, m2, m3);
+            sha1_ni_group<1>(abcd, e_prev, m1, m2, m3, m0);
+            sha1_ni_group<1>(abcd, e_prev, m2, m3, m0, m1);
+            sha1_ni_group<1>(abcd, e_prev, m3, m0, m1, m2);
+            sha1_ni_group<1>(abcd, e_prev, m0, m1, m2, m3);
+            sha1_ni_group<1>(abcd, e_prev, m1, m2, m3, m0);
+            sha1_ni_group<2>(abcd, e_prev, m2, m3, m0, m1);
+            sha1_ni_group<2>(abcd, e_prev, m3, m0, m1, m2);
+            sha1_ni_group<2>(abcd, e_prev, m0, m1, m2, m3);
+            sha1_ni_group<2>(abcd, e_prev, m1, m2, m3, m0);
+            sha1_ni_group<2>(abcd, e_prev, m2, m3, m0, m1);
+            sha1_ni_group<3>(abcd, e_prev, m3, m0, m1, m2);
+            sha1_ni_group<3>(abcd, e_prev, m0, m1, m2, m3);
+            sha1_ni_group<3>(abcd, e_prev, m1, m2, m3, m0);
+            sha1_ni_group<3>(abcd, e_prev, m2, m3, m0, m1);
+            sha1_ni_group<3>(abcd, e_prev, m3, m0, m1, m2);
+
+            e0 = _mm_sha1nexte_epu32(e_prev, e_save);
+            abcd = _mm_add_epi32(abcd, abcd_save);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+        state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+    }
+
+    // Eight rounds, current becomes W[t..t+3] from the four groups before it unless it was just loaded
+    BINARYVIEW_TARGET("sha,sse4.1,ssse3")
+    inline void sha256_ni_group(__m128i& abef, __m128i& cdgh, __m128i& current, __m128i next, __m128i second, __m128i last, int group)
+    {
+        if(group >= 4)
+        {
+            // W[t-16] + s0(W[t-15]) + W[t-7], then s1(W[t-2])
+            current = _mm_add_epi32(_mm_sha256msg1_epu32(current, next), _mm_alignr_epi8(last, second, 4));
+            current = _mm_sha256msg2_epu32(current, last);
+        }
+
+        __m128i words = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(sha256_k + group * 4)));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+    }
+
+    BINARYVIEW_TARGET("sha,sse4.1,ssse3")
+    void sha256_ni(uint32_t* state, const uint8_t* blocks, size_t count)
+    {
+        const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // The instructions want the state as ABEF and CDGH
+        __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+        __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+        __m128i abef = _mm_alignr_epi8(dcba, hgfe, 8);
+        __m128i cdgh = _mm_blend_epi16(hgfe, dcba, 0xF0);
+
+        for (; count > 0; --count, blocks += 64)
+        {
+            __m128i abef_save = abef;
+            __m128i cdgh_save = cdgh;
+
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks)), mask);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)), mask);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 32)), mask);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 48)), mask);
+
+            for (int group = 0; group < 16; group += 4)
+            {
+                sha256_ni_group(abef, cdgh, m0, m1, m2, m3, group);
+                sha256_ni_group(abef, cdgh, m1, m2, m3, m0, group + 1);
+                sha256_ni_group(abef, cdgh, m2, m3, m0, m1, group + 2);
+                sha256_ni_group(abef, cdgh, m3, m0, m1, m2, group + 3);
+            }
+
+            abef = _mm_add_epi32(abef, abef_save);
+            cdgh = _mm_add_epi32(cdgh, cdgh_save);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    struct Kernel
+    {
+        CompressFn sha1;
+        CompressFn sha256;
+        const char* name;
+    };
+
+    const Kernel& kernel()
+    {
+        static const Kernel selected = []() -> Kernel
+        {
+#if BINARYVIEW_X86
+            if(cpu_has_sha())
+                return { sha1_ni, sha256_ni, "sha-ni" };
+#endif
+            return { sha1_scalar, sha256_scalar, "scalar" };
+        }();
+
+        return selected;
+    }
+}
+
+Md5::Md5() : state{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 }
+{
+}
+
+void Md5::update(const uint8_t* data, size_t size)
+{
+    absorb(buffer, buffered, length, data, size, state, md5_compress);
+}
+
+void Md5::finish(uint8_t* digest)
+{
+    pad(buffer, buffered, length, false, state, md5_compress);
+
+    for (int i = 0; i < 4; ++i)
+        store_le(digest + i * 4, state[i]);
+}
+
+Sha1::Sha1() : state{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 }
+{
+}
+
+void Sha1::update(const uint8_t* data, size_t size)
+{
+    absorb(buffer, buffered, length, data, size, state, kernel().sha1);
+}
+
+void Sha1::finish(uint8_t* digest)
+{
+    pad(buffer, buffered, length, true, state, kernel().sha1);
+
+    for (int i = 0; i < 5; ++i)
+        store_be(digest + i * 4, state[i]);
+}
+
+Sha256::Sha256() : state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
+}
+
+void Sha256::update(const uint8_t* data, size_t size)
+{
+    absorb(buffer, buffered, length, data, size, state, kernel().sha256);
+}
+
+void Sha256::finish(uint8_t* digest)
+{
+    pad(buffer, buffered, length, true, state, kernel().sha256);
+
+    for (int i = 0; i < 8; ++i)
+        store_be(digest + i * 4, state[i]);
+}
+
+std::string digest_hex(const uint8_t* digest, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i)
+    {
+        out[i * 2] = digits[digest[i] >> 4];
+        out[i * 2 + 1] = digits[digest[i] & 15];
+    }
+
+    return out;
+}
+
+const char* hash_isa()
+{
+    return kernel().name;
+}
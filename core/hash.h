@@ -0,0 +1,69 @@
+/*
+* MD5, SHA-1 and SHA-256
+* Streaming digests with the same update/finish shape so one pass over a file can feed several of them. SHA-1 and SHA-256
+* compress with the SHA extensions when the CPU has them, MD5 has no hardware support and every step depends on the one
+* before it, so it stays scalar.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Md5
+{
+public:
+    static constexpr size_t digest_size = 16;
+
+    Md5();
+
+    void update(const uint8_t* data, size_t size);
+    // Writes digest_size bytes, the object can't be updated afterwards
+    void finish(uint8_t* digest);
+
+private:
+    uint32_t state[4];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
+
+class Sha1
+{
+public:
+    static constexpr size_t digest_size = 20;
+
+    Sha1();
+
+    void update(const uint8_t* data, size_t size);
+    void finish(uint8_t* digest);
+
+private:
+    uint32_t state[5];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
+
+class Sha256
+{
+public:
+    static constexpr size_t digest_size = 32;
+
+    Sha256();
+
+    void update(const uint8_t* data, size_t size);
+    void finish(uint8_t* digest);
+
+private:
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
+
+// Lower case hex
+std::string digest_hex(const uint8_t* digest, size_t size);
+
+// Name of the SHA compression kernel picked for this CPU
+const char* hash_isa();
@@ -0,0 +1,679 @@
+#include "image.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    uint32_t read_u32_be(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    uint32_t read_u32_le(const uint8_t* p)
+    {
+        return p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    uint16_t read_u16_le(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    // Deflate bits come least significant first
+    struct BitReader
+    {
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        uint32_t buffer = 0;
+        int available = 0;
+        bool overrun = false;
+
+        uint32_t bits(int count)
+        {
+            while(available < count)
+            {
+                if(position >= size)
+                {
+                    overrun = true;
+                    return 0;
+                }
+
+                buffer |= uint32_t(data[position++]) << available;
+                available += 8;
+            }
+
+            uint32_t value = buffer & ((1u << count) - 1);
+            buffer >>= count;
+            available -= count;
+
+            return value;
+        }
+    };
+
+    // Canonical Huffman code as the number of codes of each length and the symbols sorted by code
+    struct Huffman
+    {
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    // False if the lengths describe more codes than fit
+    bool build_huffman(Huffman& table, const uint8_t* lengths, int count)
+    {
+        std::fill(std::begin(table.counts), std::end(table.counts), uint16_t(0));
+        for (int i = 0; i < count; ++i)
+            ++table.counts[lengths[i]];
+
+        int left = 1;
+        for (int length = 1; length < 16; ++length)
+        {
+            left = (left << 1) - table.counts[length];
+            if(left < 0)
+                return false;
+        }
+
+        uint16_t offsets[16] = {};
+        for (int length = 1; length < 15; ++length)
+            offsets[length + 1] = offsets[length] + table.counts[length];
+
+        for (int i = 0; i < count; ++i)
+        {
+            if(lengths[i] != 0)
+                table.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+
+        return true;
+    }
+
+    // Next symbol, -1 on a code that isn't in the table or the end of the data
+    int decode_symbol(BitReader& in, const Huffman& table)
+    {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+
+        for (int length = 1; length < 16; ++length)
+        {
+            code |= static_cast<int>(in.bits(1));
+            if(in.overrun)
+                return -1;
+
+            int count = table.counts[length];
+            if(code - count < first)
+                return table.symbols[index + (code - first)];
+
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        return -1;
+    }
+
+    const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    bool inflate_codes(BitReader& in, const Huffman& literals, const Huffman& distances, size_t limit, std::vector<uint8_t>& out)
+    {
+        for (;;)
+        {
+            int symbol = decode_symbol(in, literals);
+            if(symbol < 0)
+                return false;
+
+            if(symbol < 256)
+            {
+                if(out.size() >= limit)
+                    return false;
+
+                out.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+
+            if(symbol == 256)
+                return true;
+
+            symbol -= 257;
+            if(symbol >= 29)
+                return false;
+
+            size_t length = length_base[symbol] + in.bits(length_extra[symbol]);
+
+            int code = decode_symbol(in, distances);
+            if(code < 0 || code >= 30)
+                return false;
+
+            size_t distance = distance_base[code] + in.bits(distance_extra[code]);
+            if(in.overrun || distance > out.size() || length > limit - out.size())
+                return false;
+
+            // Byte by byte, the source may overlap what's being written
+            size_t from = out.size() - distance;
+            for (size_t i = 0; i < length; ++i)
+                out.push_back(out[from + i]);
+        }
+    }
+
+    // zlib stream, at most limit bytes of output. The Adler-32 at the end isn't checked.
+    bool inflate(ByteSpan data, size_t limit, std::vector<uint8_t>& out, std::string& error)
+    {
+        if(data.size() < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+        {
+            error = "invalid zlib header";
+            return false;
+        }
+
+        BitReader in = { data.data() + 2, data.size() - 2 };
+        bool last = false;
+
+        while(!last)
+        {
+            last = in.bits(1) != 0;
+            uint32_t type = in.bits(2);
+
+            if(in.overrun)
+                break;
+
+            if(type == 0)
+            {
+                // Stored, starts at the next byte boundary
+                in.buffer = 0;
+                in.available = 0;
+
+                if(in.size - in.position < 4)
+                    break;
+
+                uint16_t length = read_u16_le(in.data + in.position);
+                uint16_t inverse = read_u16_le(in.data + in.position + 2);
+                in.position += 4;
+
+                if(length != static_cast<uint16_t>(~inverse) || length > in.size - in.position || length > limit - out.size())
+                    break;
+
+                out.insert(out.end(), in.data + in.position, in.data + in.position + length);
+                in.position += length;
+
+                continue;
+            }
+
+            Huffman literals;
+            Huffman distances;
+            uint8_t lengths[320];
+
+            if(type == 1)
+            {
+                std::fill(lengths, lengths + 144, uint8_t(8));
+                std::fill(lengths + 144, lengths + 256, uint8_t(9));
+                std::fill(lengths + 256, lengths + 280, uint8_t(7));
+                std::fill(lengths + 280, lengths + 288, uint8_t(8));
+                std::fill(lengths + 288, lengths + 318, uint8_t(5));
+
+                build_huffman(literals, lengths, 288);
+                build_huffman(distances, lengths + 288, 30);
+            }
+            else if(type == 2)
+            {
+                static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+                int literal_count = static_cast<int>(in.bits(5)) + 257;
+                int distance_count = static_cast<int>(in.bits(5)) + 1;
+                int code_count = static_cast<int>(in.bits(4)) + 4;
+
+                if(literal_count > 286 || distance_count > 30)
+                    break;
+
+                uint8_t code_lengths[19] = {};
+                for (int i = 0; i < code_count; ++i)
+                    code_lengths[order[i]] = static_cast<uint8_t>(in.bits(3));
+
+                Huffman codes;
+                if(in.overrun || !build_huffman(codes, code_lengths, 19))
+                    break;
+
+                int total = literal_count + distance_count;
+                int filled = 0;
+
+                while(filled < total)
+                {
+                    int symbol = decode_symbol(in, codes);
+                    if(symbol < 0)
+                        break;
+
+                    if(symbol < 16)
+                    {
+                        lengths[filled++] = static_cast<uint8_t>(symbol);
+                        continue;
+                    }
+
+                    uint8_t value = 0;
+                    int repeat;
+
+                    if(symbol == 16)
+                    {
+                        if(filled == 0)
+                            break;
+
+                        value = lengths[filled - 1];
+                        repeat = 3 + static_cast<int>(in.bits(2));
+                    }
+                    else if(symbol == 17)
+                        repeat = 3 + static_cast<int>(in.bits(3));
+                    else
+                        repeat = 11 + static_cast<int>(in.bits(7));
+
+                    if(repeat > total - filled)
+                        break;
+
+                    std::fill(lengths + filled, lengths + filled + repeat, value);
+                    filled += repeat;
+                }
+
+                if(filled < total || lengths[256] == 0)
+                    break;
+
+                if(!build_huffman(literals, lengths, literal_count) || !build_huffman(distances, lengths + literal_count, distance_count))
+                    break;
+            }
+            else
+                break;
+
+            if(!inflate_codes(in, literals, distances, limit, out))
+                break;
+        }
+
+        if(!last || in.overrun)
+        {
+            error = "corrupt compressed data";
+            return false;
+        }
+
+        return true;
+    }
+
+    uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+    {
+        int p = int(a) + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+
+        if(pa <= pb && pa <= pc)
+            return a;
+
+        return pb <= pc ? b : c;
+    }
+}
+
+bool is_png(ByteSpan data)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    return data.size() >= sizeof(signature) && std::memcmp(data.data(), signature, sizeof(signature)) == 0;
+}
+
+bool decode_png(ByteSpan data, uint32_t max_dimension, Image& out, std::string& error)
+{
+    if(!is_png(data))
+    {
+        error = "not a PNG";
+        return false;
+    }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t depth = 0;
+    uint8_t color = 0;
+    uint8_t interlace = 0;
+    uint8_t palette[256][4];
+    uint32_t palette_size = 0;
+    std::vector<uint8_t> compressed;
+
+    for (size_t position = 8; position + 12 <= data.size(); )
+    {
+        uint32_t length = read_u32_be(data.data() + position);
+        const uint8_t* type = data.data() + position + 4;
+        const uint8_t* chunk = type + 4;
+
+        if(length > data.size() - position - 12)
+        {
+            error = "truncated chunk";
+            return false;
+        }
+
+        if(std::memcmp(type, "IHDR", 4) == 0 && length >= 13)
+        {
+            width = read_u32_be(chunk);
+            height = read_u32_be(chunk + 4);
+            depth = chunk[8];
+            color = chunk[9];
+            interlace = chunk[12];
+        }
+        else if(std::memcmp(type, "PLTE", 4) == 0)
+        {
+            palette_size = std::min<uint32_t>(length / 3, 256);
+            for (uint32_t i = 0; i < palette_size; ++i)
+            {
+                palette[i][0] = chunk[i * 3];
+                palette[i][1] = chunk[i * 3 + 1];
+                palette[i][2] = chunk[i * 3 + 2];
+                palette[i][3] = 0xFF;
+            }
+        }
+        else if(std::memcmp(type, "tRNS", 4) == 0 && color == 3)
+        {
+            for (uint32_t i = 0; i < std::min(length, palette_size); ++i)
+                palette[i][3] = chunk[i];
+        }
+        else if(std::memcmp(type, "IDAT", 4) == 0)
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        else if(std::memcmp(type, "IEND", 4) == 0)
+            break;
+
+        position += size_t(length) + 12;
+    }
+
+    if(width == 0 || height == 0 || width > max_dimension || height > max_dimension)
+    {
+        error = width == 0 || height == 0 ? "missing or empty IHDR" : "image is too large";
+        return false;
+    }
+
+    if(interlace != 0)
+    {
+        error = "interlaced PNGs aren't supported";
+        return false;
+    }
+
+    uint32_t channels;
+    switch (color)
+    {
+        case 0: channels = 1; break;
+        case 2: channels = 3; break;
+        case 3: channels = 1; break;
+        case 4: channels = 2; break;
+        case 6: channels = 4; break;
+        default:
+            error = "unknown colour type";
+            return false;
+    }
+
+    if(depth != 8 && !(color == 3 && (depth == 1 || depth == 2 || depth == 4)))
+    {
+        error = "only 8-bit channels and palettes are supported";
+        return false;
+    }
+
+    if(color == 3 && palette_size == 0)
+    {
+        error = "missing palette";
+        return false;
+    }
+
+    size_t bits_per_pixel = size_t(channels) * depth;
+    size_t stride = (width * bits_per_pixel + 7) / 8;
+    size_t step = std::max<size_t>(1, bits_per_pixel / 8); // Filters look back one pixel, at least one byte
+
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    if(!inflate(ByteSpan(compressed.data(), compressed.size()), (stride + 1) * height, raw, error))
+        return false;
+
+    if(raw.size() < (stride + 1) * height)
+    {
+        error = "image data is truncated";
+        return false;
+    }
+
+    // Undo the per-row filters in place, each row follows its filter type byte
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* row = raw.data() + y * (stride + 1) + 1;
+        const uint8_t* previous = y > 0 ? row - (stride + 1) : nullptr;
+        uint8_t filter = row[-1];
+
+        for (size_t x = 0; x < stride; ++x)
+        {
+            uint8_t left = x >= step ? row[x - step] : 0;
+            uint8_t up = previous != nullptr ? previous[x] : 0;
+            uint8_t corner = previous != nullptr && x >= step ? previous[x - step] : 0;
+
+            switch (filter)
+            {
+                case 0: break;
+                case 1: row[x] += left; break;
+                case 2: row[x] += up; break;
+                case 3: row[x] += static_cast<uint8_t>((left + up) / 2); break;
+                case 4: row[x] += paeth(left, up, corner); break;
+                default:
+                    error = "unknown row filter";
+                    return false;
+            }
+        }
+    }
+
+    out.width = width;
+    out.height = height;
+    out.rgba.resize(size_t(width) * height * 4);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = raw.data() + y * (stride + 1) + 1;
+        uint8_t* pixel = out.rgba.data() + size_t(y) * width * 4;
+
+        for (uint32_t x = 0; x < width; ++x, pixel += 4)
+        {
+            switch (color)
+            {
+                case 0:
+                    pixel[0] = pixel[1] = pixel[2] = row[x];
+                    pixel[3] = 0xFF;
+                    break;
+                case 2:
+                    std::memcpy(pixel, row + x * 3, 3);
+                    pixel[3] = 0xFF;
+                    break;
+                case 3:
+                {
+                    uint32_t bit = x * depth;
+                    uint32_t index = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+                    if(index < palette_size)
+                        std::memcpy(pixel, palette[index], 4);
+                    else
+                        std::memset(pixel, 0, 4);
+                    break;
+                }
+                case 4:
+                    pixel[0] = pixel[1] = pixel[2] = row[x * 2];
+                    pixel[3] = row[x * 2 + 1];
+                    break;
+                default:
+                    std::memcpy(pixel, row + x * 4, 4);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool decode_dib(ByteSpan data, bool icon, uint32_t max_dimension, Image& out, std::string& error)
+{
+    if(data.size() < 40 || read_u32_le(data.data()) < 40 || read_u32_le(data.data()) > data.size())
+    {
+        error = "missing BITMAPINFOHEADER";
+        return false;
+    }
+
+    const uint8_t* header = data.data();
+    uint32_t header_size = read_u32_le(header);
+    int32_t stored_width = static_cast<int32_t>(read_u32_le(header + 4));
+    int32_t stored_height = static_cast<int32_t>(read_u32_le(header + 8));
+    uint16_t bit_count = read_u16_le(header + 14);
+    uint32_t compression = read_u32_le(header + 16);
+    uint32_t colors_used = read_u32_le(header + 32);
+
+    // Positive heights are stored bottom-up, icons always are and count the mask rows too
+    bool bottom_up = stored_height > 0;
+    uint32_t width = stored_width > 0 ? static_cast<uint32_t>(stored_width) : 0;
+    uint32_t height = stored_height == INT32_MIN ? 0 : static_cast<uint32_t>(bottom_up ? stored_height : -stored_height);
+    if(icon)
+        height /= 2;
+
+    if(width == 0 || height == 0 || width > max_dimension || height > max_dimension)
+    {
+        error = width == 0 || height == 0 ? "empty image" : "image is too large";
+        return false;
+    }
+
+    const uint32_t bi_rgb = 0;
+    const uint32_t bi_bitfields = 3;
+
+    if(compression != bi_rgb && !(compression == bi_bitfields && (bit_count == 16 || bit_count == 32)))
+    {
+        error = "compressed bitmaps aren't supported";
+        return false;
+    }
+
+    if(bit_count != 1 && bit_count != 4 && bit_count != 8 && bit_count != 16 && bit_count != 24 && bit_count != 32)
+    {
+        error = "unsupported bit count";
+        return false;
+    }
+
+    size_t position = header_size;
+
+    // Channel masks, in the header from BITMAPV2INFOHEADER on, after it before that
+    uint32_t masks[4] = { 0x7C00, 0x03E0, 0x001F, 0 };
+    if(bit_count == 32)
+    {
+        masks[0] = 0x00FF0000;
+        masks[1] = 0x0000FF00;
+        masks[2] = 0x000000FF;
+        masks[3] = 0xFF000000;
+    }
+
+    if(compression == bi_bitfields)
+    {
+        size_t at = header_size >= 52 ? 40 : header_size;
+        if(at + 12 > data.size())
+        {
+            error = "missing channel masks";
+            return false;
+        }
+
+        for (int i = 0; i < 3; ++i)
+            masks[i] = read_u32_le(data.data() + at + i * 4);
+        masks[3] = header_size >= 56 ? read_u32_le(data.data() + 52) : 0;
+
+        if(header_size < 52)
+            position += 12;
+    }
+
+    uint8_t palette[256][4] = {};
+    if(bit_count <= 8)
+    {
+        uint32_t entries = colors_used != 0 && colors_used < (1u << bit_count) ? colors_used : 1u << bit_count;
+        if(position + size_t(entries) * 4 > data.size())
+        {
+            error = "truncated palette";
+            return false;
+        }
+
+        // Stored as BGRX
+        for (uint32_t i = 0; i < entries; ++i)
+        {
+            palette[i][0] = data[position + i * 4 + 2];
+            palette[i][1] = data[position + i * 4 + 1];
+            palette[i][2] = data[position + i * 4];
+            palette[i][3] = 0xFF;
+        }
+
+        position += size_t(entries) * 4;
+    }
+
+    size_t stride = (size_t(width) * bit_count + 31) / 32 * 4;
+    size_t mask_stride = (size_t(width) + 31) / 32 * 4;
+
+    if(position > data.size() || stride * height > data.size() - position)
+    {
+        error = "truncated pixel data";
+        return false;
+    }
+
+    const uint8_t* pixels = data.data() + position;
+    const uint8_t* mask = nullptr;
+    if(icon && mask_stride * height <= data.size() - position - stride * height)
+        mask = pixels + stride * height;
+
+    // Channel value scaled to 8 bits
+    auto channel = [](uint32_t value, uint32_t channel_mask) -> uint8_t
+    {
+        if(channel_mask == 0)
+            return 0;
+
+        int shift = 0;
+        while(!(channel_mask & (1u << shift)))
+            ++shift;
+
+        uint32_t maximum = channel_mask >> shift;
+        return static_cast<uint8_t>(((value & channel_mask) >> shift) * 255 / maximum);
+    };
+
+    out.width = width;
+    out.height = height;
+    out.rgba.assign(size_t(width) * height * 4, 0);
+
+    bool has_alpha = false;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint32_t stored = bottom_up ? height - 1 - y : y;
+        const uint8_t* row = pixels + stored * stride;
+        uint8_t* pixel = out.rgba.data() + size_t(y) * width * 4;
+
+        for (uint32_t x = 0; x < width; ++x, pixel += 4)
+        {
+            if(bit_count <= 8)
+            {
+                uint32_t bit = x * bit_count;
+                uint32_t index = (row[bit / 8] >> (8 - bit_count - bit % 8)) & ((1u << bit_count) - 1);
+                std::memcpy(pixel, palette[index], 4);
+            }
+            else if(bit_count == 24)
+            {
+                pixel[0] = row[x * 3 + 2];
+                pixel[1] = row[x * 3 + 1];
+                pixel[2] = row[x * 3];
+                pixel[3] = 0xFF;
+            }
+            else
+            {
+                uint32_t value = bit_count == 16 ? read_u16_le(row + x * 2) : read_u32_le(row + x * 4);
+
+                pixel[0] = channel(value, masks[0]);
+                pixel[1] = channel(value, masks[1]);
+                pixel[2] = channel(value, masks[2]);
+                pixel[3] = channel(value, masks[3]);
+                has_alpha |= pixel[3] != 0;
+            }
+        }
+    }
+
+    // Without an alpha channel (or with one that's all zero) transparency comes from the AND mask, set bits are transparent
+    if(!has_alpha)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            uint32_t stored = bottom_up ? height - 1 - y : y;
+            uint8_t* pixel = out.rgba.data() + size_t(y) * width * 4;
+
+            for (uint32_t x = 0; x < width; ++x, pixel += 4)
+                pixel[3] = mask != nullptr && (mask[stored * mask_stride + x / 8] & (0x80 >> (x % 8))) ? 0 : 0xFF;
+        }
+    }
+
+    return true;
+}
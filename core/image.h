@@ -0,0 +1,28 @@
+/*
+* Decoders for the images embedded in executables
+* Icons and bitmaps are stored either as a DIB (a BITMAPINFOHEADER without the file header) or, for the large icons of
+* newer files, as a PNG. Both come out as top-down RGBA rows. The PNG decoder only covers what icons use: no interlacing,
+* 8-bit channels or a palette, and the inflate it needs.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "span.h"
+
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> rgba; // width * height * 4
+};
+
+bool is_png(ByteSpan data);
+
+// Images wider or taller than max_dimension are refused instead of decoded
+bool decode_png(ByteSpan data, uint32_t max_dimension, Image& out, std::string& error);
+
+// icon: the height covers the colour rows and the 1-bit AND mask below them, which supplies the alpha of images without
+// an alpha channel
+bool decode_dib(ByteSpan data, bool icon, uint32_t max_dimension, Image& out, std::string& error);
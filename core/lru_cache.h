@@ -0,0 +1,75 @@
+/*
+* Least recently used cache of decoded values
+* Holds up to capacity values, find() marks an entry as used and insert() drops the one used longest ago once the cache is
+* full. Pointers returned by find() stay valid until that entry is evicted. Not thread safe.
+*/
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+    LruCache(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    // nullptr on a miss
+    Value* find(const Key& key)
+    {
+        auto it = index_.find(key);
+        if(it == index_.end())
+            return nullptr;
+
+        entries_.splice(entries_.begin(), entries_, it->second);
+
+        return &it->second->second;
+    }
+
+    Value& insert(const Key& key, Value value)
+    {
+        if(Value* existing = find(key))
+        {
+            *existing = std::move(value);
+            return *existing;
+        }
+
+        if(entries_.size() >= capacity_)
+        {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+
+        entries_.emplace_front(key, std::move(value));
+        index_[key] = entries_.begin();
+
+        return entries_.front().second;
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+    }
+
+    size_t size() const { return entries_.size(); }
+    size_t capacity() const { return capacity_; }
+
+    // Most recently used first
+    template<typename Visit>
+    void for_each(Visit&& visit) const
+    {
+        for (const Entry& entry : entries_)
+            visit(entry.first, entry.second);
+    }
+
+private:
+    using Entry = std::pair<Key, Value>;
+
+    size_t capacity_;
+    std::list<Entry> entries_;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+};
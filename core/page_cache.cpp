@@ -0,0 +1,134 @@
+#include "page_cache.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+
+PageCache::PageCache(ByteSource& source, uint32_t page_size, uint32_t page_count) : source_(source), page_size(page_size), page_count(page_count > 0 ? page_count : 1)
+{
+}
+
+void PageCache::unlink(uint32_t slot)
+{
+    Page& page = pages[slot];
+
+    if(page.prev != UINT32_MAX)
+        pages[page.prev].next = page.next;
+    else
+        head = page.next;
+
+    if(page.next != UINT32_MAX)
+        pages[page.next].prev = page.prev;
+    else
+        tail = page.prev;
+
+    page.prev = UINT32_MAX;
+    page.next = UINT32_MAX;
+}
+
+void PageCache::push_front(uint32_t slot)
+{
+    Page& page = pages[slot];
+
+    page.prev = UINT32_MAX;
+    page.next = head;
+
+    if(head != UINT32_MAX)
+        pages[head].prev = slot;
+
+    head = slot;
+
+    if(tail == UINT32_MAX)
+        tail = slot;
+}
+
+uint32_t PageCache::fetch(uint64_t index)
+{
+    auto it = slots.find(index);
+    if(it != slots.end())
+    {
+        ++hits_;
+
+        if(it->second != head)
+        {
+            unlink(it->second);
+            push_front(it->second);
+        }
+
+        return it->second;
+    }
+
+    ++misses_;
+    PROFILE_COUNT("page cache misses", 1);
+
+    if(buffer == nullptr)
+    {
+        buffer.reset(new uint8_t[uint64_t(page_size) * page_count]);
+        pages.resize(page_count);
+        slots.reserve(page_count);
+    }
+
+    // Free slots are handed out first, after that the tail gets evicted
+    uint32_t slot;
+    if(used < page_count)
+    {
+        slot = used++;
+    }
+    else
+    {
+        slot = tail;
+        unlink(slot);
+        slots.erase(pages[slot].index);
+    }
+
+    Page& page = pages[slot];
+    page.index = index;
+    page.size = static_cast<uint32_t>(source_.read(index * page_size, buffer.get() + uint64_t(slot) * page_size, page_size));
+
+    slots.emplace(index, slot);
+    push_front(slot);
+
+    return slot;
+}
+
+uint64_t PageCache::read(uint64_t offset, void* dst, uint64_t length)
+{
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    uint64_t copied = 0;
+
+    while(copied < length && offset < size())
+    {
+        uint32_t slot = fetch(offset / page_size);
+        const Page& page = pages[slot];
+
+        uint64_t within = offset % page_size;
+        if(within >= page.size)
+            break;
+
+        uint64_t count = std::min<uint64_t>(length - copied, page.size - within);
+        std::memcpy(out + copied, buffer.get() + uint64_t(slot) * page_size + within, count);
+
+        copied += count;
+        offset += count;
+    }
+
+    return copied;
+}
+
+void PageCache::clear()
+{
+    slots.clear();
+    std::fill(pages.begin(), pages.end(), Page());
+
+    head = UINT32_MAX;
+    tail = UINT32_MAX;
+    used = 0;
+}
+
+uint64_t PageCache::memory_usage() const
+{
+    uint64_t total = pages.capacity() * sizeof(Page) + slots.size() * (sizeof(std::pair<uint64_t, uint32_t>) + sizeof(void*));
+    if(buffer != nullptr)
+        total += uint64_t(page_size) * page_count;
+
+    return total;
+}
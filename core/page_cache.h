@@ -0,0 +1,62 @@
+/*
+* Fixed-size LRU cache of file pages
+* Used by views that walk arbitrary parts of a file, memory stays at page_size * page_count however large the file is.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "byte_source.h"
+
+class PageCache
+{
+public:
+    PageCache(ByteSource& source, uint32_t page_size = 64 * 1024, uint32_t page_count = 64);
+
+    uint64_t size() const { return source_.size(); }
+
+    // Copies up to length bytes starting at offset into dst through the cache, returns the amount copied
+    uint64_t read(uint64_t offset, void* dst, uint64_t length);
+
+    // Drops every cached page, the memory is kept for reuse
+    void clear();
+
+    // Approximate heap use
+    uint64_t memory_usage() const;
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+private:
+    struct Page
+    {
+        uint64_t index = UINT64_MAX;
+        uint32_t size = 0;     // Short for the last page of the file
+        uint32_t prev = UINT32_MAX;
+        uint32_t next = UINT32_MAX;
+    };
+
+    // Returns the slot holding page index, loading it over the least recently used page on a miss
+    uint32_t fetch(uint64_t index);
+
+    void unlink(uint32_t slot);
+    void push_front(uint32_t slot);
+
+    ByteSource& source_;
+    uint32_t page_size;
+    uint32_t page_count;
+
+    std::unique_ptr<uint8_t[]> buffer; // page_count pages, allocated on first use
+    std::vector<Page> pages;
+    std::unordered_map<uint64_t, uint32_t> slots;
+
+    // Most recently used at the head
+    uint32_t head = UINT32_MAX;
+    uint32_t tail = UINT32_MAX;
+    uint32_t used = 0;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
@@ -0,0 +1,265 @@
+#include "patch_layer.h"
+#include "atomic_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+PatchLayer::PatchLayer(ByteSource& source) : source_(source)
+{
+    pieces_.push_back({ 0, 0, false, UINT32_MAX, tail });
+    pieces_.push_back({ 0, 0, false, head, UINT32_MAX });
+
+    if(source_.size() > 0)
+    {
+        uint32_t whole = push(0, source_.size(), false);
+        link(head, whole, whole, tail);
+    }
+}
+
+uint32_t PatchLayer::push(uint64_t start, uint64_t length, bool added)
+{
+    pieces_.push_back({ start, length, added, UINT32_MAX, UINT32_MAX });
+
+    return static_cast<uint32_t>(pieces_.size() - 1);
+}
+
+void PatchLayer::link(uint32_t before, uint32_t first, uint32_t last, uint32_t after)
+{
+    pieces_[before].next = first;
+    pieces_[first].prev = before;
+    pieces_[last].next = after;
+    pieces_[after].prev = last;
+}
+
+uint32_t PatchLayer::find(uint64_t offset, uint64_t& piece_offset) const
+{
+    uint32_t piece = pieces_[head].next;
+    uint64_t position = 0;
+
+    // Rows of the hex view and the fields of one header are read in order, most lookups start at the last one
+    if(hint_revision_ == revision_ && hint_ != head && offset >= hint_offset_)
+    {
+        piece = hint_;
+        position = hint_offset_;
+    }
+
+    for (; piece != tail; piece = pieces_[piece].next)
+    {
+        if(offset - position < pieces_[piece].length)
+        {
+            hint_ = piece;
+            hint_offset_ = position;
+            hint_revision_ = revision_;
+            piece_offset = position;
+
+            return piece;
+        }
+
+        position += pieces_[piece].length;
+    }
+
+    piece_offset = position;
+
+    return tail;
+}
+
+bool PatchLayer::write(uint64_t offset, const void* data, uint64_t length)
+{
+    if(length == 0 || offset >= size() || length > size() - offset)
+        return false;
+
+    uint64_t end = offset + length;
+    uint64_t first_offset = 0;
+    uint64_t last_offset = 0;
+    uint32_t first = find(offset, first_offset);
+    uint32_t last = find(end - 1, last_offset);
+
+    Change change = {};
+    change.before = pieces_[first].prev;
+    change.after = pieces_[last].next;
+    change.old_first = first;
+    change.old_last = last;
+
+    for (uint32_t piece = first; ; piece = pieces_[piece].next)
+    {
+        change.added_delta -= pieces_[piece].added ? 1 : 0;
+
+        if(piece == last)
+            break;
+    }
+
+    uint64_t added_start = added_.size();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    added_.insert(added_.end(), bytes, bytes + length);
+
+    // What's left of the first and last pieces around the written range
+    uint32_t span[3];
+    size_t count = 0;
+
+    if(offset > first_offset)
+        span[count++] = push(pieces_[first].start, offset - first_offset, pieces_[first].added);
+
+    span[count++] = push(added_start, length, true);
+
+    uint64_t last_end = last_offset + pieces_[last].length;
+    if(end < last_end)
+        span[count++] = push(pieces_[last].start + (end - last_offset), last_end - end, pieces_[last].added);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        change.added_delta += pieces_[span[i]].added ? 1 : 0;
+
+        if(i > 0)
+        {
+            pieces_[span[i - 1]].next = span[i];
+            pieces_[span[i]].prev = span[i - 1];
+        }
+    }
+
+    change.first = span[0];
+    change.last = span[count - 1];
+
+    link(change.before, change.first, change.last, change.after);
+    added_pieces_ += change.added_delta;
+    ++revision_;
+
+    undo_.push_back(change);
+    redo_.clear();
+
+    return true;
+}
+
+bool PatchLayer::undo()
+{
+    if(undo_.empty())
+        return false;
+
+    Change change = undo_.back();
+    undo_.pop_back();
+
+    link(change.before, change.old_first, change.old_last, change.after);
+    added_pieces_ -= change.added_delta;
+    ++revision_;
+
+    redo_.push_back(change);
+
+    return true;
+}
+
+bool PatchLayer::redo()
+{
+    if(redo_.empty())
+        return false;
+
+    Change change = redo_.back();
+    redo_.pop_back();
+
+    link(change.before, change.first, change.last, change.after);
+    added_pieces_ += change.added_delta;
+    ++revision_;
+
+    undo_.push_back(change);
+
+    return true;
+}
+
+uint64_t PatchLayer::read(uint64_t offset, void* dst, uint64_t length) const
+{
+    if(offset >= size())
+        return 0;
+
+    length = std::min(length, size() - offset);
+
+    uint64_t piece_offset = 0;
+    uint32_t piece = find(offset, piece_offset);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    uint64_t copied = 0;
+
+    for (; piece != tail && copied < length; piece = pieces_[piece].next)
+    {
+        const Piece& current = pieces_[piece];
+        uint64_t skip = offset + copied - piece_offset;
+        uint64_t count = std::min(current.length - skip, length - copied);
+
+        if(current.added)
+            std::memcpy(out + copied, added_.data() + current.start + skip, count);
+        else if(source_.read(current.start + skip, out + copied, count) != count)
+            break;
+
+        copied += count;
+        piece_offset += current.length;
+    }
+
+    return copied;
+}
+
+std::vector<PatchLayer::Range> PatchLayer::modified_ranges() const
+{
+    std::vector<Range> ranges;
+    uint64_t position = 0;
+
+    for (uint32_t piece = pieces_[head].next; piece != tail; piece = pieces_[piece].next)
+    {
+        const Piece& current = pieces_[piece];
+
+        if(current.added)
+        {
+            // Neighbouring edits are reported as one range
+            if(!ranges.empty() && ranges.back().offset + ranges.back().length == position)
+                ranges.back().length += current.length;
+            else
+                ranges.push_back({ position, current.length });
+        }
+
+        position += current.length;
+    }
+
+    return ranges;
+}
+
+bool PatchLayer::save(const std::string& path, std::string& error) const
+{
+    return replace_file(path, [this](std::FILE* file)
+    {
+        // Unmodified ranges are written straight from the mapping, unmapped sources go through a bounded buffer
+        const uint64_t chunk_size = 1 << 20;
+        std::vector<uint8_t> buffer;
+        bool ok = true;
+
+        for (uint32_t piece = pieces_[head].next; piece != tail && ok; piece = pieces_[piece].next)
+        {
+            const Piece& current = pieces_[piece];
+
+            if(current.added)
+            {
+                ok = std::fwrite(added_.data() + current.start, 1, current.length, file) == current.length;
+                continue;
+            }
+
+            for (uint64_t done = 0; done < current.length && ok; )
+            {
+                uint64_t count = std::min(chunk_size, current.length - done);
+
+                if(source_.is_mapped())
+                {
+                    ByteSpan span = source_.view(current.start + done, count);
+                    ok = !span.empty() && std::fwrite(span.data(), 1, count, file) == count;
+                }
+                else
+                {
+                    buffer.resize(chunk_size);
+                    ok = source_.read(current.start + done, buffer.data(), count) == count && std::fwrite(buffer.data(), 1, count, file) == count;
+                }
+
+                done += count;
+            }
+        }
+
+        return ok;
+    }, error);
+}
+
+uint64_t PatchLayer::memory_usage() const
+{
+    return pieces_.capacity() * sizeof(Piece) + added_.capacity() + (undo_.capacity() + redo_.capacity()) * sizeof(Change);
+}
@@ -0,0 +1,98 @@
+/*
+* Copy-on-write edits over a read-only file
+* A piece table: the edited file is a chain of pieces, each a range of either the original file or of an append-only
+* buffer holding every byte ever written. An edit swaps the pieces it covers for new ones but keeps the old ones, so undo
+* and redo relink one span of the chain back and forth in O(1) however many edits there are. Edits only overwrite, the
+* size never changes. Saving streams the pieces, unmodified ranges straight from the mapping.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "byte_source.h"
+
+class PatchLayer
+{
+public:
+    PatchLayer(ByteSource& source);
+
+    uint64_t size() const { return source_.size(); }
+
+    // Overwrites [offset, offset + length) as one undo step and drops the redo history, false if it runs past the end
+    bool write(uint64_t offset, const void* data, uint64_t length);
+
+    // Copies up to length bytes starting at offset into dst with the edits applied, returns the amount copied
+    uint64_t read(uint64_t offset, void* dst, uint64_t length) const;
+
+    bool undo();
+    bool redo();
+    bool can_undo() const { return !undo_.empty(); }
+    bool can_redo() const { return !redo_.empty(); }
+
+    // Some edit is in effect, undoing all of them makes it false again
+    bool modified() const { return added_pieces_ > 0; }
+
+    // Changes with every write, undo and redo
+    uint64_t revision() const { return revision_; }
+
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    // Ranges whose bytes come from edits, in file order
+    std::vector<Range> modified_ranges() const;
+
+    // Writes the edited file to a temporary next to path and renames it over path, so the mapping stays valid even when
+    // path is the file it maps (not possible on Windows, the rename fails while it's mapped)
+    bool save(const std::string& path, std::string& error) const;
+
+    // Approximate heap use
+    uint64_t memory_usage() const;
+
+private:
+    static const uint32_t head = 0; // Sentinels, the chain runs from pieces_[head].next to pieces_[tail].prev
+    static const uint32_t tail = 1;
+
+    struct Piece
+    {
+        uint64_t start;  // Into the file, or into added_ when added is set
+        uint64_t length;
+        bool added;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    // The pieces from first to last replaced those from old_first to old_last between before and after. Either span is
+    // linked in at a time, the other keeps its own links.
+    struct Change
+    {
+        uint32_t before;
+        uint32_t after;
+        uint32_t old_first;
+        uint32_t old_last;
+        uint32_t first;
+        uint32_t last;
+        int32_t added_delta; // Added pieces gained by applying it
+    };
+
+    // Piece holding offset and the offset its range starts at, tail and the size when offset is past the end
+    uint32_t find(uint64_t offset, uint64_t& piece_offset) const;
+    uint32_t push(uint64_t start, uint64_t length, bool added);
+    void link(uint32_t before, uint32_t first, uint32_t last, uint32_t after);
+
+    ByteSource& source_;
+    std::vector<Piece> pieces_;
+    std::vector<uint8_t> added_;
+    std::vector<Change> undo_;
+    std::vector<Change> redo_;
+    int64_t added_pieces_ = 0; // In the chain
+    uint64_t revision_ = 0;
+
+    // Last piece find() returned, reads of neighbouring rows start there instead of at the head
+    mutable uint32_t hint_ = head;
+    mutable uint64_t hint_offset_ = 0;
+    mutable uint64_t hint_revision_ = UINT64_MAX;
+};
@@ -0,0 +1,479 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t duration;
+    };
+
+    // Per thread, so recording only takes a lock nobody else holds unless a reader is merging
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        uint32_t id;
+        std::vector<Event> events;
+        std::vector<ProfileScopeStats> scopes;  // A handful of names, found by pointer
+        std::vector<ProfileCounter> counters;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<ThreadBuffer*> buffers; // Never freed, a thread's events still belong in a trace after it exits
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        static const size_t frame_window = 600; // About 10 seconds at 60 fps
+        std::vector<double> frames;
+        size_t next_frame = 0;
+    };
+
+    // Never destroyed, pool workers can still record while statics are torn down at exit
+    Registry& registry()
+    {
+        static Registry* instance = new Registry;
+
+        return *instance;
+    }
+
+    ThreadBuffer& local_buffer()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+
+        if(buffer == nullptr)
+        {
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+
+            // Placed in malloc storage rather than allocated with new, so registering isn't counted as an allocation of the
+            // thread and nothing pairs the replaced operator new with a free
+            void* storage = std::malloc(sizeof(ThreadBuffer));
+            if(storage == nullptr)
+                throw std::bad_alloc();
+
+            buffer = new (storage) ThreadBuffer;
+            shared.buffers.push_back(buffer);
+            buffer->id = static_cast<uint32_t>(shared.buffers.size());
+        }
+
+        return *buffer;
+    }
+
+#ifdef BINARYVIEW_PROFILING
+    // Allocation counts of one thread, only that thread writes them so counting is a plain load and store on a line nobody
+    // else writes. Not a ThreadBuffer, registering one allocates. Threads link their counts into a list the reader sums
+    // and fold them into the retired totals when they exit.
+    struct AllocationCounts
+    {
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        AllocationCounts* previous = nullptr;
+        AllocationCounts* next = nullptr;
+        enum { Unlinked, Linked, Retired } state = Unlinked;
+
+        ~AllocationCounts();
+    };
+
+    struct AllocationList
+    {
+        std::mutex mutex;
+        AllocationCounts* head = nullptr;
+        uint64_t retired_allocations = 0; // Of threads that exited, and whatever they allocated while exiting
+        uint64_t retired_bytes = 0;
+        uint64_t baseline_allocations = 0; // Totals at the last reset
+        uint64_t baseline_bytes = 0;
+    };
+
+    // Never destroyed and not allocated with new, which counts into it
+    AllocationList& allocation_list()
+    {
+        alignas(AllocationList) static unsigned char storage[sizeof(AllocationList)];
+        static AllocationList* list = new (storage) AllocationList;
+
+        return *list;
+    }
+
+    thread_local AllocationCounts allocation_counts;
+
+    AllocationCounts::~AllocationCounts()
+    {
+        AllocationList& list = allocation_list();
+        std::lock_guard<std::mutex> lock(list.mutex);
+
+        list.retired_allocations += allocations.load(std::memory_order_relaxed);
+        list.retired_bytes += bytes.load(std::memory_order_relaxed);
+
+        if(state == Linked)
+        {
+            (previous != nullptr ? previous->next : list.head) = next;
+            if(next != nullptr)
+                next->previous = previous;
+        }
+
+        state = Retired;
+    }
+
+    void count_allocation(std::size_t size)
+    {
+        AllocationCounts& counts = allocation_counts;
+
+        if(counts.state != AllocationCounts::Linked)
+        {
+            AllocationList& list = allocation_list();
+            std::lock_guard<std::mutex> lock(list.mutex);
+
+            // Other thread_locals freeing and allocating after this one is gone
+            if(counts.state == AllocationCounts::Retired)
+            {
+                ++list.retired_allocations;
+                list.retired_bytes += size;
+
+                return;
+            }
+
+            counts.next = list.head;
+            if(list.head != nullptr)
+                list.head->previous = &counts;
+
+            list.head = &counts;
+            counts.state = AllocationCounts::Linked;
+        }
+
+        counts.allocations.store(counts.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        counts.bytes.store(counts.bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    }
+
+    // Totals since the process started, list.mutex has to be held
+    void total_allocations(const AllocationList& list, uint64_t& allocations, uint64_t& bytes)
+    {
+        allocations = list.retired_allocations;
+        bytes = list.retired_bytes;
+
+        for (const AllocationCounts* counts = list.head; counts != nullptr; counts = counts->next)
+        {
+            allocations += counts->allocations.load(std::memory_order_relaxed);
+            bytes += counts->bytes.load(std::memory_order_relaxed);
+        }
+    }
+#endif
+
+    void append_json_string(std::string& out, const char* text)
+    {
+        out += '"';
+
+        for (const char* c = text; *c != '\0'; ++c)
+        {
+            if(*c == '"' || *c == '\\')
+                out += '\\';
+            out += *c;
+        }
+
+        out += '"';
+    }
+}
+
+#ifdef BINARYVIEW_PROFILING
+void* operator new(std::size_t size)
+{
+    count_allocation(size);
+
+    // Like the default one, the new handler gets to free memory (or throw) until the allocation succeeds
+    for (;;)
+    {
+        if(void* memory = std::malloc(size == 0 ? 1 : size))
+            return memory;
+
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr)
+            throw std::bad_alloc();
+
+        handler();
+    }
+}
+
+// Temporary buffers of the stable sorts use this one, it has to come from the same heap as the rest
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return ::operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    std::free(memory);
+}
+#endif
+
+uint64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().start).count();
+}
+
+void Profiler::record(const char* name, uint64_t begin_ns, uint64_t duration_ns)
+{
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+
+    if(buffer.events.size() < max_events)
+        buffer.events.push_back({ name, begin_ns, duration_ns });
+
+    auto it = std::find_if(buffer.scopes.begin(), buffer.scopes.end(), [name](const ProfileScopeStats& stats) { return stats.name == name; });
+    if(it == buffer.scopes.end())
+        it = buffer.scopes.insert(buffer.scopes.end(), { name, 0, 0, 0 });
+
+    ++it->calls;
+    it->total_ns += duration_ns;
+    it->max_ns = std::max(it->max_ns, duration_ns);
+}
+
+void Profiler::count(const char* name, uint64_t amount)
+{
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+
+    auto it = std::find_if(buffer.counters.begin(), buffer.counters.end(), [name](const ProfileCounter& counter) { return counter.name == name; });
+    if(it == buffer.counters.end())
+        it = buffer.counters.insert(buffer.counters.end(), { name, 0 });
+
+    it->value += amount;
+}
+
+void Profiler::frame(double milliseconds)
+{
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    if(shared.frames.size() < Registry::frame_window)
+        shared.frames.push_back(milliseconds);
+    else
+        shared.frames[shared.next_frame] = milliseconds;
+
+    shared.next_frame = (shared.next_frame + 1) % Registry::frame_window;
+}
+
+std::vector<ProfileScopeStats> Profiler::scopes()
+{
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    std::vector<ProfileScopeStats> merged;
+
+    // The same literal can have a different address in every translation unit
+    for (ThreadBuffer* buffer : shared.buffers)
+    {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+        for (const ProfileScopeStats& stats : buffer->scopes)
+        {
+            auto it = std::find_if(merged.begin(), merged.end(), [&stats](const ProfileScopeStats& other) { return std::strcmp(other.name, stats.name) == 0; });
+            if(it == merged.end())
+            {
+                merged.push_back(stats);
+                continue;
+            }
+
+            it->calls += stats.calls;
+            it->total_ns += stats.total_ns;
+            it->max_ns = std::max(it->max_ns, stats.max_ns);
+        }
+    }
+
+    std::sort(merged.begin(), merged.end(), [](const ProfileScopeStats& a, const ProfileScopeStats& b) { return a.total_ns > b.total_ns; });
+
+    return merged;
+}
+
+std::vector<ProfileCounter> Profiler::counters()
+{
+    std::vector<ProfileCounter> merged;
+
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+
+        for (ThreadBuffer* buffer : shared.buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+            for (const ProfileCounter& counter : buffer->counters)
+            {
+                auto it = std::find_if(merged.begin(), merged.end(), [&counter](const ProfileCounter& other) { return std::strcmp(other.name, counter.name) == 0; });
+                if(it == merged.end())
+                    merged.push_back(counter);
+                else
+                    it->value += counter.value;
+            }
+        }
+    }
+
+#ifdef BINARYVIEW_PROFILING
+    {
+        AllocationList& list = allocation_list();
+        std::lock_guard<std::mutex> lock(list.mutex);
+
+        uint64_t allocations;
+        uint64_t bytes;
+        total_allocations(list, allocations, bytes);
+
+        merged.push_back({ "allocations", allocations - list.baseline_allocations });
+        merged.push_back({ "allocated bytes", bytes - list.baseline_bytes });
+    }
+#endif
+
+    std::sort(merged.begin(), merged.end(), [](const ProfileCounter& a, const ProfileCounter& b) { return std::strcmp(a.name, b.name) < 0; });
+
+    return merged;
+}
+
+ProfileFrameStats Profiler::frames()
+{
+    std::vector<double> sorted;
+
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        sorted = shared.frames;
+    }
+
+    ProfileFrameStats stats = {};
+    stats.frames = sorted.size();
+    if(sorted.empty())
+        return stats;
+
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](double fraction) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))]; };
+
+    stats.p50 = percentile(0.5);
+    stats.p90 = percentile(0.9);
+    stats.p99 = percentile(0.99);
+    stats.max = sorted.back();
+
+    return stats;
+}
+
+bool Profiler::write_trace(const std::string& path, std::string& error)
+{
+    std::vector<ProfileCounter> totals = counters();
+    ProfileFrameStats frame_stats = frames();
+    uint64_t end = now();
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char number[96];
+    bool first = true;
+
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+
+        for (ThreadBuffer* buffer : shared.buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+            // Complete events, timestamps are in microseconds
+            for (const Event& event : buffer->events)
+            {
+                out += first ? "\n{\"name\":" : ",\n{\"name\":";
+                append_json_string(out, event.name);
+                std::snprintf(number, sizeof(number), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%" PRIu32 "}", event.begin / 1000.0, event.duration / 1000.0, buffer->id);
+                out += number;
+                first = false;
+            }
+        }
+    }
+
+    // Counter totals as one sample at the end, so the trace viewer lists them too
+    std::string values = "{";
+    for (size_t i = 0; i < totals.size(); ++i)
+    {
+        if(i > 0)
+            values += ',';
+
+        append_json_string(values, totals[i].name);
+        std::snprintf(number, sizeof(number), ":%" PRIu64, totals[i].value);
+        values += number;
+    }
+    values += '}';
+
+    if(totals.size() > 0)
+    {
+        out += first ? "\n" : ",\n";
+        std::snprintf(number, sizeof(number), "{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":0,\"args\":", end / 1000.0);
+        out += number;
+        out += values;
+        out += '}';
+    }
+
+    out += "\n],\"counters\":";
+    out += values;
+    std::snprintf(number, sizeof(number), ",\"frames\":{\"count\":%zu,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}}\n", frame_stats.frames, frame_stats.p50, frame_stats.p90, frame_stats.p99, frame_stats.max);
+    out += number;
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        error = "can't create " + path;
+
+        return false;
+    }
+
+    bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    if(!ok)
+        error = "can't write " + path;
+
+    return ok;
+}
+
+void Profiler::reset()
+{
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    for (ThreadBuffer* buffer : shared.buffers)
+    {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+        buffer->events.clear();
+        buffer->scopes.clear();
+        buffer->counters.clear();
+    }
+
+    shared.frames.clear();
+    shared.next_frame = 0;
+
+#ifdef BINARYVIEW_PROFILING
+    // The counts belong to their threads, reset only moves the baseline
+    AllocationList& list = allocation_list();
+    std::lock_guard<std::mutex> allocation_lock(list.mutex);
+
+    total_allocations(list, list.baseline_allocations, list.baseline_bytes);
+#endif
+}
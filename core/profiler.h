@@ -0,0 +1,96 @@
+/*
+* Scoped timers and counters for the hot paths
+* PROFILE_SCOPE(name) times the rest of the enclosing block and PROFILE_COUNT(name, amount) adds to a named counter. Both
+* write to a buffer owned by the calling thread, so threads never wait on each other, and the buffers are only merged when
+* the overlay or a trace reads them. Names have to be string literals or live as long. Without BINARYVIEW_PROFILING (the CMake option of
+* the same name) the macros expand to nothing and allocations aren't counted.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Time and calls of one scope name across every thread
+struct ProfileScopeStats
+{
+    const char* name;
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+};
+
+struct ProfileCounter
+{
+    const char* name;
+    uint64_t value;
+};
+
+// Over the last frames recorded, in milliseconds
+struct ProfileFrameStats
+{
+    size_t frames;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+class Profiler
+{
+public:
+    static constexpr bool enabled()
+    {
+#ifdef BINARYVIEW_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Nanoseconds since the first call
+    static uint64_t now();
+
+    static void record(const char* name, uint64_t begin_ns, uint64_t duration_ns);
+    static void count(const char* name, uint64_t amount);
+    static void frame(double milliseconds);
+
+    // Sorted by total time
+    static std::vector<ProfileScopeStats> scopes();
+    // Sorted by name, allocations are included when they're counted
+    static std::vector<ProfileCounter> counters();
+    static ProfileFrameStats frames();
+
+    // Every event still buffered as Chrome trace JSON (chrome://tracing, Perfetto), with the counters and frame
+    // percentiles as extra top level keys. Threads keep their first max_events events, the aggregates count them all.
+    static bool write_trace(const std::string& path, std::string& error);
+
+    // Empties every buffer, aggregate and counter
+    static void reset();
+
+    static const size_t max_events = 1 << 20;
+};
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name_(name), begin_(Profiler::now()) {}
+    ~ProfileScope() { Profiler::record(name_, begin_, Profiler::now() - begin_); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_;
+};
+
+#ifdef BINARYVIEW_PROFILING
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profile_scope_, __LINE__)(name)
+#define PROFILE_COUNT(name, amount) Profiler::count(name, amount)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(name, amount) ((void)0)
+#endif
@@ -0,0 +1,1260 @@
+#include "signature_scanner.h"
+#include "cpu.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#if BINARYVIEW_X86
+    #include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace
+{
+    const size_t max_pattern_length = 1024;
+    const size_t max_atom_length = 4;
+    const uint32_t no_state = UINT32_MAX;
+    const uint32_t accept_bit = 0x80000000u;
+    const uint32_t state_mask = 0x7FFFFFFFu;
+
+    // 2^20 bits, 128 KB
+    const unsigned gram_bits = 20;
+
+    // Past this many distinct start bytes most positions need the three byte check anyway, the gram kernel does it instead
+    // of the start byte skip
+    const unsigned max_prefilter_bytes = 48;
+
+    uint8_t fold(uint8_t c)
+    {
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+
+    uint32_t gram_hash(uint8_t a, uint8_t b, uint8_t c)
+    {
+        return ((uint32_t(a) | uint32_t(b) << 8 | uint32_t(c) << 16) * 0x9E3779B1u) >> (32 - gram_bits);
+    }
+
+    // Input bytes that fold to c
+    std::vector<uint8_t> unfold(uint8_t c, bool folding)
+    {
+        if(folding && c >= 'a' && c <= 'z')
+            return { c, static_cast<uint8_t>(c - ('a' - 'A')) };
+
+        return { c };
+    }
+
+    unsigned count_trailing_zeros(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+
+        return index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    // Position of the first byte at or after position that can leave the root, end if there is none
+    using SkipFn = size_t (*)(const uint8_t* data, size_t position, size_t end, const uint8_t* low, const uint8_t* high);
+
+    // Position of the first candidate for the whole filter (a one byte atom in the low/high tables or a hit in the gram
+    // bitmap) at or after position, end if there is none. data has two readable bytes past end.
+    using GramFn = size_t (*)(const uint8_t* data, size_t position, size_t end, const uint64_t* grams, const uint8_t* low, const uint8_t* high);
+
+    bool in_start_set(uint8_t c, const uint8_t* low, const uint8_t* high)
+    {
+        return ((c < 0x80 ? low : high)[c & 15] >> ((c >> 4) & 7)) & 1;
+    }
+
+    bool is_candidate(const uint8_t* data, size_t position, const uint64_t* grams, const uint8_t* low, const uint8_t* high)
+    {
+        uint32_t hash = gram_hash(data[position], data[position + 1], data[position + 2]);
+
+        return in_start_set(data[position], low, high) || ((grams[hash / 64] >> (hash % 64)) & 1) != 0;
+    }
+
+    size_t grams_scalar(const uint8_t* data, size_t position, size_t end, const uint64_t* grams, const uint8_t* low, const uint8_t* high)
+    {
+        while(position < end && !is_candidate(data, position, grams, low, high))
+            ++position;
+
+        return position;
+    }
+
+    size_t skip_scalar(const uint8_t* data, size_t position, size_t end, const uint8_t* low, const uint8_t* high)
+    {
+        while(position < end && !in_start_set(data[position], low, high))
+            ++position;
+
+        return position;
+    }
+
+#if BINARYVIEW_X86
+    // Exact set membership from two nibble lookups: the low nibble picks a table entry, the high nibble one of its bits.
+    // pshufb zeroes lanes with the top bit set, so flipping it selects the table for the other half of the byte range.
+    BINARYVIEW_TARGET("ssse3")
+    size_t skip_ssse3(const uint8_t* data, size_t position, size_t end, const uint8_t* low, const uint8_t* high)
+    {
+        const __m128i low_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(low));
+        const __m128i high_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(high));
+        const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i flip = _mm_set1_epi8(-128);
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; position + 16 <= end; position += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+
+            __m128i entry = _mm_or_si128(_mm_shuffle_epi8(low_table, v), _mm_shuffle_epi8(high_table, _mm_xor_si128(v, flip)));
+            __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+
+            uint32_t hits = ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(entry, bit), zero))) & 0xFFFF;
+            if(hits != 0)
+                return position + count_trailing_zeros(hits);
+        }
+
+        return skip_scalar(data, position, end, low, high);
+    }
+
+    BINARYVIEW_TARGET("avx2")
+    size_t skip_avx2(const uint8_t* data, size_t position, size_t end, const uint8_t* low, const uint8_t* high)
+    {
+        // vpshufb looks up within each 128 bit lane, both get the same tables
+        const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low)));
+        const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(high)));
+        const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                              1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i flip = _mm256_set1_epi8(-128);
+        const __m256i zero = _mm256_setzero_si256();
+
+        for (; position + 32 <= end; position += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+
+            __m256i entry = _mm256_or_si256(_mm256_shuffle_epi8(low_table, v), _mm256_shuffle_epi8(high_table, _mm256_xor_si256(v, flip)));
+            __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+            uint32_t hits = ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(entry, bit), zero)));
+            if(hits != 0)
+                return position + count_trailing_zeros(hits);
+        }
+
+        return skip_scalar(data, position, end, low, high);
+    }
+
+    // The three byte filter eight positions at a time for rule sets where most bytes start some atom: the grams are spread
+    // into dwords, hashed with one multiply and their bits gathered from the bitmap. Single byte atoms take the nibble
+    // lookup of skip_ssse3.
+    BINARYVIEW_TARGET("avx2")
+    size_t grams_avx2(const uint8_t* data, size_t position, size_t end, const uint64_t* grams, const uint8_t* low, const uint8_t* high)
+    {
+        // Lane k gets bytes k, k + 1 and k + 2, the high half of the register repeats the 16 bytes so it starts at 4
+        const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 1, 2, 3, -1, 2, 3, 4, -1, 3, 4, 5, -1,
+                                                4, 5, 6, -1, 5, 6, 7, -1, 6, 7, 8, -1, 7, 8, 9, -1);
+        const __m256i multiplier = _mm256_set1_epi32(int(0x9E3779B1u));
+        const __m256i low_bits = _mm256_set1_epi32(31);
+        const __m256i one = _mm256_set1_epi32(1);
+        const int* words = reinterpret_cast<const int*>(grams); // Bit i of the bitmap is bit i % 32 of dword i / 32
+
+        const __m128i low_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(low));
+        const __m128i high_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(high));
+        const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i flip = _mm_set1_epi8(-128);
+        const __m128i zero = _mm_setzero_si128();
+
+        // 16 bytes are loaded for 8 positions, the last of them reads up to position + 9
+        for (; position + 16 <= end + 2; position += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+
+            __m256i hash = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(v), spread), multiplier), 32 - gram_bits);
+            __m256i word = _mm256_i32gather_epi32(words, _mm256_srli_epi32(hash, 5), 4);
+            __m256i bit = _mm256_sllv_epi32(one, _mm256_and_si256(hash, low_bits));
+
+            uint32_t hits = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(word, bit), bit))));
+
+            __m128i entry = _mm_or_si128(_mm_shuffle_epi8(low_table, v), _mm_shuffle_epi8(high_table, _mm_xor_si128(v, flip)));
+            __m128i single = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            hits |= ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(entry, single), zero))) & 0xFF;
+
+            if(hits != 0)
+                return position + count_trailing_zeros(hits);
+        }
+
+        return grams_scalar(data, position, end, grams, low, high);
+    }
+#endif
+
+    struct Kernel
+    {
+        SkipFn skip;
+        GramFn grams;
+        const char* name;
+    };
+
+    const Kernel& kernel()
+    {
+        static const Kernel selected = []() -> Kernel
+        {
+#if BINARYVIEW_X86
+            if(cpu_has_avx2())
+                return { skip_avx2, grams_avx2, "avx2" };
+
+            if(cpu_has_ssse3())
+                return { skip_ssse3, grams_scalar, "ssse3" };
+#endif
+            return { nullptr, grams_scalar, "scalar" };
+        }();
+
+        return selected;
+    }
+
+    class RuleParser
+    {
+    public:
+        RuleParser(std::string_view text, std::string& error) : text_(text), error_(error) {}
+
+        bool parse(std::vector<SignatureRule>& rules, std::vector<SignaturePattern>& patterns, uint32_t first_rule)
+        {
+            while(true)
+            {
+                skip();
+                if(at_end())
+                    return true;
+
+                std::string keyword = word();
+                if(keyword != "rule")
+                    return fail("expected 'rule'");
+
+                SignatureRule rule;
+                skip();
+                rule.name = word();
+                if(rule.name.empty())
+                    return fail("expected a rule name");
+
+                // Tags aren't used, only skipped
+                skip();
+                if(!at_end() && peek() == ':')
+                {
+                    ++position_;
+                    for (skip(); !at_end() && peek() != '{'; skip())
+                    {
+                        if(word().empty())
+                            return fail("expected a tag");
+                    }
+                }
+
+                if(!expect('{'))
+                    return false;
+
+                uint32_t index = first_rule + static_cast<uint32_t>(rules.size());
+                if(!parse_body(rule, index, patterns))
+                    return false;
+
+                if(rule.string_count == 0)
+                    return fail("rule " + rule.name + " has no strings");
+
+                rules.push_back(std::move(rule));
+            }
+        }
+
+    private:
+        bool parse_body(SignatureRule& rule, uint32_t index, std::vector<SignaturePattern>& patterns)
+        {
+            while(true)
+            {
+                skip();
+                if(at_end())
+                    return fail("missing '}'");
+
+                if(peek() == '}')
+                {
+                    ++position_;
+                    return true;
+                }
+
+                if(peek() == '$')
+                {
+                    ++position_;
+
+                    std::string id = "$" + word();
+                    if(!expect('=') || !parse_string(rule, index, id, patterns))
+                        return false;
+
+                    continue;
+                }
+
+                std::string section = word();
+                if(section == "strings")
+                {
+                    if(!expect(':'))
+                        return false;
+                }
+                else if(section == "condition")
+                {
+                    if(!expect(':') || !parse_condition(rule))
+                        return false;
+                }
+                else
+                    return fail("expected 'strings:', 'condition:' or a $string");
+            }
+        }
+
+        bool parse_condition(SignatureRule& rule)
+        {
+            std::string words[3];
+            for (std::string& text : words)
+            {
+                skip();
+                text = word();
+            }
+
+            const std::string& quantifier = words[0];
+            const std::string& of = words[1];
+            const std::string& them = words[2];
+
+            if((quantifier != "any" && quantifier != "all") || of != "of" || them != "them")
+                return fail("only 'any of them' and 'all of them' conditions are supported");
+
+            rule.all = quantifier == "all";
+
+            return true;
+        }
+
+        bool parse_string(SignatureRule& rule, uint32_t index, const std::string& id, std::vector<SignaturePattern>& patterns)
+        {
+            skip();
+
+            SignaturePattern pattern;
+            pattern.id = id;
+            pattern.rule = index;
+            pattern.string = rule.string_count++;
+
+            if(peek() == '{')
+            {
+                ++position_;
+                if(!parse_hex(pattern))
+                    return false;
+
+                return add(pattern, patterns);
+            }
+
+            if(peek() != '"')
+                return fail("expected a \"string\" or { hex bytes } after " + id);
+
+            ++position_;
+
+            std::vector<uint8_t> text;
+            if(!parse_text(text))
+                return false;
+
+            bool ascii = false;
+            bool wide = false;
+            bool nocase = false;
+
+            // Modifiers end at the next $string, section or closing brace
+            while(true)
+            {
+                size_t position = position_;
+                size_t line = line_;
+
+                skip();
+                std::string modifier = word();
+
+                if(modifier == "ascii")
+                    ascii = true;
+                else if(modifier == "wide")
+                    wide = true;
+                else if(modifier == "nocase")
+                    nocase = true;
+                else
+                {
+                    position_ = position;
+                    line_ = line;
+                    break;
+                }
+            }
+
+            pattern.nocase = nocase;
+
+            if(ascii || !wide)
+            {
+                pattern.bytes = text;
+                if(!add(pattern, patterns))
+                    return false;
+            }
+
+            if(wide)
+            {
+                pattern.bytes.clear();
+                for (uint8_t c : text)
+                {
+                    pattern.bytes.push_back(c);
+                    pattern.bytes.push_back(0);
+                }
+
+                if(!add(pattern, patterns))
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool parse_text(std::vector<uint8_t>& out)
+        {
+            while(true)
+            {
+                if(at_end() || peek() == '\n')
+                    return fail("unterminated string");
+
+                char c = text_[position_++];
+                if(c == '"')
+                    return true;
+
+                if(c != '\\')
+                {
+                    out.push_back(static_cast<uint8_t>(c));
+                    continue;
+                }
+
+                if(at_end())
+                    return fail("unterminated string");
+
+                char escape = text_[position_++];
+                switch (escape)
+                {
+                    case 'n': out.push_back('\n'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 't': out.push_back('\t'); break;
+                    case '0': out.push_back(0); break;
+                    case '\\': out.push_back('\\'); break;
+                    case '"': out.push_back('"'); break;
+                    case 'x':
+                    {
+                        int high = position_ + 1 < text_.size() ? hex_digit(text_[position_]) : -1;
+                        int low = high >= 0 ? hex_digit(text_[position_ + 1]) : -1;
+                        if(low < 0)
+                            return fail("expected two hex digits after \\x");
+
+                        out.push_back(static_cast<uint8_t>(high << 4 | low));
+                        position_ += 2;
+                        break;
+                    }
+                    default:
+                        return fail(std::string("unknown escape \\") + escape);
+                }
+            }
+        }
+
+        bool parse_hex(SignaturePattern& pattern)
+        {
+            while(true)
+            {
+                skip();
+                if(at_end())
+                    return fail("missing '}' after hex bytes");
+
+                char c = peek();
+                if(c == '}')
+                {
+                    ++position_;
+                    return true;
+                }
+
+                if(c == '[')
+                {
+                    ++position_;
+
+                    size_t count = 0;
+                    size_t digits = 0;
+                    for (skip(); !at_end() && peek() >= '0' && peek() <= '9'; ++position_, ++digits)
+                        count = std::min(count * 10 + (peek() - '0'), max_pattern_length + 1);
+
+                    skip();
+                    if(!at_end() && peek() == '-')
+                        return fail("variable length jumps aren't supported");
+
+                    if(digits == 0 || !expect(']'))
+                        return fail("expected [n]");
+
+                    if(count > max_pattern_length)
+                        return fail("jump is longer than a pattern can be");
+
+                    pattern.bytes.insert(pattern.bytes.end(), count, 0);
+                    pattern.mask.insert(pattern.mask.end(), count, 0);
+                    continue;
+                }
+
+                if(c == '(' || c == '|')
+                    return fail("alternatives aren't supported");
+
+                if(position_ + 1 >= text_.size())
+                    return fail("expected a hex byte");
+
+                uint8_t value = 0;
+                uint8_t mask = 0;
+
+                for (unsigned half = 0; half < 2; ++half)
+                {
+                    char digit = text_[position_ + half];
+                    int nibble = hex_digit(digit);
+                    unsigned shift = half == 0 ? 4 : 0;
+
+                    if(nibble >= 0)
+                    {
+                        value |= nibble << shift;
+                        mask |= 0xF << shift;
+                    }
+                    else if(digit != '?')
+                        return fail(std::string("unexpected '") + digit + "' in hex bytes");
+                }
+
+                position_ += 2;
+                pattern.bytes.push_back(value);
+                pattern.mask.push_back(mask);
+            }
+        }
+
+        bool add(SignaturePattern pattern, std::vector<SignaturePattern>& patterns)
+        {
+            if(pattern.mask.empty())
+                pattern.mask.assign(pattern.bytes.size(), 0xFF);
+
+            if(pattern.bytes.empty())
+                return fail(pattern.id + " is empty");
+
+            if(pattern.bytes.size() > max_pattern_length)
+                return fail(pattern.id + " is longer than 1024 bytes");
+
+            if(std::find(pattern.mask.begin(), pattern.mask.end(), 0xFF) == pattern.mask.end())
+                return fail(pattern.id + " needs at least one byte without wildcards");
+
+            if(pattern.nocase)
+            {
+                for (uint8_t& c : pattern.bytes)
+                    c = fold(c);
+            }
+
+            patterns.push_back(pattern);
+
+            return true;
+        }
+
+        static int hex_digit(char c)
+        {
+            if(c >= '0' && c <= '9')
+                return c - '0';
+            if(c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+
+            return -1;
+        }
+
+        // Whitespace and // or /* */ comments
+        void skip()
+        {
+            while(!at_end())
+            {
+                char c = peek();
+
+                if(c == '\n')
+                {
+                    ++line_;
+                    ++position_;
+                }
+                else if(c == ' ' || c == '\t' || c == '\r')
+                    ++position_;
+                else if(text_.compare(position_, 2, "//") == 0)
+                {
+                    while(!at_end() && peek() != '\n')
+                        ++position_;
+                }
+                else if(text_.compare(position_, 2, "/*") == 0)
+                {
+                    size_t close = text_.find("*/", position_ + 2);
+                    size_t stop = close == std::string_view::npos ? text_.size() : close + 2;
+
+                    line_ += std::count(text_.begin() + position_, text_.begin() + stop, '\n');
+                    position_ = stop;
+                }
+                else
+                    break;
+            }
+        }
+
+        std::string word()
+        {
+            size_t start = position_;
+
+            while(!at_end())
+            {
+                char c = peek();
+                if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+                    break;
+
+                ++position_;
+            }
+
+            return std::string(text_.substr(start, position_ - start));
+        }
+
+        bool expect(char c)
+        {
+            skip();
+            if(at_end() || peek() != c)
+                return fail(std::string("expected '") + c + "'");
+
+            ++position_;
+
+            return true;
+        }
+
+        bool fail(const std::string& message)
+        {
+            error_ = "line " + std::to_string(line_) + ": " + message;
+
+            return false;
+        }
+
+        bool at_end() const { return position_ >= text_.size(); }
+        char peek() const { return text_[position_]; }
+
+        std::string_view text_;
+        std::string& error_;
+        size_t position_ = 0;
+        size_t line_ = 1;
+    };
+
+    // Common bytes make atoms that hit all the time, padding and alignment fill most of all
+    unsigned byte_quality(uint8_t c)
+    {
+        return c == 0x00 || c == 0xFF || c == 0xCC || c == 0x90 || c == 0x20 ? 1 : 4;
+    }
+
+    // Exact byte window starting at each offset, up to max_atom_length long
+    size_t window_length(const SignaturePattern& pattern, size_t start)
+    {
+        size_t length = 0;
+        while(length < max_atom_length && start + length < pattern.bytes.size() && pattern.mask[start + length] == 0xFF)
+            ++length;
+
+        return length;
+    }
+
+    uint64_t window_key(const SignaturePattern& pattern, size_t start, size_t length, bool folding)
+    {
+        uint64_t key = length;
+        for (size_t j = 0; j < length; ++j)
+            key |= uint64_t(folding ? fold(pattern.bytes[start + j]) : pattern.bytes[start + j]) << (8 + j * 8);
+
+        return key;
+    }
+
+    unsigned bit_width(uint32_t value)
+    {
+        unsigned width = 0;
+        for (; value != 0; value >>= 1)
+            ++width;
+
+        return width;
+    }
+
+    // Window with the best score, first wins ties. Windows many patterns share are marked down, every pattern sharing an
+    // atom gets checked wherever it's found.
+    void pick_atom(const SignaturePattern& pattern, const std::unordered_map<uint64_t, uint32_t>& shared, bool folding, size_t& start, size_t& length)
+    {
+        int best = INT_MIN;
+        start = 0;
+        length = 0;
+
+        for (size_t i = 0; i < pattern.bytes.size(); ++i)
+        {
+            size_t run = window_length(pattern, i);
+            if(run == 0)
+                continue;
+
+            int score = 0;
+            for (size_t j = 0; j < run; ++j)
+            {
+                score += byte_quality(pattern.bytes[i + j]);
+
+                // Repeated bytes add little
+                if(std::find(pattern.bytes.begin() + i, pattern.bytes.begin() + i + j, pattern.bytes[i + j]) == pattern.bytes.begin() + i + j)
+                    score += 2;
+            }
+
+            score -= 2 * static_cast<int>(bit_width(shared.at(window_key(pattern, i, run, folding)) - 1));
+
+            if(score > best)
+            {
+                best = score;
+                start = i;
+                length = run;
+            }
+        }
+    }
+}
+
+bool SignatureSet::parse(std::string_view text, std::string& error)
+{
+    std::vector<SignatureRule> rules;
+    std::vector<SignaturePattern> patterns;
+
+    RuleParser parser(text, error);
+    if(!parser.parse(rules, patterns, static_cast<uint32_t>(rules_.size())))
+        return false;
+
+    rules_.insert(rules_.end(), rules.begin(), rules.end());
+    patterns_.insert(patterns_.end(), patterns.begin(), patterns.end());
+    compiled_ = false;
+
+    return true;
+}
+
+bool SignatureSet::load(const std::string& path, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        error = "can't read the file";
+        return false;
+    }
+
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    return parse(text, error);
+}
+
+bool SignatureSet::compile(std::string& error)
+{
+    compiled_ = false;
+    fold_ = std::any_of(patterns_.begin(), patterns_.end(), [](const SignaturePattern& pattern) { return pattern.nocase; });
+    max_length_ = 0;
+
+    // The same string in several rules is compiled and checked once, a hit is reported for each of its patterns
+    std::unordered_map<std::string, uint32_t> distinct;
+    std::vector<std::vector<uint32_t>> groups;
+
+    for (size_t i = 0; i < patterns_.size(); ++i)
+    {
+        const SignaturePattern& pattern = patterns_[i];
+
+        std::string key(pattern.bytes.begin(), pattern.bytes.end());
+        key.append(pattern.mask.begin(), pattern.mask.end());
+        key.push_back(pattern.nocase ? 1 : 0);
+
+        auto inserted = distinct.emplace(std::move(key), static_cast<uint32_t>(groups.size()));
+        if(inserted.second)
+            groups.emplace_back();
+
+        groups[inserted.first->second].push_back(static_cast<uint32_t>(i));
+    }
+
+    checks_.assign(groups.size(), {});
+    members_.clear();
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        checks_[i].member_begin = static_cast<uint32_t>(members_.size());
+        members_.insert(members_.end(), groups[i].begin(), groups[i].end());
+        checks_[i].member_end = static_cast<uint32_t>(members_.size());
+    }
+
+    // Atoms are read through the same folding as the input
+    std::vector<std::vector<uint8_t>> atoms(groups.size());
+
+    // Patterns each candidate window appears in
+    std::unordered_map<uint64_t, uint32_t> shared;
+    std::vector<uint64_t> keys;
+
+    for (const std::vector<uint32_t>& group : groups)
+    {
+        const SignaturePattern& pattern = patterns_[group[0]];
+
+        keys.clear();
+        for (size_t i = 0; i < pattern.bytes.size(); ++i)
+        {
+            size_t run = window_length(pattern, i);
+            if(run != 0)
+                keys.push_back(window_key(pattern, i, run, fold_));
+        }
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        for (uint64_t key : keys)
+            ++shared[key];
+    }
+
+    bool used[256] = {};
+    uint64_t atom_bytes = 0;
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        const SignaturePattern& pattern = patterns_[groups[i][0]];
+
+        size_t start;
+        size_t length;
+        pick_atom(pattern, shared, fold_, start, length);
+
+        for (size_t j = start; j < start + length; ++j)
+        {
+            uint8_t c = fold_ ? fold(pattern.bytes[j]) : pattern.bytes[j];
+
+            atoms[i].push_back(c);
+            used[c] = true;
+        }
+
+        Check& check = checks_[i];
+        check.atom_end = static_cast<uint32_t>(start + length);
+        check.length = static_cast<uint32_t>(pattern.bytes.size());
+
+        for (size_t j = 0; j < std::min<size_t>(8, pattern.bytes.size()); ++j)
+        {
+            uint8_t byte = pattern.bytes[j];
+            uint8_t mask = pattern.mask[j];
+
+            if(pattern.nocase && fold(byte) >= 'a' && fold(byte) <= 'z')
+            {
+                byte &= ~0x20;
+                mask &= ~0x20;
+            }
+
+            check.bytes |= uint64_t(byte) << (j * 8);
+            check.mask |= uint64_t(mask) << (j * 8);
+        }
+
+        atom_bytes += length;
+        max_length_ = std::max(max_length_, pattern.bytes.size());
+    }
+
+    // Bytes no atom uses all share class 0, so the table is only as wide as the alphabet the rules actually use
+    classes_ = 1;
+    std::memset(class_of_, 0, sizeof(class_of_));
+
+    for (unsigned c = 0; c < 256; ++c)
+    {
+        if(used[c])
+            class_of_[c] = static_cast<uint8_t>(classes_++);
+    }
+
+    if(fold_)
+    {
+        for (unsigned c = 'A'; c <= 'Z'; ++c)
+            class_of_[c] = class_of_[fold(static_cast<uint8_t>(c))];
+    }
+
+    if(atom_bytes >= state_mask)
+    {
+        error = "too many rules for the automaton";
+        return false;
+    }
+
+    // Trie of the atoms, children sorted by class
+    std::vector<std::vector<Edge>> children(1);
+    std::vector<std::vector<uint32_t>> outputs(1);
+
+    for (size_t i = 0; i < atoms.size(); ++i)
+    {
+        uint32_t state = 0;
+
+        for (uint8_t c : atoms[i])
+        {
+            uint32_t klass = class_of_[c];
+            std::vector<Edge>& edges = children[state];
+            auto edge = std::lower_bound(edges.begin(), edges.end(), klass, [](const Edge& e, uint32_t k) { return e.klass < k; });
+
+            if(edge == edges.end() || edge->klass != klass)
+            {
+                uint32_t child = static_cast<uint32_t>(children.size());
+                edges.insert(edge, { klass, child });
+                children.emplace_back();
+                outputs.emplace_back();
+                state = child;
+                continue;
+            }
+
+            state = edge->target;
+        }
+
+        outputs[state].push_back(static_cast<uint32_t>(i));
+    }
+
+    // Renumbered breadth first: the root and the states one byte deep come first and are the only ones with full rows
+    std::vector<uint32_t> order(1, 0);
+    std::vector<uint32_t> rank(children.size(), 0);
+
+    for (size_t head = 0; head < order.size(); ++head)
+    {
+        for (const Edge& edge : children[order[head]])
+        {
+            rank[edge.target] = static_cast<uint32_t>(order.size());
+            order.push_back(edge.target);
+        }
+    }
+
+    states_ = order.size();
+    shallow_states_ = 1 + static_cast<uint32_t>(children[0].size());
+
+    std::vector<std::vector<Edge>> edges(states_);
+    std::vector<std::vector<uint32_t>> merged(states_);
+
+    for (size_t state = 0; state < states_; ++state)
+    {
+        for (const Edge& edge : children[order[state]])
+            edges[state].push_back({ edge.klass, rank[edge.target] });
+
+        merged[state] = std::move(outputs[order[state]]);
+    }
+
+    auto child_of = [&](uint32_t state, uint32_t klass)
+    {
+        for (const Edge& edge : edges[state])
+        {
+            if(edge.klass == klass)
+                return edge.target;
+        }
+
+        return no_state;
+    };
+
+    // Breadth first, so a state's failure target (always shallower) is complete before it
+    failure_.assign(states_, 0);
+
+    for (uint32_t state = 0; state < states_; ++state)
+    {
+        for (const Edge& edge : edges[state])
+        {
+            uint32_t fallback = 0;
+
+            if(state != 0)
+            {
+                uint32_t current = failure_[state];
+                while((fallback = child_of(current, edge.klass)) == no_state && current != 0)
+                    current = failure_[current];
+
+                if(fallback == no_state)
+                    fallback = 0;
+            }
+
+            // Atoms ending at the longest proper suffix end here too
+            failure_[edge.target] = fallback;
+            merged[edge.target].insert(merged[edge.target].end(), merged[fallback].begin(), merged[fallback].end());
+        }
+    }
+
+    auto encode = [&](uint32_t state) { return state | (merged[state].empty() ? 0 : accept_bit); };
+
+    // Full rows for the shallow states, a missing edge takes the failure state's
+    delta_.assign(size_t(shallow_states_) * classes_, 0);
+
+    for (uint32_t state = 0; state < shallow_states_; ++state)
+    {
+        for (uint32_t klass = 0; klass < classes_; ++klass)
+        {
+            uint32_t target = child_of(state, klass);
+            if(target == no_state)
+                target = state == 0 ? 0 : delta_[klass] & state_mask;
+
+            delta_[state * classes_ + klass] = encode(target);
+        }
+    }
+
+    // Deeper states only keep their own edges
+    edge_begin_.assign(states_ - shallow_states_ + 1, 0);
+    edges_.clear();
+
+    for (size_t state = shallow_states_; state < states_; ++state)
+    {
+        edge_begin_[state - shallow_states_] = static_cast<uint32_t>(edges_.size());
+
+        for (const Edge& edge : edges[state])
+            edges_.push_back({ edge.klass, encode(edge.target) });
+    }
+    edge_begin_.back() = static_cast<uint32_t>(edges_.size());
+
+    output_begin_.assign(states_ + 1, 0);
+    outputs_.clear();
+
+    for (size_t state = 0; state < states_; ++state)
+    {
+        output_begin_[state] = static_cast<uint32_t>(outputs_.size());
+        outputs_.insert(outputs_.end(), merged[state].begin(), merged[state].end());
+    }
+    output_begin_[states_] = static_cast<uint32_t>(outputs_.size());
+
+    std::memset(singles_low_, 0, sizeof(singles_low_));
+    std::memset(singles_high_, 0, sizeof(singles_high_));
+    grams_.assign((size_t(1) << gram_bits) / 64, 0);
+
+    auto set_gram = [&](uint8_t a, uint8_t b, uint8_t c)
+    {
+        uint32_t hash = gram_hash(a, b, c);
+        grams_[hash / 64] |= uint64_t(1) << (hash % 64);
+    };
+
+    for (const std::vector<uint8_t>& atom : atoms)
+    {
+        for (uint8_t a : unfold(atom[0], fold_))
+        {
+            if(atom.size() == 1)
+            {
+                (a < 0x80 ? singles_low_ : singles_high_)[a & 15] |= 1 << ((a >> 4) & 7);
+                continue;
+            }
+
+            for (uint8_t b : unfold(atom[1], fold_))
+            {
+                if(atom.size() == 2)
+                {
+                    for (unsigned c = 0; c < 256; ++c)
+                        set_gram(a, b, static_cast<uint8_t>(c));
+
+                    continue;
+                }
+
+                for (uint8_t c : unfold(atom[2], fold_))
+                    set_gram(a, b, c);
+            }
+        }
+    }
+
+    std::memset(start_low_, 0, sizeof(start_low_));
+    std::memset(start_high_, 0, sizeof(start_high_));
+    unsigned start_bytes = 0;
+
+    for (unsigned c = 0; c < 256; ++c)
+    {
+        if((delta_[class_of_[c]] & state_mask) == 0)
+            continue;
+
+        (c < 0x80 ? start_low_ : start_high_)[c & 15] |= 1 << ((c >> 4) & 7);
+        ++start_bytes;
+    }
+
+    prefilter_ = kernel().skip != nullptr && start_bytes <= max_prefilter_bytes;
+    compiled_ = true;
+
+    return true;
+}
+
+uint32_t SignatureSet::transition(uint32_t state, uint32_t klass) const
+{
+    // Failure links only lead to shallower states, at most max_atom_length - 1 of them before a full row
+    while(state >= shallow_states_)
+    {
+        const Edge* edge = edges_.data() + edge_begin_[state - shallow_states_];
+        const Edge* last = edges_.data() + edge_begin_[state - shallow_states_ + 1];
+
+        for (; edge != last; ++edge)
+        {
+            if(edge->klass == klass)
+                return edge->target;
+        }
+
+        state = failure_[state];
+    }
+
+    return delta_[state * classes_ + klass];
+}
+
+size_t SignatureSet::next_candidate(const uint8_t* data, size_t position, size_t end) const
+{
+    if(!prefilter_)
+        return kernel().grams(data, position, end, grams_.data(), singles_low_, singles_high_);
+
+    SkipFn skip = kernel().skip;
+
+    while(position < end)
+    {
+        position = skip(data, position, end, start_low_, start_high_);
+        if(position >= end)
+            break;
+
+        if(is_candidate(data, position, grams_.data(), singles_low_, singles_high_))
+            return position;
+
+        ++position;
+    }
+
+    return end;
+}
+
+void SignatureSet::scan(const uint8_t* data, size_t size, uint64_t base_offset, const SignatureScanOptions& options, std::vector<SignatureMatch>& out) const
+{
+    if(!compiled_ || size == 0 || patterns_.empty())
+        return;
+
+    size_t first = out.size();
+    std::vector<uint32_t> counts(checks_.size(), 0);
+
+    // The filter reads three bytes, the last two positions are always walked
+    size_t filtered_end = size >= 2 ? size - 2 : 0;
+    uint32_t state = 0;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if(state < shallow_states_ && i < filtered_end)
+        {
+            // Only an atom starting at the last byte can be in progress, nothing before the next candidate can start one
+            size_t from = state == 0 ? i : i - 1;
+            size_t candidate = next_candidate(data, from, filtered_end);
+
+            if(candidate != from || state == 0)
+            {
+                state = 0;
+                i = candidate;
+            }
+        }
+
+        uint32_t target = transition(state, class_of_[data[i]]);
+        state = target & state_mask;
+
+        if((target & accept_bit) == 0)
+            continue;
+
+        // An atom ended at i, check the whole pattern around it
+
+        for (uint32_t k = output_begin_[state]; k < output_begin_[state + 1]; ++k)
+        {
+            uint32_t index = outputs_[k];
+            const Check& check = checks_[index];
+
+            if(i + 1 < check.atom_end || counts[index] >= options.max_matches_per_pattern)
+                continue;
+
+            size_t start = i + 1 - check.atom_end;
+            if(check.length > size - start)
+                continue;
+
+            if(size - start >= 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, data + start, sizeof(word));
+
+                if((word & check.mask) != check.bytes)
+                    continue;
+            }
+
+            const SignaturePattern& pattern = patterns_[members_[check.member_begin]];
+            bool matched = true;
+            for (size_t j = 0; j < pattern.bytes.size() && matched; ++j)
+            {
+                uint8_t c = pattern.nocase ? fold(data[start + j]) : data[start + j];
+                matched = (c & pattern.mask[j]) == pattern.bytes[j];
+            }
+
+            if(!matched)
+                continue;
+
+            ++counts[index];
+            for (uint32_t member = check.member_begin; member < check.member_end; ++member)
+                out.push_back({ members_[member], base_offset + start, check.length });
+        }
+    }
+
+    // Found in the order their atoms end, which differs from the order they start when atoms sit at different offsets
+    std::sort(out.begin() + first, out.end(), [](const SignatureMatch& a, const SignatureMatch& b)
+    {
+        return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+    });
+}
+
+void SignatureSet::scan_parallel(const uint8_t* data, size_t size, uint64_t base_offset, const SignatureScanOptions& options, ThreadPool& pool, std::vector<SignatureMatch>& out) const
+{
+    const size_t chunk_size = 4 << 20;
+
+    size_t chunks = (size + chunk_size - 1) / chunk_size;
+    bool observed = options.cancel != nullptr || options.progress != nullptr;
+
+    if(chunks <= 1 || (pool.size() <= 1 && !observed))
+    {
+        scan(data, size, base_offset, options, out);
+
+        if(options.progress != nullptr)
+            options.progress->fetch_add(size, std::memory_order_relaxed);
+
+        return;
+    }
+
+    // A chunk reads on past its end by the longest pattern so hits starting inside it are complete, hits starting past
+    // its end belong to the next chunk
+    std::vector<std::vector<SignatureMatch>> results(chunks);
+
+    parallel_for(pool, chunks, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t chunk = begin; chunk < end; ++chunk)
+        {
+            if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                return;
+
+            size_t first = chunk * chunk_size;
+            size_t last = std::min(size, first + chunk_size);
+            size_t read_end = std::min<uint64_t>(size, uint64_t(last) + max_length_ - 1);
+
+            std::vector<SignatureMatch>& result = results[chunk];
+            scan(data + first, read_end - first, base_offset + first, options, result);
+
+            auto outside = std::find_if(result.begin(), result.end(), [&](const SignatureMatch& match) { return match.offset >= base_offset + last; });
+            result.erase(outside, result.end());
+
+            if(options.progress != nullptr)
+                options.progress->fetch_add(last - first, std::memory_order_relaxed);
+        }
+    });
+
+    // Each chunk capped its own hits, the cap applies to the whole buffer
+    std::vector<uint32_t> counts(patterns_.size(), 0);
+
+    for (const std::vector<SignatureMatch>& result : results)
+    {
+        for (const SignatureMatch& match : result)
+        {
+            if(counts[match.pattern]++ < options.max_matches_per_pattern)
+                out.push_back(match);
+        }
+    }
+}
+
+std::vector<uint32_t> SignatureSet::matched_rules(const std::vector<SignatureMatch>& matches) const
+{
+    std::vector<std::vector<bool>> seen(rules_.size());
+    for (size_t i = 0; i < rules_.size(); ++i)
+        seen[i].assign(rules_[i].string_count, false);
+
+    for (const SignatureMatch& match : matches)
+    {
+        const SignaturePattern& pattern = patterns_[match.pattern];
+        seen[pattern.rule][pattern.string] = true;
+    }
+
+    std::vector<uint32_t> matched;
+
+    for (size_t i = 0; i < rules_.size(); ++i)
+    {
+        size_t hit = std::count(seen[i].begin(), seen[i].end(), true);
+
+        if(rules_[i].all ? hit == seen[i].size() : hit > 0)
+            matched.push_back(static_cast<uint32_t>(i));
+    }
+
+    return matched;
+}
+
+const char* signature_scanner_isa()
+{
+    return kernel().name;
+}
@@ -0,0 +1,151 @@
+/*
+* Multi-pattern signature scanning
+* Rules are written in a YARA-like subset and compiled once into an Aho-Corasick automaton over a short literal "atom" of
+* every pattern (the same string in several rules is compiled once), atom hits are verified against the full pattern
+* (wildcards included). The automaton only runs where an atom can start: whenever it's back near its root, a filter on the
+* next three bytes (a hashed bitmap that fits in L2) skips ahead to the next position where one can. While few bytes start
+* atoms a start byte check does it 16 or 32 bytes at a time with SSSE3/AVX2 (picked at runtime); with more rules most
+* bytes start some atom and AVX2 hashes eight grams at a time and gathers their bits instead. States past the first byte
+* keep only their own edges, so the automaton stays in cache with thousands of rules. The cost per byte still grows with
+* the rule count: more grams are set in the bitmap, so more positions reach the automaton and more atom hits need checks.
+*
+*   rule UPX
+*   {
+*       strings:
+*           $name = "UPX!"
+*           $stub = { 60 BE ?? ?? ?? ?? 8D BE [4] 57 }
+*           $text = "packed" nocase wide ascii
+*       condition:
+*           any of them
+*   }
+*
+* Hex bytes take ?? and nibble (4?, ?D) wildcards and [n] skips n bytes. Strings take \\ \" \n \r \t \0 and \xNN escapes
+* and the nocase, ascii and wide (UTF-16LE) modifiers. Conditions are "any of them" (the default) or "all of them".
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+struct SignaturePattern
+{
+    std::string id;             // $name, shared by the ascii and wide forms of a string
+    uint32_t rule;
+    uint32_t string;            // Index of the string within its rule, for "all of them"
+    std::vector<uint8_t> bytes; // Already masked, and lowercase for nocase patterns
+    std::vector<uint8_t> mask;  // 0xFF exact, 0xF0/0x0F nibble wildcard, 0x00 any byte
+    bool nocase = false;
+};
+
+struct SignatureRule
+{
+    std::string name;
+    uint32_t string_count = 0;
+    bool all = false; // "all of them"
+};
+
+struct SignatureMatch
+{
+    uint32_t pattern; // Index into SignatureSet::patterns()
+    uint64_t offset;  // Of the first byte, data relative plus base_offset
+    uint32_t length;
+};
+
+struct SignatureScanOptions
+{
+    uint32_t max_matches_per_pattern = 1000; // Later hits of a pattern are dropped, { 00 00 } would otherwise match everywhere
+
+    // Optional, only used by scan_parallel which checks and reports between chunks. A cancelled scan returns partial results.
+    const std::atomic<bool>* cancel = nullptr;
+    std::atomic<uint64_t>* progress = nullptr; // Bytes scanned
+};
+
+class SignatureSet
+{
+public:
+    // Adds the rules in text, false with a "line N: ..." message in error if it doesn't parse (nothing is added then)
+    bool parse(std::string_view text, std::string& error);
+    bool load(const std::string& path, std::string& error);
+
+    // Builds the automaton, has to be called after the last parse() and before scanning. False if the rules are too big
+    // for the table.
+    bool compile(std::string& error);
+
+    const std::vector<SignatureRule>& rules() const { return rules_; }
+    const std::vector<SignaturePattern>& patterns() const { return patterns_; }
+    size_t state_count() const { return states_; }
+
+    // Appends every pattern hit in data sorted by offset. Const, any number of threads can scan with one compiled set.
+    void scan(const uint8_t* data, size_t size, uint64_t base_offset, const SignatureScanOptions& options, std::vector<SignatureMatch>& out) const;
+
+    // Same result as scan, the buffer is split into chunks scanned across the pool. Chunks overlap by the longest pattern
+    // and each only keeps the hits starting inside it.
+    void scan_parallel(const uint8_t* data, size_t size, uint64_t base_offset, const SignatureScanOptions& options, ThreadPool& pool, std::vector<SignatureMatch>& out) const;
+
+    // Indices of the rules whose condition holds for these hits, in rule order
+    std::vector<uint32_t> matched_rules(const std::vector<SignatureMatch>& matches) const;
+
+private:
+    std::vector<SignatureRule> rules_;
+    std::vector<SignaturePattern> patterns_;
+    size_t max_length_ = 0;
+    bool fold_ = false; // Some pattern is nocase, the automaton reads lowercase input
+
+    // Automaton, see compile(). Transitions hold the target state with accept_bit set when atoms end in it. The root and
+    // the states one byte deep (below shallow_states_) have a full row in delta_, deeper ones only their own edges and
+    // fall back along failure_, which keeps the automaton in cache with thousands of rules.
+    struct Edge
+    {
+        uint32_t klass;
+        uint32_t target;
+    };
+
+    uint8_t class_of_[256] = {};
+    uint32_t classes_ = 0;
+    size_t states_ = 0;
+    uint32_t shallow_states_ = 0;
+    std::vector<uint32_t> delta_;
+    std::vector<uint32_t> edge_begin_; // Per deep state, into edges_, one past the end is the next state's begin
+    std::vector<Edge> edges_;
+    std::vector<uint32_t> failure_;
+    std::vector<uint32_t> output_begin_; // Per state, into outputs_, one past the end is the next state's begin
+    std::vector<uint32_t> outputs_;      // Distinct patterns (into checks_) whose atom ends at the state
+
+    // Per distinct pattern (the same string can be in several rules), where its atom ends and its first eight bytes as
+    // one masked word (letters of nocase patterns without the case bit) so most atom hits that aren't pattern hits are
+    // turned down without touching the pattern itself
+    struct Check
+    {
+        uint32_t atom_end;
+        uint32_t length;
+        uint64_t bytes;
+        uint64_t mask;
+        uint32_t member_begin; // Into members_, the patterns with this string
+        uint32_t member_end;
+    };
+    std::vector<Check> checks_;
+    std::vector<uint32_t> members_;
+    // Filter for positions where an atom can start: singles_low_/singles_high_ have the bytes of one byte atoms (laid out
+    // like start_low_/start_high_), grams_ the hashed first three bytes of the others (every third byte for two byte atoms)
+    uint8_t singles_low_[16] = {};
+    uint8_t singles_high_[16] = {};
+    std::vector<uint64_t> grams_;
+
+    // Bytes that start atoms for the SIMD skip: entry b & 15 has bit (b >> 4) & 7 set, start_low_ for bytes below 0x80
+    uint8_t start_low_[16] = {};
+    uint8_t start_high_[16] = {};
+    bool prefilter_ = false;
+    bool compiled_ = false;
+
+    uint32_t transition(uint32_t state, uint32_t klass) const;
+    size_t next_candidate(const uint8_t* data, size_t position, size_t end) const;
+};
+
+// Name of the prefilter kernel picked for this CPU
+const char* signature_scanner_isa();
@@ -0,0 +1,39 @@
+/*
+* Lightweight read-only views, C++17 has no std::span
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+template<typename T>
+class Span
+{
+public:
+    Span() = default;
+    Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+    const T& operator[](size_t index) const { return data_[index]; }
+
+    // Bounds-checked sub view, empty if [offset, offset + count) doesn't fit
+    Span subspan(size_t offset, size_t count) const
+    {
+        if(offset > size_ || count > size_ - offset)
+            return {};
+
+        return Span(data_ + offset, count);
+    }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+using ByteSpan = Span<uint8_t>;
@@ -0,0 +1,282 @@
+#include "string_index.h"
+#include <algorithm>
+#include <numeric>
+#include <regex>
+
+namespace
+{
+    const uint32_t bucket_count = 1 << 16;
+
+    char fold(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    std::string fold(std::string_view text)
+    {
+        std::string out(text);
+        for (char& c : out)
+            c = fold(c);
+
+        return out;
+    }
+
+    uint32_t trigram_bucket(const char* p)
+    {
+        uint32_t value = uint32_t(uint8_t(p[0])) | (uint32_t(uint8_t(p[1])) << 8) | (uint32_t(uint8_t(p[2])) << 16);
+
+        return (value * 2654435761u) >> 16;
+    }
+}
+
+bool StringIndex::add(std::string_view text)
+{
+    if(offsets_storage.empty())
+        offsets_storage.push_back(0);
+
+    // Ids and postings stay below the arena size too, so this one check keeps every table in range
+    if(text.size() >= UINT32_MAX - arena_storage.size())
+        return false;
+
+    arena_storage.append(text.data(), text.size());
+    arena_storage.push_back('\0');
+
+    offsets_storage.push_back(static_cast<uint32_t>(arena_storage.size()));
+
+    return true;
+}
+
+void StringIndex::finalize()
+{
+    if(offsets_storage.empty())
+        offsets_storage.push_back(0);
+
+    folded_storage = fold(arena_storage);
+
+    arena = arena_storage;
+    folded = folded_storage;
+    offsets = Span<uint32_t>(offsets_storage.data(), offsets_storage.size());
+
+    // Two passes over the arena, count then fill, so the postings are one allocation.
+    // A string is posted once per bucket no matter how often the trigram repeats in it.
+    std::vector<uint32_t> last_id(bucket_count, UINT32_MAX);
+    std::vector<uint32_t>& counts = bucket_offsets_storage;
+    counts.assign(bucket_count + 1, 0);
+
+    auto for_each_bucket = [&](auto&& visit)
+    {
+        std::fill(last_id.begin(), last_id.end(), UINT32_MAX);
+
+        for (uint32_t id = 0; id < size(); ++id)
+        {
+            std::string_view text = folded_text(id);
+
+            for (size_t i = 0; i + 3 <= text.size(); ++i)
+            {
+                uint32_t bucket = trigram_bucket(text.data() + i);
+                if(last_id[bucket] == id)
+                    continue;
+
+                last_id[bucket] = id;
+                visit(bucket, id);
+            }
+        }
+    };
+
+    for_each_bucket([&](uint32_t bucket, uint32_t) { ++counts[bucket + 1]; });
+
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+    postings_storage.resize(counts.back());
+
+    std::vector<uint32_t> cursor(counts.begin(), counts.end() - 1);
+    for_each_bucket([&](uint32_t bucket, uint32_t id) { postings_storage[cursor[bucket]++] = id; });
+
+    bucket_offsets = Span<uint32_t>(counts.data(), counts.size());
+    postings = Span<uint32_t>(postings_storage.data(), postings_storage.size());
+
+    has_result = false;
+    ++generation_;
+}
+
+void StringIndex::clear()
+{
+    *this = StringIndex();
+}
+
+uint64_t StringIndex::memory_usage() const
+{
+    return arena_storage.capacity() + folded_storage.capacity() + last_query.capacity() +
+        (offsets_storage.capacity() + bucket_offsets_storage.capacity() + postings_storage.capacity() + matches.capacity()) * sizeof(uint32_t);
+}
+
+bool StringIndex::attach(const Tables& tables)
+{
+    clear();
+
+    // Everything search() indexes with is checked once here so it never has to be
+    const Span<uint32_t>& ends = tables.offsets;
+    if(ends.empty() || ends[0] != 0 || ends[ends.size() - 1] != tables.arena.size() || tables.folded.size() != tables.arena.size())
+        return false;
+
+    for (size_t i = 1; i < ends.size(); ++i)
+    {
+        if(ends[i] <= ends[i - 1] || tables.arena[ends[i] - 1] != '\0')
+            return false;
+    }
+
+    const Span<uint32_t>& buckets = tables.bucket_offsets;
+    if(buckets.size() != bucket_count + 1 || buckets[0] != 0 || buckets[bucket_count] != tables.postings.size())
+        return false;
+
+    for (size_t i = 1; i < buckets.size(); ++i)
+    {
+        if(buckets[i] < buckets[i - 1])
+            return false;
+    }
+
+    for (uint32_t id : tables.postings)
+    {
+        if(id >= ends.size() - 1)
+            return false;
+    }
+
+    arena = tables.arena;
+    folded = tables.folded;
+    offsets = tables.offsets;
+    bucket_offsets = tables.bucket_offsets;
+    postings = tables.postings;
+    ++generation_;
+
+    return true;
+}
+
+std::string_view StringIndex::text(uint32_t id) const
+{
+    return std::string_view(arena.data() + offsets[id], offsets[id + 1] - offsets[id] - 1);
+}
+
+std::string_view StringIndex::folded_text(uint32_t id) const
+{
+    return std::string_view(folded.data() + offsets[id], offsets[id + 1] - offsets[id] - 1);
+}
+
+uint32_t StringIndex::id_at(size_t arena_offset) const
+{
+    return static_cast<uint32_t>(std::upper_bound(offsets.begin(), offsets.end(), arena_offset) - offsets.begin() - 1);
+}
+
+void StringIndex::candidates_from_trigrams(std::string_view folded_query, std::vector<uint32_t>& out) const
+{
+    std::vector<uint32_t> buckets;
+    for (size_t i = 0; i + 3 <= folded_query.size(); ++i)
+        buckets.push_back(trigram_bucket(folded_query.data() + i));
+
+    std::sort(buckets.begin(), buckets.end());
+    buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+    // Intersect starting from the rarest lists, every candidate gets verified anyway so a few lists are enough
+    std::sort(buckets.begin(), buckets.end(), [this](uint32_t a, uint32_t b)
+    {
+        return bucket_offsets[a + 1] - bucket_offsets[a] < bucket_offsets[b + 1] - bucket_offsets[b];
+    });
+
+    if(buckets.size() > 4)
+        buckets.resize(4);
+
+    const uint32_t* first = postings.data() + bucket_offsets[buckets[0]];
+    out.assign(first, postings.data() + bucket_offsets[buckets[0] + 1]);
+
+    std::vector<uint32_t> intersection;
+    for (size_t i = 1; i < buckets.size() && !out.empty(); ++i)
+    {
+        const uint32_t* begin = postings.data() + bucket_offsets[buckets[i]];
+        const uint32_t* end = postings.data() + bucket_offsets[buckets[i] + 1];
+
+        intersection.clear();
+        std::set_intersection(out.begin(), out.end(), begin, end, std::back_inserter(intersection));
+        out.swap(intersection);
+    }
+}
+
+void StringIndex::candidates_from_scan(std::string_view folded_query, std::vector<uint32_t>& out) const
+{
+    // Too short for trigrams, one find() over the contiguous arena is still far cheaper than a find() per string
+    std::string_view haystack(folded);
+
+    size_t position = haystack.find(folded_query);
+    while(position != std::string_view::npos)
+    {
+        uint32_t id = id_at(position);
+        out.push_back(id);
+
+        position = haystack.find(folded_query, offsets[id + 1]);
+    }
+}
+
+const std::vector<uint32_t>& StringIndex::search(std::string_view query, SearchMode mode)
+{
+    if(has_result && mode == last_mode && query == last_query)
+        return matches;
+
+    std::vector<uint32_t> result;
+    invalid_query_ = false;
+
+    if(query.empty())
+    {
+        result.resize(size());
+        std::iota(result.begin(), result.end(), 0u);
+    }
+    else if(mode == SearchMode::Regex)
+    {
+        try
+        {
+            std::regex pattern(query.begin(), query.end(), std::regex::ECMAScript | std::regex::optimize);
+
+            for (uint32_t id = 0; id < size(); ++id)
+            {
+                std::string_view string = text(id);
+
+                if(std::regex_search(string.begin(), string.end(), pattern))
+                    result.push_back(id);
+            }
+        }
+        catch (const std::regex_error&)
+        {
+            invalid_query_ = true;
+        }
+    }
+    else
+    {
+        bool ignore_case = mode == SearchMode::CaseInsensitive;
+        std::string folded_query = fold(query);
+
+        // Typing appends to the query, every match of the new query must be a match of the previous one
+        bool refine = has_result && last_mode == mode && !last_query.empty() &&
+            (ignore_case ? folded_query.find(fold(last_query)) : std::string_view(query).find(last_query)) != std::string::npos;
+
+        std::vector<uint32_t> candidates;
+
+        if(refine)
+            candidates.swap(matches);
+        else if(folded_query.size() >= 3)
+            candidates_from_trigrams(folded_query, candidates);
+        else
+            candidates_from_scan(folded_query, candidates);
+
+        for (uint32_t id : candidates)
+        {
+            bool found = ignore_case ? folded_text(id).find(folded_query) != std::string_view::npos : text(id).find(query) != std::string_view::npos;
+
+            if(found)
+                result.push_back(id);
+        }
+    }
+
+    matches.swap(result);
+    last_query.assign(query.data(), query.size());
+    last_mode = mode;
+    has_result = true;
+    ++generation_;
+
+    return matches;
+}
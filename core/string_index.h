@@ -0,0 +1,90 @@
+/*
+* Search index over extracted strings
+* All texts live in one contiguous arena (plus a case folded copy) and every string is posted under the hashed trigrams it
+* contains, so substring queries only verify the strings that can possibly match. The tables can also be borrowed from a
+* mapped analysis cache instead of being built.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "span.h"
+
+enum class SearchMode
+{
+    Substring,
+    CaseInsensitive,
+    Regex
+};
+
+class StringIndex
+{
+public:
+    // Everything search() reads, arena holds the NUL separated texts and offsets has one extra entry at the end
+    struct Tables
+    {
+        std::string_view arena;
+        std::string_view folded;
+        Span<uint32_t> offsets;
+        Span<uint32_t> bucket_offsets;
+        Span<uint32_t> postings;
+    };
+
+    // Strings get consecutive ids in the order they're added, call finalize() once everything is added. Offsets are 32
+    // bit, false (and nothing added) once text would take the arena past 4 GB.
+    bool add(std::string_view text);
+    void finalize();
+
+    void clear();
+
+    // Valid after finalize() or attach()
+    Tables tables() const { return { arena, folded, offsets, bucket_offsets, postings }; }
+    // Uses tables someone else keeps alive instead of add()/finalize(), false (and left empty) if they're inconsistent
+    bool attach(const Tables&);
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    std::string_view text(uint32_t id) const;
+
+    // Ids of the matching strings in ascending order. The result is cached, repeating a query costs nothing and a query
+    // that extends the previous one (typing) only re-checks the previous matches.
+    const std::vector<uint32_t>& search(std::string_view query, SearchMode mode);
+
+    // Changes whenever the result of search() changes
+    uint64_t generation() const { return generation_; }
+
+    // Set when the last regex query didn't compile
+    bool invalid_query() const { return invalid_query_; }
+
+    // Approximate heap use, attached tables aren't counted
+    uint64_t memory_usage() const;
+
+private:
+    std::string_view folded_text(uint32_t id) const;
+    uint32_t id_at(size_t arena_offset) const;
+
+    void candidates_from_trigrams(std::string_view folded_query, std::vector<uint32_t>& out) const;
+    void candidates_from_scan(std::string_view folded_query, std::vector<uint32_t>& out) const;
+
+    // Views of the storage below or of attached tables. Compressed posting lists, bucket b owns
+    // postings[bucket_offsets[b], bucket_offsets[b + 1])
+    std::string_view arena;
+    std::string_view folded;
+    Span<uint32_t> offsets;
+    Span<uint32_t> bucket_offsets;
+    Span<uint32_t> postings;
+
+    std::string arena_storage;
+    std::string folded_storage;
+    std::vector<uint32_t> offsets_storage;
+    std::vector<uint32_t> bucket_offsets_storage;
+    std::vector<uint32_t> postings_storage;
+
+    std::vector<uint32_t> matches;
+    std::string last_query;
+    SearchMode last_mode = SearchMode::Substring;
+    bool has_result = false;
+    bool invalid_query_ = false;
+    uint64_t generation_ = 0;
+};
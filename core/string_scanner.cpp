@@ -0,0 +1,643 @@
+#include "string_scanner.h"
+#include "cpu.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+#if BINARYVIEW_X86
+    #include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace
+{
+    // Classifies blocks of 64 bytes, bit i of a mask describes byte i of the block
+    using ClassifyFn = void (*)(const uint8_t* data, size_t blocks, uint64_t* printable, uint64_t* zero);
+
+    bool is_printable(uint8_t c)
+    {
+        return (c >= 0x20 && c <= 0x7E) || c == '\t';
+    }
+
+    unsigned count_trailing_zeros(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+
+        return index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    // Gathers the even bits of a 64 bit mask into the low 32 bits
+    uint64_t compress_even_bits(uint64_t x)
+    {
+        x &= 0x5555555555555555ull;
+        x = (x | (x >> 1)) & 0x3333333333333333ull;
+        x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+        x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+
+        return x;
+    }
+
+    void classify_scalar(const uint8_t* data, size_t blocks, uint64_t* printable, uint64_t* zero)
+    {
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            uint64_t p = 0;
+            uint64_t z = 0;
+
+            for (unsigned i = 0; i < 64; ++i)
+            {
+                uint8_t c = data[block * 64 + i];
+
+                p |= uint64_t(is_printable(c)) << i;
+                z |= uint64_t(c == 0) << i;
+            }
+
+            printable[block] = p;
+            zero[block] = z;
+        }
+    }
+
+#if BINARYVIEW_X86
+    BINARYVIEW_TARGET("sse2")
+    void classify_sse2(const uint8_t* data, size_t blocks, uint64_t* printable, uint64_t* zero)
+    {
+        // Printable bytes are 0x20-0x7E, as signed bytes everything >= 0x80 is negative so two signed compares cover it
+        const __m128i below = _mm_set1_epi8(0x1F);
+        const __m128i above = _mm_set1_epi8(0x7F);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i nul = _mm_setzero_si128();
+
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            uint64_t p = 0;
+            uint64_t z = 0;
+
+            for (unsigned lane = 0; lane < 4; ++lane)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + block * 64 + lane * 16));
+
+                __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+                __m128i is_print = _mm_or_si128(in_range, _mm_cmpeq_epi8(v, tab));
+
+                p |= uint64_t(uint16_t(_mm_movemask_epi8(is_print))) << (lane * 16);
+                z |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul)))) << (lane * 16);
+            }
+
+            printable[block] = p;
+            zero[block] = z;
+        }
+    }
+
+    BINARYVIEW_TARGET("avx2")
+    void classify_avx2(const uint8_t* data, size_t blocks, uint64_t* printable, uint64_t* zero)
+    {
+        const __m256i below = _mm256_set1_epi8(0x1F);
+        const __m256i above = _mm256_set1_epi8(0x7F);
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i nul = _mm256_setzero_si256();
+
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * 64));
+            __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * 64 + 32));
+
+            __m256i print_lo = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(lo, below), _mm256_cmpgt_epi8(above, lo)), _mm256_cmpeq_epi8(lo, tab));
+            __m256i print_hi = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(hi, below), _mm256_cmpgt_epi8(above, hi)), _mm256_cmpeq_epi8(hi, tab));
+
+            printable[block] = uint64_t(uint32_t(_mm256_movemask_epi8(print_lo))) | (uint64_t(uint32_t(_mm256_movemask_epi8(print_hi))) << 32);
+            zero[block] = uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nul)))) | (uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nul)))) << 32);
+        }
+    }
+#endif
+
+    struct Kernel
+    {
+        ClassifyFn classify;
+        const char* name;
+    };
+
+    const Kernel& kernel()
+    {
+        static const Kernel selected = []() -> Kernel
+        {
+#if BINARYVIEW_X86
+            if(cpu_has_avx2())
+                return { classify_avx2, "avx2" };
+
+            if(cpu_has_sse2())
+                return { classify_sse2, "sse2" };
+#endif
+            return { classify_scalar, "scalar" };
+        }();
+
+        return selected;
+    }
+
+    // Streams a RunTracker follows: ASCII, then UTF-16 at even and at odd offsets
+    const unsigned stream_count = 3;
+
+    struct Run
+    {
+        bool active = false;
+        uint64_t start = 0;
+        bool continued = false; // Started before the chunk being scanned, start is only known once the chunks are stitched
+    };
+
+    // A run that started in an earlier chunk and ended in this one, it left a placeholder at index in the chunk's strings
+    struct DeferredRun
+    {
+        size_t index = SIZE_MAX;
+        uint64_t end = 0;
+    };
+
+    void append_run(uint64_t base_offset, uint64_t start, uint64_t end, StringEncoding encoding, size_t min_length, std::vector<StringSpan>& out)
+    {
+        uint64_t length = end - start;
+        uint64_t characters = encoding == StringEncoding::UTF16LE ? length / 2 : length;
+
+        if(characters < min_length)
+            return;
+
+        // Lengths are 32 bit, runs over 4GB are split
+        const uint64_t max_length = 0xFFFFFFFEull;
+        while(length > max_length)
+        {
+            out.push_back({ base_offset + start, uint32_t(max_length), encoding });
+            start += max_length;
+            length -= max_length;
+        }
+
+        out.push_back({ base_offset + start, uint32_t(length), encoding });
+    }
+
+    class RunTracker
+    {
+    public:
+        RunTracker(uint64_t base_offset, const StringScanOptions& options, std::vector<StringSpan>& out) : base_offset_(base_offset), options_(options), out_(out) {}
+
+        // next_* are the masks of the following block, strings and UTF-16 characters can straddle blocks
+        void block(uint64_t origin, uint64_t printable, uint64_t zero, uint64_t next_printable, uint64_t next_zero)
+        {
+            Filtered masks = filter(printable, zero, next_printable, next_zero);
+
+            if(options_.ascii)
+                track(0, masks.ascii, ~0ull, origin, 1, StringEncoding::ASCII);
+
+            if(options_.utf16)
+            {
+                for (unsigned lane = 0; lane < 2; ++lane)
+                    track(1 + lane, masks.lanes[lane], 0xFFFFFFFFull, origin + lane, 2, StringEncoding::UTF16LE);
+            }
+        }
+
+        // Picks up at position (a block boundary) without looking behind it, previous_* are the masks of the block before it.
+        // Runs crossing the boundary are continued from an unknown start, see DeferredRun.
+        void resume(uint64_t position, uint64_t previous_printable, uint64_t previous_zero, uint64_t printable, uint64_t zero)
+        {
+            Filtered previous = filter(previous_printable, previous_zero, printable, zero);
+
+            if(options_.ascii && (previous.ascii >> 63) != 0)
+                runs_[0] = { true, position, true };
+
+            for (unsigned lane = 0; lane < 2; ++lane)
+            {
+                if(options_.utf16 && ((previous.lanes[lane] >> 31) & 1) != 0)
+                    runs_[1 + lane] = { true, position + lane, true };
+            }
+        }
+
+        void finish(uint64_t size)
+        {
+            for (unsigned stream = 0; stream < stream_count; ++stream)
+            {
+                const Run& run = runs_[stream];
+                if(!run.active)
+                    continue;
+
+                if(stream == 0)
+                    close(stream, size, StringEncoding::ASCII);
+                else
+                    close(stream, run.start + ((size - run.start) & ~1ull), StringEncoding::UTF16LE);
+            }
+        }
+
+        const Run& open_run(unsigned stream) const { return runs_[stream]; }
+        const DeferredRun& deferred_run(unsigned stream) const { return deferred_[stream]; }
+
+    private:
+        struct Filtered
+        {
+            uint64_t ascii;
+            uint64_t lanes[2];
+        };
+
+        Filtered filter(uint64_t printable, uint64_t zero, uint64_t next_printable, uint64_t next_zero)
+        {
+            Filtered masks = {};
+
+            if(options_.ascii)
+                masks.ascii = long_runs(printable, next_printable);
+
+            if(options_.utf16)
+            {
+                // Bit i is a printable character followed by a NUL, each alignment is tracked as its own lane of pairs.
+                // The lookahead block's own last pair can't be known yet, it's only needed for runs longer than 32 characters.
+                uint64_t pairs = printable & ((zero >> 1) | ((next_zero & 1) << 63));
+                uint64_t next_pairs = next_printable & (next_zero >> 1);
+
+                masks.lanes[0] = long_lane_runs(0, compress_even_bits(pairs), compress_even_bits(next_pairs));
+                masks.lanes[1] = long_lane_runs(1, compress_even_bits(pairs >> 1), compress_even_bits(next_pairs >> 1));
+            }
+
+            return masks;
+        }
+
+        // Drops printable runs shorter than min_length from the mask so binary noise never reaches the transition walk.
+        // Erode (bit i set if the next min_length bytes are printable) then dilate back, both by doubling shifts.
+        uint64_t long_runs(uint64_t printable, uint64_t next_printable)
+        {
+            unsigned length = unsigned(options_.min_length);
+            if(length <= 1 || length > 64)
+                return printable;
+
+            uint64_t lo = printable;
+            uint64_t hi = next_printable;
+
+            unsigned span = 1;
+            for (; span * 2 <= length; span *= 2)
+            {
+                lo &= (lo >> span) | (hi << (64 - span));
+                hi &= hi >> span;
+            }
+
+            unsigned rest = length - span;
+            uint64_t starts = rest == 0 ? lo : lo & ((lo >> rest) | (hi << (64 - rest)));
+
+            uint64_t cur = starts;
+            uint64_t prev = previous_starts_;
+
+            for (unsigned step = 1; step < span; step *= 2)
+            {
+                cur |= (cur << step) | (prev >> (64 - step));
+                prev |= prev << step;
+            }
+
+            if(rest != 0)
+                cur |= (cur << rest) | (prev >> (64 - rest));
+
+            previous_starts_ = starts;
+
+            return cur;
+        }
+
+        // Same as long_runs for the 32 pair lanes, the current and next block fit in one word
+        uint64_t long_lane_runs(unsigned lane, uint64_t pairs, uint64_t next_pairs)
+        {
+            unsigned length = unsigned(options_.min_length);
+            if(length <= 1 || length > 32)
+                return pairs;
+
+            uint64_t window = pairs | (next_pairs << 32);
+
+            unsigned span = 1;
+            for (; span * 2 <= length; span *= 2)
+                window &= window >> span;
+
+            unsigned rest = length - span;
+            if(rest != 0)
+                window &= window >> rest;
+
+            uint64_t starts = window & 0xFFFFFFFFull;
+
+            // Previous block in the low half so the dilation can carry into this one
+            uint64_t spread = previous_lane_starts_[lane] | (starts << 32);
+
+            for (unsigned step = 1; step < span; step *= 2)
+                spread |= spread << step;
+
+            if(rest != 0)
+                spread |= spread << rest;
+
+            previous_lane_starts_[lane] = starts;
+
+            return spread >> 32;
+        }
+
+        // Walks the transitions of a mask, bit k describes the character at origin + k * stride
+        void track(unsigned stream, uint64_t bits, uint64_t width_mask, uint64_t origin, unsigned stride, StringEncoding encoding)
+        {
+            Run& run = runs_[stream];
+            unsigned width = width_mask == ~0ull ? 64 : 32;
+            unsigned position = 0;
+
+            while(position < width)
+            {
+                if(run.active)
+                {
+                    uint64_t rest = (~bits & width_mask) >> position;
+                    if(rest == 0)
+                        return; // Run continues into the next block
+
+                    position += count_trailing_zeros(rest);
+
+                    close(stream, origin + uint64_t(position) * stride, encoding);
+                }
+                else
+                {
+                    uint64_t rest = bits >> position;
+                    if(rest == 0)
+                        return;
+
+                    position += count_trailing_zeros(rest);
+                    run.active = true;
+                    run.start = origin + uint64_t(position) * stride;
+                }
+            }
+        }
+
+        void close(unsigned stream, uint64_t end, StringEncoding encoding)
+        {
+            Run& run = runs_[stream];
+            run.active = false;
+
+            if(!run.continued)
+            {
+                append_run(base_offset_, run.start, end, encoding, options_.min_length, out_);
+
+                return;
+            }
+
+            run.continued = false;
+            deferred_[stream] = { out_.size(), end };
+            out_.push_back({ 0, 0, encoding });
+        }
+
+        uint64_t base_offset_;
+        const StringScanOptions& options_;
+        std::vector<StringSpan>& out_;
+
+        Run runs_[stream_count];
+        DeferredRun deferred_[stream_count];
+        uint64_t previous_starts_ = 0;
+        uint64_t previous_lane_starts_[2] = {};
+    };
+
+    // Serves the masks of a buffer by block index, the partial last block is zero padded and masked so the padding
+    // can't extend strings or end UTF-16 characters. Blocks past the end are empty.
+    class BlockReader
+    {
+    public:
+        BlockReader(const uint8_t* data, size_t size) : data_(data), full_blocks_(size / 64), remaining_(size % 64)
+        {
+            if(remaining_ != 0)
+            {
+                uint8_t tail[64] = {};
+                std::memcpy(tail, data + full_blocks_ * 64, remaining_);
+
+                classify_scalar(tail, 1, &tail_printable_, &tail_zero_);
+
+                uint64_t valid = (1ull << remaining_) - 1;
+                tail_printable_ &= valid;
+                tail_zero_ &= valid;
+            }
+        }
+
+        size_t blocks() const { return full_blocks_ + (remaining_ != 0); }
+
+        void classify(size_t first, size_t count, uint64_t* printable, uint64_t* zero) const
+        {
+            size_t full = first < full_blocks_ ? std::min(count, full_blocks_ - first) : 0;
+            if(full != 0)
+                kernel().classify(data_ + first * 64, full, printable, zero);
+
+            for (size_t i = full; i < count; ++i)
+            {
+                bool tail = first + i == full_blocks_ && remaining_ != 0;
+
+                printable[i] = tail ? tail_printable_ : 0;
+                zero[i] = tail ? tail_zero_ : 0;
+            }
+        }
+
+    private:
+        const uint8_t* data_;
+        size_t full_blocks_;
+        size_t remaining_;
+        uint64_t tail_printable_ = 0;
+        uint64_t tail_zero_ = 0;
+    };
+
+    // origin is where the reader's data starts in the tracker's range
+    void scan_blocks(const BlockReader& reader, size_t first, size_t last, RunTracker& tracker, uint64_t origin = 0)
+    {
+        // Masks are produced for a batch of blocks per kernel call so the call overhead disappears, plus one block of lookahead
+        const size_t batch_blocks = 64;
+
+        uint64_t printable[batch_blocks + 1];
+        uint64_t zero[batch_blocks + 1];
+
+        for (size_t batch = first; batch < last; batch += batch_blocks)
+        {
+            size_t count = std::min(batch_blocks, last - batch);
+            reader.classify(batch, count + 1, printable, zero);
+
+            for (size_t i = 0; i < count; ++i)
+                tracker.block(origin + (batch + i) * 64, printable[i], zero[i], printable[i + 1], zero[i + 1]);
+        }
+    }
+}
+
+void scan_strings(const uint8_t* data, size_t size, uint64_t base_offset, const StringScanOptions& options, std::vector<StringSpan>& out)
+{
+    PROFILE_SCOPE("scan_strings");
+    size_t found = out.size();
+
+    BlockReader reader(data, size);
+    RunTracker tracker(base_offset, options, out);
+
+    scan_blocks(reader, 0, reader.blocks(), tracker);
+
+    tracker.finish(size);
+
+    PROFILE_COUNT("bytes scanned for strings", size);
+    PROFILE_COUNT("strings", out.size() - found);
+}
+
+void scan_strings_parallel(const uint8_t* data, size_t size, uint64_t base_offset, const StringScanOptions& options, ThreadPool& pool, std::vector<StringSpan>& out)
+{
+    const size_t chunk_blocks = (1 << 20) / 64;
+
+    BlockReader reader(data, size);
+    size_t chunks = (reader.blocks() + chunk_blocks - 1) / chunk_blocks;
+
+    PROFILE_SCOPE("scan_strings_parallel");
+
+    // Chunking is kept on a single thread when someone watches the progress or may cancel
+    bool observed = options.cancel != nullptr || options.progress != nullptr;
+
+    if(chunks <= 1 || (pool.size() <= 1 && !observed))
+    {
+        scan_strings(data, size, base_offset, options, out);
+
+        return;
+    }
+
+    // Every chunk only emits the runs that end inside it and doesn't look back past its start. A run crossing into a chunk
+    // ends there as a placeholder (or stays open through it), the stitching below resolves it from the chunks before.
+    struct ChunkResult
+    {
+        std::vector<StringSpan> strings;
+        DeferredRun deferred[stream_count];
+        Run open[stream_count];
+        bool scanned = false;
+    };
+
+    std::vector<ChunkResult> results(chunks);
+
+    parallel_for(pool, chunks, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t chunk = begin; chunk < end; ++chunk)
+        {
+            if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                return;
+
+            size_t first = chunk * chunk_blocks;
+            size_t last = std::min(reader.blocks(), first + chunk_blocks);
+
+            ChunkResult& result = results[chunk];
+            RunTracker tracker(base_offset, options, result.strings);
+
+            if(chunk != 0)
+            {
+                uint64_t printable[2];
+                uint64_t zero[2];
+                reader.classify(first - 1, 2, printable, zero);
+
+                tracker.resume(first * 64, printable[0], zero[0], printable[1], zero[1]);
+            }
+
+            scan_blocks(reader, first, last, tracker);
+
+            if(chunk == chunks - 1)
+                tracker.finish(size);
+
+            for (unsigned stream = 0; stream < stream_count; ++stream)
+            {
+                result.deferred[stream] = tracker.deferred_run(stream);
+                result.open[stream] = tracker.open_run(stream);
+            }
+
+            result.scanned = true;
+
+            if(options.progress != nullptr)
+                options.progress->fetch_add(std::min<uint64_t>(size, last * 64) - first * 64, std::memory_order_relaxed);
+        }
+    });
+
+    size_t found = out.size();
+
+    // Runs open at the end of the chunks stitched so far, with their real start
+    Run carried[stream_count];
+
+    for (const ChunkResult& result : results)
+    {
+        // A cancelled scan keeps the chunks before the first one it skipped
+        if(!result.scanned)
+            break;
+
+        for (size_t i = 0; i < result.strings.size(); ++i)
+        {
+            unsigned stream = 0;
+            while(stream < stream_count && result.deferred[stream].index != i)
+                ++stream;
+
+            if(stream == stream_count)
+                out.push_back(result.strings[i]);
+            else if(carried[stream].active)
+                append_run(base_offset, carried[stream].start, result.deferred[stream].end, result.strings[i].encoding, options.min_length, out);
+        }
+
+        for (unsigned stream = 0; stream < stream_count; ++stream)
+        {
+            const Run& open = result.open[stream];
+
+            if(!open.active)
+                carried[stream] = {};
+            else if(!open.continued)
+                carried[stream] = open;
+        }
+    }
+
+    PROFILE_COUNT("bytes scanned for strings", size);
+    PROFILE_COUNT("strings", out.size() - found);
+}
+
+void scan_strings(ByteSource& source, uint64_t offset, uint64_t size, const StringScanOptions& options, std::vector<StringSpan>& out)
+{
+    PROFILE_SCOPE("scan_strings");
+    size_t found = out.size();
+
+    if(offset > source.size())
+        return;
+
+    size = std::min(size, source.size() - offset);
+
+    // One tracker sees every block in order, each read carries one block past the chunk for the lookahead
+    const uint64_t chunk_size = 1 << 20;
+    std::vector<uint8_t> buffer;
+    RunTracker tracker(offset, options, out);
+
+    for (uint64_t position = 0; position < size; position += chunk_size)
+    {
+        if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+            return;
+
+        uint64_t length = std::min(chunk_size + 64, size - position);
+        ByteSpan data = source.chunk(offset + position, length, buffer);
+        if(data.empty())
+            return;
+
+        BlockReader reader(data.data(), data.size());
+        scan_blocks(reader, 0, std::min<size_t>(reader.blocks(), chunk_size / 64), tracker, position);
+
+        if(options.progress != nullptr)
+            options.progress->fetch_add(std::min(chunk_size, size - position), std::memory_order_relaxed);
+    }
+
+    tracker.finish(size);
+
+    PROFILE_COUNT("bytes scanned for strings", size);
+    PROFILE_COUNT("strings", out.size() - found);
+}
+
+void append_string_text(const uint8_t* data, const StringSpan& span, std::string& out)
+{
+    if(span.encoding == StringEncoding::ASCII)
+    {
+        out.append(reinterpret_cast<const char*>(data), span.length);
+
+        return;
+    }
+
+    size_t start = out.size();
+    out.resize(start + span.length / 2);
+
+    for (size_t i = 0; i < span.length / 2; ++i)
+        out[start + i] = static_cast<char>(data[i * 2]);
+}
+
+const char* string_scanner_isa()
+{
+    return kernel().name;
+}
@@ -0,0 +1,55 @@
+/*
+* Vectorized printable string extraction
+* Bytes are classified 64 at a time into bitmasks (AVX2/SSE2 with a scalar fallback, picked at runtime) and runs are
+* found by scanning the masks for transitions, so the cost is per run rather than per byte.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "byte_source.h"
+
+class ThreadPool;
+
+enum class StringEncoding : uint8_t
+{
+    ASCII,
+    UTF16LE
+};
+
+struct StringSpan
+{
+    uint64_t offset;         // Offset of the first character
+    uint32_t length;         // Length in bytes, 2 per character for UTF-16LE
+    StringEncoding encoding;
+};
+
+struct StringScanOptions
+{
+    size_t min_length = 4; // In characters
+    bool ascii = true;
+    bool utf16 = true;
+
+    // Optional, only used by scan_strings_parallel which checks and reports between 1 MB chunks. A cancelled scan returns partial results.
+    const std::atomic<bool>* cancel = nullptr;
+    std::atomic<uint64_t>* progress = nullptr; // Bytes scanned
+};
+
+// Appends every run of printable ASCII (0x20-0x7E and tab) or UTF-16LE with the same range of characters, offsets are data relative plus base_offset
+void scan_strings(const uint8_t* data, size_t size, uint64_t base_offset, const StringScanOptions& options, std::vector<StringSpan>& out);
+
+// Same result as scan_strings, the buffer is split into chunks scanned across the pool and strings crossing chunks are stitched back together
+void scan_strings_parallel(const uint8_t* data, size_t size, uint64_t base_offset, const StringScanOptions& options, ThreadPool& pool, std::vector<StringSpan>& out);
+
+// Same result as scan_strings over [offset, offset + size) of source (cut at its end), read in 1 MB chunks so sources that
+// aren't mapped don't pin a copy of the range. Offsets are source offsets, cancel and progress are checked between chunks.
+void scan_strings(ByteSource& source, uint64_t offset, uint64_t size, const StringScanOptions& options, std::vector<StringSpan>& out);
+
+// Appends the characters of a span, UTF-16LE is narrowed since every character is ASCII. data points at the span's first byte.
+void append_string_text(const uint8_t* data, const StringSpan& span, std::string& out);
+
+// Name of the kernel picked for this CPU
+const char* string_scanner_isa();
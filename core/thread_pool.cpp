@@ -0,0 +1,207 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    thread_local const ThreadPool* local_pool = nullptr;
+    thread_local size_t local_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (size_t i = 0; i < threads; ++i)
+        workers[i]->thread = std::thread(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+
+    sleep_cv.notify_all();
+
+    for (std::unique_ptr<Worker>& worker : workers)
+        worker->thread.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+
+    return pool;
+}
+
+size_t ThreadPool::current_worker() const
+{
+    return local_pool == this ? local_index : workers.size();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    // Work spawned by a worker stays local (and hot in its cache) until someone steals it
+    size_t index = current_worker();
+    if(index == workers.size())
+        index = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        pending.fetch_add(1, std::memory_order_release);
+    }
+
+    sleep_cv.notify_one();
+}
+
+bool ThreadPool::pop_task(size_t preferred, std::function<void()>& task)
+{
+    if(pending.load(std::memory_order_acquire) == 0)
+        return false;
+
+    if(preferred < workers.size())
+    {
+        Worker& own = *workers[preferred];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if(!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i <= workers.size(); ++i)
+    {
+        Worker& victim = *workers[(preferred + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if(!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            pending.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::run_pending_task()
+{
+    std::function<void()> task;
+    if(!pop_task(current_worker(), task))
+        return false;
+
+    task();
+
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t index)
+{
+    local_pool = this;
+    local_index = index;
+
+    std::function<void()> task;
+
+    while(true)
+    {
+        if(pop_task(index, task))
+        {
+            task();
+            task = nullptr;
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) != 0; });
+
+        if(stopping && pending.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++outstanding;
+    }
+
+    pool_.submit([this, task = std::move(task)]
+    {
+        task();
+
+        // Notify under the lock so wait() can't return (and destroy us) before we're done touching the group
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--outstanding == 0)
+            done_cv.notify_all();
+    });
+}
+
+void TaskGroup::wait()
+{
+    while(true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(outstanding == 0)
+                return;
+        }
+
+        if(pool_.run_pending_task())
+            continue;
+
+        // Everything left is running on other threads, sleep briefly in case more work gets queued meanwhile
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait_for(lock, std::chrono::milliseconds(1), [this] { return outstanding == 0; });
+    }
+}
+
+void parallel_for(ThreadPool& pool, size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& body)
+{
+    if(count == 0)
+        return;
+
+    // A few chunks per worker gives the stealing something to balance with
+    size_t chunks = std::max<size_t>(1, std::min(pool.size() * 4, count / std::max<size_t>(1, min_chunk)));
+    size_t chunk_size = (count + chunks - 1) / chunks;
+
+    if(chunks == 1)
+    {
+        body(0, count);
+
+        return;
+    }
+
+    TaskGroup group(pool);
+
+    for (size_t begin = chunk_size; begin < count; begin += chunk_size)
+    {
+        size_t end = std::min(count, begin + chunk_size);
+        group.run([&body, begin, end] { body(begin, end); });
+    }
+
+    body(0, std::min(count, chunk_size));
+
+    group.wait();
+}
@@ -0,0 +1,78 @@
+/*
+* Work-stealing thread pool
+* Every worker owns a deque, it pops its own work from the back and steals from the front of the others when it runs dry.
+*/
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process wide pool for parallel work inside a single file
+    static ThreadPool& shared();
+
+    size_t size() const { return workers.size(); }
+
+    // Index of the calling worker in this pool, size() for any other thread
+    size_t current_worker() const;
+
+    void submit(std::function<void()> task);
+
+    // Runs one queued task on the calling thread, lets waiting threads help instead of blocking
+    bool run_pending_task();
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    bool pop_task(size_t preferred, std::function<void()>& task);
+    void worker_loop(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> next_worker{ 0 };
+    std::atomic<size_t> pending{ 0 };
+    std::atomic<bool> stopping{ false };
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+};
+
+// Tracks a set of tasks so the caller can wait for them, the waiting thread runs queued tasks meanwhile so nested groups can't deadlock
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+    ~TaskGroup() { wait(); }
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    ThreadPool& pool_;
+
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t outstanding = 0;
+};
+
+// Splits [0, count) into chunks spread over the pool, body is called with (begin, end)
+void parallel_for(ThreadPool& pool, size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& body);
@@ -0,0 +1,181 @@
+#include "workspace.h"
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <utility>
+
+Workspace::Workspace(ThreadPool& thread_pool, uint64_t memory_budget, std::string directory) : pool(thread_pool), budget(memory_budget), cache_directory(std::move(directory))
+{
+}
+
+Document* Workspace::open(const std::string& path)
+{
+    if(Document* existing = find(path))
+        return existing;
+
+    std::unique_ptr<Document> document = std::make_unique<Document>();
+    document->path = path;
+    document->name = std::filesystem::path(path).filename().string();
+    document->file = ByteSource::open(path);
+
+    if(document->file == nullptr)
+        return nullptr;
+
+    document->patches = std::make_unique<PatchLayer>(*document->file);
+
+    return add(std::move(document));
+}
+
+Document* Workspace::open_embedded(Document& parent, uint64_t offset, uint64_t size, const std::string& label)
+{
+    // Not a path on disk, only tells embedded documents apart. The same offset can be opened with different sizes.
+    char suffix[32];
+    char extent[32];
+    std::snprintf(suffix, sizeof(suffix), "@%" PRIX64, offset);
+    std::snprintf(extent, sizeof(extent), "+%" PRIX64, size);
+
+    if(Document* existing = find(parent.path + suffix + extent))
+        return existing;
+
+    std::unique_ptr<Document> document = std::make_unique<Document>();
+    document->path = parent.path + suffix + extent;
+    document->name = parent.name + suffix + " " + label;
+    document->file = ByteSource::slice(parent.file, offset, size);
+    document->embedded = true;
+
+    return add(std::move(document));
+}
+
+void Workspace::close(size_t index)
+{
+    if(index >= documents.size())
+        return;
+
+    documents.erase(documents.begin() + index);
+
+    if(documents.empty())
+        active_ = SIZE_MAX;
+    else if(active_ > index || active_ == documents.size())
+        activate(active_ - 1);
+    else if(active_ == index)
+        activate(active_);
+}
+
+Document* Workspace::find(const std::string& path)
+{
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        if(documents[i]->path == path)
+        {
+            activate(i);
+
+            return documents[i].get();
+        }
+    }
+
+    return nullptr;
+}
+
+Document* Workspace::add(std::unique_ptr<Document> document)
+{
+    document->kind = detect_format(*document->file);
+    document->view = create_view_state(document->kind);
+
+    documents.push_back(std::move(document));
+    activate(documents.size() - 1);
+
+    return documents.back().get();
+}
+
+Document* Workspace::active()
+{
+    return active_ < documents.size() ? documents[active_].get() : nullptr;
+}
+
+void Workspace::activate(size_t index)
+{
+    if(index >= documents.size())
+        return;
+
+    active_ = index;
+    documents[index]->last_used = ++clock;
+
+    // Parsing starts right away, the window shows progress until it's done
+    if(documents[index]->binary == nullptr)
+        load(*documents[index]);
+}
+
+void Workspace::update()
+{
+    if(Document* document = active())
+    {
+        if(document->binary == nullptr)
+            load(*document);
+    }
+
+    // Background documents don't change once measured, the active one grows as panels decode and search
+    uint64_t total = 0;
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        Document& document = *documents[i];
+
+        if(document.binary != nullptr && document.analysis->finished() && (i == active_ || document.memory == 0))
+            document.memory = document.binary->memory_usage();
+
+        total += document.memory;
+    }
+
+    while(total > budget)
+    {
+        Document* oldest = nullptr;
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            Document& document = *documents[i];
+
+            if(i != active_ && document.memory > 0 && (oldest == nullptr || document.last_used < oldest->last_used))
+                oldest = &document;
+        }
+
+        if(oldest == nullptr)
+            break;
+
+        total -= oldest->memory;
+        evict(*oldest);
+    }
+}
+
+uint64_t Workspace::memory_usage() const
+{
+    uint64_t total = 0;
+    for (const std::unique_ptr<Document>& document : documents)
+        total += document->memory;
+
+    return total;
+}
+
+void Workspace::load(Document& document)
+{
+    document.binary = create_format(document.kind, *document.file);
+    document.binary->set_view_state(document.view.get());
+    document.binary->set_patches(document.patches.get());
+
+    // Caches are keyed by the file on disk, embedded documents have none
+    if(!document.embedded)
+        document.binary->set_cache(document.path, cache_directory);
+
+    document.analysis = std::make_unique<BackgroundAnalysis>(pool);
+    document.binary->set_analysis(document.analysis.get());
+    document.analysis->start(document.binary->analysis_stages(*document.analysis));
+
+    document.memory = 0;
+}
+
+void Workspace::evict(Document& document)
+{
+    document.view->detach();
+
+    document.analysis.reset();
+    document.binary.reset();
+
+    document.memory = 0;
+}
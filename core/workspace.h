@@ -0,0 +1,81 @@
+/*
+* Open files of the GUI
+* Every document keeps its mapping and view state for as long as it's open. Parsers and everything they computed are
+* dropped for background documents, least recently used first, while the open files use more than the memory budget,
+* and rebuilt (through the analysis cache when it's on) once the document is brought back to the front.
+*/
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "binary_format.h"
+#include "patch_layer.h"
+
+struct Document
+{
+    std::string path;
+    std::string name; // File name, for the tab
+    std::shared_ptr<ByteSource> file; // Shared with the documents embedded in it
+    BinaryKind kind = BinaryKind::Unknown; // Detected once when opened
+    std::unique_ptr<ViewState> view;
+    std::unique_ptr<PatchLayer> patches; // Unsaved edits, kept while the parser is evicted. nullptr for embedded documents.
+    bool embedded = false;               // Carved out of another document's file, read-only and never cached
+
+    // nullptr while evicted. Members are destroyed bottom up, so the analysis is cancelled and joined before the parser
+    // and file it uses go away.
+    std::unique_ptr<BinaryFormat> binary;
+    std::unique_ptr<BackgroundAnalysis> analysis;
+
+    uint64_t last_used = 0;
+    uint64_t memory = 0; // BinaryFormat::memory_usage() when last measured, 0 until the analysis has finished
+};
+
+class Workspace
+{
+public:
+    // Documents use the analysis cache in cache_directory, an empty one keeps caches next to the files
+    Workspace(ThreadPool& pool, uint64_t memory_budget, std::string cache_directory);
+
+    // Opens a file in a new document and makes it the active one, or activates the document already showing it. nullptr
+    // if the file can't be opened.
+    Document* open(const std::string& path);
+    // Opens size bytes at offset of parent's file (as opened, edits aren't carried over) as a document of their own
+    // without copying them, or activates the document already showing them. They can be carved again in turn and stay
+    // open when parent is closed. Bytes no backend recognises open as a raw document with only the hex view.
+    Document* open_embedded(Document& parent, uint64_t offset, uint64_t size, const std::string& label);
+    void close(size_t index);
+
+    size_t size() const { return documents.size(); }
+    Document& document(size_t index) { return *documents[index]; }
+
+    // nullptr when nothing is open
+    Document* active();
+    size_t active_index() const { return active_; }
+    void activate(size_t index);
+
+    // Once per frame before rendering: rebuilds the active document if it was evicted, measures the ones whose analysis
+    // has finished and evicts background documents until the total fits the budget (or only the active one is left)
+    void update();
+
+    // Sum of the measured documents
+    uint64_t memory_usage() const;
+    uint64_t memory_budget() const { return budget; }
+    void set_memory_budget(uint64_t bytes) { budget = bytes; }
+
+private:
+    // Activates the document with this path, nullptr if there's none
+    Document* find(const std::string& path);
+    // Detects the format, then adds and activates the document
+    Document* add(std::unique_ptr<Document> document);
+    void load(Document&);
+    void evict(Document&);
+
+    ThreadPool& pool;
+    std::vector<std::unique_ptr<Document>> documents;
+    size_t active_ = SIZE_MAX;
+    uint64_t budget;
+    uint64_t clock = 0;
+    std::string cache_directory;
+};
@@ -0,0 +1,1655 @@
+#include "x86_decoder.h"
+#include <cstdio>
+#include <cstring>
+
+/*
+* Operand specs are comma separated tokens, the first letter is the addressing method and the rest the size:
+*   E r/m, G reg, M memory only, R r/m register, Z register in the low opcode bits, S segment, C/D control/debug
+*   I immediate, J relative, O moffs, A far pointer, V/W/H xmm reg, r/m and VEX.vvvv, P/Q mmx (xmm with a mandatory prefix)
+*   b 8, w 16, d 32, q 64, v operand size, y 32/64, z 16/32, s imm8 sign extended to the operand size, t 80, x vector
+* and fixed operands are spelled out (AL, CL, DX, AX, rAX, eAX, 1, ST, STi).
+*/
+
+namespace
+{
+    enum OpcodeFlags : uint16_t
+    {
+        ModRM = 1 << 0,
+        Default64 = 1 << 1, // 64 bit operand size in long mode unless 66 is used
+        Force64 = 1 << 2,   // 64 bit operand size in long mode, 66 is ignored
+        Invalid64 = 1 << 3,
+        String = 1 << 4,
+        Prefix66 = 1 << 5,  // 66 selects the xmm form instead of changing the operand size
+        Suffix8 = 1 << 6    // 3DNow! opcode byte after the operands
+    };
+
+    struct GroupEntry
+    {
+        const char* mnemonic = nullptr;
+        const char* operands = nullptr; // nullptr keeps the opcode's operands
+        uint16_t flags = 0;
+    };
+
+    struct Group
+    {
+        GroupEntry memory[8];
+        GroupEntry registers[8] = {};
+        bool split = false; // registers differ from memory, otherwise memory is used for both
+    };
+
+    struct Opcode
+    {
+        const char* names[4] = {}; // No prefix, 66, F3, F2
+        const char* operands = "";
+        uint16_t flags = 0;
+        const Group* group = nullptr;
+    };
+
+    const char* condition_codes[16] = { "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g" };
+
+    const Group group1 = { { { "add" }, { "or" }, { "adc" }, { "sbb" }, { "and" }, { "sub" }, { "xor" }, { "cmp" } } };
+    const Group group1a = { { { "pop" } } };
+    const Group group2 = { { { "rol" }, { "ror" }, { "rcl" }, { "rcr" }, { "shl" }, { "shr" }, { "sal" }, { "sar" } } };
+    const Group group3b = { { { "test", "Eb,Ib" }, { "test", "Eb,Ib" }, { "not" }, { "neg" }, { "mul" }, { "imul" }, { "div" }, { "idiv" } } };
+    const Group group3v = { { { "test", "Ev,Iz" }, { "test", "Ev,Iz" }, { "not" }, { "neg" }, { "mul" }, { "imul" }, { "div" }, { "idiv" } } };
+    const Group group4 = { { { "inc" }, { "dec" } } };
+    const Group group5 = { { { "inc" }, { "dec" }, { "call", nullptr, Force64 }, { "call far", "M" }, { "jmp", nullptr, Force64 }, { "jmp far", "M" }, { "push", nullptr, Default64 } } };
+    const Group group11 = { { { "mov" } } };
+
+    const Group group6 = { { { "sldt" }, { "str" }, { "lldt" }, { "ltr" }, { "verr" }, { "verw" } } };
+    const Group group7 = { { { "sgdt", "M" }, { "sidt", "M" }, { "lgdt", "M" }, { "lidt", "M" }, { "smsw", "Ew" }, {}, { "lmsw", "Ew" }, { "invlpg", "M" } } };
+    const Group group8 = { { {}, {}, {}, {}, { "bt" }, { "bts" }, { "btr" }, { "btc" } } };
+    const Group group9 = {
+        { {}, { "cmpxchg8b", "M" }, {}, { "xrstors", "M" }, { "xsavec", "M" }, { "xsaves", "M" }, { "vmptrld", "M" }, { "vmptrst", "M" } },
+        { {}, {}, {}, {}, {}, {}, { "rdrand", "Rv" }, { "rdseed", "Rv" } },
+        true
+    };
+    const Group group12 = { { {}, {}, { "psrlw" }, {}, { "psraw" }, {}, { "psllw" } } };
+    const Group group13 = { { {}, {}, { "psrld" }, {}, { "psrad" }, {}, { "pslld" } } };
+    const Group group14 = { { {}, {}, { "psrlq" }, { "psrldq" }, {}, {}, { "psllq" }, { "pslldq" } } };
+    const Group group15 = {
+        { { "fxsave", "M" }, { "fxrstor", "M" }, { "ldmxcsr", "Md" }, { "stmxcsr", "Md" }, { "xsave", "M" }, { "xrstor", "M" }, { "xsaveopt", "M" }, { "clflush", "Mb" } },
+        { {}, {}, {}, {}, {}, { "lfence", "" }, { "mfence", "" }, { "sfence", "" } },
+        true
+    };
+    const Group group16 = { { { "prefetchnta", "Mb" }, { "prefetcht0", "Mb" }, { "prefetcht1", "Mb" }, { "prefetcht2", "Mb" }, { "nop" }, { "nop" }, { "nop" }, { "nop" } } };
+    const Group group_prefetch = { { { "prefetch", "Mb" }, { "prefetchw", "Mb" }, { "prefetchwt1", "Mb" }, { "prefetch", "Mb" }, { "prefetch", "Mb" }, { "prefetch", "Mb" }, { "prefetch", "Mb" }, { "prefetch", "Mb" } } };
+
+    struct Tables
+    {
+        Opcode one_byte[256];
+        Opcode two_byte[256];
+
+        Tables()
+        {
+            build_one_byte();
+            build_two_byte();
+        }
+
+        void set(Opcode* table, int opcode, const char* name, const char* operands = "", uint16_t flags = 0, const Group* group = nullptr)
+        {
+            table[opcode].names[0] = name;
+            table[opcode].operands = operands;
+            table[opcode].flags = flags;
+            table[opcode].group = group;
+        }
+
+        // ps, pd, ss, sd (or any four prefix variants)
+        void set_sse(int opcode, const char* none, const char* p66, const char* f3, const char* f2, const char* operands, uint16_t flags = ModRM)
+        {
+            Opcode& entry = two_byte[opcode];
+            entry.names[0] = none;
+            entry.names[1] = p66;
+            entry.names[2] = f3;
+            entry.names[3] = f2;
+            entry.operands = operands;
+            entry.flags = flags;
+        }
+
+        // MMX instruction whose 66 form is the SSE2 one
+        void set_mmx(int opcode, const char* name, const char* operands = "Pq,Qq")
+        {
+            set_sse(opcode, name, name, nullptr, nullptr, operands);
+        }
+
+        void build_one_byte()
+        {
+            Opcode* t = one_byte;
+            const char* alu[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+
+            for (int i = 0; i < 8; ++i)
+            {
+                set(t, i * 8 + 0, alu[i], "Eb,Gb", ModRM);
+                set(t, i * 8 + 1, alu[i], "Ev,Gv", ModRM);
+                set(t, i * 8 + 2, alu[i], "Gb,Eb", ModRM);
+                set(t, i * 8 + 3, alu[i], "Gv,Ev", ModRM);
+                set(t, i * 8 + 4, alu[i], "AL,Ib");
+                set(t, i * 8 + 5, alu[i], "rAX,Iz");
+            }
+
+            set(t, 0x06, "push es", "", Invalid64);
+            set(t, 0x07, "pop es", "", Invalid64);
+            set(t, 0x0E, "push cs", "", Invalid64);
+            set(t, 0x16, "push ss", "", Invalid64);
+            set(t, 0x17, "pop ss", "", Invalid64);
+            set(t, 0x1E, "push ds", "", Invalid64);
+            set(t, 0x1F, "pop ds", "", Invalid64);
+            set(t, 0x27, "daa", "", Invalid64);
+            set(t, 0x2F, "das", "", Invalid64);
+            set(t, 0x37, "aaa", "", Invalid64);
+            set(t, 0x3F, "aas", "", Invalid64);
+
+            // 40-4F are REX in long mode and consumed as a prefix before the table is consulted
+            for (int i = 0; i < 8; ++i)
+            {
+                set(t, 0x40 + i, "inc", "Zv");
+                set(t, 0x48 + i, "dec", "Zv");
+                set(t, 0x50 + i, "push", "Zv", Default64);
+                set(t, 0x58 + i, "pop", "Zv", Default64);
+            }
+
+            set(t, 0x60, "pushad", "", Invalid64);
+            set(t, 0x61, "popad", "", Invalid64);
+            set(t, 0x62, "bound", "Gv,M", ModRM | Invalid64);
+            set(t, 0x63, "arpl", "Ew,Gw", ModRM);
+            set(t, 0x68, "push", "Iz", Default64);
+            set(t, 0x69, "imul", "Gv,Ev,Iz", ModRM);
+            set(t, 0x6A, "push", "Is", Default64);
+            set(t, 0x6B, "imul", "Gv,Ev,Is", ModRM);
+            set(t, 0x6C, "insb", "", String);
+            set(t, 0x6D, "ins", "", String);
+            set(t, 0x6E, "outsb", "", String);
+            set(t, 0x6F, "outs", "", String);
+
+            for (int i = 0; i < 16; ++i)
+                set(t, 0x70 + i, nullptr, "Jb", Force64);
+
+            set(t, 0x80, nullptr, "Eb,Ib", ModRM, &group1);
+            set(t, 0x81, nullptr, "Ev,Iz", ModRM, &group1);
+            set(t, 0x82, nullptr, "Eb,Ib", ModRM | Invalid64, &group1);
+            set(t, 0x83, nullptr, "Ev,Is", ModRM, &group1);
+            set(t, 0x84, "test", "Eb,Gb", ModRM);
+            set(t, 0x85, "test", "Ev,Gv", ModRM);
+            set(t, 0x86, "xchg", "Eb,Gb", ModRM);
+            set(t, 0x87, "xchg", "Ev,Gv", ModRM);
+            set(t, 0x88, "mov", "Eb,Gb", ModRM);
+            set(t, 0x89, "mov", "Ev,Gv", ModRM);
+            set(t, 0x8A, "mov", "Gb,Eb", ModRM);
+            set(t, 0x8B, "mov", "Gv,Ev", ModRM);
+            set(t, 0x8C, "mov", "Ev,Sw", ModRM);
+            set(t, 0x8D, "lea", "Gv,M", ModRM);
+            set(t, 0x8E, "mov", "Sw,Ew", ModRM);
+            set(t, 0x8F, nullptr, "Ev", ModRM | Default64, &group1a);
+
+            set(t, 0x90, "nop");
+            for (int i = 1; i < 8; ++i)
+                set(t, 0x90 + i, "xchg", "Zv,rAX");
+
+            set(t, 0x98, "cwde");
+            set(t, 0x99, "cdq");
+            set(t, 0x9A, "call far", "Ap", Invalid64);
+            set(t, 0x9B, "fwait");
+            set(t, 0x9C, "pushfd", "", Default64);
+            set(t, 0x9D, "popfd", "", Default64);
+            set(t, 0x9E, "sahf");
+            set(t, 0x9F, "lahf");
+
+            set(t, 0xA0, "mov", "AL,Ob");
+            set(t, 0xA1, "mov", "rAX,Ov");
+            set(t, 0xA2, "mov", "Ob,AL");
+            set(t, 0xA3, "mov", "Ov,rAX");
+            set(t, 0xA4, "movsb", "", String);
+            set(t, 0xA5, "movs", "", String);
+            set(t, 0xA6, "cmpsb", "", String);
+            set(t, 0xA7, "cmps", "", String);
+            set(t, 0xA8, "test", "AL,Ib");
+            set(t, 0xA9, "test", "rAX,Iz");
+            set(t, 0xAA, "stosb", "", String);
+            set(t, 0xAB, "stos", "", String);
+            set(t, 0xAC, "lodsb", "", String);
+            set(t, 0xAD, "lods", "", String);
+            set(t, 0xAE, "scasb", "", String);
+            set(t, 0xAF, "scas", "", String);
+
+            for (int i = 0; i < 8; ++i)
+            {
+                set(t, 0xB0 + i, "mov", "Zb,Ib");
+                set(t, 0xB8 + i, "mov", "Zv,Iv");
+            }
+
+            set(t, 0xC0, nullptr, "Eb,Ib", ModRM, &group2);
+            set(t, 0xC1, nullptr, "Ev,Ib", ModRM, &group2);
+            set(t, 0xC2, "ret", "Iw", Force64);
+            set(t, 0xC3, "ret", "", Force64);
+            set(t, 0xC4, "les", "Gz,M", ModRM | Invalid64);
+            set(t, 0xC5, "lds", "Gz,M", ModRM | Invalid64);
+            set(t, 0xC6, nullptr, "Eb,Ib", ModRM, &group11);
+            set(t, 0xC7, nullptr, "Ev,Iz", ModRM, &group11);
+            set(t, 0xC8, "enter", "Iw,Ib", Default64);
+            set(t, 0xC9, "leave", "", Default64);
+            set(t, 0xCA, "retf", "Iw");
+            set(t, 0xCB, "retf");
+            set(t, 0xCC, "int3");
+            set(t, 0xCD, "int", "Ib");
+            set(t, 0xCE, "into", "", Invalid64);
+            set(t, 0xCF, "iretd");
+
+            set(t, 0xD0, nullptr, "Eb,1", ModRM, &group2);
+            set(t, 0xD1, nullptr, "Ev,1", ModRM, &group2);
+            set(t, 0xD2, nullptr, "Eb,CL", ModRM, &group2);
+            set(t, 0xD3, nullptr, "Ev,CL", ModRM, &group2);
+            set(t, 0xD4, "aam", "Ib", Invalid64);
+            set(t, 0xD5, "aad", "Ib", Invalid64);
+            set(t, 0xD6, "salc", "", Invalid64);
+            set(t, 0xD7, "xlatb");
+
+            // x87, the mnemonic comes from the ModRM byte
+            for (int i = 0; i < 8; ++i)
+                set(t, 0xD8 + i, "fpu", "", ModRM);
+
+            set(t, 0xE0, "loopne", "Jb", Force64);
+            set(t, 0xE1, "loope", "Jb", Force64);
+            set(t, 0xE2, "loop", "Jb", Force64);
+            set(t, 0xE3, "jecxz", "Jb", Force64);
+            set(t, 0xE4, "in", "AL,Ib");
+            set(t, 0xE5, "in", "eAX,Ib");
+            set(t, 0xE6, "out", "Ib,AL");
+            set(t, 0xE7, "out", "Ib,eAX");
+            set(t, 0xE8, "call", "Jz", Force64);
+            set(t, 0xE9, "jmp", "Jz", Force64);
+            set(t, 0xEA, "jmp far", "Ap", Invalid64);
+            set(t, 0xEB, "jmp", "Jb", Force64);
+            set(t, 0xEC, "in", "AL,DX");
+            set(t, 0xED, "in", "eAX,DX");
+            set(t, 0xEE, "out", "DX,AL");
+            set(t, 0xEF, "out", "DX,eAX");
+
+            set(t, 0xF1, "int1");
+            set(t, 0xF4, "hlt");
+            set(t, 0xF5, "cmc");
+            set(t, 0xF6, nullptr, "Eb", ModRM, &group3b);
+            set(t, 0xF7, nullptr, "Ev", ModRM, &group3v);
+            set(t, 0xF8, "clc");
+            set(t, 0xF9, "stc");
+            set(t, 0xFA, "cli");
+            set(t, 0xFB, "sti");
+            set(t, 0xFC, "cld");
+            set(t, 0xFD, "std");
+            set(t, 0xFE, nullptr, "Eb", ModRM, &group4);
+            set(t, 0xFF, nullptr, "Ev", ModRM, &group5);
+        }
+
+        void build_two_byte()
+        {
+            Opcode* t = two_byte;
+
+            set(t, 0x00, nullptr, "Ew", ModRM, &group6);
+            set(t, 0x01, nullptr, "", ModRM, &group7);
+            set(t, 0x02, "lar", "Gv,Ew", ModRM);
+            set(t, 0x03, "lsl", "Gv,Ew", ModRM);
+            set(t, 0x05, "syscall");
+            set(t, 0x06, "clts");
+            set(t, 0x07, "sysret");
+            set(t, 0x08, "invd");
+            set(t, 0x09, "wbinvd");
+            set(t, 0x0B, "ud2");
+            set(t, 0x0D, nullptr, "", ModRM, &group_prefetch);
+            set(t, 0x0E, "femms");
+            set(t, 0x0F, "3dnow", "Pq,Qq", ModRM | Suffix8);
+
+            set_sse(0x10, "movups", "movupd", "movss", "movsd", "Vx,Wx");
+            set_sse(0x11, "movups", "movupd", "movss", "movsd", "Wx,Vx");
+            set_sse(0x12, "movlps", "movlpd", "movsldup", "movddup", "Vx,Wx");
+            set_sse(0x13, "movlps", "movlpd", nullptr, nullptr, "Wx,Vx");
+            set_sse(0x14, "unpcklps", "unpcklpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x15, "unpckhps", "unpckhpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x16, "movhps", "movhpd", "movshdup", nullptr, "Vx,Wx");
+            set_sse(0x17, "movhps", "movhpd", nullptr, nullptr, "Wx,Vx");
+            set(t, 0x18, nullptr, "Ev", ModRM, &group16);
+
+            for (int i = 0x19; i <= 0x1F; ++i)
+                set(t, i, "nop", "Ev", ModRM);
+
+            set(t, 0x20, "mov", "Ry,Cd", ModRM);
+            set(t, 0x21, "mov", "Ry,Dd", ModRM);
+            set(t, 0x22, "mov", "Cd,Ry", ModRM);
+            set(t, 0x23, "mov", "Dd,Ry", ModRM);
+
+            set_sse(0x28, "movaps", "movapd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x29, "movaps", "movapd", nullptr, nullptr, "Wx,Vx");
+            set_sse(0x2A, "cvtpi2ps", "cvtpi2pd", "cvtsi2ss", "cvtsi2sd", "Vx,Ey");
+            set_sse(0x2B, "movntps", "movntpd", nullptr, nullptr, "Wx,Vx");
+            set_sse(0x2C, "cvttps2pi", "cvttpd2pi", "cvttss2si", "cvttsd2si", "Gy,Wx");
+            set_sse(0x2D, "cvtps2pi", "cvtpd2pi", "cvtss2si", "cvtsd2si", "Gy,Wx");
+            set_sse(0x2E, "ucomiss", "ucomisd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x2F, "comiss", "comisd", nullptr, nullptr, "Vx,Wx");
+
+            set(t, 0x30, "wrmsr");
+            set(t, 0x31, "rdtsc");
+            set(t, 0x32, "rdmsr");
+            set(t, 0x33, "rdpmc");
+            set(t, 0x34, "sysenter");
+            set(t, 0x35, "sysexit");
+            set(t, 0x37, "getsec");
+
+            for (int i = 0; i < 16; ++i)
+            {
+                set(t, 0x40 + i, nullptr, "Gv,Ev", ModRM);
+                set(t, 0x80 + i, nullptr, "Jz", Force64);
+                set(t, 0x90 + i, nullptr, "Eb", ModRM);
+            }
+
+            set_sse(0x50, "movmskps", "movmskpd", nullptr, nullptr, "Gd,Wx");
+            set_sse(0x51, "sqrtps", "sqrtpd", "sqrtss", "sqrtsd", "Vx,Wx");
+            set_sse(0x52, "rsqrtps", nullptr, "rsqrtss", nullptr, "Vx,Wx");
+            set_sse(0x53, "rcpps", nullptr, "rcpss", nullptr, "Vx,Wx");
+            set_sse(0x54, "andps", "andpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x55, "andnps", "andnpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x56, "orps", "orpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x57, "xorps", "xorpd", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x58, "addps", "addpd", "addss", "addsd", "Vx,Wx");
+            set_sse(0x59, "mulps", "mulpd", "mulss", "mulsd", "Vx,Wx");
+            set_sse(0x5A, "cvtps2pd", "cvtpd2ps", "cvtss2sd", "cvtsd2ss", "Vx,Wx");
+            set_sse(0x5B, "cvtdq2ps", "cvtps2dq", "cvttps2dq", nullptr, "Vx,Wx");
+            set_sse(0x5C, "subps", "subpd", "subss", "subsd", "Vx,Wx");
+            set_sse(0x5D, "minps", "minpd", "minss", "minsd", "Vx,Wx");
+            set_sse(0x5E, "divps", "divpd", "divss", "divsd", "Vx,Wx");
+            set_sse(0x5F, "maxps", "maxpd", "maxss", "maxsd", "Vx,Wx");
+
+            const char* mmx_60[12] = { "punpcklbw", "punpcklwd", "punpckldq", "packsswb", "pcmpgtb", "pcmpgtw", "pcmpgtd", "packuswb",
+                "punpckhbw", "punpckhwd", "punpckhdq", "packssdw" };
+
+            for (int i = 0; i < 12; ++i)
+                set_mmx(0x60 + i, mmx_60[i]);
+
+            set_sse(0x6C, nullptr, "punpcklqdq", nullptr, nullptr, "Vx,Wx");
+            set_sse(0x6D, nullptr, "punpckhqdq", nullptr, nullptr, "Vx,Wx");
+            set_mmx(0x6E, "movd", "Pq,Ey");
+            set_sse(0x6F, "movq", "movdqa", "movdqu", nullptr, "Pq,Qq");
+            set_sse(0x70, "pshufw", "pshufd", "pshufhw", "pshuflw", "Pq,Qq,Ib");
+
+            set(t, 0x71, nullptr, "Qq,Ib", ModRM | Prefix66, &group12);
+            set(t, 0x72, nullptr, "Qq,Ib", ModRM | Prefix66, &group13);
+            set(t, 0x73, nullptr, "Qq,Ib", ModRM | Prefix66, &group14);
+            set_mmx(0x74, "pcmpeqb");
+            set_mmx(0x75, "pcmpeqw");
+            set_mmx(0x76, "pcmpeqd");
+            set(t, 0x77, "emms");
+            set(t, 0x78, "vmread", "Ey,Gy", ModRM | Force64);
+            set(t, 0x79, "vmwrite", "Gy,Ey", ModRM | Force64);
+            set_sse(0x7C, nullptr, "haddpd", nullptr, "haddps", "Vx,Wx");
+            set_sse(0x7D, nullptr, "hsubpd", nullptr, "hsubps", "Vx,Wx");
+            set_sse(0x7E, "movd", "movd", "movq", nullptr, "Ey,Pq");
+            set_sse(0x7F, "movq", "movdqa", "movdqu", nullptr, "Qq,Pq");
+
+            set(t, 0xA0, "push fs", "", Default64);
+            set(t, 0xA1, "pop fs", "", Default64);
+            set(t, 0xA2, "cpuid");
+            set(t, 0xA3, "bt", "Ev,Gv", ModRM);
+            set(t, 0xA4, "shld", "Ev,Gv,Ib", ModRM);
+            set(t, 0xA5, "shld", "Ev,Gv,CL", ModRM);
+            set(t, 0xA8, "push gs", "", Default64);
+            set(t, 0xA9, "pop gs", "", Default64);
+            set(t, 0xAA, "rsm");
+            set(t, 0xAB, "bts", "Ev,Gv", ModRM);
+            set(t, 0xAC, "shrd", "Ev,Gv,Ib", ModRM);
+            set(t, 0xAD, "shrd", "Ev,Gv,CL", ModRM);
+            set(t, 0xAE, nullptr, "", ModRM, &group15);
+            set(t, 0xAF, "imul", "Gv,Ev", ModRM);
+
+            set(t, 0xB0, "cmpxchg", "Eb,Gb", ModRM);
+            set(t, 0xB1, "cmpxchg", "Ev,Gv", ModRM);
+            set(t, 0xB2, "lss", "Gv,M", ModRM);
+            set(t, 0xB3, "btr", "Ev,Gv", ModRM);
+            set(t, 0xB4, "lfs", "Gv,M", ModRM);
+            set(t, 0xB5, "lgs", "Gv,M", ModRM);
+            set(t, 0xB6, "movzx", "Gv,Eb", ModRM);
+            set(t, 0xB7, "movzx", "Gv,Ew", ModRM);
+            set_sse(0xB8, nullptr, nullptr, "popcnt", nullptr, "Gv,Ev");
+            set(t, 0xB9, "ud1", "Gv,Ev", ModRM);
+            set(t, 0xBA, nullptr, "Ev,Ib", ModRM, &group8);
+            set(t, 0xBB, "btc", "Ev,Gv", ModRM);
+            set_sse(0xBC, "bsf", nullptr, "tzcnt", nullptr, "Gv,Ev");
+            set_sse(0xBD, "bsr", nullptr, "lzcnt", nullptr, "Gv,Ev");
+            set(t, 0xBE, "movsx", "Gv,Eb", ModRM);
+            set(t, 0xBF, "movsx", "Gv,Ew", ModRM);
+
+            set(t, 0xC0, "xadd", "Eb,Gb", ModRM);
+            set(t, 0xC1, "xadd", "Ev,Gv", ModRM);
+            set_sse(0xC2, "cmpps", "cmppd", "cmpss", "cmpsd", "Vx,Wx,Ib");
+            set(t, 0xC3, "movnti", "Ey,Gy", ModRM);
+            set_mmx(0xC4, "pinsrw", "Pq,Ed,Ib");
+            set_mmx(0xC5, "pextrw", "Gd,Qq,Ib");
+            set_sse(0xC6, "shufps", "shufpd", nullptr, nullptr, "Vx,Wx,Ib");
+            set(t, 0xC7, nullptr, "", ModRM, &group9);
+
+            for (int i = 0; i < 8; ++i)
+                set(t, 0xC8 + i, "bswap", "Zv");
+
+            const char* mmx_d0[48] = {
+                nullptr, "psrlw", "psrld", "psrlq", "paddq", "pmullw", nullptr, "pmovmskb",
+                "psubusb", "psubusw", "pminub", "pand", "paddusb", "paddusw", "pmaxub", "pandn",
+                "pavgb", "psraw", "psrad", "pavgw", "pmulhuw", "pmulhw", nullptr, "movntq",
+                "psubsb", "psubsw", "pminsw", "por", "paddsb", "paddsw", "pmaxsw", "pxor",
+                nullptr, "psllw", "pslld", "psllq", "pmuludq", "pmaddwd", "psadbw", "maskmovq",
+                "psubb", "psubw", "psubd", "psubq", "paddb", "paddw", "paddd", nullptr
+            };
+
+            for (int i = 0; i < 48; ++i)
+            {
+                if(mmx_d0[i])
+                    set_mmx(0xD0 + i, mmx_d0[i]);
+            }
+
+            set_sse(0xD0, nullptr, "addsubpd", nullptr, "addsubps", "Vx,Wx");
+            set_sse(0xD6, nullptr, "movq", "movq2dq", "movdq2q", "Wx,Vx");
+            set_mmx(0xD7, "pmovmskb", "Gd,Qq");
+            set_sse(0xE6, nullptr, "cvttpd2dq", "cvtdq2pd", "cvtpd2dq", "Vx,Wx");
+            set_sse(0xE7, "movntq", "movntdq", nullptr, nullptr, "Qq,Pq");
+            set_sse(0xF0, nullptr, nullptr, nullptr, "lddqu", "Vx,M");
+            set_sse(0xF7, "maskmovq", "maskmovdqu", nullptr, nullptr, "Pq,Qq");
+            set(t, 0xFF, "ud0", "Gv,Ev", ModRM);
+        }
+    };
+
+    const Tables& tables()
+    {
+        static const Tables instance;
+        return instance;
+    }
+
+    const char* name_0f38(uint8_t opcode, uint8_t prefix)
+    {
+        switch(opcode)
+        {
+        case 0x00: return "pshufb";
+        case 0x01: return "phaddw";
+        case 0x02: return "phaddd";
+        case 0x04: return "pmaddubsw";
+        case 0x08: return "psignb";
+        case 0x0B: return "pmulhrsw";
+        case 0x10: return "pblendvb";
+        case 0x17: return "ptest";
+        case 0x18: return "broadcastss";
+        case 0x1C: return "pabsb";
+        case 0x1D: return "pabsw";
+        case 0x1E: return "pabsd";
+        case 0x20: return "pmovsxbw";
+        case 0x21: return "pmovsxbd";
+        case 0x23: return "pmovsxwd";
+        case 0x25: return "pmovsxdq";
+        case 0x28: return "pmuldq";
+        case 0x29: return "pcmpeqq";
+        case 0x2B: return "packusdw";
+        case 0x30: return "pmovzxbw";
+        case 0x31: return "pmovzxbd";
+        case 0x33: return "pmovzxwd";
+        case 0x35: return "pmovzxdq";
+        case 0x37: return "pcmpgtq";
+        case 0x38: return "pminsb";
+        case 0x39: return "pminsd";
+        case 0x3A: return "pminuw";
+        case 0x3B: return "pminud";
+        case 0x3C: return "pmaxsb";
+        case 0x3D: return "pmaxsd";
+        case 0x3E: return "pmaxuw";
+        case 0x3F: return "pmaxud";
+        case 0x40: return "pmulld";
+        case 0x58: return "pbroadcastd";
+        case 0x59: return "pbroadcastq";
+        case 0x78: return "pbroadcastb";
+        case 0x79: return "pbroadcastw";
+        case 0xDB: return "aesimc";
+        case 0xDC: return "aesenc";
+        case 0xDD: return "aesenclast";
+        case 0xDE: return "aesdec";
+        case 0xDF: return "aesdeclast";
+        case 0xF0: return prefix == 0xF2 ? "crc32" : "movbe";
+        case 0xF1: return prefix == 0xF2 ? "crc32" : "movbe";
+        }
+
+        return nullptr;
+    }
+
+    const char* name_0f3a(uint8_t opcode)
+    {
+        switch(opcode)
+        {
+        case 0x08: return "roundps";
+        case 0x09: return "roundpd";
+        case 0x0A: return "roundss";
+        case 0x0B: return "roundsd";
+        case 0x0C: return "blendps";
+        case 0x0D: return "blendpd";
+        case 0x0E: return "pblendw";
+        case 0x0F: return "palignr";
+        case 0x14: return "pextrb";
+        case 0x15: return "pextrw";
+        case 0x16: return "pextrd";
+        case 0x17: return "extractps";
+        case 0x18: return "insertf128";
+        case 0x19: return "extractf128";
+        case 0x20: return "pinsrb";
+        case 0x21: return "insertps";
+        case 0x22: return "pinsrd";
+        case 0x38: return "inserti128";
+        case 0x39: return "extracti128";
+        case 0x40: return "dpps";
+        case 0x41: return "dppd";
+        case 0x42: return "mpsadbw";
+        case 0x44: return "pclmulqdq";
+        case 0x60: return "pcmpestrm";
+        case 0x61: return "pcmpestri";
+        case 0x62: return "pcmpistrm";
+        case 0x63: return "pcmpistri";
+        case 0xDF: return "aeskeygenassist";
+        }
+
+        return nullptr;
+    }
+
+    // Sets mnemonic and operands for D8-DF from the ModRM byte
+    void decode_x87(X86Instruction& out)
+    {
+        static const char* arithmetic[8] = { "fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr" };
+        static const char* integer[8] = { "fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr" };
+
+        static const GroupEntry memory[8][8] = {
+            {},
+            { { "fld", "Md" }, {}, { "fst", "Md" }, { "fstp", "Md" }, { "fldenv", "M" }, { "fldcw", "Mw" }, { "fnstenv", "M" }, { "fnstcw", "Mw" } },
+            {},
+            { { "fild", "Md" }, { "fisttp", "Md" }, { "fist", "Md" }, { "fistp", "Md" }, {}, { "fld", "Mt" }, {}, { "fstp", "Mt" } },
+            {},
+            { { "fld", "Mq" }, { "fisttp", "Mq" }, { "fst", "Mq" }, { "fstp", "Mq" }, { "frstor", "M" }, {}, { "fnsave", "M" }, { "fnstsw", "Mw" } },
+            {},
+            { { "fild", "Mw" }, { "fisttp", "Mw" }, { "fist", "Mw" }, { "fistp", "Mw" }, { "fbld", "Mt" }, { "fild", "Mq" }, { "fbstp", "Mt" }, { "fistp", "Mq" } }
+        };
+
+        static const char* d9_e0[32] = {
+            "fchs", "fabs", nullptr, nullptr, "ftst", "fxam", nullptr, nullptr,
+            "fld1", "fldl2t", "fldl2e", "fldpi", "fldlg2", "fldln2", "fldz", nullptr,
+            "f2xm1", "fyl2x", "fptan", "fpatan", "fxtract", "fprem1", "fdecstp", "fincstp",
+            "fprem", "fyl2xp1", "fsqrt", "fsincos", "frndint", "fscale", "fsin", "fcos"
+        };
+
+        int escape = out.opcode - 0xD8;
+        int reg = (out.modrm >> 3) & 7;
+
+        out.mnemonic = nullptr;
+        out.operands = "";
+
+        if((out.modrm >> 6) != 3)
+        {
+            switch(escape)
+            {
+            case 0: out.mnemonic = arithmetic[reg]; out.operands = "Md"; break;
+            case 2: out.mnemonic = integer[reg]; out.operands = "Md"; break;
+            case 4: out.mnemonic = arithmetic[reg]; out.operands = "Mq"; break;
+            case 6: out.mnemonic = integer[reg]; out.operands = "Mw"; break;
+            default:
+                out.mnemonic = memory[escape][reg].mnemonic;
+                out.operands = memory[escape][reg].operands ? memory[escape][reg].operands : "";
+                break;
+            }
+
+            return;
+        }
+
+        static const char* fcmov[8] = { "fcmovb", "fcmove", "fcmovbe", "fcmovu", "fcmovnb", "fcmovne", "fcmovnbe", "fcmovnu" };
+        static const char* reversed[8] = { "fadd", "fmul", "fcom", "fcomp", "fsubr", "fsub", "fdivr", "fdiv" };
+        static const char* popped[8] = { "faddp", "fmulp", "fcomp", "fcompp", "fsubrp", "fsubp", "fdivrp", "fdivp" };
+
+        switch(escape)
+        {
+        case 0:
+            out.mnemonic = arithmetic[reg];
+            out.operands = "ST,STi";
+            break;
+        case 1:
+            if(reg == 0) { out.mnemonic = "fld"; out.operands = "STi"; }
+            else if(reg == 1) { out.mnemonic = "fxch"; out.operands = "STi"; }
+            else if(out.modrm == 0xD0) out.mnemonic = "fnop";
+            else if(out.modrm >= 0xE0) out.mnemonic = d9_e0[out.modrm - 0xE0];
+            break;
+        case 2:
+            if(reg < 4) { out.mnemonic = fcmov[reg]; out.operands = "ST,STi"; }
+            else if(out.modrm == 0xE9) out.mnemonic = "fucompp";
+            break;
+        case 3:
+            if(reg < 4) { out.mnemonic = fcmov[reg + 4]; out.operands = "ST,STi"; }
+            else if(out.modrm == 0xE2) out.mnemonic = "fnclex";
+            else if(out.modrm == 0xE3) out.mnemonic = "fninit";
+            else if(reg == 5) { out.mnemonic = "fucomi"; out.operands = "ST,STi"; }
+            else if(reg == 6) { out.mnemonic = "fcomi"; out.operands = "ST,STi"; }
+            break;
+        case 4:
+            out.mnemonic = reversed[reg];
+            out.operands = "STi,ST";
+            break;
+        case 5:
+            {
+                static const char* names[8] = { "ffree", "fxch", "fst", "fstp", "fucom", "fucomp", nullptr, nullptr };
+                out.mnemonic = names[reg];
+                out.operands = "STi";
+            }
+            break;
+        case 6:
+            if(reg == 3 && out.modrm != 0xD9)
+                break;
+
+            out.mnemonic = popped[reg];
+            out.operands = reg == 3 ? "" : "STi,ST";
+            break;
+        case 7:
+            if(out.modrm == 0xE0) { out.mnemonic = "fnstsw"; out.operands = "AX"; }
+            else if(reg == 5) { out.mnemonic = "fucomip"; out.operands = "ST,STi"; }
+            else if(reg == 6) { out.mnemonic = "fcomip"; out.operands = "ST,STi"; }
+            break;
+        }
+    }
+
+    const char* name_0f01(uint8_t modrm)
+    {
+        switch(modrm)
+        {
+        case 0xC1: return "vmcall";
+        case 0xC2: return "vmlaunch";
+        case 0xC3: return "vmresume";
+        case 0xC4: return "vmxoff";
+        case 0xC8: return "monitor";
+        case 0xC9: return "mwait";
+        case 0xCA: return "clac";
+        case 0xCB: return "stac";
+        case 0xD0: return "xgetbv";
+        case 0xD1: return "xsetbv";
+        case 0xD5: return "xend";
+        case 0xD6: return "xtest";
+        case 0xF8: return "swapgs";
+        case 0xF9: return "rdtscp";
+        }
+
+        return nullptr;
+    }
+
+    struct Reader
+    {
+        const uint8_t* code;
+        size_t size;
+        size_t position = 0;
+        bool ok = true;
+
+        bool available() const { return position < size; }
+
+        uint8_t peek() const { return position < size ? code[position] : 0; }
+
+        uint8_t byte()
+        {
+            if(position >= size)
+            {
+                ok = false;
+                return 0;
+            }
+
+            return code[position++];
+        }
+
+        uint64_t value(size_t bytes)
+        {
+            uint64_t result = 0;
+            for (size_t i = 0; i < bytes; ++i)
+                result |= uint64_t(byte()) << (i * 8);
+
+            return result;
+        }
+    };
+
+    int64_t sign_extend(uint64_t value, size_t bytes)
+    {
+        if(bytes == 0 || bytes >= 8)
+            return int64_t(value);
+
+        uint64_t sign = uint64_t(1) << (bytes * 8 - 1);
+        return int64_t((value ^ sign) - sign);
+    }
+
+    // Splits the next token off an operand spec
+    bool next_token(const char*& spec, char* token, size_t token_size)
+    {
+        if(spec == nullptr || *spec == '\0')
+            return false;
+
+        size_t length = 0;
+        while(*spec != '\0' && *spec != ',')
+        {
+            if(length + 1 < token_size)
+                token[length++] = *spec;
+
+            ++spec;
+        }
+
+        token[length] = '\0';
+
+        if(*spec == ',')
+            ++spec;
+
+        return true;
+    }
+
+    bool fixed_operand(const char* token)
+    {
+        return strcmp(token, "AL") == 0 || strcmp(token, "CL") == 0 || strcmp(token, "DX") == 0 || strcmp(token, "AX") == 0 ||
+            strcmp(token, "rAX") == 0 || strcmp(token, "eAX") == 0 || strcmp(token, "1") == 0 || strcmp(token, "ST") == 0 || strcmp(token, "STi") == 0;
+    }
+
+    // Size of the immediate a token consumes, 0 for tokens without one
+    size_t immediate_bytes(const char* token, const X86Instruction& in, size_t& second)
+    {
+        second = 0;
+
+        if(fixed_operand(token))
+            return 0;
+
+        switch(token[0])
+        {
+        case 'I':
+            switch(token[1])
+            {
+            case 'b': case 's': return 1;
+            case 'w': return 2;
+            case 'd': return 4;
+            case 'z': return in.operand_bits == 16 ? 2 : 4;
+            case 'v': return in.operand_bits / 8;
+            }
+            return 0;
+        case 'J':
+            if(token[1] == 'b')
+                return 1;
+
+            return (in.operand_bits == 16 && !in.x64) ? 2 : 4;
+        case 'O':
+            return in.address_bits / 8;
+        case 'A':
+            second = 2;
+            return in.operand_bits == 16 ? 2 : 4;
+        }
+
+        return 0;
+    }
+
+    bool invalid(const uint8_t* code, size_t size, X86Instruction& out)
+    {
+        bool x64 = out.x64;
+
+        out = X86Instruction();
+        out.x64 = x64;
+        out.length = 1;
+        out.mnemonic = "db";
+        out.operands = "Ib";
+        out.immediate_size = 1;
+        out.immediate = size > 0 ? code[0] : 0;
+
+        return false;
+    }
+
+    bool is_vex_map1_two_operand(uint8_t opcode, uint8_t prefix)
+    {
+        switch(opcode)
+        {
+        case 0x10: case 0x11: case 0x12: case 0x13: case 0x16: case 0x17:
+        case 0x28: case 0x29: case 0x2B: case 0x2C: case 0x2D: case 0x2E: case 0x2F:
+        case 0x50: case 0x5B: case 0x6E: case 0x6F: case 0x70: case 0x7E: case 0x7F:
+        case 0xC5: case 0xD6: case 0xD7: case 0xE6: case 0xE7: case 0xF0: case 0xF7:
+            return true;
+        case 0x51: case 0x52: case 0x53: case 0x5A:
+            return prefix != 0xF3 && prefix != 0xF2;
+        }
+
+        return false;
+    }
+}
+
+bool x86_decode(const uint8_t* code, size_t size, bool x64, X86Instruction& out)
+{
+    out = X86Instruction();
+    out.x64 = x64;
+
+    if(code == nullptr || size == 0)
+        return invalid(code, size, out);
+
+    Reader reader{ code, size < 15 ? size : 15 };
+    uint8_t last_rep = 0;
+
+    // Legacy prefixes in any order, REX only counts when it's the last one
+    for (;;)
+    {
+        if(!reader.available())
+            return invalid(code, size, out);
+
+        uint8_t b = reader.peek();
+
+        if(b == 0xF0) out.lock = true;
+        else if(b == 0xF2 || b == 0xF3) last_rep = b;
+        else if(b == 0x2E || b == 0x36 || b == 0x3E || b == 0x26 || b == 0x64 || b == 0x65) out.segment = b;
+        else if(b == 0x66) out.operand_size = true;
+        else if(b == 0x67) out.address_size = true;
+        else if(x64 && (b & 0xF0) == 0x40)
+        {
+            reader.byte();
+            out.rex = b;
+
+            uint8_t following = reader.peek();
+            bool legacy = following == 0xF0 || following == 0xF2 || following == 0xF3 || following == 0x2E || following == 0x36 ||
+                following == 0x3E || following == 0x26 || following == 0x64 || following == 0x65 || following == 0x66 || following == 0x67;
+
+            if(legacy || (following & 0xF0) == 0x40)
+                out.rex = 0;
+
+            continue;
+        }
+        else
+            break;
+
+        reader.byte();
+    }
+
+    out.rep = last_rep == 0xF3;
+    out.repne = last_rep == 0xF2;
+    out.address_bits = x64 ? (out.address_size ? 32 : 64) : (out.address_size ? 16 : 32);
+
+    const Tables& t = tables();
+    uint8_t b = reader.byte();
+
+    Opcode entry;
+    bool vector_prefix = false;
+
+    // C4/C5, 62 and 8F are VEX, EVEX and XOP in long mode, or when the next byte couldn't be a memory ModRM
+    uint8_t next = reader.peek();
+    bool register_form = reader.position < reader.size && (next & 0xC0) == 0xC0;
+
+    if((b == 0xC4 || b == 0xC5) && (x64 || register_form))
+    {
+        uint8_t p1 = reader.byte();
+        uint8_t rex = 0x40;
+        uint8_t pp;
+
+        out.vex = true;
+
+        if(b == 0xC5)
+        {
+            rex |= (p1 & 0x80) ? 0 : 4;
+            out.vex_v = (~p1 >> 3) & 0xF;
+            out.vex_l = (p1 >> 2) & 1;
+            pp = p1 & 3;
+            out.map = 1;
+        }
+        else
+        {
+            uint8_t p2 = reader.byte();
+            rex |= (p1 & 0x80) ? 0 : 4;
+            rex |= (p1 & 0x40) ? 0 : 2;
+            rex |= (p1 & 0x20) ? 0 : 1;
+            out.vex_w = (p2 & 0x80) != 0;
+            rex |= out.vex_w ? 8 : 0;
+            out.map = p1 & 0x1F;
+            out.vex_v = (~p2 >> 3) & 0xF;
+            out.vex_l = (p2 >> 2) & 1;
+            pp = p2 & 3;
+        }
+
+        out.rex = x64 ? rex : (rex & 8 ? 0x48 : 0);
+        const uint8_t implied[4] = { 0, 0x66, 0xF3, 0xF2 };
+        out.mandatory_prefix = implied[pp];
+        vector_prefix = true;
+    }
+    else if(b == 0x62 && (x64 || register_form))
+    {
+        uint8_t p0 = reader.byte();
+        uint8_t p1 = reader.byte();
+        uint8_t p2 = reader.byte();
+        uint8_t rex = 0x40;
+
+        out.evex = true;
+        rex |= (p0 & 0x80) ? 0 : 4;
+        rex |= (p0 & 0x40) ? 0 : 2;
+        rex |= (p0 & 0x20) ? 0 : 1;
+        out.vex_w = (p1 & 0x80) != 0;
+        rex |= out.vex_w ? 8 : 0;
+        out.map = p0 & 0x7;
+        out.vex_v = (~p1 >> 3) & 0xF;
+        out.vex_l = (p2 >> 5) & 3;
+
+        out.rex = x64 ? rex : (rex & 8 ? 0x48 : 0);
+        const uint8_t implied[4] = { 0, 0x66, 0xF3, 0xF2 };
+        out.mandatory_prefix = implied[p1 & 3];
+        vector_prefix = true;
+    }
+    else if(b == 0x8F && reader.available() && (next & 0x1F) >= 8 && (next & 0x1F) <= 10)
+    {
+        // AMD XOP, sized like VEX with its own maps 8-10
+        uint8_t p1 = reader.byte();
+        uint8_t p2 = reader.byte();
+
+        out.vex = true;
+        out.map = p1 & 0x1F;
+        out.vex_w = (p2 & 0x80) != 0;
+        out.vex_v = (~p2 >> 3) & 0xF;
+        out.vex_l = (p2 >> 2) & 1;
+        out.opcode = reader.byte();
+        out.has_modrm = true;
+        out.mnemonic = nullptr;
+        out.operands = "Vx,Hx,Wx";
+        entry.flags = ModRM;
+    }
+
+    if(vector_prefix)
+    {
+        // Every VEX/EVEX opcode has a ModRM byte except vzeroupper/vzeroall, immediates depend on the map and opcode
+        out.opcode = reader.byte();
+        out.has_modrm = !(out.map == 1 && out.opcode == 0x77);
+        entry.flags = out.has_modrm ? ModRM : 0;
+
+        const char* name = nullptr;
+
+        if(out.map == 1)
+        {
+            const Opcode& legacy = t.two_byte[out.opcode];
+
+            if(out.mandatory_prefix == 0xF3) name = legacy.names[2];
+            else if(out.mandatory_prefix == 0xF2) name = legacy.names[3];
+            else if(out.mandatory_prefix == 0x66) name = legacy.names[1];
+            else name = legacy.names[0];
+
+            if(out.opcode == 0x77)
+                name = out.vex_l ? "zeroall" : "zeroupper";
+
+            bool immediate = out.opcode == 0x70 || out.opcode == 0x71 || out.opcode == 0x72 || out.opcode == 0x73 ||
+                out.opcode == 0xC2 || out.opcode == 0xC4 || out.opcode == 0xC5 || out.opcode == 0xC6;
+
+            if(out.opcode == 0x71 || out.opcode == 0x72 || out.opcode == 0x73)
+                out.operands = "Hx,Wx,Ib";
+            else if(out.opcode == 0x77)
+                out.operands = "";
+            else if(is_vex_map1_two_operand(out.opcode, out.mandatory_prefix))
+                out.operands = immediate ? "Vx,Wx,Ib" : "Vx,Wx";
+            else
+                out.operands = immediate ? "Vx,Hx,Wx,Ib" : "Vx,Hx,Wx";
+
+            // Stores keep the register as the second operand
+            if(out.opcode == 0x11 || out.opcode == 0x13 || out.opcode == 0x17 || out.opcode == 0x29 || out.opcode == 0x2B ||
+                out.opcode == 0x7F || out.opcode == 0xD6 || out.opcode == 0xE7)
+                out.operands = "Wx,Vx";
+            else if(out.opcode == 0x7E && out.mandatory_prefix != 0xF3)
+                out.operands = "Ey,Vx";
+            else if(out.opcode == 0x6E)
+                out.operands = "Vx,Ey";
+        }
+        else if(out.map == 2)
+        {
+            name = name_0f38(out.opcode, out.mandatory_prefix);
+            out.operands = "Vx,Hx,Wx";
+        }
+        else if(out.map == 3)
+        {
+            name = name_0f3a(out.opcode);
+            out.operands = "Vx,Hx,Wx,Ib";
+        }
+
+        out.mnemonic = name;
+        out.operand_bits = out.vex_w && x64 ? 64 : 32;
+    }
+    else if(out.vex)
+    {
+        // XOP, map 8 carries an imm8 and map 10 an imm32
+        out.operand_bits = 32;
+        if(out.map == 8)
+            out.operands = "Vx,Hx,Wx,Ib";
+        else if(out.map == 10)
+            out.operands = "Vx,Wx,Id";
+    }
+    else
+    {
+        if(b == 0x0F)
+        {
+            uint8_t second = reader.byte();
+
+            if(second == 0x38 || second == 0x3A)
+            {
+                out.map = second == 0x38 ? 2 : 3;
+                out.opcode = reader.byte();
+                out.mandatory_prefix = out.operand_size ? 0x66 : 0;
+                if(last_rep)
+                    out.mandatory_prefix = last_rep;
+
+                entry.flags = ModRM;
+                out.mnemonic = out.map == 2 ? name_0f38(out.opcode, out.mandatory_prefix) : name_0f3a(out.opcode);
+
+                // movbe/crc32 work on general purpose registers, the rest on vectors
+                if(out.map == 2 && (out.opcode == 0xF0 || out.opcode == 0xF1))
+                {
+                    if(out.mandatory_prefix == 0xF2)
+                        out.operands = out.opcode == 0xF0 ? "Gy,Eb" : "Gy,Ev";
+                    else
+                        out.operands = out.opcode == 0xF0 ? "Gv,M" : "M,Gv";
+
+                    if(out.mandatory_prefix == 0x66)
+                        out.mandatory_prefix = 0;
+                }
+                else
+                {
+                    out.operands = out.map == 2 ? "Vx,Wx" : "Vx,Wx,Ib";
+                }
+            }
+            else
+            {
+                out.map = 1;
+                out.opcode = second;
+                entry = t.two_byte[second];
+            }
+        }
+        else
+        {
+            out.opcode = b;
+            entry = t.one_byte[b];
+        }
+
+        if(out.map <= 1)
+        {
+            if(x64 && (entry.flags & Invalid64))
+                return invalid(code, size, out);
+
+            // Mandatory prefixes pick the variant, F3/F2 win over 66
+            const char* name = entry.names[0];
+
+            if(last_rep == 0xF3 && entry.names[2]) { name = entry.names[2]; out.mandatory_prefix = 0xF3; }
+            else if(last_rep == 0xF2 && entry.names[3]) { name = entry.names[3]; out.mandatory_prefix = 0xF2; }
+            else if(out.operand_size && (entry.names[1] || (entry.flags & Prefix66))) { name = entry.names[1]; out.mandatory_prefix = 0x66; }
+
+            if(name == nullptr && entry.group == nullptr && !(out.map == 0 && out.opcode >= 0x70 && out.opcode <= 0x7F) &&
+                !(out.map == 1 && ((out.opcode & 0xF0) == 0x40 || (out.opcode & 0xF0) == 0x80 || (out.opcode & 0xF0) == 0x90)))
+                return invalid(code, size, out);
+
+            out.mnemonic = name;
+            out.operands = entry.operands;
+        }
+    }
+
+    if(!reader.ok)
+        return invalid(code, size, out);
+
+    // ModRM, SIB and displacement
+    if(entry.flags & ModRM)
+    {
+        out.has_modrm = true;
+        out.modrm = reader.byte();
+
+        uint8_t mod = out.modrm >> 6;
+        uint8_t rm = out.modrm & 7;
+
+        if(out.address_bits == 16)
+        {
+            if(mod == 1) out.displacement_size = 1;
+            else if(mod == 2 || (mod == 0 && rm == 6)) out.displacement_size = 2;
+        }
+        else if(mod != 3)
+        {
+            if(rm == 4)
+            {
+                out.has_sib = true;
+                out.sib = reader.byte();
+
+                if(mod == 0 && (out.sib & 7) == 5)
+                    out.displacement_size = 4;
+            }
+
+            if(mod == 1) out.displacement_size = 1;
+            else if(mod == 2 || (mod == 0 && rm == 5)) out.displacement_size = 4;
+        }
+
+        if(out.displacement_size)
+            out.displacement = sign_extend(reader.value(out.displacement_size), out.displacement_size);
+    }
+
+    // Groups and the opcodes whose meaning depends on the ModRM byte
+    uint16_t flags = entry.flags;
+    uint8_t mod = out.modrm >> 6;
+    uint8_t reg = (out.modrm >> 3) & 7;
+
+    if(!out.vex && !out.evex && out.map <= 1)
+    {
+        if(entry.group)
+        {
+            const GroupEntry& group = (entry.group->split && mod == 3) ? entry.group->registers[reg] : entry.group->memory[reg];
+
+            out.mnemonic = group.mnemonic;
+            if(group.operands)
+                out.operands = group.operands;
+
+            flags |= group.flags;
+
+            if(out.map == 0 && (out.opcode == 0xC6 || out.opcode == 0xC7) && out.modrm == 0xF8)
+            {
+                out.mnemonic = out.opcode == 0xC6 ? "xabort" : "xbegin";
+                out.operands = out.opcode == 0xC6 ? "Ib" : "Jz";
+            }
+
+            if(out.map == 1 && out.opcode == 0x01 && mod == 3)
+            {
+                out.mnemonic = name_0f01(out.modrm);
+                out.operands = "";
+                if(reg == 4 || reg == 6)
+                {
+                    out.mnemonic = reg == 4 ? "smsw" : "lmsw";
+                    out.operands = "Ew";
+                }
+            }
+
+            if(out.map == 1 && out.opcode == 0xAE && mod == 3 && last_rep == 0xF3 && reg < 4)
+            {
+                const char* names[4] = { "rdfsbase", "rdgsbase", "wrfsbase", "wrgsbase" };
+                out.mnemonic = names[reg];
+                out.operands = "Rv";
+                out.mandatory_prefix = 0xF3;
+            }
+
+            if(out.map == 1 && out.opcode == 0xC7 && reg == 1 && (out.rex & 8))
+                out.mnemonic = "cmpxchg16b";
+
+            if(out.mnemonic == nullptr && !(out.map == 1 && out.opcode == 0x01))
+                return invalid(code, size, out);
+        }
+        else if(out.map == 0 && out.opcode >= 0xD8 && out.opcode <= 0xDF)
+        {
+            decode_x87(out);
+        }
+        else if(out.map == 0 && out.opcode == 0x63 && x64)
+        {
+            out.mnemonic = "movsxd";
+            out.operands = "Gv,Ed";
+        }
+        else if(out.map == 1 && out.opcode == 0x1E && last_rep == 0xF3 && (out.modrm == 0xFA || out.modrm == 0xFB))
+        {
+            out.mnemonic = out.modrm == 0xFA ? "endbr64" : "endbr32";
+            out.operands = "";
+            out.mandatory_prefix = 0xF3;
+        }
+        else if(out.map == 1 && out.opcode == 0x7E && out.mandatory_prefix == 0xF3)
+        {
+            out.operands = "Vx,Wx";
+        }
+
+    }
+
+    // Operand size now that every flag is known
+    if(!out.vex && !out.evex)
+    {
+        bool prefix66 = out.operand_size && out.mandatory_prefix != 0x66;
+
+        if(x64 && (flags & Force64)) out.operand_bits = 64;
+        else if(x64 && (out.rex & 8)) out.operand_bits = 64;
+        else if(prefix66) out.operand_bits = 16;
+        else if(x64 && (flags & Default64)) out.operand_bits = 64;
+        else out.operand_bits = 32;
+    }
+
+    // Immediates in operand order
+    char token[8];
+    const char* spec = out.operands;
+    while(next_token(spec, token, sizeof(token)))
+    {
+        size_t second = 0;
+        size_t bytes = immediate_bytes(token, out, second);
+        if(bytes == 0)
+            continue;
+
+        if(token[0] == 'J')
+            out.relative = true;
+
+        if(out.immediate_size == 0)
+        {
+            out.immediate_size = static_cast<uint8_t>(bytes);
+            out.immediate = reader.value(bytes);
+        }
+        else
+        {
+            out.immediate2_size = static_cast<uint8_t>(bytes);
+            out.immediate2 = reader.value(bytes);
+        }
+
+        if(second)
+        {
+            out.immediate2_size = static_cast<uint8_t>(second);
+            out.immediate2 = reader.value(second);
+        }
+    }
+
+    if(flags & Suffix8)
+    {
+        out.immediate2_size = 1;
+        out.immediate2 = reader.byte();
+    }
+
+    if(!reader.ok)
+        return invalid(code, size, out);
+
+    out.string_op = (flags & String) != 0;
+    out.length = static_cast<uint8_t>(reader.position);
+
+    // Mnemonics that depend on the operand or address size
+    if(out.map == 0 && !out.vex && !out.evex)
+    {
+        int size_index = out.operand_bits == 16 ? 0 : out.operand_bits == 32 ? 1 : 2;
+
+        switch(out.opcode)
+        {
+        case 0x6D: { const char* n[3] = { "insw", "insd", "insd" }; out.mnemonic = n[size_index]; break; }
+        case 0x6F: { const char* n[3] = { "outsw", "outsd", "outsd" }; out.mnemonic = n[size_index]; break; }
+        case 0xA5: { const char* n[3] = { "movsw", "movsd", "movsq" }; out.mnemonic = n[size_index]; break; }
+        case 0xA7: { const char* n[3] = { "cmpsw", "cmpsd", "cmpsq" }; out.mnemonic = n[size_index]; break; }
+        case 0xAB: { const char* n[3] = { "stosw", "stosd", "stosq" }; out.mnemonic = n[size_index]; break; }
+        case 0xAD: { const char* n[3] = { "lodsw", "lodsd", "lodsq" }; out.mnemonic = n[size_index]; break; }
+        case 0xAF: { const char* n[3] = { "scasw", "scasd", "scasq" }; out.mnemonic = n[size_index]; break; }
+        case 0x98: { const char* n[3] = { "cbw", "cwde", "cdqe" }; out.mnemonic = n[size_index]; break; }
+        case 0x99: { const char* n[3] = { "cwd", "cdq", "cqo" }; out.mnemonic = n[size_index]; break; }
+        case 0xCF: { const char* n[3] = { "iret", "iretd", "iretq" }; out.mnemonic = n[size_index]; break; }
+        case 0x9C: { const char* n[3] = { "pushf", "pushfd", "pushfq" }; out.mnemonic = n[size_index]; break; }
+        case 0x9D: { const char* n[3] = { "popf", "popfd", "popfq" }; out.mnemonic = n[size_index]; break; }
+        case 0x60: out.mnemonic = out.operand_bits == 16 ? "pusha" : "pushad"; break;
+        case 0x61: out.mnemonic = out.operand_bits == 16 ? "popa" : "popad"; break;
+        case 0xE3: out.mnemonic = out.address_bits == 16 ? "jcxz" : out.address_bits == 32 ? "jecxz" : "jrcxz"; break;
+        case 0x90:
+            if(out.rex & 1) { out.mnemonic = "xchg"; out.operands = "Zv,rAX"; }
+            else if(out.rep) out.mnemonic = "pause";
+            break;
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+    const char* gpr_names[4][16] = {
+        { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" },
+        { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" },
+        { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" },
+        { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" }
+    };
+
+    const char* legacy_byte_names[8] = { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" };
+    const char* segment_names[8] = { "es", "cs", "ss", "ds", "fs", "gs", "?", "?" };
+
+    void append_hex(std::string& out, uint64_t value)
+    {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(value));
+        out += buffer;
+    }
+
+    void append_gpr(std::string& out, const X86Instruction& in, int bits, int index)
+    {
+        if(bits == 8 && in.rex == 0 && index < 8)
+        {
+            out += legacy_byte_names[index];
+            return;
+        }
+
+        int row = bits == 8 ? 0 : bits == 16 ? 1 : bits == 32 ? 2 : 3;
+        out += gpr_names[row][index & 15];
+    }
+
+    void append_vector(std::string& out, const X86Instruction& in, int index)
+    {
+        const char* prefix = in.vex_l == 2 ? "zmm" : in.vex_l == 1 ? "ymm" : "xmm";
+        out += prefix;
+        out += std::to_string(index);
+    }
+
+    int size_bits(char size, const X86Instruction& in)
+    {
+        switch(size)
+        {
+        case 'b': return 8;
+        case 'w': return 16;
+        case 'd': return 32;
+        case 'q': return 64;
+        case 't': return 80;
+        case 'v': return in.operand_bits;
+        case 'y': return in.operand_bits == 64 ? 64 : 32;
+        case 'z': return in.operand_bits == 16 ? 16 : 32;
+        }
+
+        return 0;
+    }
+
+    uint64_t address_mask(const X86Instruction& in)
+    {
+        return in.address_bits == 64 ? UINT64_MAX : (uint64_t(1) << in.address_bits) - 1;
+    }
+
+    void append_size(std::string& out, int bits)
+    {
+        switch(bits)
+        {
+        case 8: out += "byte ptr "; break;
+        case 16: out += "word ptr "; break;
+        case 32: out += "dword ptr "; break;
+        case 64: out += "qword ptr "; break;
+        case 80: out += "tbyte ptr "; break;
+        }
+    }
+
+    void append_segment(std::string& out, const X86Instruction& in)
+    {
+        const uint8_t bytes[6] = { 0x26, 0x2E, 0x36, 0x3E, 0x64, 0x65 };
+
+        for (int i = 0; i < 6; ++i)
+        {
+            if(bytes[i] == in.segment)
+            {
+                out += segment_names[i];
+                out += ':';
+            }
+        }
+    }
+
+    void append_displacement(std::string& out, int64_t displacement, bool first)
+    {
+        if(displacement < 0)
+        {
+            out += '-';
+            append_hex(out, uint64_t(0) - uint64_t(displacement));
+        }
+        else
+        {
+            if(!first)
+                out += '+';
+
+            append_hex(out, uint64_t(displacement));
+        }
+    }
+
+    // Memory operand, rip_target is set for RIP relative addressing
+    void append_memory(std::string& out, const X86Instruction& in, int bits, uint64_t address, uint64_t& rip_target)
+    {
+        append_size(out, bits);
+
+        append_segment(out, in);
+        out += '[';
+
+        uint8_t mod = in.modrm >> 6;
+        uint8_t rm = in.modrm & 7;
+
+        if(in.address_bits == 16)
+        {
+            const char* bases[8] = { "bx+si", "bx+di", "bp+si", "bp+di", "si", "di", "bp", "bx" };
+
+            if(mod == 0 && rm == 6)
+            {
+                append_hex(out, uint64_t(in.displacement) & 0xFFFF);
+            }
+            else
+            {
+                out += bases[rm];
+                if(in.displacement_size)
+                    append_displacement(out, in.displacement, false);
+            }
+
+            out += ']';
+            return;
+        }
+
+        int row = in.address_bits == 64 ? 3 : 2;
+        bool first = true;
+
+        if(in.has_sib)
+        {
+            int base = (in.sib & 7) | ((in.rex & 1) << 3);
+            int index = ((in.sib >> 3) & 7) | ((in.rex & 2) << 2);
+            int scale = 1 << (in.sib >> 6);
+
+            if(!(mod == 0 && (in.sib & 7) == 5))
+            {
+                out += gpr_names[row][base];
+                first = false;
+            }
+
+            if(index != 4)
+            {
+                if(!first)
+                    out += '+';
+
+                out += gpr_names[row][index];
+                if(scale > 1)
+                {
+                    out += '*';
+                    out += char('0' + scale);
+                }
+
+                first = false;
+            }
+        }
+        else if(mod == 0 && rm == 5)
+        {
+            if(in.x64)
+            {
+                out += in.address_bits == 64 ? "rip" : "eip";
+                first = false;
+                rip_target = (address + in.length + uint64_t(in.displacement)) & address_mask(in);
+            }
+        }
+        else
+        {
+            out += gpr_names[row][rm | ((in.rex & 1) << 3)];
+            first = false;
+        }
+
+        if(first)
+            append_hex(out, uint64_t(in.displacement) & address_mask(in));
+        else if(in.displacement_size && in.displacement != 0)
+            append_displacement(out, in.displacement, false);
+
+        out += ']';
+    }
+}
+
+uint64_t x86_branch_target(const X86Instruction& instruction, uint64_t address)
+{
+    if(!instruction.relative)
+        return 0;
+
+    uint64_t target = address + instruction.length + uint64_t(sign_extend(instruction.immediate, instruction.immediate_size));
+    return instruction.x64 ? target : (target & 0xFFFFFFFF);
+}
+
+void x86_format(const X86Instruction& in, uint64_t address, std::string& out)
+{
+    out.clear();
+
+    if(in.lock)
+        out += "lock ";
+
+    if(in.string_op && in.rep)
+        out += "rep ";
+    else if(in.string_op && in.repne)
+        out += "repne ";
+
+    // Conditional branches, set and cmov share the condition code table
+    if(in.mnemonic == nullptr && !in.vex && !in.evex && ((in.map == 0 && (in.opcode & 0xF0) == 0x70) || (in.map == 1 && (in.opcode & 0xF0) == 0x80)))
+    {
+        out += 'j';
+        out += condition_codes[in.opcode & 15];
+    }
+    else if(in.mnemonic == nullptr && in.map == 1 && !in.vex && !in.evex && (in.opcode & 0xF0) == 0x90)
+    {
+        out += "set";
+        out += condition_codes[in.opcode & 15];
+    }
+    else if(in.mnemonic == nullptr && in.map == 1 && !in.vex && !in.evex && (in.opcode & 0xF0) == 0x40)
+    {
+        out += "cmov";
+        out += condition_codes[in.opcode & 15];
+    }
+    else if(in.mnemonic == nullptr)
+    {
+        // Sized correctly but not in the tables, name it by its encoding
+        char buffer[48];
+        const char* maps[4] = { "", "0f ", "0f38 ", "0f3a " };
+        const char* kind = in.evex ? "evex " : in.vex ? "vex " : "";
+
+        snprintf(buffer, sizeof(buffer), "(%s%s%02x)", kind, in.map < 4 ? maps[in.map] : "", in.opcode);
+        out += buffer;
+        return;
+    }
+    else
+    {
+        if((in.vex || in.evex) && in.map != 0)
+            out += 'v';
+
+        out += in.mnemonic;
+    }
+
+    // Vector registers and mmx/xmm selection
+    bool xmm_form = in.vex || in.evex || in.mandatory_prefix != 0;
+
+    int reg = ((in.modrm >> 3) & 7) | ((in.rex & 4) << 1);
+    int rm = (in.modrm & 7) | ((in.rex & 1) << 3);
+    bool memory = in.has_modrm && (in.modrm >> 6) != 3;
+
+    uint64_t rip_target = 0;
+    int immediate_index = 0;
+    bool first = true;
+
+    char token[8];
+    const char* spec = in.operands;
+    while(next_token(spec, token, sizeof(token)))
+    {
+        out += first ? " " : ", ";
+        first = false;
+
+        if(strcmp(token, "AL") == 0) { out += "al"; continue; }
+        if(strcmp(token, "CL") == 0) { out += "cl"; continue; }
+        if(strcmp(token, "DX") == 0) { out += "dx"; continue; }
+        if(strcmp(token, "AX") == 0) { out += "ax"; continue; }
+        if(strcmp(token, "1") == 0) { out += "1"; continue; }
+        if(strcmp(token, "ST") == 0) { out += "st"; continue; }
+        if(strcmp(token, "STi") == 0) { out += "st("; out += char('0' + (in.modrm & 7)); out += ')'; continue; }
+        if(strcmp(token, "rAX") == 0) { append_gpr(out, in, in.operand_bits, 0); continue; }
+        if(strcmp(token, "eAX") == 0) { append_gpr(out, in, in.operand_bits == 16 ? 16 : 32, 0); continue; }
+
+        int bits = size_bits(token[1], in);
+
+        switch(token[0])
+        {
+        case 'E':
+            if(memory)
+                append_memory(out, in, bits, address, rip_target);
+            else
+                append_gpr(out, in, bits, rm);
+            break;
+        case 'M':
+            append_memory(out, in, bits, address, rip_target);
+            break;
+        case 'G':
+            append_gpr(out, in, bits, reg);
+            break;
+        case 'R':
+            append_gpr(out, in, token[1] == 'y' ? (in.x64 ? 64 : 32) : bits, rm);
+            break;
+        case 'Z':
+            append_gpr(out, in, bits, (in.opcode & 7) | ((in.rex & 1) << 3));
+            break;
+        case 'S':
+            out += segment_names[(in.modrm >> 3) & 7];
+            break;
+        case 'C':
+            out += "cr";
+            out += std::to_string(reg);
+            break;
+        case 'D':
+            out += "dr";
+            out += std::to_string(reg);
+            break;
+        case 'V':
+            append_vector(out, in, reg);
+            break;
+        case 'H':
+            append_vector(out, in, in.vex_v);
+            break;
+        case 'W':
+        case 'U':
+            if(memory)
+                append_memory(out, in, 0, address, rip_target);
+            else
+                append_vector(out, in, rm);
+            break;
+        case 'P':
+            if(xmm_form)
+                append_vector(out, in, reg);
+            else
+            {
+                out += "mm";
+                out += char('0' + (reg & 7));
+            }
+            break;
+        case 'Q':
+        case 'N':
+            if(memory)
+                append_memory(out, in, 0, address, rip_target);
+            else if(xmm_form)
+                append_vector(out, in, rm);
+            else
+            {
+                out += "mm";
+                out += char('0' + (rm & 7));
+            }
+            break;
+        case 'I':
+            {
+                uint64_t value = immediate_index == 0 ? in.immediate : in.immediate2;
+                size_t size = immediate_index == 0 ? in.immediate_size : in.immediate2_size;
+                ++immediate_index;
+
+                if(token[1] == 's' || (token[1] == 'z' && in.operand_bits == 64))
+                {
+                    value = uint64_t(sign_extend(value, size));
+                    if(in.operand_bits < 64)
+                        value &= (uint64_t(1) << in.operand_bits) - 1;
+                }
+
+                append_hex(out, value);
+            }
+            break;
+        case 'J':
+            ++immediate_index;
+            append_hex(out, x86_branch_target(in, address));
+            break;
+        case 'O':
+            {
+                uint64_t offset = immediate_index == 0 ? in.immediate : in.immediate2;
+                ++immediate_index;
+
+                append_size(out, token[1] == 'b' ? 8 : in.operand_bits);
+                append_segment(out, in);
+                out += '[';
+                append_hex(out, offset);
+                out += ']';
+            }
+            break;
+        case 'A':
+            append_hex(out, in.immediate2);
+            out += ':';
+            append_hex(out, in.immediate);
+            immediate_index += 2;
+            break;
+        default:
+            out += token;
+            break;
+        }
+    }
+
+    if(rip_target)
+    {
+        out += "  ; ";
+        append_hex(out, rip_target);
+    }
+}
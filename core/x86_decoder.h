@@ -0,0 +1,67 @@
+/*
+* Table driven x86/x64 instruction decoder
+* Decodes prefixes, opcode maps (one byte, 0F, 0F38, 0F3A, VEX and EVEX), ModRM/SIB, displacement and immediates so the
+* length is exact for linear sweep. Mnemonics cover the general purpose, x87 and common SSE/AVX instructions, anything
+* else is still sized correctly and printed by its opcode.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct X86Instruction
+{
+    uint8_t length = 0;
+
+    // Prefixes
+    uint8_t segment = 0;      // Override prefix byte, 0 if none
+    bool lock = false;
+    bool rep = false;         // F3
+    bool repne = false;       // F2
+    bool operand_size = false; // 66
+    bool address_size = false; // 67
+    uint8_t rex = 0;          // 0x40-0x4F, VEX/EVEX fill in the equivalent bits, 0 if none
+    uint8_t mandatory_prefix = 0; // 66, F3 or F2 when it selects the instruction instead of modifying it
+
+    // VEX/EVEX
+    bool vex = false;
+    bool evex = false;
+    uint8_t vex_l = 0;        // Vector length, 0 = 128, 1 = 256, 2 = 512
+    uint8_t vex_v = 0;        // Extra source register (already inverted)
+    bool vex_w = false;
+
+    uint8_t map = 0;          // 0 = one byte, 1 = 0F, 2 = 0F38, 3 = 0F3A
+    uint8_t opcode = 0;
+
+    bool has_modrm = false;
+    uint8_t modrm = 0;
+    bool has_sib = false;
+    uint8_t sib = 0;
+
+    uint8_t displacement_size = 0;
+    int64_t displacement = 0;
+
+    uint8_t immediate_size = 0;
+    uint64_t immediate = 0;
+    uint8_t immediate2_size = 0; // ENTER and far pointers carry a second immediate
+    uint64_t immediate2 = 0;
+
+    // Resolved by the decoder, the formatter only reads these
+    const char* mnemonic = nullptr;
+    const char* operands = nullptr; // Operand spec, see x86_decoder.cpp
+    uint8_t operand_bits = 32;
+    uint8_t address_bits = 64;
+    bool x64 = false;
+    bool relative = false;    // Branch with a target relative to the next instruction
+    bool string_op = false;   // Takes rep/repne
+};
+
+// Decodes one instruction, returns false if the bytes don't form a valid instruction (out.length is then 1)
+bool x86_decode(const uint8_t* code, size_t size, bool x64, X86Instruction& out);
+
+// Intel syntax text, address is where the instruction lives so relative targets can be resolved
+void x86_format(const X86Instruction& instruction, uint64_t address, std::string& out);
+
+// Target of a relative branch or call, 0 if the instruction has none
+uint64_t x86_branch_target(const X86Instruction& instruction, uint64_t address);
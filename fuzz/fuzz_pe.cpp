@@ -0,0 +1,107 @@
+/*
+* libFuzzer target for the PE parser
+* Runs every parser over the input on the calling thread, anything the sanitizers or an unbounded allocation catch is a bug.
+*/
+
+#include "../PE/PE.h"
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    std::shared_ptr<ByteSource> source = ByteSource::from_memory(data, size);
+
+    PE pe(*source);
+    pe.set_thread_pool(nullptr);
+
+    pe.get_diagnostics();
+    if(pe.get_error() != nullptr)
+        return 0;
+
+    Span<IMAGE_SECTION_HEADER> sections = pe.get_sections();
+    for (const IMAGE_SECTION_HEADER& section : sections)
+    {
+        pe.get_section_name(section);
+        pe.rva_to_offset(section.VirtualAddress);
+        pe.get_section_by_rva(section.VirtualAddress + section.Misc.VirtualSize);
+        pe.offset_to_rva(section.PointerToRawData);
+    }
+
+    pe.get_imports();
+    pe.get_exports();
+    pe.get_relocations();
+    // Every decoder through the flat list, then the first entries of the lazy walk
+    for (const PEResource& resource : pe.get_resources())
+        pe.decode_resource(resource.type.id, resource.name.id, resource.rva, resource.size);
+
+    // Directories that point back at each other would otherwise keep a batch job in the walk for hours
+    if(pe.get_resource_entries_read() > PE_MAX_RESOURCE_ENTRIES)
+        std::abort();
+
+    PEResourceNode node;
+    IMAGE_RESOURCE_DATA_ENTRY resource_data;
+    for (uint32_t i = 0; i < 16 && pe.get_resource_entry(0, i, node); ++i)
+    {
+        if(node.directory)
+            pe.get_resource_entry_count(node.offset);
+        else
+            pe.get_resource_data(node.offset, resource_data);
+    }
+
+    pe.get_tls();
+    pe.get_debug_entries();
+    pe.get_exception_entries();
+
+    uint64_t start;
+    uint64_t end;
+    pe.describe_offset(size / 2, start, end);
+
+    StringScanOptions options;
+    pe.set_string_options(options);
+    pe.get_string_index(true).search("a", SearchMode::Substring);
+
+    pe.get_entropy();
+    pe.get_hashes();
+
+    // Embedded executables are parsed through a slice like the GUI opens them, and the whole input is carved again with the
+    // smallest buffer so magics land across chunk boundaries
+    pe.get_overlay();
+    for (const CarvedPayload& payload : pe.get_payloads())
+    {
+        if(payload.kind != PayloadKind::PE)
+            continue;
+
+        std::unique_ptr<ByteSource> slice = ByteSource::slice(source, payload.offset, payload.size);
+        PE embedded(*slice);
+        embedded.get_sections();
+        embedded.get_imports();
+        embedded.get_overlay();
+    }
+
+    CarveOptions carve_options;
+    carve_options.buffer_size = 0;
+    carve_payloads(*source, 0, size, carve_options);
+
+    // A few instructions from the start of each executable section
+    for (int32_t i = 0; i < static_cast<int32_t>(sections.size()); ++i)
+    {
+        Disassembly* disassembly = pe.get_disassembly(i);
+        if(disassembly == nullptr)
+            continue;
+
+        Disassembly::Position position = disassembly->locate(disassembly->address());
+        for (int n = 0; n < 64; ++n)
+        {
+            X86Instruction instruction;
+            uint8_t bytes[16];
+            disassembly->instruction(position, instruction, bytes);
+
+            std::string text;
+            x86_format(instruction, disassembly->address_of(position), text);
+
+            if(!disassembly->next(position))
+                break;
+        }
+    }
+
+    return 0;
+}
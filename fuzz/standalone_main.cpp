@@ -0,0 +1,33 @@
+/*
+* Replays inputs through the fuzz target when the compiler has no libFuzzer (GCC, MSVC)
+* Each argument is a file to run, crashes found elsewhere reproduce here under a debugger or sanitizer build.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if(!file)
+        {
+            std::fprintf(stderr, "Can't open %s\n", argv[i]);
+
+            return 1;
+        }
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+
+        std::printf("%s: ok\n", argv[i]);
+    }
+
+    return 0;
+}
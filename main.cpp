@@ -1,13 +1,23 @@
-#include <fstream>
 #include <inttypes.h>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
 
 #include <GLFW/glfw3.h>
+#include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
 #include <vector>
 
 #include "PE/PE.h"
+#include "PE/PE_diff.h"
+#include "ELF/ELF.h"
+#include "core/thread_pool.h"
+#include "core/workspace.h"
+#include "core/profiler.h"
+#include "widgets/widgets.h"
+#include <string>
 #include <iostream>
 #include <iomanip> 
 
@@ -17,46 +27,180 @@ const char* GetArchitectureName(MachineArc machine)
 }
 
 
-int main()
+// Budget for the parsed state of open files before background ones are dropped, --memory-budget <MB> overrides it
+static const uint64_t default_memory_budget = 1024ull << 20;
+
+static std::vector<std::string> dropped_paths;
+
+static void drop_callback(GLFWwindow*, int count, const char** paths)
 {
-    if (!glfwInit())
-    {
-        std::printf("Failed to initialize GLFW!");
+    for (int i = 0; i < count; ++i)
+        dropped_paths.emplace_back(paths[i]);
+}
 
-        return -1;
+// The one place the GUI looks at which backend a document has, the panels themselves are on the concrete classes
+static void render_document(BinaryFormat& binary, bool sidebar)
+{
+    switch (binary.kind())
+    {
+        case BinaryKind::ELF:
+        {
+            ELF& elf = static_cast<ELF&>(binary);
+            sidebar ? elf.render_sidebar() : elf.render_main();
+            break;
+        }
+        default:
+        {
+            PE& pe = static_cast<PE&>(binary);
+            sidebar ? pe.render_sidebar() : pe.render_main();
+        }
     }
+}
 
-    std::fstream file("/home/user/Downloads/DiscordSetup.exe", std::ios::in | std::ios::binary);
+// Timed scopes, counters and frame times, the window the "Performance" button opens
+static void render_performance(bool& open, std::string& trace_path, std::string& trace_status)
+{
+    if(!ImGui::Begin("Performance", &open))
+    {
+        ImGui::End();
 
-    if(!file.is_open())
+        return;
+    }
+
+    if(!Profiler::enabled())
     {
-        std::printf("Failed to open file\n");
+        ImGui::TextDisabled("Built without BINARYVIEW_PROFILING");
+        ImGui::End();
 
-        return -1;
+        return;
     }
 
-    PE pe(file);
+    // CPU time of the frame, waiting for vsync isn't included
+    ProfileFrameStats frames = Profiler::frames();
+    ImGui::Text("Last %zu frames: p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms", frames.frames, frames.p50, frames.p90, frames.p99, frames.max);
 
-    IMAGE_DOS_HEADER* dos = pe.get_dos();
-    if(dos == nullptr)
+    if(ImGui::Button("Reset"))
+        Profiler::reset();
+
+    ImGui::SameLine();
+    if(ImGui::Button("Save trace"))
     {
-        std::printf("Executeable isn't in DOS format!\n");
+        std::string error;
+        trace_status = Profiler::write_trace(trace_path, error) ? "Saved " + trace_path : error;
+    }
 
-        return -1;
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1);
+    ImGui::InputTextWithHintR("Trace file", trace_path);
+
+    if(!trace_status.empty())
+        ImGui::TextDisabled("%s", trace_status.c_str());
+
+    std::vector<ProfileScopeStats> scopes = Profiler::scopes();
+    if(ImGui::BeginTable("scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total ms");
+        ImGui::TableSetupColumn("Average ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (const ProfileScopeStats& scope : scopes)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", scope.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%" PRIu64, scope.calls);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.2f", scope.total_ns / 1e6);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.3f", scope.total_ns / 1e6 / scope.calls);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%.3f", scope.max_ns / 1e6);
+        }
+
+        ImGui::EndTable();
     }
 
-    IMAGE_NT_HEADERS* nt = pe.get_nt();
-    if(nt == nullptr)
+    if(ImGui::BeginTable("counters", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg))
     {
-        std::printf("Executeable isn't in PE format!\n");
+        ImGui::TableSetupColumn("Counter");
+        ImGui::TableSetupColumn("Value");
+        ImGui::TableHeadersRow();
 
-        return -1;
+        for (const ProfileCounter& counter : Profiler::counters())
+        {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", counter.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%" PRIu64, counter.value);
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+int main(int argc, char** argv)
+{
+    Workspace workspace(ThreadPool::shared(), default_memory_budget, default_cache_directory());
+
+    // Comparisons are tabs of their own after the documents, --diff <old> <new> starts one
+    std::vector<std::unique_ptr<PEDiffSession>> diffs;
+
+    // --trace <file> also writes the trace on exit
+    std::string trace_path = "binaryview-trace.json";
+    bool trace_on_exit = false;
+    std::string trace_status;
+    bool show_performance = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if(std::string(argv[i]) == "--memory-budget" && i + 1 < argc)
+            workspace.set_memory_budget(std::strtoull(argv[++i], nullptr, 10) << 20);
+        else if(std::string(argv[i]) == "--trace" && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+            trace_on_exit = true;
+        }
+        else if(std::string(argv[i]) == "--diff" && i + 2 < argc)
+        {
+            std::unique_ptr<PEDiffSession> diff = PEDiffSession::open(argv[i + 1], argv[i + 2], ThreadPool::shared());
+            if(diff == nullptr)
+            {
+                std::printf("Failed to open %s or %s\n", argv[i + 1], argv[i + 2]);
+
+                return -1;
+            }
+
+            diffs.push_back(std::move(diff));
+            i += 2;
+        }
+        else if(workspace.open(argv[i]) == nullptr)
+        {
+            std::printf("Failed to open %s\n", argv[i]);
+
+            return -1;
+        }
     }
 
-    std::vector<std::string> rdata_strings;
-    std::vector<IMAGE_SECTION_HEADER> sections = pe.get_sections();
+    // Tab to select on the next frame, ImGui otherwise keeps the one the user last clicked
+    size_t select_tab = workspace.active_index();
 
-   
+    // Documents picked in the compare popup
+    size_t compare_old = 0;
+    size_t compare_new = 1;
+
+    if (!glfwInit())
+    {
+        std::printf("Failed to initialize GLFW!");
+
+        return -1;
+    }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 #if defined(__APPLE__)
@@ -92,6 +236,7 @@ int main()
         return -1;
     }
 
+    glfwSetDropCallback(window, drop_callback);
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
 
@@ -108,6 +253,20 @@ int main()
     {
         glfwPollEvents();
 
+        uint64_t frame_start = Profiler::now();
+
+        for (const std::string& path : dropped_paths)
+        {
+            if(workspace.open(path) != nullptr)
+                select_tab = workspace.active_index();
+        }
+        dropped_paths.clear();
+
+        {
+            PROFILE_SCOPE("Workspace::update");
+            workspace.update();
+        }
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -120,24 +279,163 @@ int main()
 
         ImGui::Begin("BinaryView", nullptr, ImGuiWindowFlags_NoTitleBar);
         {
-            ImGui::BeginChild("Sidebar", ImVec2(200, 0), true, ImGuiWindowFlags_HorizontalScrollbar);
+            if(workspace.size() == 0 && diffs.empty())
+                ImGui::TextDisabled("Drop files here to open them");
+
+            if(ImGui::Button("Performance"))
+                show_performance = !show_performance;
+
+            if(workspace.size() >= 2)
+                ImGui::SameLine();
+
+            if(workspace.size() >= 2)
+            {
+                if(ImGui::Button("Compare..."))
+                    ImGui::OpenPopup("Compare");
+
+                if(ImGui::BeginPopup("Compare"))
+                {
+                    auto pick_document = [&workspace](const char* label, size_t& selected)
+                    {
+                        selected = std::min(selected, workspace.size() - 1);
+
+                        if(ImGui::BeginCombo(label, workspace.document(selected).name.c_str()))
+                        {
+                            for (size_t i = 0; i < workspace.size(); ++i)
+                            {
+                                ImGui::PushID(static_cast<int>(i));
+                                if(ImGui::Selectable(workspace.document(i).name.c_str(), i == selected))
+                                    selected = i;
+                                ImGui::PopID();
+                            }
+
+                            ImGui::EndCombo();
+                        }
+                    };
+
+                    pick_document("Old", compare_old);
+                    pick_document("New", compare_new);
+
+                    if(ImGui::Button("Diff") && compare_old != compare_new)
+                    {
+                        std::unique_ptr<PEDiffSession> diff = PEDiffSession::open(workspace.document(compare_old).path, workspace.document(compare_new).path, ThreadPool::shared());
+                        if(diff != nullptr)
+                            diffs.push_back(std::move(diff));
+
+                        ImGui::CloseCurrentPopup();
+                    }
+
+                    ImGui::EndPopup();
+                }
+            }
+
+            size_t close_tab = SIZE_MAX;
+            size_t close_diff = SIZE_MAX;
+            size_t open_from = SIZE_MAX; // Document whose view asked to open an embedded file
+
+            if((workspace.size() > 0 || !diffs.empty()) && ImGui::BeginTabBar("Documents", ImGuiTabBarFlags_Reorderable | ImGuiTabBarFlags_FittingPolicyScroll | ImGuiTabBarFlags_AutoSelectNewTabs))
+            {
+                for (size_t i = 0; i < workspace.size(); ++i)
+                {
+                    Document& document = workspace.document(i);
+                    bool open = true;
+
+                    // Tabs are told apart by document, files with the same name can be open at once
+                    ImGui::PushID(&document);
+                    bool selected = ImGui::BeginTabItem(document.name.c_str(), &open, i == select_tab ? ImGuiTabItemFlags_SetSelected : 0);
+                    ImGui::PopID();
+
+                    if(!open)
+                        close_tab = i;
+
+                    if(!selected)
+                        continue;
+
+                    if(i != workspace.active_index() && select_tab == SIZE_MAX)
+                        workspace.activate(i);
+
+                    // Only the active document has a parser once it's over budget, a newly selected one gets it back on the next update()
+                    if(document.binary != nullptr && i == workspace.active_index())
+                    {
+                        ImGui::PushID(&document);
+
+                        ImGui::BeginChild("Sidebar", ImVec2(200, 0), true, ImGuiWindowFlags_HorizontalScrollbar);
+                        {
+                            render_document(*document.binary, true);
+
+                            ImGui::EndChild();
+                        }
+
+                        ImGui::SameLine();
+
+                        ImGui::BeginChild("Content", ImVec2(0, 0), true);
+                        {
+                            render_document(*document.binary, false);
+
+                            ImGui::EndChild();
+                        }
+
+                        ImGui::PopID();
+
+                        if(document.view->openSize != 0)
+                            open_from = i;
+                    }
+
+                    ImGui::EndTabItem();
+                }
+
+                for (size_t i = 0; i < diffs.size(); ++i)
+                {
+                    bool open = true;
+
+                    ImGui::PushID(diffs[i].get());
+                    if(ImGui::BeginTabItem(diffs[i]->title().c_str(), &open))
+                    {
+                        ImGui::BeginChild("Diff", ImVec2(0, 0), true);
+                        {
+                            diffs[i]->render();
+
+                            ImGui::EndChild();
+                        }
+
+                        ImGui::EndTabItem();
+                    }
+                    ImGui::PopID();
+
+                    if(!open)
+                        close_diff = i;
+                }
+
+                ImGui::EndTabBar();
+            }
+
+            if(close_diff != SIZE_MAX)
+                diffs.erase(diffs.begin() + close_diff);
+
+            select_tab = SIZE_MAX;
+
+            // Before closing, which could move the document
+            if(open_from != SIZE_MAX)
             {
-                pe.render_sidebar();
+                Document& parent = workspace.document(open_from);
+                ViewState& request = *parent.view;
 
-                ImGui::EndChild();
+                workspace.open_embedded(parent, request.openOffset, request.openSize, request.openLabel);
+                request.openSize = 0;
+                select_tab = workspace.active_index();
             }
-            
-            ImGui::SameLine();
 
-            ImGui::BeginChild("Content", ImVec2(0, 0), true);
+            if(close_tab != SIZE_MAX)
             {
-                pe.render_main();
-                
-                ImGui::EndChild();
+                workspace.close(close_tab);
+                select_tab = workspace.active_index();
             }
         }
         ImGui::End();
 
+        if(show_performance)
+            render_performance(show_performance, trace_path, trace_status);
+
         ImGui::Render();
         
         glViewport(0, 0, w, h);
@@ -145,9 +443,28 @@ int main()
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        uint64_t frame_time = Profiler::now() - frame_start;
+        if(Profiler::enabled())
+        {
+            Profiler::record("frame", frame_start, frame_time);
+            Profiler::frame(frame_time / 1e6);
+        }
+
         glfwSwapBuffers(window);
     }
 
+    if(trace_on_exit)
+    {
+        std::string error;
+        if(!Profiler::write_trace(trace_path, error))
+            std::printf("%s\n", error.c_str());
+    }
+
+    diffs.clear();
+
+    while(workspace.size() > 0)
+        workspace.close(workspace.size() - 1);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -1,4 +1,5 @@
 #include "widgets.h"
+#include <GLFW/glfw3.h>
 
 static int callback(ImGuiInputTextCallbackData* data)
 {
@@ -15,5 +16,25 @@ static int callback(ImGuiInputTextCallbackData* data)
    
 bool ImGui::InputTextWithHintR(std::string label, std::string& value, const ImVec2& size, ImGuiInputTextFlags flags)
 {
-    return ImGui::InputTextWithHint("##", label.c_str(), (char*)value.data(), value.capacity() + 1, ImGuiInputTextFlags_CallbackResize, callback, &value);
-}
\ No newline at end of file
+    return ImGui::InputTextWithHint(("##" + label).c_str(), label.c_str(), (char*)value.data(), value.capacity() + 1, flags | ImGuiInputTextFlags_CallbackResize, callback, &value);
+}
+
+std::shared_ptr<uint32_t> create_texture(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // Nearest so small icons scale up without blurring
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+    return std::shared_ptr<uint32_t>(new uint32_t(texture), [](uint32_t* id)
+    {
+        GLuint name = *id;
+        glDeleteTextures(1, &name);
+        delete id;
+    });
+}
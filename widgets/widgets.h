@@ -1,7 +1,84 @@
+#pragma once
 #include <imgui.h>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include "../core/background_analysis.h"
 
 namespace ImGui
 {
     bool InputTextWithHintR(std::string, std::string&, const ImVec2& = ImVec2(0, 0), ImGuiInputTextFlags = 0);
-}
\ No newline at end of file
+}
+
+// GL texture of width * height RGBA pixels, deleted with the last reference, which has to go before the GL context does
+std::shared_ptr<uint32_t> create_texture(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+inline ImTextureID texture_id(const std::shared_ptr<uint32_t>& texture)
+{
+    return (ImTextureID)(intptr_t)*texture;
+}
+
+inline float list_height(size_t rows)
+{
+    // Lists get a fixed window of rows so the clipper has a scroll region to work with
+    return ImGui::GetTextLineHeightWithSpacing() * static_cast<float>(rows < 24 ? rows + 2 : 26);
+}
+
+// Scrolling table that only emits the visible rows, row(i) fills in the columns of row i
+template<typename Row>
+void clipped_table(const char* id, std::initializer_list<const char*> columns, size_t rows, Row&& row)
+{
+    if (!ImGui::BeginTable(id, static_cast<int>(columns.size()), ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, ImVec2(0, list_height(rows))))
+        return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    for (const char* column : columns)
+        ImGui::TableSetupColumn(column);
+    ImGui::TableHeadersRow();
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(rows));
+
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+            ImGui::TableNextRow();
+            row(static_cast<size_t>(i));
+        }
+    }
+
+    ImGui::EndTable();
+}
+
+// Shows the stage's progress in place of a panel until the background analysis has published its results
+template<typename Stage>
+bool stage_ready(const BackgroundAnalysis* analysis, Stage stage, const char* panel)
+{
+    if(analysis == nullptr)
+        return true;
+
+    size_t index = static_cast<size_t>(stage);
+
+    switch (analysis->state(index))
+    {
+        case StageState::Done:
+            return true;
+        case StageState::Failed:
+            ImGui::TextDisabled("%s: %s", panel, analysis->error(index));
+            break;
+        case StageState::Cancelled:
+            ImGui::TextDisabled("%s: cancelled", panel);
+            break;
+        default:
+        {
+            char overlay[64];
+            std::snprintf(overlay, sizeof(overlay), "%s: %s %.0f%%", panel, analysis->stage_name(index), analysis->progress(index) * 100.0f);
+            ImGui::ProgressBar(analysis->progress(index), ImVec2(-1, 0), overlay);
+        }
+    }
+
+    return false;
+}